@@ -62,25 +62,7 @@ bool AudioGeneratorWAVLoop::freeBuf()
 }
 
 // Handle buffered reading, reload each time we run out of data
-bool AudioGeneratorWAVLoop::GetBufferedData16x2(int16_t& destL, int16_t& destR)
-{
-    if(buffPtr >= buffLen) {
-        buffPtr = 0;
-        //uint32_t toRead = availBytes > buffSize ? buffSize : availBytes;
-        //buffLen = file->read( buff, toRead );
-        //availBytes -= buffLen;
-        buffLen = file->read( buff, buffSize );
-        if(buffPtr >= buffLen)
-            return false; // No data left!
-    }
-    destL = *(int16_t *)(buff+buffPtr);
-    buffPtr += 2;
-    destR = *(int16_t *)(buff+buffPtr);
-    buffPtr += 2;
-    return true;
-}
-
-bool AudioGeneratorWAVLoop::GetBufferedData16(int16_t& dest)
+bool AudioGeneratorWAVLoop::GetBufferedData8(uint8_t& dest)
 {
     if(buffPtr >= buffLen) {
         buffPtr = 0;
@@ -91,49 +73,58 @@ bool AudioGeneratorWAVLoop::GetBufferedData16(int16_t& dest)
         if(buffPtr >= buffLen)
             return false; // No data left!
     }
-    dest = *(int16_t *)(buff+buffPtr);
-    buffPtr += 2;
+    dest = (uint8_t)buff[buffPtr++];
     return true;
 }
 
-bool AudioGeneratorWAVLoop::GetBufferedData8(uint8_t& dest)
+// TW: Reload buffer if less than one full frame is left.
+// A trailing partial frame is dropped.
+bool AudioGeneratorWAVLoop::FillBuffer16(uint16_t frameBytes)
 {
-    if(buffPtr >= buffLen) {
-        buffPtr = 0;
-        //uint32_t toRead = availBytes > buffSize ? buffSize : availBytes;
-        //buffLen = file->read( buff, toRead );
-        //availBytes -= buffLen;
-        buffLen = file->read( buff, buffSize );
-        if(buffPtr >= buffLen)
-            return false; // No data left!
-    }
-    dest = (uint8_t)buff[buffPtr++];
-    return true;
+    if(buffLen - buffPtr >= frameBytes)
+        return true;
+    buffPtr = 0;
+    buffLen = file->read( buff, buffSize );
+    return (buffLen >= frameBytes);
 }
 
 bool AudioGeneratorWAVLoop::loop()
 {
+    size_t avail, taken;
+    
     if(!running) goto done; // Nothing to do here!
 
-    // First, try and push in the stored sample.  If we can't, then punt and try later
-    if(!output->ConsumeSample(sL, sR)) goto done; // Can't send, but no error detected
-
-    // Try and stuff the buffer one sample at a time
-    // TW: Unroll this
+    // TW: 16 bit data is handed to the output in blocks, straight
+    // from our buffer. Stop when the output can't take it all.
     if(bitsPerSample == 16) {
         if(channels == 2) {
             do
             {
-                if(!GetBufferedData16x2(sL, sR)) stop();
-            } while (running && output->ConsumeSample(sL, sR));
+                if(!FillBuffer16(4)) { stop(); break; }
+                avail = (buffLen - buffPtr) / 4;
+                taken = output->ConsumeSamples((const int16_t *)(buff + buffPtr), avail);
+                buffPtr += taken * 4;
+            } while (running && taken == avail);
         } else {
-            sR = 0;
+            int16_t blk[2*32];
             do
             {
-                if(!GetBufferedData16(sL)) stop();
-            } while (running && output->ConsumeSample(sL, sR));
+                if(!FillBuffer16(2)) { stop(); break; }
+                avail = (buffLen - buffPtr) / 2;
+                if(avail > 32) avail = 32;
+                const int16_t *s = (const int16_t *)(buff + buffPtr);
+                for(size_t i = 0; i < avail; i++) {
+                    blk[i*2] = s[i];
+                    blk[i*2+1] = 0;
+                }
+                taken = output->ConsumeSamples(blk, avail);
+                buffPtr += taken * 2;
+            } while (running && taken == avail);
         }
     } else if(bitsPerSample == 8) {
+        // First, try and push in the stored sample.  If we can't, then punt and try later
+        if(!output->ConsumeSample(sL, sR)) goto done; // Can't send, but no error detected
+        
         uint8_t l, r = 0;
         do
         {
@@ -43,8 +43,7 @@ class AudioGeneratorWAVLoop : public AudioGenerator
     bool ReadU32(uint32_t *dest) { return file->read(reinterpret_cast<uint8_t*>(dest), 4); }
     bool ReadU16(uint16_t *dest) { return file->read(reinterpret_cast<uint8_t*>(dest), 2); }
     bool ReadU8(uint8_t *dest) { return file->read(reinterpret_cast<uint8_t*>(dest), 1); }
-    bool GetBufferedData16x2(int16_t& destL, int16_t& destR);
-    bool GetBufferedData16(int16_t& dest);
+    bool FillBuffer16(uint16_t frameBytes);
     bool GetBufferedData8(uint8_t& dest);
     bool ReadWAVInfo();
 
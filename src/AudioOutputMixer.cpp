@@ -0,0 +1,301 @@
+/*
+  AudioOutputMixer
+  Mixes the output of one generator with a number of PCM voices
+  from memory and passes the result on to another AudioOutput
+
+  Copyright (C) 2025 Thomas Winischhofer (A10001986)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "AudioOutputMixer.h"
+
+static inline int32_t toQ15(float f)
+{
+    if(f <= 0.0f) return 0;
+    if(f >= 1.0f) return 32767;
+    return (int32_t)(f * 32768.0f);
+}
+
+static inline int16_t sat16(int32_t v)
+{
+    if(v > 32767) return 32767;
+    if(v < -32768) return -32768;
+    return (int16_t)v;
+}
+
+AudioOutputMixer::AudioOutputMixer(AudioOutput *sink)
+{
+    this->sink = sink;
+    sinkOn = mainOn = false;
+    hertz = MIX_VOICE_RATE;
+    bps = 16;
+    channels = 2;
+    mainGain = mainTarget = 32767;
+    for(int i = 0; i < maxVoices; i++) {
+        voice[i].pcm = NULL;
+    }
+    numVoices = 0;
+    voiceSeq = 0;
+    blkOut = blkIn = 0;
+}
+
+bool AudioOutputMixer::SetRate(int hz)
+{
+    // Voices can only be mixed into a stream of their own rate
+    if(hz != MIX_VOICE_RATE) stopVoices();
+    hertz = hz;
+    return sink->SetRate(hz);
+}
+
+bool AudioOutputMixer::SetBitsPerSample(int bits)
+{
+    // Generators convert to 16 bit themselves
+    if(bits != 16 && bits != 8) return false;
+    bps = bits;
+    return true;
+}
+
+bool AudioOutputMixer::SetChannels(int chan)
+{
+    // Output to sink is always stereo
+    if(chan < 1 || chan > 2) return false;
+    channels = chan;
+    return true;
+}
+
+bool AudioOutputMixer::SetGain(float f1, int mutechnls)
+{
+    // Gain of main stream; sink stays at 1.0
+    (void)mutechnls;
+    mainTarget = toQ15(f1);
+    // No ramp if nothing is playing
+    if(!mainOn) mainGain = mainTarget;
+    return true;
+}
+
+bool AudioOutputMixer::ensureSink()
+{
+    if(sinkOn) return true;
+    sink->SetRate(hertz);
+    sink->SetBitsPerSample(16);
+    sink->SetChannels(2);
+    blkOut = blkIn = 0;
+    sinkOn = sink->begin();
+    return sinkOn;
+}
+
+bool AudioOutputMixer::begin()
+{
+    mainOn = true;
+    return ensureSink();
+}
+
+bool AudioOutputMixer::stop()
+{
+    mainOn = false;
+
+    // Drop what is left of the main stream
+    blkOut = blkIn = 0;
+
+    // Keep the sink running as long as voices are playing
+    if(numVoices) return true;
+
+    if(sinkOn) {
+        sink->stop();
+        sinkOn = false;
+    }
+    return true;
+}
+
+bool AudioOutputMixer::playVoice(const int16_t *pcm, uint32_t len, float gain, uint8_t prio)
+{
+    mixVoice *v = NULL;
+
+    if(!pcm || !len) return false;
+
+    if(mainOn) {
+        if(hertz != MIX_VOICE_RATE) return false;
+    } else if(hertz != MIX_VOICE_RATE) {
+        hertz = MIX_VOICE_RATE;
+        sink->SetRate(hertz);
+    }
+
+    for(int i = 0; i < maxVoices; i++) {
+        if(!voice[i].pcm) {
+            v = &voice[i];
+            break;
+        }
+    }
+
+    if(!v) {
+        // Steal the oldest voice of lowest priority
+        for(int i = 0; i < maxVoices; i++) {
+            if(voice[i].prio > prio) continue;
+            if(!v || voice[i].prio < v->prio ||
+               (voice[i].prio == v->prio && (int32_t)(voice[i].seq - v->seq) < 0)) {
+                v = &voice[i];
+            }
+        }
+        if(!v) return false;
+        numVoices--;
+    }
+
+    if(!ensureSink()) return false;
+
+    v->len = len;
+    v->pos = 0;
+    v->gain = toQ15(gain);
+    v->prio = prio;
+    v->seq = voiceSeq++;
+    v->pcm = pcm;
+    numVoices++;
+
+    return true;
+}
+
+void AudioOutputMixer::stopVoices()
+{
+    for(int i = 0; i < maxVoices; i++) {
+        voice[i].pcm = NULL;
+    }
+    numVoices = 0;
+}
+
+// Mix n (<= blkLen) frames from in (interleaved L/R, NULL for
+// silence) and all active voices into blk. Gains are Q15; voice 
+// sum and main stream are added before saturation, in Q13 so that
+// the main stream and three voices at full scale can't overflow.
+// If the main gain changed, it is ramped over this block; the
+// ramp runs in Q23 (ga) so that short blocks step smoothly.
+void AudioOutputMixer::mixBlock(const int16_t *in, int n)
+{
+    int32_t vsum[blkLen];
+    int16_t *d = blk;
+    int32_t ga = mainGain << 8, gstep = 0;
+
+    if(in && mainTarget != mainGain) {
+        gstep = ((mainTarget - mainGain) << 8) / n;
+        // Land on target with the last frame
+        ga = (mainTarget << 8) - gstep * n;
+        mainGain = mainTarget;
+    }
+
+    if(numVoices) {
+        memset(vsum, 0, n * sizeof(int32_t));
+        for(int k = 0; k < maxVoices; k++) {
+            mixVoice *v = &voice[k];
+            if(!v->pcm) continue;
+            const int16_t *p = v->pcm + v->pos;
+            int32_t g = v->gain;
+            uint32_t cnt = v->len - v->pos;
+            if(cnt > (uint32_t)n) cnt = n;
+            for(uint32_t i = 0; i < cnt; i++) {
+                vsum[i] += (p[i] * g) >> 2;
+            }
+            v->pos += cnt;
+            if(v->pos >= v->len) {
+                v->pcm = NULL;
+                numVoices--;
+            }
+        }
+        if(in) {
+            int step = (channels == 1) ? 0 : 1;
+            for(int i = 0; i < n; i++, in += 2) {
+                int32_t g = (ga += gstep) >> 8;
+                *d++ = sat16((((in[0] * g) >> 2) + vsum[i]) >> 13);
+                *d++ = sat16((((in[step] * g) >> 2) + vsum[i]) >> 13);
+            }
+        } else {
+            for(int i = 0; i < n; i++) {
+                d[0] = d[1] = sat16(vsum[i] >> 13);
+                d += 2;
+            }
+        }
+    } else if(in) {
+        // Main stream only: Gain <= 1.0, no saturation needed
+        int step = (channels == 1) ? 0 : 1;
+        if(!gstep) {
+            int32_t g = mainGain;
+            for(int i = 0; i < n; i++, in += 2) {
+                *d++ = (in[0] * g) >> 15;
+                *d++ = (in[step] * g) >> 15;
+            }
+        } else {
+            for(int i = 0; i < n; i++, in += 2) {
+                int32_t g = (ga += gstep) >> 8;
+                *d++ = (in[0] * g) >> 15;
+                *d++ = (in[step] * g) >> 15;
+            }
+        }
+    } else {
+        memset(blk, 0, n * 2 * sizeof(int16_t));
+    }
+
+    blkOut = 0;
+    blkIn = n;
+}
+
+// Hand pending mixed frames to sink; true if all are gone
+bool AudioOutputMixer::flushBlk()
+{
+    if(blkOut < blkIn) {
+        blkOut += sink->ConsumeSamples(&blk[blkOut * 2], blkIn - blkOut);
+        if(blkOut < blkIn) return false;
+    }
+    blkOut = blkIn = 0;
+    return true;
+}
+
+size_t AudioOutputMixer::ConsumeSample(int16_t sL, int16_t sR)
+{
+    int16_t s[2] = { sL, sR };
+    return ConsumeSamples(s, 1);
+}
+
+size_t AudioOutputMixer::ConsumeSamples(const int16_t *samples, size_t count)
+{
+    size_t done = 0;
+
+    if(!sinkOn) return 0;
+
+    while(done < count) {
+        if(!flushBlk()) break;
+        int n = (count - done > blkLen) ? blkLen : (int)(count - done);
+        mixBlock(samples + done * 2, n);
+        done += n;
+    }
+    flushBlk();
+
+    return done;
+}
+
+bool AudioOutputMixer::loop()
+{
+    if(!sinkOn) return true;
+
+    if(!mainOn) {
+        // Nobody feeds us; play voices over silence
+        while(numVoices && flushBlk()) {
+            mixBlock(NULL, blkLen);
+        }
+        if(!numVoices && flushBlk()) {
+            sink->stop();
+            sinkOn = false;
+            return true;
+        }
+    }
+
+    return sink->loop();
+}
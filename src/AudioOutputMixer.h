@@ -0,0 +1,90 @@
+/*
+  AudioOutputMixer
+  Mixes the output of one generator with a number of PCM voices
+  from memory and passes the result on to another AudioOutput
+
+  Copyright (C) 2025 Thomas Winischhofer (A10001986)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _AUDIOOUTPUTMIXER_H
+#define _AUDIOOUTPUTMIXER_H
+
+#include "src/ESP8266Audio/AudioOutput.h"
+
+// Voices are mono, 16 bit, at this rate
+#define MIX_VOICE_RATE  44100
+
+class AudioOutputMixer : public AudioOutput
+{
+  public:
+    AudioOutputMixer(AudioOutput *sink);
+    virtual ~AudioOutputMixer() override {};
+    virtual bool SetRate(int hz) override;
+    virtual bool SetBitsPerSample(int bits) override;
+    virtual bool SetChannels(int chan) override;
+    virtual bool SetGain(float f1, int mutechnls = 0) override;
+    virtual bool begin() override;
+    virtual size_t ConsumeSample(int16_t sL, int16_t sR) override;
+    virtual size_t ConsumeSamples(const int16_t *samples, size_t count) override;
+    virtual bool stop() override;
+    virtual bool loop() override;
+
+    // Start a voice. pcm must stay valid while the voice plays.
+    // If all slots are taken, the oldest voice of lowest priority
+    // (which must not be higher than prio) is replaced.
+    bool playVoice(const int16_t *pcm, uint32_t len, float gain, uint8_t prio);
+    void stopVoices();
+    // True while voices play, or without main stream, until the
+    // last mixed block has been handed to the sink
+    bool voicesActive() { return (numVoices > 0) || (sinkOn && !mainOn); }
+
+  protected:
+    static constexpr int maxVoices = 3;
+    static constexpr int blkLen = 64;     // frames
+
+    typedef struct {
+        const int16_t *pcm;
+        uint32_t len;
+        uint32_t pos;
+        int32_t  gain;      // Q15
+        uint8_t  prio;
+        uint32_t seq;
+    } mixVoice;
+
+    void mixBlock(const int16_t *in, int n);
+    bool flushBlk();
+    bool ensureSink();
+
+    AudioOutput *sink;
+    bool sinkOn;
+    bool mainOn;
+
+    // Gain of main stream. SetGain() only sets the target; the
+    // mixer ramps there linearly over one block.
+    int32_t mainGain;       // Q15, current
+    int32_t mainTarget;     // Q15
+
+    mixVoice voice[maxVoices];
+    int numVoices;
+    uint32_t voiceSeq;
+
+    // Mixed block, waiting for sink
+    int16_t blk[blkLen * 2];
+    int blkOut;
+    int blkIn;
+};
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Acceleration profiles
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#include "remote_global.h"
+
+#include <Arduino.h>
+#include "accel.h"
+
+/*
+ * Source curves
+ */
+
+// Linear mode
+static constexpr uint16_t accelDelays[ACCEL_BUCKETS] = { 50, 42, 35, 28, ACCEL_FAST_DELAY };  // 1-100%
+static constexpr uint16_t accelSteps[ACCEL_BUCKETS]  = {  1,  1,  1,  1,  1 };  // 1-100%
+static constexpr uint16_t decelSteps[ACCEL_BUCKETS]  = {  1,  1,  1,  2,  2 };  // 1-100%
+
+/* movie mode
+ *       0- 7:  90ms/mph
+ *      20-24: 197ms/mph
+ *      32-39: 200ms/mph
+ *      55-59: 220ms/mph
+ *      77-81: 300ms/mph
+*/
+static constexpr uint16_t strictAccelFacts[ACCEL_BUCKETS] = { 25, 21, 17, 14, 10 };
+static constexpr uint16_t strictAccelDelays[ACCEL_SPEEDS] =
+{
+      0,  90,  90,  90,  90,  90,  90,  95,  95, 100,  // m0 - 9  10mph  0- 9: 0.83s  (m=measured, i=interpolated)
+    105, 110, 115, 120, 125, 130, 135, 140, 145, 150,  // i10-19  20mph 10-19: 1.27s
+    155, 160, 165, 170, 175, 180, 185, 190, 195, 200,  // i20-29  30mph 20-29: 1.77s
+    200, 200, 202, 203, 204, 205, 206, 207, 208, 209,  // m30-39  40mph 30-39: 2s
+    210, 211, 212, 213, 214, 215, 216, 217, 218, 219,  // i40-49  50mph 40-49: 2.1s
+    220, 221, 222, 223, 224, 225, 226, 227, 228, 229,  // m50-59  60mph 50-59: 2.24s
+    230, 233, 236, 240, 243, 246, 250, 253, 256, 260,  // i60-69  70mph 60-69: 2.47s
+    263, 266, 270, 273, 276, 280, 283, 286, 290, 293,  // m70-79  80mph 70-79: 2.78s
+    296, 300, 300, 303, 303, 306, 310, 310,   0        // i80-88  90mph 80-88: 2.4s   total 17.6 secs
+};
+static constexpr uint16_t strictdecelSteps[ACCEL_BUCKETS]  = {  2,  2,  2,  2,  2 };  // 1-100%
+#define STRICT_DECEL_MIN_DELAY 13
+
+static const int16_t coastCurve[ACCEL_SPEEDS][2] =
+{
+    {6, 2}, {6, 2}, {6, 2}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 4}, // 0 
+    {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 3}, {6, 3}, // 10
+    {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, // 20
+    {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, // 30
+    {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, // 40
+    {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, // 50 
+    {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, // 60 
+    {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {5, 1}, {5, 1}, {5, 1}, // 70
+    {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}          // 80
+};
+
+/*
+ * Compile-time table generation
+ *
+ * Each profile is expanded into one flat table of accelEntry, 
+ * indexed by [decel][speed][bucket], so that main_loop only needs 
+ * a single lookup instead of a multiplication and division.
+ * The index sequence is built in log depth in order to stay within 
+ * the compiler's template recursion limit.
+ */
+
+#define ACCEL_TBL_SIZE (2 * ACCEL_SPEEDS * ACCEL_BUCKETS)
+
+template<unsigned... I> struct accelSeq {};
+
+template<class A, class B> struct accelCat;
+template<unsigned... A, unsigned... B> struct accelCat<accelSeq<A...>, accelSeq<B...> > {
+    typedef accelSeq<A..., (sizeof...(A) + B)...> type;
+};
+
+template<unsigned N> struct accelMkSeq {
+    typedef typename accelCat<typename accelMkSeq<N / 2>::type, 
+                              typename accelMkSeq<N - N / 2>::type>::type type;
+};
+template<> struct accelMkSeq<0> { typedef accelSeq<> type; };
+template<> struct accelMkSeq<1> { typedef accelSeq<0> type; };
+
+static constexpr unsigned accIdxBucket(unsigned i) { return i % ACCEL_BUCKETS; }
+static constexpr unsigned accIdxSpeed(unsigned i)  { return (i / ACCEL_BUCKETS) % ACCEL_SPEEDS; }
+static constexpr bool     accIdxDecel(unsigned i)  { return (i / (ACCEL_BUCKETS * ACCEL_SPEEDS)) != 0; }
+
+static constexpr uint16_t movieDelay(unsigned d, bool decel)
+{
+    return (decel && d < STRICT_DECEL_MIN_DELAY) ? STRICT_DECEL_MIN_DELAY : d;
+}
+
+static constexpr accelEntry movieEntry(unsigned i)
+{
+    return accelEntry { 
+        movieDelay(strictAccelDelays[accIdxSpeed(i)] * strictAccelFacts[accIdxBucket(i)] / 100, accIdxDecel(i)),
+        accIdxDecel(i) ? strictdecelSteps[accIdxBucket(i)] : (uint16_t)1 
+    };
+}
+
+static constexpr accelEntry linearEntry(unsigned i)
+{
+    return accelEntry { 
+        accelDelays[accIdxBucket(i)],
+        accIdxDecel(i) ? decelSteps[accIdxBucket(i)] : accelSteps[accIdxBucket(i)] 
+    };
+}
+
+template<class S> struct accelGen;
+template<unsigned... I> struct accelGen<accelSeq<I...> > {
+    static const accelEntry movie[sizeof...(I)];
+    static const accelEntry linear[sizeof...(I)];
+};
+template<unsigned... I> 
+const accelEntry accelGen<accelSeq<I...> >::movie[sizeof...(I)] = { movieEntry(I)... };
+template<unsigned... I> 
+const accelEntry accelGen<accelSeq<I...> >::linear[sizeof...(I)] = { linearEntry(I)... };
+
+typedef accelGen<accelMkSeq<ACCEL_TBL_SIZE>::type> accelTables;
+
+// Spot checks against the source curves
+static_assert(movieEntry(1 * ACCEL_BUCKETS + 0).delay == 22, "movie table broken");
+static_assert(movieEntry(87 * ACCEL_BUCKETS + 4).delay == 31, "movie table broken");
+static_assert(movieEntry((ACCEL_SPEEDS + 88) * ACCEL_BUCKETS + 4).delay == STRICT_DECEL_MIN_DELAY, "movie table broken");
+static_assert(movieEntry((ACCEL_SPEEDS + 10) * ACCEL_BUCKETS + 2).step == 2, "movie table broken");
+static_assert(linearEntry((ACCEL_SPEEDS + 5) * ACCEL_BUCKETS + 3).step == 2, "linear table broken");
+static_assert(linearEntry(50 * ACCEL_BUCKETS + 3).step == 1, "linear table broken");
+
+/*
+ * Table-driven profile
+ */
+
+class accelTableProfile : public accelProfile {
+
+    public:
+
+        accelTableProfile(const accelEntry *table, unsigned long coastMin)
+        {
+            _table = table;
+            _coastMin = coastMin;
+        }
+
+        const accelEntry *get(int speed, int bucket, bool decel) const
+        {
+            return &_table[((decel ? ACCEL_SPEEDS : 0) + speed) * ACCEL_BUCKETS + bucket];
+        }
+
+        unsigned long coastDelay() const
+        {
+            return (esp_random() % 30) + _coastMin;
+        }
+
+        unsigned long coastMinDelay() const
+        {
+            return _coastMin;
+        }
+
+        int coastStep(int speedF) const
+        {
+            const int16_t *c = coastCurve[speedF / 10];
+            return max(0, (int)(esp_random() % c[0]) - c[1]);
+        }
+
+    private:
+
+        const accelEntry *_table;
+        unsigned long    _coastMin;
+};
+
+static const accelTableProfile linearProfile(accelTables::linear, 55);
+static const accelTableProfile movieProfile(accelTables::movie, 60);
+
+static const accelProfile *profiles[ACCEL_NUM_PROFILES] = {
+    &linearProfile,
+    &movieProfile
+};
+
+const accelProfile *accel_getProfile(int profile)
+{
+    if(profile < 0 || profile >= ACCEL_NUM_PROFILES) profile = ACCEL_LINEAR;
+    return profiles[profile];
+}
+
+/*
+ * accelEngine class
+ */
+
+void accelEngine::update(const accelProfile *prof, int32_t throttlePos, int32_t speedF, bool coast)
+{
+    int speed = speedF / 10;
+
+    _moving = (speedF > 0);
+
+    if(prof == _prof && throttlePos == _throttlePos && speed == _speed && coast == _coast)
+        return;
+
+    _prof = prof;
+    _throttlePos = throttlePos;
+    _speed = speed;
+    _coast = coast;
+    
+    if(throttlePos) {
+        const accelEntry *ae;
+        _bucket = (abs(throttlePos)-1) * ACCEL_BUCKETS / 100;
+        ae = prof->get(speed, _bucket, throttlePos < 0);
+        _delay = ae->delay;
+        _step = ae->step;
+    } else {
+        _bucket = 0;
+        _delay = 0;
+    }
+}
+
+bool accelEngine::due(unsigned long now)
+{
+    // Coasting delay is drawn anew every time we are asked
+    if(!_throttlePos && _coast) {
+        return (now - _lastStep > _prof->coastDelay());
+    }
+    
+    return (now - _lastStep > _delay);
+}
+
+bool accelEngine::nextDeadline(unsigned long &when)
+{
+    if(_throttlePos) {
+        when = _lastStep + _delay + 1;
+    } else if(_coast && _moving) {
+        when = _lastStep + _prof->coastMinDelay() + 1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void accelEngine::stepped(unsigned long now)
+{
+    _lastStep = now;
+}
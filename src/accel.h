@@ -0,0 +1,149 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Acceleration profiles
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _REM_ACCEL_H
+#define _REM_ACCEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ACCEL_BUCKETS     5     // Throttle range (1-100%) is split into this many buckets
+#define ACCEL_SPEEDS      89    // 0-88 mph
+#define ACCEL_FAST_DELAY  20    // Delay at full throttle in linear mode (ms)
+
+// Profiles
+#define ACCEL_LINEAR      0
+#define ACCEL_MOVIE       1
+#define ACCEL_NUM_PROFILES 2
+
+typedef struct {
+    uint16_t delay;     // ms until next step
+    uint16_t step;      // step size in 1/10 mph
+} accelEntry;
+
+/* accelProfile Class
+ *
+ * A profile delivers delay and step size for a given speed and
+ * throttle bucket, as well as the coasting behavior.
+ * New curves are added by deriving from this class and
+ * registering the result in accel_getProfile().
+ */
+
+class accelProfile {
+
+    public:
+
+        virtual ~accelProfile() {}
+
+        // speed: 0-88 (mph), bucket: 0-(ACCEL_BUCKETS-1), 
+        // decel: true if throttle is negative
+        virtual const accelEntry *get(int speed, int bucket, bool decel) const = 0;
+
+        // Delay between coasting steps (ms); coastDelay() may vary
+        // from call to call, but never goes below coastMinDelay()
+        virtual unsigned long coastDelay() const = 0;
+        virtual unsigned long coastMinDelay() const = 0;
+
+        // Amount to reduce speed (1/10 mph) by when coasting
+        virtual int coastStep(int speedF) const = 0;
+};
+
+const accelProfile *accel_getProfile(int profile);
+
+/* accelEngine Class
+ *
+ * Caches delay and step size for the current throttle position,
+ * speed and profile; these are only looked up again when one of
+ * them changes. Also tells when the next speed step is due.
+ */
+
+class accelEngine {
+
+    public:
+
+        // Set inputs; cheap if nothing changed
+        void update(const accelProfile *prof, int32_t throttlePos, int32_t speedF, bool coast);
+
+        // True if the next step is due (always true if throttle
+        // is 0 and coasting is off; caller does nothing then)
+        bool due(unsigned long now);
+
+        // Earliest time (millis) the next step can be due;
+        // false if no step is pending
+        bool nextDeadline(unsigned long &when);
+
+        // Speed was changed at time now
+        void stepped(unsigned long now);
+
+        int32_t step() { return _step; }
+        int     bucket() { return _bucket; }
+        int     coastStep(int speedF) { return _prof->coastStep(speedF); }
+
+    private:
+
+        const accelProfile *_prof = NULL;
+        int32_t       _throttlePos = 0;
+        int           _speed = -1;
+        bool          _coast = false;
+        bool          _moving = false;
+
+        int           _bucket = 0;
+        unsigned long _delay = 0;
+        int32_t       _step = 1;
+
+        unsigned long _lastStep = 0;
+};
+
+#endif
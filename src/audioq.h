@@ -0,0 +1,185 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Audio command queue (no hardware dependencies)
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _REM_AUDIOQ_H
+#define _REM_AUDIOQ_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#include "remote_audio.h"
+
+// Commands from main to audio task
+enum {
+    AC_PLAY = 0,
+    AC_KEY,
+    AC_APPEND,
+    AC_CLRAPPEND,
+    AC_CLICK,
+    AC_THRUP,
+    AC_STOP,
+    AC_STOPMP3,
+    AC_STOPKEY,
+    AC_STOPLOOPEND
+};
+
+typedef struct {
+    uint8_t  cmd;
+    uint32_t flags;
+    float    vol;
+    int32_t  seek;      // AC_PLAY: Start of audio data, -1 = unknown
+    uint32_t size;      // AC_PLAY: Expected file size, 0 = unknown
+    char     fn[32];
+} audioCmd;
+
+// Return codes of push()
+#define AQ_OK      0
+#define AQ_FULL    1    // Try again once the consumer caught up
+#define AQ_BADFN   2    // File name too long, nothing queued
+
+/*
+ * Single-producer (main) single-consumer (audio task) queue
+ * of audio commands. Lock-free; waiting (and waking up the 
+ * other side) is up to the caller. N must be a power of 2.
+ */
+template<unsigned N>
+class audioCmdQueue {
+
+    public:
+
+        // Producer
+
+        int push(uint8_t cmd, const char *fn, uint32_t flags, float vol, int32_t seek, uint32_t size = 0)
+        {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            audioCmd *c;
+
+            if(h - tail.load(std::memory_order_acquire) >= N)
+                return AQ_FULL;
+
+            c = &q[h & (N - 1)];
+            if(fn) {
+                if(strlen(fn) >= sizeof(c->fn))
+                    return AQ_BADFN;
+                strcpy(c->fn, fn);
+            } else {
+                c->fn[0] = 0;
+            }
+            c->cmd = cmd;
+            c->flags = flags;
+            c->vol = vol;
+            c->seek = seek;
+            c->size = size;
+
+            head.store(h + 1, std::memory_order_release);
+
+            return AQ_OK;
+        }
+
+        bool pending() const
+        {
+            return (head.load(std::memory_order_relaxed) != tail.load(std::memory_order_acquire));
+        }
+
+        // Mark the commands posted so far...
+        uint32_t mark() const { return head.load(std::memory_order_relaxed); }
+
+        // ...and check if they are all processed
+        bool reached(uint32_t m) const
+        {
+            return ((int32_t)(tail.load(std::memory_order_acquire) - m) >= 0);
+        }
+
+        // Consumer
+
+        // Next command, or NULL if none
+        audioCmd *front()
+        {
+            uint32_t t = tail.load(std::memory_order_relaxed);
+
+            if(t == head.load(std::memory_order_acquire))
+                return NULL;
+
+            return &q[t & (N - 1)];
+        }
+
+        // Done with front(); slot may be reused from now
+        void pop()
+        {
+            tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+    private:
+
+        audioCmd q[N];
+        std::atomic<uint32_t> head{0};    // written by producer only
+        std::atomic<uint32_t> tail{0};    // written by consumer only
+};
+
+/*
+ * Key sounds
+ *
+ * Whether key "key" is what is playing according to "playflags";
+ * key 0 means any key. Decided by the audio task when it processes
+ * AC_KEY/AC_STOPKEY: Only it knows whether a key sound that is 
+ * still in the queue will be playing by then.
+ */
+static inline bool ac_keyPlaying(uint32_t playflags, uint32_t key)
+{
+    return key ? (key == (playflags & PA_KMASK)) : !!(playflags & PA_KMASK);
+}
+
+#endif
@@ -0,0 +1,598 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * BTTFN client core
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#include "remote_global.h"
+
+#include <Arduino.h>
+
+#include "bttfn.h"
+
+static const uint8_t BTTFUDPHD[4] = { 'B', 'T', 'T', 'F' };
+
+static bttfnTransport *tr = NULL;
+static bttfnFunc     onStatus = NULL;
+static bttfnFunc     onNotify = NULL;
+
+static uint8_t       BTTFUDPBuf[BTTF_PACKET_SIZE];     // Receive
+static uint8_t       BTTFUDPTBuf[BTTF_PACKET_SIZE];    // Transmit
+static uint8_t       BTTFMCBuf[BTTF_PACKET_SIZE];
+static bttfnPacket   bttfnTx(BTTFUDPTBuf);
+
+static unsigned long BTTFNUpdateNow = 0;
+static unsigned long bttfnRemPollInt = BTTFN_POLL_INT;
+static unsigned long BTTFNTSRQAge = 0;
+static bool          BTTFNPacketDue = false;
+static bool          BTTFNWiFiUp = false;
+static uint8_t       BTTFNfailCount = 0;
+static uint32_t      BTTFUDPID = 0;
+static unsigned long lastBTTFNpacket = 0;
+static unsigned long bttfnLastNotData = 0;
+static bool          BTTFNBootTO = false;
+static bool          haveTCDIP = false;
+static uint32_t      bttfnTcdIP = 0;
+static uint8_t       bttfnReqStatus = 0x52; // Request capabilities, status, speed
+static bool          TCDSupportsNOTData = false;
+static bool          TCDSupportsSSID = false;
+static bool          bttfnDataNotEnabled = false;
+static uint32_t      tcdHostNameHash = 0;
+static uint32_t      bttfnSeqCnt[BTTFN_REM_MAX_COMMAND+1];
+static uint32_t      bttfnTCDDataSeqCnt = 0;
+static uint32_t      bttfnSessionID = 0;
+static uint32_t      bttfnTCDSeqCnt = 0;
+static unsigned long bttfnPacketSentNow = 0;
+
+// RTT estimation as in TCP (RFC 6298): srtt scaled by 8, 
+// rttvar by 4 for integer arithmetic
+static unsigned long bttfnSRTT8 = 0;
+static unsigned long bttfnRTTVar4 = 0;
+static unsigned long bttfnRTO = BTTFN_RESPONSE_TO;
+static uint8_t       bttfnOKCount = 0;
+static uint32_t      bttfnResponses = 0;
+static uint32_t      bttfnTimeouts = 0;
+static uint32_t      bttfnRTTHist[BTTFN_RTT_BUCKETS] = { 0 };
+
+int                  bttfnHaveTCDSSID = 0;
+char                 TCDSSID[8] = { 0 };
+uint8_t              TCDpwMarker = 0;
+
+static unsigned long nonZero(unsigned long now)
+{
+    return now ? now : 1;
+}
+
+static void bttfn_rtt_sample(unsigned long rtt)
+{
+    int b = 0;
+    
+    while(b < BTTFN_RTT_BUCKETS - 1 && (rtt >> b)) b++;
+    bttfnRTTHist[b]++;
+    bttfnResponses++;
+
+    if(bttfnResponses == 1) {
+        bttfnSRTT8 = rtt << 3;
+        bttfnRTTVar4 = rtt << 1;
+    } else {
+        long err = (long)rtt - (long)(bttfnSRTT8 >> 3);
+        bttfnSRTT8 += err;                                  // += err/8, scaled
+        if(err < 0) err = -err;
+        bttfnRTTVar4 += err - (long)(bttfnRTTVar4 >> 2);    // += (|err|-rttvar)/4, scaled
+    }
+
+    bttfnRTO = (bttfnSRTT8 >> 3) + bttfnRTTVar4;            // srtt + 4 * rttvar
+    if(bttfnRTO < BTTFN_RTO_MIN) bttfnRTO = BTTFN_RTO_MIN;
+    else if(bttfnRTO > BTTFN_RTO_MAX) bttfnRTO = BTTFN_RTO_MAX;
+
+    // Poll less often once link is stable, unless 
+    // we depend on polling for the speed
+    if(bttfnOKCount < BTTFN_STABLE_CNT || (bttfnReqStatus & 0x02)) {
+        bttfnOKCount++;
+        bttfnRemPollInt = BTTFN_POLL_INT;
+    } else if(bttfnRemPollInt < BTTFN_POLL_INT_MAX) {
+        bttfnRemPollInt += 100;
+    }
+}
+
+static void bttfn_rtt_timeout()
+{
+    bttfnTimeouts++;
+    bttfnOKCount = 0;
+
+    if(!haveTCDIP) {
+        // DISCOVER: Keep asking at normal rate
+        bttfnRemPollInt = BTTFN_POLL_INT;
+        return;
+    }
+
+    // Back off: Double RTO, then poll interval
+    bttfnRTO <<= 1;
+    if(bttfnRTO > BTTFN_RTO_MAX) bttfnRTO = BTTFN_RTO_MAX;
+
+    if(BTTFNfailCount < 10) {
+        // Immediately trigger new request for
+        // the first 10 timeouts, after that
+        // the new request is only triggered
+        // in greater intervals via bttfnc_loop().
+        BTTFNfailCount++;
+        BTTFNUpdateNow = 0;
+        bttfnRemPollInt = BTTFN_POLL_INT;
+    } else if(bttfnRemPollInt < BTTFN_POLL_INT * BTTFN_POLL_BACKOFF) {
+        bttfnRemPollInt <<= 1;
+        if(bttfnRemPollInt > BTTFN_POLL_INT * BTTFN_POLL_BACKOFF) {
+            bttfnRemPollInt = BTTFN_POLL_INT * BTTFN_POLL_BACKOFF;
+        }
+    }
+}
+
+static void bttfn_eval_response(uint8_t *buf, bool checkCaps)
+{
+    bttfnPacket p(buf);
+    uint8_t flags = p.get<BTTFN_F_REQ>();
+    
+    if(checkCaps && (flags & 0x40)) {
+        uint8_t caps = p.get<BTTFN_F_CAPS>();
+        bttfnReqStatus &= ~0x40;     // Do no longer poll capabilities
+        if(caps & 0x01) {
+            bttfnReqStatus &= ~0x02; // Do no longer poll speed, comes over multicast
+        }
+        if(caps & 0x10) {
+            TCDSupportsNOTData = true;
+            TCDSupportsSSID = !!(caps & 0x40);
+        }
+    }
+
+    onStatus(p);
+
+    if(!bttfnHaveTCDSSID && !checkCaps && TCDSupportsSSID) {
+        bttfnHaveTCDSSID = 1;
+        p.getArray<BTTFN_F_SSID>(TCDSSID);
+        TCDSSID[6] = p.get<BTTFN_F_SSID7>();
+        TCDpwMarker = p.get<BTTFN_F_PWMARK>() & 0x01;
+    }
+}
+
+static void handle_tcd_notification(uint8_t *buf)
+{
+    bttfnPacket p(buf);
+    uint8_t  type = p.get<BTTFN_F_REQ>();
+    uint32_t seqCnt;
+
+    if(type & BTTFN_NOT_DATA) {
+        if(TCDSupportsNOTData) {
+            bttfnDataNotEnabled = true;
+            bttfnLastNotData = millis();
+            seqCnt = p.get<BTTFN_F_SESSION>();
+            if(bttfnSessionID && (bttfnSessionID != seqCnt)) {
+                bttfnTCDDataSeqCnt = 1;
+                bttfnHaveTCDSSID = 0;
+            }
+            bttfnSessionID = seqCnt;
+            seqCnt = p.get<BTTFN_F_ID>();
+            if(seqCnt > bttfnTCDDataSeqCnt || seqCnt == 1) {
+                #ifdef REMOTE_DBG_NET
+                Serial.println("Valid NOT_DATA packet received");
+                #endif
+                bttfn_eval_response(buf, false);
+            } else {
+                #ifdef REMOTE_DBG_NET
+                Serial.printf("Out-of-sequence NOT_DATA packet received %d %d\n", seqCnt, bttfnTCDDataSeqCnt);
+                #endif
+            }
+            bttfnTCDDataSeqCnt = seqCnt;
+        }
+        return;
+    }
+
+    switch(type) {
+    case BTTFN_NOT_SPD:       // TCD fw >= 10/26/2024 (MC)
+    case BTTFN_NOT_REM_SPD:   // TCD fw < 10/26/2024 (non-MC)
+        seqCnt = p.get<BTTFN_F_NSEQ>();
+        if(seqCnt > bttfnTCDSeqCnt || seqCnt == 1) {
+            onNotify(p);
+        } else {
+            #ifdef REMOTE_DBG_NET
+            Serial.printf("Out-of-sequence packet received from TCD %d %d\n", seqCnt, bttfnTCDSeqCnt);
+            #endif
+        }
+        bttfnTCDSeqCnt = seqCnt;
+        break;
+    default:
+        onNotify(p);
+    }
+}
+
+// Check for pending MC packet and parse it
+static bool bttfn_checkmc()
+{
+    uint32_t fromIP;
+
+    // This returns true as long as a packet was received
+    // regardless whether it was for us or not. Point is
+    // to clear the receive buffer.
+    
+    if(!tr->recvMC(BTTFMCBuf, fromIP)) {
+        return false;
+    }
+
+    if(haveTCDIP) {
+        if(bttfnTcdIP != fromIP)
+            return true;
+    } else {
+        // Do not use tcdHostNameHash; let DISCOVER do its work
+        // and wait for a result.
+        return true;
+    }
+
+    if(!bttfn_checkPacket(BTTFMCBuf))
+        return true;
+
+    if((bttfnPacket(BTTFMCBuf).get<BTTFN_F_VER>() & 0x4f) == (BTTFN_VERSION | 0x40)) {
+
+        // A notification from the TCD
+        handle_tcd_notification(BTTFMCBuf);
+    
+    }
+
+    return true;
+}
+
+// Check for pending packet and parse it
+static void BTTFNCheckPacket()
+{
+    unsigned long mymillis = nonZero(millis());
+    uint32_t fromIP;
+    
+    if(!tr->recv(BTTFUDPBuf, fromIP)) {
+        if(!bttfnDataNotEnabled && BTTFNPacketDue) {
+            if((mymillis - BTTFNTSRQAge) > bttfnRTO) {
+                // Packet timed out
+                BTTFNPacketDue = false;
+                bttfn_rtt_timeout();
+            }
+        }
+        return;
+    }
+
+    if(!bttfn_checkPacket(BTTFUDPBuf))
+        return;
+
+    bttfnPacket p(BTTFUDPBuf);
+
+    if((p.get<BTTFN_F_VER>() & 0x4f) == (BTTFN_VERSION | 0x40)) {
+
+        // A notification from the TCD
+        handle_tcd_notification(BTTFUDPBuf);
+        
+    } else {
+
+        // (Possibly) a response packet
+    
+        if(p.get<BTTFN_F_ID>() != BTTFUDPID)
+            return;
+    
+        // Response marker missing or wrong version, bail
+        if((p.get<BTTFN_F_VER>() & 0x8f) != (BTTFN_VERSION | 0x80))
+            return;
+
+        bttfn_rtt_sample(mymillis - bttfnPacketSentNow);
+
+        BTTFNfailCount = 0;
+    
+        // If it's our expected packet, no other is due for now
+        BTTFNPacketDue = false;
+
+        if(p.get<BTTFN_F_REQ>() & 0x80) {
+            if(!haveTCDIP) {
+                bttfnTcdIP = fromIP;
+                haveTCDIP = true;
+                #ifdef REMOTE_DBG_NET
+                Serial.printf("Discovered TCD IP %d.%d.%d.%d\n", 
+                    fromIP & 0xff, (fromIP >> 8) & 0xff, (fromIP >> 16) & 0xff, fromIP >> 24);
+                #endif
+            } else {
+                #ifdef REMOTE_DBG_NET
+                Serial.println("Internal error - received unexpected DISCOVER response");
+                #endif
+            }
+        }
+
+        lastBTTFNpacket = mymillis;
+
+        bttfn_eval_response(BTTFUDPBuf, true);
+    }
+}
+
+static void BTTFNPreparePacketTemplate(const char *hostName, uint32_t remID)
+{
+    bttfnTx.init(BTTFUDPHD);
+
+    // Tell the TCD about our hostname
+    // 13 bytes total. If hostname is longer, last in buf is '.'
+    // hostName may be shorter than the field; pad with 0
+    char hbuf[BTTFN_F_HOST::len] = { 0 };
+    memcpy(hbuf, hostName, strnlen(hostName, sizeof(hbuf)));
+    bttfnTx.setArray<BTTFN_F_HOST>(hbuf);
+    if(strlen(hostName) > 13) bttfnTx.setArrayByte<BTTFN_F_HOST>(12, '.');
+
+    bttfnTx.set<BTTFN_F_TYPE>(BTTFN_TYPE_REMOTE);
+
+    // Version, MC-marker, ND-marker
+    bttfnTx.set<BTTFN_F_VER>(BTTFN_VERSION | BTTFN_SUP_MC | BTTFN_SUP_ND);
+    
+    // Remote-ID
+    bttfnTx.set<BTTFN_F_REMID>(remID);
+}
+
+// The packet is built in place: Reset the fields that vary
+// between packets; only bytes that actually change are 
+// written and added to the checksum.
+static void BTTFNPreparePacket()
+{
+    bttfnTx.set<BTTFN_F_REQ>(0);
+    bttfnTx.set<BTTFN_F_ID>(0);
+    bttfnTx.set<BTTFN_F_CMD>(0);
+    bttfnTx.set<BTTFN_F_P1>(0);
+    bttfnTx.set<BTTFN_F_P2>(0);
+    bttfnTx.set<BTTFN_F_TCDHASH>(0);
+}
+
+static void BTTFNDispatch()
+{
+    tr->send(haveTCDIP ? bttfnTcdIP : 0, bttfnTx.data());
+}
+
+// Send a new data request
+static bool BTTFNSendRequest()
+{
+    BTTFNPacketDue = false;
+
+    BTTFNUpdateNow = nonZero(millis());
+
+    if(!tr->linkUp()) {
+        BTTFNWiFiUp = false;
+        return false;
+    }
+
+    BTTFNWiFiUp = true;
+
+    // Send new packet
+    BTTFNPreparePacket();
+    
+    // Serial
+    BTTFUDPID = (uint32_t)millis();
+    bttfnTx.set<BTTFN_F_ID>(BTTFUDPID);
+
+    // Request flags
+    if(!haveTCDIP) {
+        bttfnTx.set<BTTFN_F_REQ>(bttfnReqStatus | 0x80);
+        bttfnTx.set<BTTFN_F_TCDHASH>(tcdHostNameHash);
+    } else {
+        bttfnTx.set<BTTFN_F_REQ>(bttfnReqStatus);
+    }
+
+    BTTFNDispatch();
+
+    BTTFNTSRQAge = bttfnPacketSentNow = millis();
+    
+    BTTFNPacketDue = true;
+    
+    return true;
+}
+
+/*
+ * tcdIP: TCD's IP address, or 0 if the TCD is to be 
+ * discovered by tcdHostName.
+ */
+void bttfnc_setup(bttfnTransport *transport, uint32_t tcdIP, const char *tcdHostName, 
+                  const char *hostName, uint32_t remID,
+                  bttfnFunc statusFunc, bttfnFunc notifyFunc)
+{
+    tr = transport;
+    onStatus = statusFunc;
+    onNotify = notifyFunc;
+
+    haveTCDIP = !!tcdIP;
+    
+    if(!haveTCDIP) {
+        tcdHostNameHash = 0;
+        unsigned char *s = (unsigned char *)tcdHostName;
+        for ( ; *s; ++s) tcdHostNameHash = 37 * tcdHostNameHash + tolower(*s);
+    } else {
+        bttfnTcdIP = tcdIP;
+    }
+
+    for(int i = 0; i < BTTFN_REM_MAX_COMMAND+1; i++) {
+        bttfnSeqCnt[i] = 1;
+    }
+
+    BTTFNPreparePacketTemplate(hostName, remID);
+    
+    BTTFNfailCount = 0;
+}
+
+void bttfnc_loop()
+{
+    int t = 100;
+
+    while(bttfn_checkmc() && t--) {}
+
+    unsigned long now = nonZero(millis());
+        
+    BTTFNCheckPacket();
+    
+    if(bttfnDataNotEnabled) {
+        // Remote does not need to send KEEP_ALIVE, it
+        // sends combined updates on a regular basis.
+        if(now - bttfnLastNotData > BTTFN_DATA_TO) {
+            // Return to polling if no NOT_DATA for too long
+            bttfnDataNotEnabled = false;
+            bttfnTCDDataSeqCnt = 1;
+            // Re-do DISCOVER, TCD might have got new IP address
+            if(tcdHostNameHash) haveTCDIP = false;
+            // Don't assume TCD comes back with same SSID/pwMarker
+            bttfnHaveTCDSSID = 0;
+            // Avoid immediate return to stand-alone
+            lastBTTFNpacket = now;
+            // Start polling at normal rate
+            bttfnOKCount = 0;
+            bttfnRemPollInt = BTTFN_POLL_INT;
+            #ifdef REMOTE_DBG_NET
+            Serial.println("NOT_DATA timeout, returning to polling");
+            #endif
+        }
+    } else if(!BTTFNPacketDue) {
+        // If WiFi status changed, trigger immediately
+        if(!BTTFNWiFiUp && tr->linkUp()) {
+            BTTFNUpdateNow = 0;
+        }
+        if((!BTTFNUpdateNow) || (millis() - BTTFNUpdateNow > bttfnRemPollInt)) {
+            BTTFNSendRequest();
+        }
+    }
+}
+
+void bttfnc_loop_quick()
+{
+    int t = 100;
+
+    while(bttfn_checkmc() && t--) {}
+}
+
+bool bttfnc_connected()
+{
+    if(!haveTCDIP)
+        return false;
+
+    if(!tr->linkUp())
+        return false;
+
+    if(!lastBTTFNpacket)
+        return false;
+
+    return true;
+}
+
+// Trigger BTTFN-wide TT
+bool bttfnc_send_tt()
+{
+    if(!bttfnc_connected())
+        return false;
+
+    BTTFNPreparePacket();
+
+    bttfnTx.set<BTTFN_F_REQ>(0x80);
+
+    BTTFNDispatch();
+
+    return true;
+}
+
+bool bttfnc_send_command(uint8_t cmd, uint8_t p1, uint8_t p2)
+{
+    if(!bttfnc_connected())
+        return false;
+
+    BTTFNPreparePacket();
+    
+    //bttfnTx.set<BTTFN_F_REQ>(0);   // already 0
+
+    if(cmd <= BTTFN_REM_MAX_COMMAND) {
+        bttfnTx.set<BTTFN_F_ID>(bttfnSeqCnt[cmd]);
+        bttfnSeqCnt[cmd]++;
+        if(!bttfnSeqCnt[cmd]) bttfnSeqCnt[cmd]++;
+    }
+
+    bttfnTx.set<BTTFN_F_CMD>(cmd);
+    bttfnTx.set<BTTFN_F_P1>(p1);
+    bttfnTx.set<BTTFN_F_P2>(p2);
+
+    BTTFNDispatch();
+
+    return true;
+}
+
+// True (once) if the network is considered interrupted:
+// No packet for BTTFN_LOST_TO, or none at all within 
+// BTTFN_BOOT_TO after boot. NOT_DATA has its own timeout.
+bool bttfnc_lost(unsigned long now, unsigned long bootNow)
+{
+    if(bttfnDataNotEnabled)
+        return false;
+
+    if( (lastBTTFNpacket && (now - lastBTTFNpacket > BTTFN_LOST_TO)) ||
+        (!BTTFNBootTO && !lastBTTFNpacket && (now - bootNow > BTTFN_BOOT_TO)) ) {
+        lastBTTFNpacket = 0;
+        BTTFNBootTO = true;
+        return true;
+    }
+
+    return false;
+}
+
+// Half of the smoothed round-trip time
+unsigned long bttfnc_latency()
+{
+    return bttfnSRTT8 >> 4;
+}
+
+void bttfnc_getStats(bttfnStats &st)
+{
+    st.srtt = bttfnSRTT8 >> 3;
+    st.rttvar = bttfnRTTVar4 >> 2;
+    st.rto = bttfnRTO;
+    st.pollInt = bttfnRemPollInt;
+    st.responses = bttfnResponses;
+    st.timeouts = bttfnTimeouts;
+    memcpy(st.rttHist, bttfnRTTHist, sizeof(st.rttHist));
+}
@@ -0,0 +1,194 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * BTTFN client core
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _REM_BTTFN_H
+#define _REM_BTTFN_H
+
+#include <stdint.h>
+
+#include "bttfnpkt.h"
+
+#define BTTFN_VERSION              1
+#define BTTFN_SUP_MC            0x80
+#define BTTFN_SUP_ND            0x40
+#define BTTF_DEFAULT_LOCAL_PORT 1338
+#define BTTFN_POLL_INT          1300
+#define BTTFN_POLL_INT_FAST      500
+#define BTTFN_POLL_INT_MAX      2600    // Stable link
+#define BTTFN_POLL_BACKOFF         4    // Max factor for poll interval under loss
+#define BTTFN_STABLE_CNT          16    // Responses in a row to consider link stable
+#define BTTFN_RESPONSE_TO        700    // Initial response timeout (RTO)
+#define BTTFN_RTO_MIN            300
+#define BTTFN_RTO_MAX           3000
+#define BTTFN_RTT_BUCKETS         12
+#define BTTFN_DATA_TO          18600
+#define BTTFN_LOST_TO          30000    // No packet: Back to stand-alone
+#define BTTFN_BOOT_TO          60000    // No packet since boot: Same
+#define BTTFN_TYPE_ANY     0    // Any, unknown or no device
+#define BTTFN_TYPE_FLUX    1    // Flux Capacitor
+#define BTTFN_TYPE_SID     2    // SID
+#define BTTFN_TYPE_PCG     3    // Dash Gauges
+#define BTTFN_TYPE_VSR     4    // VSR
+#define BTTFN_TYPE_AUX     5    // Aux (user custom device)
+#define BTTFN_TYPE_REMOTE  6    // Futaba remote control
+#define BTTFN_NOT_PREPARE  1
+#define BTTFN_NOT_TT       2
+#define BTTFN_NOT_REENTRY  3
+#define BTTFN_NOT_ABORT_TT 4
+#define BTTFN_NOT_ALARM    5
+#define BTTFN_NOT_REFILL   6
+#define BTTFN_NOT_FLUX_CMD 7
+#define BTTFN_NOT_SID_CMD  8
+#define BTTFN_NOT_PCG_CMD  9
+#define BTTFN_NOT_WAKEUP   10
+#define BTTFN_NOT_AUX_CMD  11
+#define BTTFN_NOT_VSR_CMD  12
+#define BTTFN_NOT_REM_CMD  13
+#define BTTFN_NOT_REM_SPD  14
+#define BTTFN_NOT_SPD      15
+#define BTTFN_NOT_INFO     16
+#define BTTFN_NOT_DATA     128  // bit only, not value
+#define BTTFN_REMCMD_PING       1   // Implicit "Register"/keep-alive
+#define BTTFN_REMCMD_BYE        2   // Forced unregister
+#define BTTFN_REMCMD_COMBINED   3   // All switches & speed combined
+#define BTTFN_REM_MAX_COMMAND   BTTFN_REMCMD_COMBINED
+#define BTTFN_REMCMD_KEEPALIVE 101
+#define BTTFN_SSRC_NONE         0
+#define BTTFN_SSRC_GPS          1
+#define BTTFN_SSRC_ROTENC       2
+#define BTTFN_SSRC_REM          3
+#define BTTFN_SSRC_P0           4
+#define BTTFN_SSRC_P1           5
+#define BTTFN_SSRC_P2           6
+#define BTTFN_TCDI1_NOREM   0x0001
+#define BTTFN_TCDI1_NOREMKP 0x0002
+#define BTTFN_TCDI1_EXT     0x0004
+#define BTTFN_TCDI1_OFF     0x0008
+#define BTTFN_TCDI1_NM      0x0010
+#define BTTFN_TCDI2_BUSY    0x0001
+
+/*
+ * Transport
+ * 
+ * All the core needs from the network. IP addresses are 
+ * IPv4 in the layout of IPAddress' uint32_t conversion.
+ * On the ESP32, this wraps WiFiUDP; on a host, a socket pair
+ * or a script can stand in.
+ */
+class bttfnTransport {
+
+    public:
+
+        // Network usable?
+        virtual bool linkUp() = 0;
+        
+        // Fetch pending unicast/multicast packet (BTTF_PACKET_SIZE
+        // bytes) into buf; false if none pending
+        virtual bool recv(uint8_t *buf, uint32_t &fromIP) = 0;
+        virtual bool recvMC(uint8_t *buf, uint32_t &fromIP) = 0;
+
+        // Send packet to TCD; toIP 0 means "to all" (DISCOVER)
+        virtual void send(uint32_t toIP, const uint8_t *buf) = 0;
+};
+
+/*
+ * The core handles discovery, polling, timeouts, NOT_DATA sessions,
+ * sequence counters and capabilities. What a packet means for the 
+ * device is up to the application:
+ * - onStatus is called for each valid response and NOT_DATA
+ *   packet; BTTFN_F_REQ tells which fields are valid (0x10 status,
+ *   0x02 speed).
+ * - onNotify is called for all other notifications from the TCD; 
+ *   NOT_SPD and NOT_REM_SPD only if in sequence.
+ * Both may be called from bttfnc_loop_quick(), ie while the
+ * application waits in a delay loop.
+ */
+typedef void (*bttfnFunc)(bttfnPacket &p);
+
+void bttfnc_setup(bttfnTransport *tr, uint32_t tcdIP, const char *tcdHostName, 
+                  const char *hostName, uint32_t remID,
+                  bttfnFunc onStatus, bttfnFunc onNotify);
+void bttfnc_loop();
+void bttfnc_loop_quick();
+
+bool bttfnc_connected();
+bool bttfnc_send_tt();
+bool bttfnc_send_command(uint8_t cmd, uint8_t p1, uint8_t p2);
+
+bool bttfnc_lost(unsigned long now, unsigned long bootNow);
+unsigned long bttfnc_latency();
+
+/*
+ * Round-trip statistics of polled requests. rttHist[n] counts 
+ * RTTs of less than 2^n ms (and at least 2^(n-1) ms); the last
+ * bucket takes all longer ones.
+ */
+struct bttfnStats {
+    unsigned long srtt;         // Smoothed RTT, ms
+    unsigned long rttvar;       // RTT variance, ms
+    unsigned long rto;          // Current response timeout, ms
+    unsigned long pollInt;      // Current poll interval, ms
+    uint32_t      responses;
+    uint32_t      timeouts;
+    uint32_t      rttHist[BTTFN_RTT_BUCKETS];
+};
+
+void bttfnc_getStats(bttfnStats &st);
+
+extern int     bttfnHaveTCDSSID;
+extern char    TCDSSID[];
+extern uint8_t TCDpwMarker;
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * BTTFN packet layout
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#include "remote_global.h"
+
+#include <Arduino.h>
+
+#include "bttfnpkt.h"
+
+static_assert(BTTFN_CSUM_OFFS - BTTFN_CSUM_START == 43, "Checksum loop assumes 43 bytes");
+
+uint8_t bttfn_checksum(const uint8_t *buf)
+{
+    const uint8_t *p = buf + BTTFN_CSUM_START;
+    uint32_t s = 0, w;
+
+    // 40 bytes four at a time: Sum up even and odd bytes 
+    // in two 16-bit lanes each (max 20*255 per lane)
+    for(int i = 0; i < 10; i++, p += 4) {
+        memcpy(&w, p, 4);
+        w ^= 0x55555555;
+        s += (w & 0x00ff00ff) + ((w >> 8) & 0x00ff00ff);
+    }
+    s += s >> 16;
+
+    // Last three
+    s += (p[0] ^ 0x55) + (p[1] ^ 0x55) + (p[2] ^ 0x55);
+
+    return (uint8_t)s;
+}
+
+bool bttfn_checkPacket(const uint8_t *buf)
+{
+    if(buf[0] != 'B' || buf[1] != 'T' || buf[2] != 'T' || buf[3] != 'F')
+        return false;
+
+    return (buf[BTTFN_CSUM_OFFS] == bttfn_checksum(buf));
+}
+
+void bttfnPacket::init(const uint8_t *hdr)
+{
+    memset(_buf, 0, BTTF_PACKET_SIZE);
+    memcpy(_buf, hdr, BTTFN_CSUM_START);
+    _buf[BTTFN_CSUM_OFFS] = bttfn_checksum(_buf);
+}
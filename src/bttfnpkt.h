@@ -0,0 +1,186 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * BTTFN packet layout
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _REM_BTTFNPKT_H
+#define _REM_BTTFNPKT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define BTTF_PACKET_SIZE  48
+#define BTTFN_CSUM_START  4
+#define BTTFN_CSUM_OFFS   (BTTF_PACKET_SIZE - 1)
+
+/*
+ * Packet fields. All multi-byte values are little endian.
+ * Several offsets are used differently in requests, responses
+ * and notifications.
+ */
+template<uint8_t Off, typename T> struct bttfnField {
+    static_assert(Off >= BTTFN_CSUM_START && Off + sizeof(T) <= BTTFN_CSUM_OFFS, "Field outside payload");
+    static const uint8_t off = Off;
+    typedef T type;
+};
+
+template<uint8_t Off, uint8_t Len> struct bttfnArray {
+    static_assert(Off >= BTTFN_CSUM_START && Off + Len <= BTTFN_CSUM_OFFS, "Field outside payload");
+    static const uint8_t off = Off;
+    static const uint8_t len = Len;
+};
+
+// All packets
+typedef bttfnField<4,  uint8_t>   BTTFN_F_VER;      // Version, flags
+typedef bttfnField<5,  uint8_t>   BTTFN_F_REQ;      // Request flags, notification type
+typedef bttfnField<6,  uint32_t>  BTTFN_F_ID;       // Request ID, command seq, notification payload
+
+// Requests/commands (remote to TCD)
+typedef bttfnArray<10, 13>        BTTFN_F_HOST;     // Our hostname
+typedef bttfnField<23, uint8_t>   BTTFN_F_TYPE;     // Our device type
+typedef bttfnField<25, uint8_t>   BTTFN_F_CMD;
+typedef bttfnField<26, uint8_t>   BTTFN_F_P1;
+typedef bttfnField<27, uint8_t>   BTTFN_F_P2;
+typedef bttfnField<31, uint32_t>  BTTFN_F_TCDHASH;  // DISCOVER: TCD hostname hash
+typedef bttfnField<35, uint32_t>  BTTFN_F_REMID;
+
+// Responses, NOT_DATA
+typedef bttfnField<18, uint16_t>  BTTFN_F_SPEED;
+typedef bttfnField<18, uint8_t>   BTTFN_F_SSID7;    // With SSID
+typedef bttfnField<19, uint8_t>   BTTFN_F_PWMARK;   // With SSID
+typedef bttfnField<26, uint8_t>   BTTFN_F_STATUS;
+typedef bttfnField<27, uint32_t>  BTTFN_F_SESSION;  // NOT_DATA
+typedef bttfnField<31, uint8_t>   BTTFN_F_CAPS;
+typedef bttfnArray<41, 6>         BTTFN_F_SSID;
+
+// Notifications
+typedef bttfnField<6,  uint16_t>  BTTFN_F_NP0;
+typedef bttfnField<8,  uint16_t>  BTTFN_F_NP1;
+typedef bttfnField<10, uint16_t>  BTTFN_F_NP2;
+typedef bttfnField<12, uint32_t>  BTTFN_F_NSEQ;
+
+// Checksum over all bytes of a packet; same as
+// for(i = 4; i < 47; i++) a += buf[i] ^ 0x55;
+uint8_t bttfn_checksum(const uint8_t *buf);
+
+// Check header and checksum of received packet
+bool bttfn_checkPacket(const uint8_t *buf);
+
+/*
+ * bttfnPacket Class
+ * 
+ * Reads fields from, and writes them to, a packet buffer. The
+ * checksum is kept up to date on every write, by adding in the
+ * difference of the bytes that actually changed. Hence the buffer
+ * is always ready to send.
+ */
+class bttfnPacket {
+
+    public:
+
+        bttfnPacket(uint8_t *buf) : _buf(buf) {}
+
+        // Clear packet, set header
+        void init(const uint8_t *hdr);
+
+        template<typename F> typename F::type get() const
+        {
+            typename F::type v = 0;
+            for(int i = sizeof(v) - 1; i >= 0; i--) {
+                v = (v << 8) | _buf[F::off + i];
+            }
+            return v;
+        }
+
+        template<typename F> void set(typename F::type v)
+        {
+            for(unsigned int i = 0; i < sizeof(v); i++, v >>= 8) {
+                setByte(F::off + i, (uint8_t)v);
+            }
+        }
+
+        template<typename F> void getArray(void *dst) const
+        {
+            memcpy(dst, _buf + F::off, F::len);
+        }
+
+        template<typename F> void setArray(const void *src)
+        {
+            const uint8_t *s = (const uint8_t *)src;
+            for(int i = 0; i < F::len; i++) {
+                setByte(F::off + i, s[i]);
+            }
+        }
+
+        template<typename F> void setArrayByte(int idx, uint8_t v)
+        {
+            setByte(F::off + idx, v);
+        }
+
+        const uint8_t *data() const { return _buf; }
+
+    private:
+
+        void setByte(int offs, uint8_t v)
+        {
+            uint8_t o = _buf[offs];
+            if(o != v) {
+                _buf[offs] = v;
+                _buf[BTTFN_CSUM_OFFS] += (v ^ 0x55) - (o ^ 0x55);
+            }
+        }
+
+        uint8_t *_buf;
+};
+
+#endif
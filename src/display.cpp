@@ -58,7 +58,7 @@
 #include <Arduino.h>
 #include <math.h>
 #include "display.h"
-#include <Wire.h>
+#include "i2cbus.h"
 
 /* remLED class */
 
@@ -93,6 +93,8 @@ bool remLED::getState()
 
 /* remDisplay class */
 
+#define DISP_FRAME_BUDGET 10000   // us between frames (max 100fps)
+
 // The segments' wiring to buffer bits
 // This reflects the actual hardware wiring
 
@@ -177,8 +179,9 @@ remDisplay::remDisplay(uint8_t address)
 bool remDisplay::begin()
 {
     // Check for display on i2c bus
-    Wire.beginTransmission(_address);
-    _haveDisp = !Wire.endTransmission(true);
+    if((_haveDisp = i2cbus_probe(_address))) {
+        i2cbus_setDevice(_address, I2CBUS_PRIO_DISPLAY, DISP_FRAME_BUDGET);
+    }
 
     _dispType = 0;
     _num_digs = displays[_dispType].num_digs;
@@ -284,15 +287,17 @@ uint8_t remDisplay::getBrightness()
 void remDisplay::show()
 {
     if(_haveDisp) {
-        Wire.beginTransmission(_address);
-        Wire.write(0x00);  // start address
+        uint8_t buf[I2CBUS_MAX_WR];
+        int len = 0;
+        
+        buf[len++] = 0x00;  // start address
     
         for(int i = 0; i <= _buf_max; i++) {
-            Wire.write(_displayBuffer[i] & 0xFF);
-            Wire.write(_displayBuffer[i] >> 8);
+            buf[len++] = _displayBuffer[i] & 0xFF;
+            buf[len++] = _displayBuffer[i] >> 8;
         }
     
-        Wire.endTransmission();
+        i2cbus_post(_address, buf, len, 0, I2CBUS_NOGAP, NULL, I2CBUS_FRAME);
     }
 }
 
@@ -395,23 +400,15 @@ uint16_t remDisplay::getLEDChar(uint8_t value)
 void remDisplay::clearDisplay()
 {
     if(_haveDisp) {
-        Wire.beginTransmission(_address);
-        Wire.write(0x00);  // start address
-    
-        for(int i = 0; i <= _buf_max; i++) {
-            Wire.write(0x00);
-            Wire.write(0x00);
-        }
+        uint8_t buf[I2CBUS_MAX_WR] = { 0 };   // start address + data
     
-        Wire.endTransmission();
+        i2cbus_post(_address, buf, 1 + (_buf_max + 1) * 2, 0, I2CBUS_NOGAP, NULL, I2CBUS_FRAME);
     }
 }
 
 void remDisplay::directCmd(uint8_t val)
 {
     if(_haveDisp) {
-        Wire.beginTransmission(_address);
-        Wire.write(val);
-        Wire.endTransmission();
+        i2cbus_post(_address, &val, 1, 0, I2CBUS_NOGAP, NULL);
     }
 }
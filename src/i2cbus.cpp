@@ -0,0 +1,371 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * i2c transaction layer
+ * 
+ * Devices which need time between selecting a register and reading
+ * it (like the seesaw on the Ada4991) are handled in two steps: The
+ * register write is done immediately, the read is done in a later 
+ * i2cbus_loop() call once the gap has passed. Meanwhile, the main 
+ * loop continues.
+ *
+ * Each device is assigned a priority; there is one queue per 
+ * priority, so the order of transactions for one device is kept, 
+ * while the throttle is never kept waiting behind the display or 
+ * the ButtonPack. While a transaction waits for its gap, others 
+ * may use the bus.
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#include "remote_global.h"
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#include "i2cbus.h"
+
+typedef struct {
+    i2cMailbox    *mb;
+    unsigned long gapStart;     // micros
+    int16_t       gap;
+    uint8_t       addr;
+    uint8_t       wlen;
+    uint8_t       rlen;
+    uint8_t       flags;
+    uint8_t       tries;
+    bool          inGap;
+    uint8_t       wbuf[I2CBUS_MAX_WR];
+} i2cTrans;
+
+typedef struct {
+    uint8_t       addr;
+    uint8_t       prio;
+    bool          haveFrame;
+    unsigned long budget;       // us between frames
+    unsigned long lastFrame;    // micros
+} i2cDevice;
+
+typedef struct {
+    i2cTrans      t[I2CBUS_QUEUE_SIZE];
+    uint8_t       head;         // Next to run
+    uint8_t       tail;         // Next free
+} i2cQueue;
+
+// Result of runTrans()
+#define TR_WAIT  0      // Nothing done
+#define TR_BUSY  1      // Progress, but not finished
+#define TR_DONE  2
+
+static i2cQueue    queue[I2CBUS_NUM_PRIO];
+static i2cDevice   devices[I2CBUS_MAX_DEV];
+static int         numDevices = 0;
+static bool        flushing = false;
+static i2cBusStats stats;
+
+static i2cDevice *findDevice(uint8_t addr)
+{
+    for(int i = 0; i < numDevices; i++) {
+        if(devices[i].addr == addr) return &devices[i];
+    }
+    return NULL;
+}
+
+static bool qEmpty(i2cQueue *q)
+{
+    return q->head == q->tail;
+}
+
+/*
+ * Run a transaction as far as possible
+ */
+static int runTrans(i2cTrans *t, i2cDevice *dev)
+{
+    uint8_t dummy[I2CBUS_MAX_RD];
+    uint8_t *buf = t->mb ? t->mb->buf : dummy;
+    unsigned long busStart;
+    int len = 0;
+    bool ok = true;
+
+    if(!t->inGap) {
+        if((t->flags & I2CBUS_FRAME) && dev && dev->budget && !flushing && dev->haveFrame) {
+            if(micros() - dev->lastFrame < dev->budget) 
+                return TR_WAIT;
+        }
+        busStart = micros();
+        if(t->wlen) {
+            Wire.beginTransmission(t->addr);
+            Wire.write(t->wbuf, t->wlen);
+            ok = !Wire.endTransmission(!t->rlen || t->gap != I2CBUS_RSTART);
+        }
+        stats.busUs += micros() - busStart;
+        if(ok && (t->flags & I2CBUS_FRAME) && dev) {
+            dev->lastFrame = busStart;
+            dev->haveFrame = true;
+        }
+        if(ok && t->rlen && t->gap > 0) {
+            t->gapStart = micros();
+            t->inGap = true;
+            return TR_BUSY;
+        }
+    } else if(micros() - t->gapStart < (unsigned long)t->gap) {
+        return TR_WAIT;
+    }
+
+    if(ok && t->rlen) {
+        busStart = micros();
+        len = Wire.requestFrom((int)t->addr, (int)t->rlen);
+        for(int i = 0; i < len; i++) {
+            buf[i] = Wire.read();
+        }
+        stats.busUs += micros() - busStart;
+        ok = (len == t->rlen);
+    }
+
+    if(!ok) {
+        stats.naks++;
+        if(t->tries < I2CBUS_RETRIES) {
+            t->tries++;
+            t->inGap = false;
+            stats.retries++;
+            return TR_BUSY;
+        }
+    }
+
+    if(t->mb) {
+        // Out of retries: Report failure, also for
+        // write-only transactions
+        t->mb->len = ok ? len : -1;
+        t->mb->state = I2CMB_DONE;
+    }
+
+    stats.trans++;
+    
+    return TR_DONE;
+}
+
+/*
+ * Run the most important transaction that can make progress
+ */
+static bool runNext()
+{
+    for(int p = 0; p < I2CBUS_NUM_PRIO; p++) {
+        i2cQueue *q = &queue[p];
+        if(qEmpty(q)) 
+            continue;
+        i2cTrans *t = &q->t[q->head];
+        switch(runTrans(t, findDevice(t->addr))) {
+        case TR_DONE:
+            q->head = (q->head + 1) % I2CBUS_QUEUE_SIZE;
+            return true;
+        case TR_BUSY:
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void i2cbus_loop()
+{
+    unsigned long startNow = micros();
+    
+    while(runNext()) {
+        if(micros() - startNow > I2CBUS_BUDGET_US)
+            break;
+    }
+}
+
+bool i2cbus_pending()
+{
+    for(int p = 0; p < I2CBUS_NUM_PRIO; p++) {
+        if(!qEmpty(&queue[p]))
+            return true;
+    }
+
+    return false;
+}
+
+void i2cbus_setDevice(uint8_t addr, uint8_t prio, unsigned long frameBudgetUs)
+{
+    i2cDevice *dev = findDevice(addr);
+
+    if(!dev) {
+        if(numDevices >= I2CBUS_MAX_DEV)
+            return;
+        dev = &devices[numDevices++];
+        dev->addr = addr;
+        dev->haveFrame = false;
+    }
+
+    dev->prio = (prio < I2CBUS_NUM_PRIO) ? prio : I2CBUS_PRIO_BATTERY;
+    dev->budget = frameBudgetUs;
+}
+
+bool i2cbus_probe(uint8_t addr)
+{
+    unsigned long busStart;
+    bool ret;
+
+    // Let queued transactions go first
+    flushing = true;
+    for(int p = 0; p < I2CBUS_NUM_PRIO; p++) {
+        while(!qEmpty(&queue[p])) {
+            i2cbus_loop();
+        }
+    }
+    flushing = false;
+
+    busStart = micros();
+    Wire.beginTransmission(addr);
+    ret = !Wire.endTransmission(true);
+    stats.busUs += micros() - busStart;
+
+    return ret;
+}
+
+bool i2cbus_post(uint8_t addr, const uint8_t *wbuf, uint8_t wlen, uint8_t rlen, int16_t gapUs, i2cMailbox *mb, uint8_t flags)
+{
+    i2cDevice *dev = findDevice(addr);
+    i2cQueue *q = &queue[dev ? dev->prio : I2CBUS_PRIO_BATTERY];
+    uint8_t next;
+    i2cTrans *t;
+
+    if(wlen > I2CBUS_MAX_WR || rlen > I2CBUS_MAX_RD)
+        return false;
+
+    // Replace a frame which has not been sent yet. Frames are 
+    // write-only and sent in one go, so a queued frame has not 
+    // been sent yet. If other transactions were queued after it,
+    // the old frame is dropped and the new one goes to the end,
+    // so it still comes after them.
+    if(flags & I2CBUS_FRAME) {
+        for(uint8_t i = q->head; i != q->tail; i = (i + 1) % I2CBUS_QUEUE_SIZE) {
+            t = &q->t[i];
+            if(t->addr != addr || !(t->flags & I2CBUS_FRAME))
+                continue;
+            stats.coalesced++;
+            if((i + 1) % I2CBUS_QUEUE_SIZE == q->tail) {
+                t->wlen = wlen;
+                memcpy(t->wbuf, wbuf, wlen);
+                i2cbus_loop();
+                return true;
+            }
+            for(uint8_t j = i; (j + 1) % I2CBUS_QUEUE_SIZE != q->tail; j = (j + 1) % I2CBUS_QUEUE_SIZE) {
+                q->t[j] = q->t[(j + 1) % I2CBUS_QUEUE_SIZE];
+            }
+            q->tail = (q->tail + I2CBUS_QUEUE_SIZE - 1) % I2CBUS_QUEUE_SIZE;
+            break;
+        }
+    }
+
+    next = (q->tail + 1) % I2CBUS_QUEUE_SIZE;
+
+    // Full? Can only happen if caller posts faster than 
+    // we can go, so wait.
+    if(next == q->head) {
+        flushing = true;
+        while(next == q->head) {
+            i2cbus_loop();
+        }
+        flushing = false;
+    }
+
+    t = &q->t[q->tail];
+    t->mb = mb;
+    t->gap = gapUs;
+    t->addr = addr;
+    t->wlen = wlen;
+    t->rlen = rlen;
+    t->flags = flags;
+    t->tries = 0;
+    t->inGap = false;
+    if(wlen) memcpy(t->wbuf, wbuf, wlen);
+    
+    if(mb) mb->state = I2CMB_BUSY;
+    
+    q->tail = next;
+
+    // Do what can be done now
+    i2cbus_loop();
+
+    return true;
+}
+
+int i2cbus_xfer(uint8_t addr, const uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen, int16_t gapUs)
+{
+    i2cMailbox mb;
+
+    if(!i2cbus_post(addr, wbuf, wlen, rlen, gapUs, &mb))
+        return -1;
+
+    // Don't hold back frames queued before ours
+    flushing = true;
+    while(mb.state != I2CMB_DONE) {
+        i2cbus_loop();
+    }
+    flushing = false;
+
+    if(mb.len > 0 && rbuf) {
+        memcpy(rbuf, mb.buf, mb.len);
+    }
+
+    return mb.len;
+}
+
+void i2cbus_getStats(i2cBusStats &st, bool reset)
+{
+    st = stats;
+    
+    if(reset) {
+        memset(&stats, 0, sizeof(stats));
+        stats.startMs = millis();
+    }
+}
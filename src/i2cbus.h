@@ -0,0 +1,129 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * i2c transaction layer
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _REM_I2CBUS_H
+#define _REM_I2CBUS_H
+
+#include <stdint.h>
+
+#define I2CBUS_QUEUE_SIZE 4       // Pending transactions per priority
+#define I2CBUS_MAX_DEV    8       // Registered devices
+#define I2CBUS_MAX_WR     17      // Display: start address + 8 words
+#define I2CBUS_MAX_RD     8
+#define I2CBUS_BUDGET_US  2000    // Max time per i2cbus_loop()
+#define I2CBUS_RETRIES    1       // Retries after NAK/short read
+
+// Priorities (0 = highest)
+#define I2CBUS_PRIO_THROTTLE 0
+#define I2CBUS_PRIO_DISPLAY  1
+#define I2CBUS_PRIO_INPUT    2    // ButtonPack, volume encoder
+#define I2CBUS_PRIO_BATTERY  3    // Also used for unregistered devices
+#define I2CBUS_NUM_PRIO      4
+
+// gapUs: Time between write and read phase
+#define I2CBUS_RSTART     -1      // Read after repeated start
+#define I2CBUS_NOGAP      0       // Stop, read right away
+
+// Flags for i2cbus_post()
+#define I2CBUS_FRAME      0x01    // Full display frame: Replaces a frame for the same
+                                  // device still waiting in the queue; rate limited
+                                  // to the device's budget
+
+// Mailbox states
+#define I2CMB_IDLE        0
+#define I2CMB_BUSY        1       // Transaction queued
+#define I2CMB_DONE        2       // Result available
+
+typedef struct {
+    uint8_t state;
+    int8_t  len;                  // Bytes read; -1 on error (NAK, short read)
+    uint8_t buf[I2CBUS_MAX_RD];
+} i2cMailbox;
+
+typedef struct {
+    unsigned long startMs;        // millis() at last reset
+    uint32_t      trans;          // Finished transactions
+    uint32_t      busUs;          // Time spent on the bus
+    uint32_t      naks;           // Failed attempts (NAK or short read)
+    uint32_t      retries;
+    uint32_t      coalesced;      // Frames replaced before being sent
+} i2cBusStats;
+
+// Set priority and minimum time between frames (us) for a device.
+void i2cbus_setDevice(uint8_t addr, uint8_t prio, unsigned long frameBudgetUs = 0);
+
+// Check if a device ACKs its address
+bool i2cbus_probe(uint8_t addr);
+
+// Queue a transaction: Write wlen bytes, then (optionally) read rlen bytes 
+// gapUs later. The result ends up in mb (if given; mb->state turns
+// I2CMB_DONE); the owner sets mb->state back to I2CMB_IDLE when done 
+// with it. Transactions for a device run in order, higher priorities
+// first; as much as possible is done right away, the rest in later 
+// i2cbus_loop() calls.
+bool i2cbus_post(uint8_t addr, const uint8_t *wbuf, uint8_t wlen, uint8_t rlen, int16_t gapUs, i2cMailbox *mb, uint8_t flags = 0);
+
+// Same as above, but wait for the result. Returns number of bytes read,
+// -1 on error.
+int  i2cbus_xfer(uint8_t addr, const uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen, int16_t gapUs);
+
+void i2cbus_loop();
+
+// True if transactions are waiting to be (completely) run
+bool i2cbus_pending();
+
+void i2cbus_getStats(i2cBusStats &stats, bool reset = false);
+
+#endif
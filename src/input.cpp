@@ -102,6 +102,8 @@
 #define SEESAW_HW_ID_CODE_TINY1616 0x88
 #define SEESAW_HW_ID_CODE_TINY1617 0x89
 
+#define SEESAW_READ_DELAY 250   // us between register select and read
+
 // Duppa V2.1
 
 #define DUV2_BASE     0x100
@@ -113,6 +115,8 @@
 #define DUV2_ISTEPB4  0x14
 #define DUV2_IDCODE   0x70
 
+#define DUV2_READ_DELAY 1000    // us between register select and read
+
 enum DUV2_CONF_PARAM {
     DU2_FLOAT_DATA   = 0x01,
     DU2_INT_DATA     = 0x00,
@@ -145,6 +149,8 @@ enum DUV2_CONF2_PARAM {
 #define DFR_COUNT_MSB 0x08
 #define DFR_GAIN_REG  0x0b
 
+#define DFR_READ_DELAY 1000     // us between register select and read
+
 #define DFR_PID_U     0x01
 #define DFR_PID_L     0xf6
 
@@ -156,6 +162,8 @@ enum DUV2_CONF2_PARAM {
 
 #define ADS_CONVERT   0x00
 #define ADS_CONFIG    0x01
+
+#define ADS_READ_DELAY I2CBUS_NOGAP
 #define ADS_LTHR      0x02
 #define ADS_HTHR      0x03
 
@@ -174,6 +182,38 @@ enum DUV2_CONF2_PARAM {
 #define SCALE_TO_0_D  33 //20
 #define SCALE_MULT_D  10000 / (100-SCALE_TO_0_D)
 
+#define SCALE_HYST    2       // %; dead band is widened by this when at 0,
+                              // smaller changes are ignored otherwise
+
+#define ADS_SAMPLE_INT 10     // ms between ADC reads (conversion rate is 128SPS)
+#define ADS_STEP_THR   24     // ADC counts; larger jumps bypass the IIR
+
+/* Time between register select and read
+ *
+ * The encoders are microcontrollers which prepare the data in
+ * firmware after the register select; the former code waited
+ * 1ms for all of them. The seesaw (Ada4991) is known to need
+ * 250us (as used by Adafruit's library). DuPPa and DFRobot do
+ * not specify a time, so they keep the 1ms; since the read is
+ * finished in a later i2cbus_loop(), this costs no loop time.
+ * The ADS1x15 is not an MCU; its conversion register is read
+ * right after setting the pointer.
+ */
+static int16_t encReadGap(int type)
+{
+    switch(type) {
+    case REM_RE_TYPE_ADA4991:
+        return SEESAW_READ_DELAY;
+    case REM_RE_TYPE_DUPPAV2:
+        return DUV2_READ_DELAY;
+    case REM_RE_TYPE_DFRGR360:
+        return DFR_READ_DELAY;
+    case REM_RE_TYPE_ADS1X15:
+        return ADS_READ_DELAY;
+    }
+    return I2CBUS_NOGAP;
+}
+
 REMRotEnc::REMRotEnc(int numTypes, const uint8_t *addrArr)
 {
     _numTypes = min(6, numTypes);
@@ -193,9 +233,9 @@ bool REMRotEnc::begin(bool forSpeed, bool newBoard)
     for(int i = 0; i < _numTypes * 2; i += 2) {
 
         _i2caddr = _addrArr[i];
+        _rdGap = encReadGap(_addrArr[i+1]);
 
-        Wire.beginTransmission(_i2caddr);
-        if(!Wire.endTransmission(true)) {
+        if(i2cbus_probe(_i2caddr)) {
 
             switch(_addrArr[i+1]) {
             case REM_RE_TYPE_ADA4991:
@@ -244,6 +284,8 @@ bool REMRotEnc::begin(bool forSpeed, bool newBoard)
 
             if(foundSt) {
                 _st = _addrArr[i+1];
+
+                i2cbus_setDevice(_i2caddr, forSpeed ? I2CBUS_PRIO_THROTTLE : I2CBUS_PRIO_INPUT);
     
                 #ifdef REMOTE_DBG
                 const char *tpArr[6] = { "ADA4991", "DuPPa V2.1", "DFRobot Gravity 360", "CircuitSetup", "ADS1015", "" };
@@ -341,6 +383,7 @@ void REMRotEnc::zeroPos(bool calibMode)
         rotEncZeroPos = getEncPos();
     }
     throttlePos = 0;
+    throttleRawPos = 0;
 }
 
 void REMRotEnc::setZeroPos(int32_t num)
@@ -383,49 +426,102 @@ bool REMRotEnc::setMaxStepsDown(int32_t num)
 }
 
 // Returns -100% - 100%
+// Without force, the hardware is read in the background; the
+// result is picked up in a later call.
 int32_t REMRotEnc::updateThrottlePos(bool force)
 {
-    if(force || (millis() - lastUpd > HWUPD_DELAY)) {
-
+    int32_t pos;
+    
+    if(force) {
         lastUpd = millis();
+        calcThrottlePos(getEncPos());
+    } else if(pollEncPos(pos, (_st == REM_RE_TYPE_ADS1X15) ? ADS_SAMPLE_INT : HWUPD_DELAY)) {
+        calcThrottlePos(pos);
+    }
+    
+    return throttlePos;
+}
 
-        int32_t t = getEncPos() - rotEncZeroPos;
+// ADC noise filter: Median of 3, then first order IIR 
+// (alpha = 1/4, accumulator in Q4). Real movements
+// of the throttle are taken over without delay.
+int32_t REMRotEnc::adsFilter(int32_t val)
+{
+    int32_t a, b, c, med;
+    
+    if(!_adsPrimed) {
+        _adsHist[0] = _adsHist[1] = _adsHist[2] = val;
+        _adsAcc = val * 16;
+        _adsPrimed = true;
+    }
 
-        if(t < 0) {
-            t *= 100;
-            if(throttlePositionsUp < 0) {
-                t /= throttlePositionsUp;
-            } else {
-                t /= (-throttlePositionsDown);
-            }
-        } else if(t > 0) {
-            t *= 100;
-            if(throttlePositionsUp > 0) {
-                t /= throttlePositionsUp;
-            } else {
-                t /= (-throttlePositionsDown);
-            }
+    _adsHist[_adsIdx] = val;
+    if(++_adsIdx > 2) _adsIdx = 0;
+
+    a = _adsHist[0]; b = _adsHist[1]; c = _adsHist[2];
+    med = max(min(a, b), min(max(a, b), c));
+
+    if(abs(med * 16 - _adsAcc) > ADS_STEP_THR * 16) {
+        _adsAcc = med * 16;
+    } else {
+        _adsAcc += (med * 16 - _adsAcc) / 4;
+    }
+
+    return (_adsAcc + (_adsAcc < 0 ? -8 : 8)) / 16;
+}
+
+void REMRotEnc::calcThrottlePos(int32_t pos)
+{
+    int32_t t;
+
+    if(_st == REM_RE_TYPE_ADS1X15) {
+        pos = adsFilter(pos);
+    }
+    
+    t = pos - rotEncZeroPos;
+
+    if(t < 0) {
+        t *= 100;
+        if(throttlePositionsUp < 0) {
+            t /= throttlePositionsUp;
+        } else {
+            t /= (-throttlePositionsDown);
         }
+    } else if(t > 0) {
+        t *= 100;
+        if(throttlePositionsUp > 0) {
+            t /= throttlePositionsUp;
+        } else {
+            t /= (-throttlePositionsDown);
+        }
+    }
 
-        if(t < -100) t = -100;
-        else if(t > 100) t = 100;
+    if(t < -100) t = -100;
+    else if(t > 100) t = 100;
 
-        if(scaleThrottlePos) {
-            if(t >= -SCALE_TO_0_D && t <= SCALE_TO_0_U) t = 0;
-            else if(t < 0) {
-                t = (t + SCALE_TO_0_D) * SCALE_MULT_D / 100;
-            } else {
-                t = (t - SCALE_TO_0_U) * SCALE_MULT_U / 100;
-            }
+    if(scaleThrottlePos) {
+        int hyst = throttlePos ? 0 : SCALE_HYST;
 
-            if(t < -100) t = -100;
-            else if(t > 100) t = 100;
+        // Hold position against jitter; done before scaling, which
+        // stretches steps by up to 1.5. End positions are let 
+        // through, but held once reached.
+        if(abs(t - throttleRawPos) < SCALE_HYST && (t == throttleRawPos || abs(t) != 100)) {
+            t = throttleRawPos;
+        }
+        throttleRawPos = t;
+        
+        if(t >= -(SCALE_TO_0_D + hyst) && t <= SCALE_TO_0_U + hyst) t = 0;
+        else if(t < 0) {
+            t = (t + SCALE_TO_0_D) * SCALE_MULT_D / 100;
+        } else {
+            t = (t - SCALE_TO_0_U) * SCALE_MULT_U / 100;
         }
 
-        throttlePos = t;
+        if(t < -100) t = -100;
+        else if(t > 100) t = 100;
     }
-    
-    return throttlePos;
+
+    throttlePos = t;
 }
 
 int32_t REMRotEnc::getMaxStepsUp()
@@ -445,15 +541,24 @@ int32_t REMRotEnc::getZeroPos()
 
 int REMRotEnc::updateVolume(int curVol, bool force)
 {
+    int32_t pos;
+    bool    gotPos;
+    
     if(curVol == 255)
         return curVol;
     
-    if(force || (millis() - lastUpd > HWUPD_DELAY_VOL)) {
-
+    if(force) {
         lastUpd = millis();
+        pos = getEncPos();
+        gotPos = true;
+    } else {
+        gotPos = pollEncPos(pos, HWUPD_DELAY_VOL);
+    }
+    
+    if(gotPos) {
         
         int32_t t = rotEncPos;
-        rotEncPos = getEncPos();
+        rotEncPos = pos;
 
         curVol += (rotEncPos - t);
 
@@ -468,14 +573,37 @@ int REMRotEnc::updateVolume(int curVol, bool force)
 int32_t newRead = 0, oldRead = 0;
 #endif
 
-int32_t REMRotEnc::getEncPos()
+// Build register select for position read; returns
+// number of bytes to read
+int REMRotEnc::encPosReg(uint8_t *wbuf, int &wlen)
 {
-    uint8_t buf[4];
+    wlen = 1;
+    
+    switch(_st) {
+    case REM_RE_TYPE_ADA4991:
+        wbuf[0] = SEESAW_ENCODER_BASE;
+        wbuf[1] = SEESAW_ENCODER_POSITION;
+        wlen = 2;
+        return 4;
+    case REM_RE_TYPE_DUPPAV2:
+        wbuf[0] = DUV2_CVALB4;
+        return 4;
+    case REM_RE_TYPE_DFRGR360:
+        wbuf[0] = DFR_COUNT_MSB;
+        return 2;
+    case REM_RE_TYPE_ADS1X15:
+        wbuf[0] = ADS_CONVERT;
+        return 2;
+    }
 
+    return 0;
+}
+
+int32_t REMRotEnc::decodeEncPos(const uint8_t *buf)
+{
     switch(_st) {
       
     case REM_RE_TYPE_ADA4991:
-        read(SEESAW_ENCODER_BASE, SEESAW_ENCODER_POSITION, buf, 4);
         // Ada4991 reports neg numbers when turned cw, so 
         // negate value
         return -(int32_t)(
@@ -486,7 +614,6 @@ int32_t REMRotEnc::getEncPos()
                 );
 
     case REM_RE_TYPE_DUPPAV2:
-        read(DUV2_BASE, DUV2_CVALB4, buf, 4);
         return (int32_t)(
                     ((uint32_t)buf[0] << 24) | 
                     ((uint32_t)buf[1] << 16) |
@@ -495,14 +622,12 @@ int32_t REMRotEnc::getEncPos()
                 );
 
     case REM_RE_TYPE_DFRGR360:
-        read(DFR_BASE, DFR_COUNT_MSB, buf, 2);
         return (int32_t)(((buf[0] << 8) | buf[1]) / dfrgain);
         
     case REM_RE_TYPE_CS:
         break;
 
     case REM_RE_TYPE_ADS1X15:
-        read(ADS_BASE, ADS_CONVERT, buf, 2);
         #ifdef REMOTE_DBG_ADC
         newRead = (int32_t)(((int16_t)((buf[0] << 8) | buf[1]))) / 16;
         if(oldRead != newRead) {
@@ -516,6 +641,50 @@ int32_t REMRotEnc::getEncPos()
     return 0;
 }
 
+int32_t REMRotEnc::getEncPos()
+{
+    uint8_t wbuf[2];
+    uint8_t buf[4] = { 0 };
+    int     wlen;
+    int     num = encPosReg(wbuf, wlen);
+
+    if(!num) return 0;
+
+    i2cbus_xfer(_i2caddr, wbuf, wlen, buf, num, _rdGap);
+    
+    return decodeEncPos(buf);
+}
+
+// Non-blocking position read: Queues a read every interval ms,
+// returns true when a result has come in.
+bool REMRotEnc::pollEncPos(int32_t &pos, unsigned long interval)
+{
+    uint8_t wbuf[2];
+    int     wlen, num;
+
+    if(_mb.state == I2CMB_DONE) {
+        _mb.state = I2CMB_IDLE;
+        if(_mb.len == encPosReg(wbuf, wlen)) {
+            pos = decodeEncPos(_mb.buf);
+            return true;
+        }
+        return false;
+    }
+
+    if(_mb.state == I2CMB_IDLE && (millis() - lastUpd > interval)) {
+        lastUpd = millis();
+        if((num = encPosReg(wbuf, wlen))) {
+            i2cbus_post(_i2caddr, wbuf, wlen, num, _rdGap, &_mb);
+            // Might be done already
+            if(_mb.state == I2CMB_DONE) {
+                return pollEncPos(pos, interval);
+            }
+        }
+    }
+
+    return false;
+}
+
 bool REMRotEnc::zeroEnc()
 {
     uint8_t buf[4] = { 0 };
@@ -540,29 +709,27 @@ bool REMRotEnc::zeroEnc()
 
 int REMRotEnc::read(uint16_t base, uint8_t reg, uint8_t *buf, uint8_t num)
 {
-    int i2clen;
+    uint8_t wbuf[2];
+    int     wlen = 0;
     
-    Wire.beginTransmission(_i2caddr);
-    if(base <= 0xff) Wire.write((uint8_t)base);
-    Wire.write(reg);
-    Wire.endTransmission(true);
-    delay(1);
-    i2clen = Wire.requestFrom(_i2caddr, (int)num);
-    for(int i = 0; i < i2clen; i++) {
-        buf[i] = Wire.read();
-    }
-    return i2clen;
+    if(base <= 0xff) wbuf[wlen++] = (uint8_t)base;
+    wbuf[wlen++] = reg;
+    
+    return i2cbus_xfer(_i2caddr, wbuf, wlen, buf, num, _rdGap);
 }
 
 void REMRotEnc::write(uint16_t base, uint8_t reg, uint8_t *buf, uint8_t num)
 {
-    Wire.beginTransmission(_i2caddr);
-    if(base <= 0xff) Wire.write((uint8_t)base);
-    Wire.write(reg);
-    for(int i = 0; i < num; i++) {
-        Wire.write(buf[i]);
+    uint8_t wbuf[2 + 4];
+    int     wlen = 0;
+    
+    if(base <= 0xff) wbuf[wlen++] = (uint8_t)base;
+    wbuf[wlen++] = reg;
+    for(int i = 0; i < num && wlen < (int)sizeof(wbuf); i++) {
+        wbuf[wlen++] = buf[i];
     }
-    Wire.endTransmission();
+    
+    i2cbus_xfer(_i2caddr, wbuf, wlen, NULL, 0, I2CBUS_NOGAP);
 }
 
 /*
@@ -743,7 +910,11 @@ ButtonPack::ButtonPack(int numTypes, const uint8_t *addrArr)
     _addrArr = addrArr;
 }
 
-bool ButtonPack::begin()
+/* intPin: GPIO the expander's INT output is connected to, or -1
+ * In interrupt mode, the port is only read over i2c if INT signals 
+ * a change, plus every BP_SAFETY_POLL ms in case an edge got lost.
+ */
+bool ButtonPack::begin(int intPin)
 {
     bool foundSt = false;
 
@@ -751,8 +922,7 @@ bool ButtonPack::begin()
 
         _i2caddr = _addrArr[i];
 
-        Wire.beginTransmission(_i2caddr);
-        if(!Wire.endTransmission(true)) {
+        if(i2cbus_probe(_i2caddr)) {
 
             switch(_addrArr[i+1]) {
             case REM_BP_TYPE_PCA8574:
@@ -768,6 +938,8 @@ bool ButtonPack::begin()
 
             if(foundSt) {
                 _st = _addrArr[i+1];
+
+                i2cbus_setDevice(_i2caddr, I2CBUS_PRIO_INPUT);
     
                 #ifdef REMOTE_DBG
                 const char *tpArr[2] = { "PCA8574(A)", "PCA9554(A)" };
@@ -804,6 +976,16 @@ bool ButtonPack::begin()
         _longPressDur[i] = 2000;
     }
 
+    _port = 0xff;
+
+    if(intPin >= 0) {
+        _intPin = intPin;
+        _intPending = true;     // Force initial read
+        _intTime = millis();
+        pinMode(_intPin, INPUT);   // INT is open drain; external pull-up required
+        attachInterruptArg(_intPin, isr, this, FALLING);
+    }
+
     return true;
 }
 
@@ -853,30 +1035,110 @@ int ButtonPack::getPackSize()
     return _pack_size;
 }
 
-// Check input of the pin and advance the state machine
+// Check input of the pins and advance the state machine
+// The port is read in the background; the state machine is
+// advanced when the result comes in.
 void ButtonPack::scan()
 {
     unsigned long now = millis();
-    unsigned long waitTime; 
-    uint8_t  port;
-    bool     active;
 
-    if(millis() - _lastScan < _scanInterval)
+    switch(_st) {
+    case REM_BP_TYPE_PCA8574:
+    case REM_BP_TYPE_PCA9554:
+        break;
+    default:
         return;
+    }
 
-    _lastScan = millis();
+    if((now - _lastScan >= _scanInterval) && _mb.state == I2CMB_IDLE) {
+
+        bool doRead = true;
+
+        _lastScan = now;
+        _evTime = now;
+    
+        if(_intPin >= 0) {
+            // INT is held low until the port is read, so the level check 
+            // catches edges that happened while we were still busy with
+            // a previous one. If we have the ISR's timestamp, use it for 
+            // debouncing, since it tells us when the change happened.
+            if(_intPending) {
+                _evTime = _intTime;
+                _intPending = false;
+            } else if(digitalRead(_intPin)) {
+                doRead = (now - _lastRead >= BP_SAFETY_POLL);
+            }
+        }
+
+        if(!doRead) {
+            advance(_port, now, now);
+            return;
+        }
+        
+        _lastRead = now;
+        port_post();
+    }
+
+    if(_mb.state == I2CMB_DONE) {
+        _mb.state = I2CMB_IDLE;
+        if(_mb.len == 1) {
+            _port = _mb.buf[0];
+            advance(_port, now, _evTime);
+        }
+    }
+}
+
+#ifdef HAVE_CRSF
+uint8_t ButtonPack::readStates()
+{
+    uint8_t port = 0xff;
 
     switch(_st) {
     case REM_BP_TYPE_PCA8574:
     case REM_BP_TYPE_PCA9554:
         if(port_read(&port) != 1) {
-            return;
+            return 0;
         }
+        return (uint8_t)(~port);
+    default:
         break;
+    }
+
+    return 0;
+}
+
+bool ButtonPack::sampleStates(uint8_t &states)
+{
+    uint8_t port = 0xff;
+
+    switch(_st) {
+    case REM_BP_TYPE_PCA8574:
+    case REM_BP_TYPE_PCA9554:
+        if(port_read(&port) != 1) {
+            return false;
+        }
+        states = (uint8_t)(~port);
+        return true;
     default:
-        return;
+        break;
     }
 
+    states = 0;
+    return false;
+}
+#endif
+
+/*
+ * Private
+ */
+
+// Advance the state machine; evTime is when the port
+// last changed (as far as we know)
+void ButtonPack::advance(uint8_t port, unsigned long now, unsigned long evTime)
+{
+    unsigned long waitTime; 
+    bool     active;
+
     for(int i = 0; i < _pack_size; i++) {
 
         waitTime = now - _startTime[i];
@@ -886,7 +1148,7 @@ void ButtonPack::scan()
         case REMBUS_IDLE:
             if(active) {
                 transitionTo(i, REMBUS_PRESSED);
-                _startTime[i] = now;
+                _startTime[i] = evTime;
             }
             break;
     
@@ -903,7 +1165,7 @@ void ButtonPack::scan()
                 }
                 if(!active) {
                     transitionTo(i, REMBUS_RELEASED);
-                    _startTime[i] = now;
+                    _startTime[i] = evTime;
                 }
             }
             break;
@@ -920,7 +1182,7 @@ void ButtonPack::scan()
         case REMBUS_HOLD:
             if(!active) {
                 transitionTo(i, REMBUS_HOLDEND);
-                _startTime[i] = now;
+                _startTime[i] = evTime;
             }
             break;
     
@@ -940,50 +1202,6 @@ void ButtonPack::scan()
     }
 }
 
-#ifdef HAVE_CRSF
-uint8_t ButtonPack::readStates()
-{
-    uint8_t port = 0xff;
-
-    switch(_st) {
-    case REM_BP_TYPE_PCA8574:
-    case REM_BP_TYPE_PCA9554:
-        if(port_read(&port) != 1) {
-            return 0;
-        }
-        return (uint8_t)(~port);
-    default:
-        break;
-    }
-
-    return 0;
-}
-
-bool ButtonPack::sampleStates(uint8_t &states)
-{
-    uint8_t port = 0xff;
-
-    switch(_st) {
-    case REM_BP_TYPE_PCA8574:
-    case REM_BP_TYPE_PCA9554:
-        if(port_read(&port) != 1) {
-            return false;
-        }
-        states = (uint8_t)(~port);
-        return true;
-    default:
-        break;
-    }
-
-    states = 0;
-    return false;
-}
-#endif
-
-/*
- * Private
- */
-
 void ButtonPack::reset(int i)
 {
     _state[i] = REMBUS_IDLE;
@@ -999,40 +1217,54 @@ void ButtonPack::transitionTo(int idx, ButState nextState)
     _state[idx]     = nextState;
 }
 
+void IRAM_ATTR ButtonPack::isr(void *arg)
+{
+    ButtonPack *bp = (ButtonPack *)arg;
+    
+    if(!bp->_intPending) {
+        bp->_intTime = millis();
+        bp->_intPending = true;
+    }
+}
+
 void ButtonPack::port_write(uint8_t reg, uint8_t val)
 {
+    uint8_t wbuf[2] = { reg, val };
+
     switch(_st) {
     case REM_BP_TYPE_PCA8574:
-        Wire.beginTransmission(_i2caddr);
-        Wire.write(val);
-        Wire.endTransmission();
+        i2cbus_xfer(_i2caddr, &wbuf[1], 1, NULL, 0, I2CBUS_NOGAP);
         break;
     case REM_BP_TYPE_PCA9554:
-        Wire.beginTransmission(_i2caddr);
-        Wire.write(reg);
-        Wire.write(val);
-        Wire.endTransmission(); 
+        i2cbus_xfer(_i2caddr, wbuf, 2, NULL, 0, I2CBUS_NOGAP);
         break;
     }  
 }
 
 int ButtonPack::port_read(uint8_t *buf)
 {
-    int i2clen = 0;
+    uint8_t reg = 0;
+
+    switch(_st) {
+    case REM_BP_TYPE_PCA8574:
+        return i2cbus_xfer(_i2caddr, NULL, 0, buf, 1, I2CBUS_NOGAP);
+    case REM_BP_TYPE_PCA9554:
+        return i2cbus_xfer(_i2caddr, &reg, 1, buf, 1, I2CBUS_NOGAP);
+    }
+    return 0;
+}
+
+// Queue port read; result goes to _mb
+void ButtonPack::port_post()
+{
+    uint8_t reg = 0;
 
     switch(_st) {
     case REM_BP_TYPE_PCA8574:
-        i2clen = Wire.requestFrom(_i2caddr, (int)1);
-        buf[0] = Wire.read();
+        i2cbus_post(_i2caddr, NULL, 0, 1, I2CBUS_NOGAP, &_mb);
         break;
     case REM_BP_TYPE_PCA9554:
-        Wire.beginTransmission(_i2caddr);
-        Wire.write(0);
-        Wire.endTransmission();
-        delay(1);
-        i2clen = Wire.requestFrom(_i2caddr, (int)1);
-        buf[0] = Wire.read();
+        i2cbus_post(_i2caddr, &reg, 1, 1, I2CBUS_NOGAP, &_mb);
         break;
     }
-    return i2clen;
 }
@@ -56,7 +56,7 @@
 #ifndef _REMOTEINPUT_H
 #define _REMOTEINPUT_H
 
-#include <Wire.h>
+#include "i2cbus.h"
 
 /*
  * REMRotEnc class
@@ -92,6 +92,11 @@ class REMRotEnc {
 
     private:
         int32_t getEncPos();
+        bool    pollEncPos(int32_t &pos, unsigned long interval);
+        int     encPosReg(uint8_t *wbuf, int &wlen);
+        int32_t decodeEncPos(const uint8_t *buf);
+        void    calcThrottlePos(int32_t pos);
+        int32_t adsFilter(int32_t val);
         int     read(uint16_t base, uint8_t reg, uint8_t *buf, uint8_t num);
         void    write(uint16_t base, uint8_t reg, uint8_t *buf, uint8_t num);
 
@@ -103,11 +108,14 @@ class REMRotEnc {
         int8_t        _type = 0;        // 0=throttle; 1=vol
         
         int           _i2caddr;
+        int16_t       _rdGap = I2CBUS_NOGAP;
+        i2cMailbox    _mb = { I2CMB_IDLE };
 
         union {
             int32_t   throttlePos = 0;
             int32_t   rotEncPos;
         };
+        int32_t       throttleRawPos = 0;    // Before scaling, for hysteresis
         int32_t       rotEncZeroPos = 0;
         int32_t       throttlePositionsUp = 5;
         int32_t       throttlePositionsDown = -5;
@@ -119,6 +127,12 @@ class REMRotEnc {
         int           dfroffslots;
 
         bool          scaleThrottlePos = false;
+
+        // ADC filter
+        bool          _adsPrimed = false;
+        int32_t       _adsHist[3];
+        int           _adsIdx = 0;
+        int32_t       _adsAcc;
 };
 
 
@@ -195,6 +209,8 @@ class RemButton {
 
 #define PACK_SIZE 8
 
+#define BP_SAFETY_POLL 1000   // ms; port read interval in interrupt mode if INT stays quiet
+
 /*
  * RemButton class
  */
@@ -204,7 +220,7 @@ class ButtonPack {
     public:
         ButtonPack(int numTypes, const uint8_t *addrArr);
 
-        bool begin();
+        bool begin(int intPin = -1);
 
         void setScanInterval(const unsigned long scanInterval);
         void setTiming(int idx, const int debounceTs, const int lPressTs);
@@ -225,9 +241,13 @@ class ButtonPack {
 
         void reset(int);
         void transitionTo(int, ButState nextState);
+        void advance(uint8_t port, unsigned long now, unsigned long evTime);
+
+        static void isr(void *arg);
 
         void port_write(uint8_t reg, uint8_t val);
         int  port_read(uint8_t *buf);
+        void port_post();
 
         void (*_pressDownFunc)(int) = NULL;
         void (*_pressEndFunc)(int) = NULL;
@@ -247,6 +267,16 @@ class ButtonPack {
 
         unsigned long _scanInterval = 20;
         unsigned long _lastScan = 0;
+
+        // Interrupt mode (INT line connected)
+        int           _intPin = -1;
+        volatile bool _intPending = false;
+        volatile unsigned long _intTime = 0;
+        unsigned long _lastRead = 0;
+        unsigned long _evTime = 0;
+        uint8_t       _port = 0xff;
+
+        i2cMailbox    _mb = { I2CMB_IDLE };
       
         int _buttonPressed;
       
@@ -0,0 +1,185 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Low-power idle while fake-off
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#include "remote_global.h"
+
+#include <Arduino.h>
+#include <esp_idf_version.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+
+#include "lowpower.h"
+#include "remote_wifi.h"
+
+// GPIOs that wake us: Fake power, buttons A/B, calibration
+static const uint8_t wakePins[] = { 
+    FPOWER_IO_PIN, BUTA_IO_PIN, BUTB_IO_PIN, CALIBB_IO_PIN 
+};
+
+static TaskHandle_t  loopTask = NULL;
+static volatile bool woken = false;
+
+static lpStateMachine lpsm;
+static bool          haveAutoLS = false;
+
+static void IRAM_ATTR wakeISR()
+{
+    BaseType_t hpw = pdFALSE;
+    
+    woken = true;
+    vTaskNotifyGiveFromISR(loopTask, &hpw);
+    if(hpw) portYIELD_FROM_ISR();
+}
+
+static bool autoLightSleep(bool enable)
+{
+    #if ESP_IDF_VERSION_MAJOR >= 5
+    esp_pm_config_t pmc;
+    #else
+    esp_pm_config_esp32_t pmc;
+    #endif
+
+    // No frequency scaling; audio might start any time
+    pmc.max_freq_mhz = pmc.min_freq_mhz = getCpuFrequencyMhz();
+    pmc.light_sleep_enable = enable;
+
+    // Fails unless power management and tickless idle
+    // are enabled in the sdkconfig of the core
+    return (esp_pm_configure(&pmc) == ESP_OK);
+}
+
+static void enterLowPower()
+{
+    for(int i = 0; i < (int)sizeof(wakePins); i++) {
+        attachInterrupt(wakePins[i], wakeISR, CHANGE);
+        // Wake from light sleep when level changes
+        gpio_wakeup_enable((gpio_num_t)wakePins[i], 
+            digitalRead(wakePins[i]) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    }
+    esp_sleep_enable_gpio_wakeup();
+
+    wifi_setPowerSave(true);
+    haveAutoLS = autoLightSleep(true);
+
+    #ifdef REMOTE_DBG
+    Serial.printf("Entering low-power mode (auto light sleep %d)\n", haveAutoLS);
+    #endif
+}
+
+static void leaveLowPower()
+{
+    if(haveAutoLS) {
+        autoLightSleep(false);
+    }
+    
+    wifi_setPowerSave(false);
+    
+    for(int i = 0; i < (int)sizeof(wakePins); i++) {
+        gpio_wakeup_disable((gpio_num_t)wakePins[i]);
+        detachInterrupt(wakePins[i]);
+    }
+
+    #ifdef REMOTE_DBG
+    Serial.println("Leaving low-power mode");
+    #endif
+}
+
+void lp_setup()
+{
+    loopTask = xTaskGetCurrentTaskHandle();
+    lpsm.begin(millis());
+}
+
+void lp_update(bool fakeOff, bool busy)
+{
+    if(woken) {
+        woken = false;
+        busy = true;
+    }
+
+    switch(lpsm.update(fakeOff, busy, millis())) {
+    case LPT_ENTER:
+        enterLowPower();
+        break;
+    case LPT_LEAVE:
+        leaveLowPower();
+        break;
+    }
+}
+
+void lp_idle(unsigned long ms)
+{
+    unsigned long startNow = millis();
+
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms));
+
+    lpsm.idled(millis() - startNow);
+}
+
+uint8_t lp_state()
+{
+    return lpsm.state();
+}
+
+unsigned long lp_idleMax(unsigned long normal)
+{
+    return lpsm.idleMax(normal);
+}
+
+void lp_getStats(lpStats &st)
+{
+    lpsm.getStats(st, haveAutoLS);
+}
@@ -0,0 +1,185 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Low-power state machine (no hardware dependencies)
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _REM_LPSTATE_H
+#define _REM_LPSTATE_H
+
+#include <stdint.h>
+
+#define LP_ENTER_DELAY  5000    // ms of quiet while fake-off before entering low-power mode
+#define LP_IDLE_MAX     100     // ms; max time main loop idles in low-power mode
+
+// States
+#define LP_OFF          0       // Fake power is on
+#define LP_PENDING      1       // Fake-off, waiting for quiet
+#define LP_ON           2       // Low-power mode
+
+// Transitions, returned by update()
+#define LPT_NONE        0
+#define LPT_ENTER       1       // Set up wakeup sources, power save
+#define LPT_LEAVE       2       // Undo that
+
+// Rough current estimates (mA) for ESP32 and WiFi only 
+// (no display, LEDs, amp)
+#define LP_EST_AWAKE_MA 110     // CPU running, WiFi without modem sleep
+#define LP_EST_IDLE_MA  35      // CPU idle, WiFi modem sleep
+#define LP_EST_LSLP_MA  12      // Automatic light sleep, WiFi modem sleep
+
+typedef struct {
+    uint8_t       state;
+    bool          autoLightSleep;   // Automatic light sleep supported
+    unsigned long fakeOffMs;        // Time spent fake-off
+    unsigned long lowPowerMs;       // ... thereof in low-power mode
+    unsigned long sleepMs;          // ... thereof idle
+    uint16_t      estCurrent;       // mA while fake-off (0 = no data)
+} lpStats;
+
+class lpStateMachine {
+
+    public:
+
+        void begin(unsigned long now)
+        {
+            _lastUpdate = now;
+        }
+
+        // busy: something is going on (display, audio, calibration,
+        // a wakeup) that needs the full loop
+        int update(bool fakeOff, bool busy, unsigned long now)
+        {
+            int ret = LPT_NONE;
+            
+            if(_state != LP_OFF) {
+                _fakeOffMs += now - _lastUpdate;
+                if(_state == LP_ON) {
+                    _lowPowerMs += now - _lastUpdate;
+                }
+            }
+            _lastUpdate = now;
+
+            switch(_state) {
+            case LP_OFF:
+                if(fakeOff) {
+                    _state = LP_PENDING;
+                    _quietSince = now;
+                }
+                break;
+            case LP_PENDING:
+                if(!fakeOff) {
+                    _state = LP_OFF;
+                } else if(busy) {
+                    _quietSince = now;
+                } else if(now - _quietSince >= LP_ENTER_DELAY) {
+                    _state = LP_ON;
+                    ret = LPT_ENTER;
+                }
+                break;
+            case LP_ON:
+                if(!fakeOff || busy) {
+                    _state = fakeOff ? LP_PENDING : LP_OFF;
+                    _quietSince = now;
+                    ret = LPT_LEAVE;
+                }
+                break;
+            }
+
+            return ret;
+        }
+
+        // Account for time spent idle
+        void idled(unsigned long ms)
+        {
+            if(_state == LP_ON) {
+                _sleepMs += ms;
+            }
+        }
+
+        uint8_t state() const { return _state; }
+
+        // Polling interval, stretched in low-power mode
+        unsigned long idleMax(unsigned long normal) const
+        {
+            return (_state == LP_ON) ? LP_IDLE_MAX : normal;
+        }
+
+        void getStats(lpStats &st, bool autoLightSleep) const
+        {
+            st.state = _state;
+            st.autoLightSleep = autoLightSleep;
+            st.fakeOffMs = _fakeOffMs;
+            st.lowPowerMs = _lowPowerMs;
+            st.sleepMs = _sleepMs;
+            st.estCurrent = 0;
+
+            if(_fakeOffMs) {
+                unsigned long idleMA = autoLightSleep ? LP_EST_LSLP_MA : LP_EST_IDLE_MA;
+                unsigned long sl = (_sleepMs > _fakeOffMs) ? _fakeOffMs : _sleepMs;
+                st.estCurrent = (uint16_t)(((uint64_t)LP_EST_AWAKE_MA * (_fakeOffMs - sl) + 
+                                            (uint64_t)idleMA * sl) / _fakeOffMs);
+            }
+        }
+
+    private:
+
+        uint8_t       _state = LP_OFF;
+        unsigned long _quietSince = 0;
+        unsigned long _lastUpdate = 0;
+
+        unsigned long _fakeOffMs = 0;
+        unsigned long _lowPowerMs = 0;
+        unsigned long _sleepMs = 0;
+};
+
+#endif
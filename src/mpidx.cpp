@@ -0,0 +1,451 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Music folder index
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#include "remote_global.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include <FS.h>
+
+#include "mpidx.h"
+
+/*
+ * Music folder index
+ *
+ * Binary file next to TCD_DONE.TXT, written after renaming.
+ * Holds one entry per file number (000 - count-1), so mp_init()
+ * and the player need no file system access. The directory
+ * signature tells whether files were added or removed since;
+ * the audio task reports replaced (or vanished) files when it
+ * plays them, which are then re-checked.
+ */
+#define MPIDX_MAGIC     0x5849504d    // "MPIX"
+#define MPIDX_VERSION   2
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;         // highest file number + 1
+    uint32_t csum;          // over all entries
+    uint32_t dirSig;        // over set of existing ddd.mp3
+} mpIdxHeader;
+
+static const char *mpidxfn = "/REM_MPIX.BIN";
+mpIdxEntry      *mpIndex = NULL;
+uint16_t        mpIdxCount = 0;
+static uint32_t mpIdxSig = 0;
+static uint8_t  mpIdxFolder = 0;
+static bool     mpIdxDirty = false;
+
+static void mpidx_fileName(char *fnbuf, int folder, int num)
+{
+    sprintf(fnbuf, "/music%1d/%03d.mp3", folder, num);
+}
+
+static uint32_t mpidx_csum(const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    uint32_t c = 0x811c9dc5;    // FNV-1a
+
+    for(size_t i = 0; i < len; i++) {
+        c = (c ^ p[i]) * 16777619;
+    }
+    return c;
+}
+
+void mpidx_free()
+{
+    mpidx_flush();
+
+    if(mpIndex) {
+        free(mpIndex);
+        mpIndex = NULL;
+    }
+    mpIdxCount = 0;
+}
+
+// Returns file number if name is "ddd.mp3", -1 otherwise
+static int mpidx_fileNum(const char *fn)
+{
+    const char *t = strrchr(fn, '/');
+
+    if(t) fn = t + 1;
+
+    if(strlen(fn) != 7 || strcasecmp(fn + 3, ".mp3"))
+        return -1;
+    if(fn[0] < '0' || fn[0] > '9' ||
+       fn[1] < '0' || fn[1] > '9' ||
+       fn[2] < '0' || fn[2] > '9')
+        return -1;
+
+    return (fn[0] - '0') * 100 + (fn[1] - '0') * 10 + (fn[2] - '0');
+}
+
+// Estimate duration from first frame: Use frame count from
+// Xing/Info header if present (VBR), otherwise bitrate.
+static uint32_t mpidx_duration(const uint8_t *b, uint32_t dataLen)
+{
+    static const uint16_t br1[16] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 };
+    static const uint16_t br2[16] = { 0,  8, 16, 24, 32, 40, 48, 56,  64,  80,  96, 112, 128, 144, 160, 0 };
+    static const uint16_t srt[3]  = { 44100, 48000, 32000 };
+
+    if(b[0] != 0xff || (b[1] & 0xe0) != 0xe0)
+        return 0;
+
+    int ver   = (b[1] >> 3) & 3;    // 3 = MPEG1, 2 = MPEG2, 0 = MPEG2.5
+    int layer = (b[1] >> 1) & 3;    // 1 = Layer III
+    int bri   = b[2] >> 4;
+    int sri   = (b[2] >> 2) & 3;
+    
+    if(ver == 1 || layer != 1 || !bri || bri == 15 || sri == 3)
+        return 0;
+
+    bool     mpeg1 = (ver == 3);
+    bool     mono  = ((b[3] >> 6) == 3);
+    uint32_t rate  = srt[sri] >> (mpeg1 ? 0 : (ver == 2 ? 1 : 2));
+    uint32_t spf   = mpeg1 ? 1152 : 576;
+    const uint8_t *x = b + 4 + (mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17));
+
+    if((!memcmp(x, "Xing", 4) || !memcmp(x, "Info", 4)) && (x[7] & 1)) {
+        uint32_t frames = (x[8] << 24) | (x[9] << 16) | (x[10] << 8) | x[11];
+        return (uint32_t)((uint64_t)frames * spf * 1000 / rate);
+    }
+
+    // kbps = bits per ms
+    return (uint32_t)((uint64_t)dataLen * 8 / (mpeg1 ? br1[bri] : br2[bri]));
+}
+
+static void mpidx_scanFile(File &file, mpIdxEntry *e)
+{
+    uint8_t buf[48];
+
+    e->size = file.size();
+    e->dataOffs = 0;
+    e->durMs = 0;
+
+    if(file.read(buf, 10) != 10)
+        return;
+    e->dataOffs = skipID3((char *)buf);
+
+    if(!file.seek(e->dataOffs) || file.read(buf, sizeof(buf)) != sizeof(buf))
+        return;
+    if(e->size > e->dataOffs) {
+        e->durMs = mpidx_duration(buf, e->size - e->dataOffs);
+    }
+}
+
+// Signature of a music folder: Hash over the set of file
+// numbers present. Needs a directory listing, but no file
+// is opened.
+static bool mpidx_dirSig(int folder, uint32_t& sig)
+{
+    char fnbuf[32];
+    uint8_t present[1000 / 8];
+    int num;
+#ifdef HAVE_GETNEXTFILENAME
+    bool isDir;
+#endif
+
+    sprintf(fnbuf, "/music%1d", folder);
+    File origin = SD.open(fnbuf);
+    if(!origin)
+        return false;
+    if(!origin.isDirectory()) {
+        origin.close();
+        return false;
+    }
+
+    memset(present, 0, sizeof(present));
+
+#ifdef HAVE_GETNEXTFILENAME
+    String fileName = origin.getNextFileName(&isDir);
+    while(fileName.length() > 0) {
+        if(!isDir && (num = mpidx_fileNum(fileName.c_str())) >= 0) {
+            present[num >> 3] |= 1 << (num & 7);
+        }
+        fileName = origin.getNextFileName(&isDir);
+    }
+#else
+    File file = origin.openNextFile();
+    while(file) {
+        if(!file.isDirectory() && (num = mpidx_fileNum(file.name())) >= 0) {
+            present[num >> 3] |= 1 << (num & 7);
+        }
+        file.close();
+        file = origin.openNextFile();
+    }
+#endif
+
+    origin.close();
+
+    sig = mpidx_csum(present, sizeof(present));
+
+    return true;
+}
+
+// Write index to the folder it belongs to
+static void mpidx_write()
+{
+    char fnbuf[32];
+    mpIdxHeader h;
+
+    h.magic = MPIDX_MAGIC;
+    h.version = MPIDX_VERSION;
+    h.count = mpIdxCount;
+    h.csum = mpidx_csum(mpIndex, mpIdxCount * sizeof(mpIdxEntry));
+    h.dirSig = mpIdxSig;
+
+    sprintf(fnbuf, "/music%1d%s", mpIdxFolder, mpidxfn);
+    File file = SD.open(fnbuf, FILE_WRITE);
+    if(file) {
+        file.write((uint8_t *)&h, sizeof(h));
+        file.write((uint8_t *)mpIndex, mpIdxCount * sizeof(mpIdxEntry));
+        file.close();
+        #ifdef REMOTE_DBG
+        Serial.printf("MusicPlayer: Wrote index, %d entries\n", mpIdxCount);
+        #endif
+    }
+
+    mpIdxDirty = false;
+}
+
+// Write back entries updated by mpidx_validate()
+void mpidx_flush()
+{
+    if(mpIndex && mpIdxDirty) {
+        mpidx_write();
+    }
+}
+
+// Check entry against its file, after the audio task found
+// it missing or of a different size; a replaced file is 
+// rescanned. Returns false if the file is gone.
+bool mpidx_validate(int num)
+{
+    char fnbuf[20];
+    mpIdxEntry *e;
+
+    if(!mpIndex || num < 0 || num >= mpIdxCount)
+        return false;
+
+    e = &mpIndex[num];
+
+    mpidx_fileName(fnbuf, mpIdxFolder, num);
+    File file = SD.open(fnbuf);
+    if(!file) {
+        e->size = 0;
+        mpIdxDirty = true;
+        return false;
+    }
+
+    if(file.size() != e->size) {
+        #ifdef REMOTE_DBG
+        Serial.printf("MusicPlayer: %s changed, rescanning\n", fnbuf);
+        #endif
+        mpidx_scanFile(file, e);
+        mpIdxDirty = true;
+    }
+    file.close();
+
+    return (e->size != 0);
+}
+
+// Load index of current folder, and verify it against the
+// folder's signature.
+bool mpidx_load(int folder)
+{
+    char fnbuf[32];
+    mpIdxHeader h;
+    uint32_t sig;
+    size_t len;
+    bool ok = false;
+
+    mpidx_free();
+
+    sprintf(fnbuf, "/music%1d%s", folder, mpidxfn);
+    if(!SD.exists(fnbuf))
+        return false;
+    
+    File file = SD.open(fnbuf);
+    if(!file)
+        return false;
+
+    if(file.read((uint8_t *)&h, sizeof(h)) == sizeof(h) &&
+       h.magic == MPIDX_MAGIC && h.version == MPIDX_VERSION &&
+       h.count && h.count <= 1000 &&
+       file.size() == sizeof(h) + h.count * sizeof(mpIdxEntry)) {
+        len = h.count * sizeof(mpIdxEntry);
+        if((mpIndex = (mpIdxEntry *)malloc(len))) {
+            ok = (file.read((uint8_t *)mpIndex, len) == len) && 
+                 (mpidx_csum(mpIndex, len) == h.csum);
+        }
+    }
+    file.close();
+
+    if(ok) {
+        ok = mpidx_dirSig(folder, sig) && (sig == h.dirSig);
+    }
+
+    if(!ok) {
+        #ifdef REMOTE_DBG
+        Serial.println("MusicPlayer: Index missing, invalid or stale");
+        #endif
+        mpidx_free();
+        return false;
+    }
+
+    mpIdxCount = h.count;
+    mpIdxSig = h.dirSig;
+    mpIdxFolder = folder;
+
+    #ifdef REMOTE_DBG
+    Serial.printf("MusicPlayer: Loaded index, %d entries\n", mpIdxCount);
+    #endif
+    
+    return true;
+}
+
+// Build index of current folder from a directory
+// listing and write it to the folder.
+bool mpidx_build(int folder)
+{
+    char fnbuf[32];
+    mpIdxEntry *e;
+    uint8_t present[1000 / 8];
+    int num, maxNum = -1;
+#ifdef HAVE_GETNEXTFILENAME
+    bool isDir;
+#endif
+
+    mpidx_free();
+
+    sprintf(fnbuf, "/music%1d", folder);
+    if(!SD.exists(fnbuf))
+        return false;
+
+    File origin = SD.open(fnbuf);
+    if(!origin)
+        return false;
+    if(!origin.isDirectory() || !(e = (mpIdxEntry *)calloc(1000, sizeof(mpIdxEntry)))) {
+        origin.close();
+        return false;
+    }
+
+    memset(present, 0, sizeof(present));
+
+#ifdef HAVE_GETNEXTFILENAME
+    String fileName = origin.getNextFileName(&isDir);
+    while(fileName.length() > 0) {
+        if(!isDir && (num = mpidx_fileNum(fileName.c_str())) >= 0) {
+            present[num >> 3] |= 1 << (num & 7);
+            mpidx_fileName(fnbuf, folder, num);
+            File file = SD.open(fnbuf);
+            if(file) {
+                mpidx_scanFile(file, &e[num]);
+                file.close();
+                if(num > maxNum) maxNum = num;
+            }
+        }
+        fileName = origin.getNextFileName(&isDir);
+    }
+#else
+    File file = origin.openNextFile();
+    while(file) {
+        if(!file.isDirectory() && (num = mpidx_fileNum(file.name())) >= 0) {
+            present[num >> 3] |= 1 << (num & 7);
+            mpidx_scanFile(file, &e[num]);
+            if(num > maxNum) maxNum = num;
+        }
+        file.close();
+        file = origin.openNextFile();
+    }
+#endif
+
+    origin.close();
+
+    if(maxNum < 0) {
+        free(e);
+        return false;
+    }
+
+    mpIdxCount = maxNum + 1;
+    if(!(mpIndex = (mpIdxEntry *)realloc(e, mpIdxCount * sizeof(mpIdxEntry)))) {
+        mpIndex = e;
+    }
+
+    mpIdxSig = mpidx_csum(present, sizeof(present));
+    mpIdxFolder = folder;
+
+    mpidx_write();
+
+    return true;
+}
+
+int skipID3(char *buf)
+{
+    if(buf[0] == 'I' && buf[1] == 'D' && buf[2] == '3' && 
+       buf[3] >= 0x02 && buf[3] <= 0x04 && buf[4] == 0 &&
+       (!(buf[5] & 0x80))) {
+        int32_t pos = ((buf[6] << (24-3)) |
+                       (buf[7] << (16-2)) |
+                       (buf[8] << (8-1))  |
+                       (buf[9])) + 10;
+        #ifdef REMOTE_DBG
+        Serial.printf("Skipping ID3 tags, seeking to %d (0x%x)\n", pos, pos);
+        #endif
+        return pos;
+    }
+    return 0;
+}
@@ -0,0 +1,786 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Music folder renamer
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#include "remote_global.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include <FS.h>
+
+#include "mpren.h"
+
+static void mpren_quickSort(char **a, int s, int e);
+static bool mpren_strLT(const char *a, const char *b);
+static void mpren_finish();
+
+// Check file is eligible for renaming:
+// - not a hidden/exAtt file,
+// - file name ends with ".mp3"
+// - filename not already "/musicX/ddd.mp3"
+static bool mpren_checkFN(const char *buf)
+{
+    // Hidden or macOS exAttr file? Ignore.
+    if(buf[0] == '.') return true;
+
+    size_t s = strlen(buf);
+
+    // Filename shorter than ".mp3"? Ignore.
+    if(s < 4) return true;
+
+    s -= 4;
+    // Not an mp3? Ignore.
+    if(buf[s] != '.' || buf[s+3] != '3')
+        return true;
+    if(buf[s+1] != 'm' && buf[s+1] != 'M')
+        return true;
+    if(buf[s+2] != 'p' && buf[s+2] != 'P')
+        return true;
+
+    // Now check for xxx.mp3 (xxx=000-999)
+
+    // Filename shorter or longer? Do it.
+    if(s != 3)
+        return false;
+
+    // Filename not a 3-digit number? Do it.
+    if(buf[0] < '0' || buf[0] > '9' ||
+       buf[1] < '0' || buf[1] > '9' ||
+       buf[2] < '0' || buf[2] > '9')
+        return false;
+
+    // Otherwise ignore.
+    return true;
+}
+
+/*
+ * The renamer works in bounded memory: File names are collected 
+ * in a sort buffer of MPREN_SORT_BUDGET bytes. When it is full, 
+ * the names are sorted and spilled to a run file. The runs are 
+ * then merged, at most MPREN_MERGE_WAYS at a time, until one 
+ * sorted list is left, which is then worked through for renaming.
+ * Merging and renaming save their progress to a file, so that
+ * work resumes after a power loss. Work files live in the music 
+ * folder (they are not mp3s, so they are ignored by the scan)
+ * and are removed when done. A fresh start first removes any
+ * work files left over from an interrupted run.
+ */
+
+#define MPREN_SORT_BUDGET  8192     // Bytes for names + pointers
+#define MPREN_MERGE_WAYS   8        // Runs merged in one pass
+#define MPREN_RDBUF        128      // Read buffer per run
+#define MPREN_PROG_EVERY   8        // Save progress every n renames
+
+enum {
+    MPREN_SCAN = 0,
+    MPREN_MERGE,
+    MPREN_RENAME,
+    MPREN_CLEAN,        // Before SCAN; numbers above are saved
+    MPREN_DONE
+};
+
+typedef struct {
+    int      pos, len;
+    bool     valid;
+    char     buf[MPREN_RDBUF];
+    char     line[256];
+} mprenReader;
+
+static int          mprenPhase = MPREN_DONE;
+static int          mprenNum;
+static File         mprenDir;
+static char        *mprenBuf = NULL;    // Sort buffer: Names grow up,
+static char        *mprenStrs;          // pointers grow down from end
+static int          mprenNumPtrs;
+static int          mprenRunLo, mprenRunHi;
+static File         mprenRdFile[MPREN_MERGE_WAYS];
+static mprenReader *mprenRd = NULL;
+static int          mprenNumRd = 0;
+static File         mprenOut;
+static int          mprenCount;         // Next file number
+static uint32_t     mprenListPos;       // Bytes of list processed
+static int          mprenTotal, mprenDone;
+static int          mprenSinceSave;
+static mprenMaxNumFunc mprenMaxNum;
+static mprenDoneFunc   mprenOnDone;
+static bool         mprenFailed = false;
+
+static void mpren_fileName(char *fnbuf, int num)
+{
+    sprintf(fnbuf, "/music%1d/%03d.mp3", mprenNum, num);
+}
+
+static void mpren_runName(char *fnbuf, int run)
+{
+    sprintf(fnbuf, "/music%1d/MPREN%03d.TMP", mprenNum, run);
+}
+
+static void mpren_progName(char *fnbuf)
+{
+    sprintf(fnbuf, "/music%1d/MPREN_P.TMP", mprenNum);
+}
+
+static char **mpren_ptrs()
+{
+    return (char **)(mprenBuf + MPREN_SORT_BUDGET) - mprenNumPtrs;
+}
+
+static void mpren_saveProgress()
+{
+    char fnbuf[32];
+    char buf[80];
+
+    mpren_progName(fnbuf);
+    File file = SD.open(fnbuf, FILE_WRITE);
+    if(file) {
+        int len = sprintf(buf, "%d %d %d %d %lu %d %d\n", 
+                      mprenPhase, mprenRunLo, mprenRunHi, mprenCount,
+                      (unsigned long)mprenListPos, mprenTotal, mprenDone);
+        file.write((uint8_t *)buf, len);
+        file.close();
+    }
+    mprenSinceSave = 0;
+}
+
+static bool mpren_loadProgress()
+{
+    char fnbuf[32];
+    char buf[80];
+    unsigned long lp;
+    int len;
+
+    mpren_progName(fnbuf);
+    if(!SD.exists(fnbuf))
+        return false;
+
+    File file = SD.open(fnbuf);
+    if(!file)
+        return false;
+    len = file.read((uint8_t *)buf, sizeof(buf) - 1);
+    file.close();
+    if(len <= 0)
+        return false;
+    buf[len] = 0;
+
+    if(sscanf(buf, "%d %d %d %d %lu %d %d", &mprenPhase, &mprenRunLo, &mprenRunHi, 
+                    &mprenCount, &lp, &mprenTotal, &mprenDone) != 7)
+        return false;
+    if((mprenPhase != MPREN_MERGE && mprenPhase != MPREN_RENAME) ||
+       mprenRunLo < 0 || mprenRunHi <= mprenRunLo || mprenRunHi > 999)
+        return false;
+    mprenListPos = lp;
+
+    return true;
+}
+
+static bool mpren_openReader(int idx, int run, uint32_t pos)
+{
+    char fnbuf[32];
+
+    mpren_runName(fnbuf, run);
+    if(!(mprenRdFile[idx] = SD.open(fnbuf)))
+        return false;
+    if(pos && !mprenRdFile[idx].seek(pos)) {
+        mprenRdFile[idx].close();
+        return false;
+    }
+    mprenRd[idx].pos = mprenRd[idx].len = 0;
+    mprenRd[idx].valid = true;
+    return true;
+}
+
+// Read next line into reader's line buffer; invalidates
+// reader at end of file.
+static bool mpren_readLine(int idx)
+{
+    mprenReader *r = &mprenRd[idx];
+    int i = 0;
+
+    while(r->valid) {
+        if(r->pos >= r->len) {
+            r->len = mprenRdFile[idx].read((uint8_t *)r->buf, MPREN_RDBUF);
+            r->pos = 0;
+            if(r->len <= 0) {
+                r->valid = false;
+                break;
+            }
+        }
+        char c = r->buf[r->pos++];
+        if(c == '\n') {
+            r->line[i] = 0;
+            return true;
+        }
+        if(i < 255) r->line[i++] = c;
+    }
+
+    return false;
+}
+
+static void mpren_closeReaders()
+{
+    for(int i = 0; i < mprenNumRd; i++) {
+        mprenRdFile[i].close();
+    }
+    mprenNumRd = 0;
+}
+
+void mpren_cleanup()
+{
+    mpren_closeReaders();
+    if(mprenRd) {
+        free(mprenRd);
+        mprenRd = NULL;
+    }
+    if(mprenBuf) {
+        free(mprenBuf);
+        mprenBuf = NULL;
+    }
+    if(mprenDir) mprenDir.close();
+    if(mprenOut) mprenOut.close();
+    mprenPhase = MPREN_DONE;
+    mprenFailed = false;
+}
+
+// Sort names in buffer and write them to a new run
+static bool mpren_spill()
+{
+    char fnbuf[32];
+    char **a = mpren_ptrs();
+
+    if(!mprenNumPtrs)
+        return true;
+
+    mpren_quickSort(a, 0, mprenNumPtrs - 1);
+
+    mpren_runName(fnbuf, mprenRunHi);
+    File file = SD.open(fnbuf, FILE_WRITE);
+    if(!file) {
+        Serial.printf("MusicPlayer/Renamer: Failed to create %s\n", fnbuf);
+        return false;
+    }
+    for(int i = 0; i < mprenNumPtrs; i++) {
+        file.write((uint8_t *)a[i], strlen(a[i]));
+        file.write('\n');
+    }
+    file.close();
+
+    #ifdef REMOTE_DBG
+    Serial.printf("MusicPlayer/Renamer: Wrote run %d (%d names)\n", mprenRunHi, mprenNumPtrs);
+    #endif
+
+    mprenRunHi++;
+    mprenTotal += mprenNumPtrs;
+    mprenNumPtrs = 0;
+    mprenStrs = mprenBuf;
+
+    return true;
+}
+
+static bool mpren_addName(const char *fn)
+{
+    const char *t = strrchr(fn, '/');
+    size_t sz;
+
+    if(t) fn = t + 1;
+
+    if(mpren_checkFN(fn))
+        return true;
+
+    sz = strlen(fn) + 1;
+    if(sz > 256)
+        return true;
+
+    if(mprenStrs + sz > (char *)(mpren_ptrs() - 1)) {
+        if(!mpren_spill())
+            return false;
+    }
+
+    strcpy(mprenStrs, fn);
+    mprenNumPtrs++;
+    *mpren_ptrs() = mprenStrs;
+    mprenStrs += sz;
+
+    return true;
+}
+
+// Work file: MPRENnnn.TMP or MPREN_P.TMP
+static bool mpren_isWorkFile(const char *fn)
+{
+    const char *t = strrchr(fn, '/');
+    size_t s;
+
+    if(t) fn = t + 1;
+    s = strlen(fn);
+
+    return (s >= 9 && !strncasecmp(fn, "MPREN", 5) && !strcasecmp(fn + s - 4, ".TMP"));
+}
+
+static void mpren_removeWorkFile(const char *fn)
+{
+    char fnbuf[256+8];
+    const char *t = strrchr(fn, '/');
+
+    if(t) fn = t + 1;
+
+    if(strlen(fn) < 256) {
+        sprintf(fnbuf, "/music%1d/%s", mprenNum, fn);
+        SD.remove(fnbuf);
+        #ifdef REMOTE_DBG
+        Serial.printf("MusicPlayer/Renamer: Removed leftover %s\n", fnbuf);
+        #endif
+    }
+}
+
+// One directory entry per step: Remove leftover work files
+// (all of them; runs of an interrupted scan need not be
+// numbered without gaps), then start over for the scan.
+static bool mpren_cleanStep()
+{
+    char fnbuf[32];
+
+#ifdef HAVE_GETNEXTFILENAME
+    bool isDir;
+    String fileName = mprenDir.getNextFileName(&isDir);
+    if(fileName.length() > 0) {
+        if(!isDir && mpren_isWorkFile(fileName.c_str())) {
+            mpren_removeWorkFile(fileName.c_str());
+        }
+        return true;
+    }
+#else
+    File file = mprenDir.openNextFile();
+    if(file) {
+        bool isWork = !file.isDirectory() && mpren_isWorkFile(file.name());
+        String fileName = file.name();
+        file.close();
+        if(isWork) {
+            mpren_removeWorkFile(fileName.c_str());
+        }
+        return true;
+    }
+#endif
+
+    mprenDir.close();
+    sprintf(fnbuf, "/music%1d", mprenNum);
+    if(!(mprenDir = SD.open(fnbuf))) {
+        return false;
+    }
+    mprenPhase = MPREN_SCAN;
+
+    return true;
+}
+
+// One directory entry per step
+static bool mpren_scanStep()
+{
+    bool ok = true;
+
+#ifdef HAVE_GETNEXTFILENAME
+    bool isDir;
+    String fileName = mprenDir.getNextFileName(&isDir);
+    if(fileName.length() > 0) {
+        if(!isDir) ok = mpren_addName(fileName.c_str());
+        return ok;
+    }
+#else
+    File file = mprenDir.openNextFile();
+    if(file) {
+        if(!file.isDirectory()) ok = mpren_addName(file.name());
+        file.close();
+        return ok;
+    }
+#endif
+
+    // End of folder
+    mprenDir.close();
+    if(!mpren_spill())
+        return false;
+    free(mprenBuf);
+    mprenBuf = NULL;
+
+    #ifdef REMOTE_DBG
+    Serial.printf("MusicPlayer/Renamer: %d files to process\n", mprenTotal);
+    #endif
+
+    if(!mprenRunHi) {
+        // Nothing to rename
+        mpren_finish();
+    } else {
+        mprenPhase = MPREN_MERGE;
+        mpren_saveProgress();
+    }
+
+    return true;
+}
+
+static void mpren_startRename()
+{
+    char fnbuf[20];
+
+    // If 000.mp3 exists, find current count
+    // the usual way. Otherwise start at 000.
+    mprenCount = 0;
+    mpren_fileName(fnbuf, 0);
+    if(SD.exists(fnbuf)) {
+        mprenCount = mprenMaxNum() + 1;
+    }
+    mprenListPos = 0;
+    mprenDone = 0;
+    mprenPhase = MPREN_RENAME;
+    mpren_saveProgress();
+}
+
+// One output line per step
+static bool mpren_mergeStep()
+{
+    char fnbuf[32];
+    int m = -1;
+
+    if(!mprenNumRd) {
+        
+        // Only one run left: This is our sorted list
+        if(mprenRunHi - mprenRunLo == 1) {
+            mpren_startRename();
+            return true;
+        }
+
+        // Start merging next group of runs into a new one
+        int n = mprenRunHi - mprenRunLo;
+        if(n > MPREN_MERGE_WAYS) n = MPREN_MERGE_WAYS;
+        for(int i = 0; i < n; i++, mprenNumRd++) {
+            if(!mpren_openReader(i, mprenRunLo + i, 0)) {
+                Serial.printf("MusicPlayer/Renamer: Failed to open run %d\n", mprenRunLo + i);
+                return false;
+            }
+            mpren_readLine(i);
+        }
+        mpren_runName(fnbuf, mprenRunHi);
+        if(!(mprenOut = SD.open(fnbuf, FILE_WRITE))) {
+            return false;
+        }
+    }
+
+    for(int i = 0; i < mprenNumRd; i++) {
+        if(mprenRd[i].valid && (m < 0 || mpren_strLT(mprenRd[i].line, mprenRd[m].line))) {
+            m = i;
+        }
+    }
+
+    if(m >= 0) {
+        mprenOut.write((uint8_t *)mprenRd[m].line, strlen(mprenRd[m].line));
+        mprenOut.write('\n');
+        mpren_readLine(m);
+        return true;
+    }
+
+    // Group done. Save progress before removing the inputs.
+    int n = mprenNumRd;
+    mpren_closeReaders();
+    mprenOut.close();
+    mprenRunLo += n;
+    mprenRunHi++;
+    mpren_saveProgress();
+    for(int i = mprenRunLo - n; i < mprenRunLo; i++) {
+        mpren_runName(fnbuf, i);
+        SD.remove(fnbuf);
+    }
+
+    return true;
+}
+
+static void mpren_finish()
+{
+    char fnbuf[32];
+
+    mpren_closeReaders();
+
+    // Remove progress first: Should we lose power in
+    // between, a fresh start removes the list.
+    if(mprenRunHi > mprenRunLo) {
+        mpren_progName(fnbuf);
+        SD.remove(fnbuf);
+        mpren_runName(fnbuf, mprenRunLo);
+        SD.remove(fnbuf);
+    }
+
+    mpren_cleanup();
+
+    // Write DONE file, index
+    mprenOnDone();
+}
+
+// One file per step
+static bool mpren_renameStep()
+{
+    char fnbuf[20];
+    char fnbuf2[256+8];
+
+    if(!mprenNumRd) {
+        if(!mpren_openReader(0, mprenRunLo, mprenListPos)) {
+            Serial.printf("MusicPlayer/Renamer: Failed to open list\n");
+            return false;
+        }
+        mprenNumRd = 1;
+    }
+
+    if(mprenCount > 999 || !mpren_readLine(0)) {
+        mpren_finish();
+        return true;
+    }
+
+    mprenListPos += strlen(mprenRd[0].line) + 1;
+
+    sprintf(fnbuf2, "/music%1d/%s", mprenNum, mprenRd[0].line);
+    mpren_fileName(fnbuf, mprenCount);
+    if(!SD.rename(fnbuf2, fnbuf)) {
+        if(!SD.exists(fnbuf2)) {
+            // Renamed before power loss, or gone
+            mprenCount--;
+        } else {
+            bool done = false;
+            while(!done) {
+                mprenCount++;
+                if(mprenCount <= 999) {
+                    mpren_fileName(fnbuf, mprenCount);
+                    done = SD.rename(fnbuf2, fnbuf);
+                } else {
+                    done = true;
+                }
+            }
+        }
+    }
+    #ifdef REMOTE_DBG
+    Serial.printf("MusicPlayer/Renamer: Renamed '%s' to '%s'\n", fnbuf2, fnbuf);
+    #endif
+
+    mprenCount++;
+    mprenDone++;
+
+    if(++mprenSinceSave >= MPREN_PROG_EVERY) {
+        mpren_saveProgress();
+    }
+
+    return true;
+}
+
+// Start or resume processing folder num
+bool mpren_begin(int num, mprenMaxNumFunc maxNumFunc, mprenDoneFunc doneFunc)
+{
+    char fnbuf[32];
+
+    mpren_cleanup();
+    
+    mprenNum = num;
+    mprenSinceSave = 0;
+    mprenMaxNum = maxNumFunc;
+    mprenOnDone = doneFunc;
+
+    if(!(mprenRd = (mprenReader *)malloc(MPREN_MERGE_WAYS * sizeof(mprenReader)))) {
+        Serial.printf("MusicPlayer/Renamer: Failed to allocate readers\n");
+        mprenFailed = true;
+        return false;
+    }
+
+    if(mpren_loadProgress()) {
+        #ifdef REMOTE_DBG
+        Serial.printf("MusicPlayer/Renamer: Resuming (phase %d)\n", mprenPhase);
+        #endif
+        return true;
+    }
+
+    sprintf(fnbuf, "/music%1d", num);
+    mprenDir = SD.open(fnbuf);
+    if(!mprenDir) {
+        Serial.printf("MusicPlayer/Renamer: '%s' failed to open\n", fnbuf);
+        mpren_cleanup();
+        mprenFailed = true;
+        return false;
+    }
+    if(!mprenDir.isDirectory()) {
+        Serial.printf("MusicPlayer/Renamer: '%s' is not a directory\n", fnbuf);
+        mpren_cleanup();
+        mprenFailed = true;
+        return false;
+    }
+
+    if(!(mprenBuf = (char *)malloc(MPREN_SORT_BUDGET))) {
+        Serial.printf("MusicPlayer/Renamer: Failed to allocate sort buffer\n");
+        mpren_cleanup();
+        mprenFailed = true;
+        return false;
+    }
+    mprenStrs = mprenBuf;
+    mprenNumPtrs = 0;
+    mprenRunLo = mprenRunHi = 0;
+    mprenTotal = mprenDone = 0;
+
+    // Fresh start: Remove leftovers first
+    mprenPhase = MPREN_CLEAN;
+
+    return true;
+}
+
+// Do one bounded piece of work; returns false when done
+bool mpren_step()
+{
+    bool ok = true;
+
+    switch(mprenPhase) {
+    case MPREN_CLEAN:
+        ok = mpren_cleanStep();
+        break;
+    case MPREN_SCAN:
+        ok = mpren_scanStep();
+        break;
+    case MPREN_MERGE:
+        ok = mpren_mergeStep();
+        break;
+    case MPREN_RENAME:
+        ok = mpren_renameStep();
+        break;
+    default:
+        return false;
+    }
+
+    if(!ok) {
+        // Retry at next mp_init()
+        mpren_cleanup();
+        mprenFailed = true;
+        return false;
+    }
+
+    return (mprenPhase != MPREN_DONE);
+}
+
+// True if the last run (or its start) stopped on an error; the
+// folder is then not completely processed
+bool mpren_failed()
+{
+    return mprenFailed;
+}
+
+bool mpren_busy()
+{
+    return (mprenPhase != MPREN_DONE);
+}
+
+int mpren_remaining()
+{
+    if(mprenPhase == MPREN_DONE)
+        return -1;
+
+    return mprenTotal - mprenDone;
+}
+
+/*
+ * QuickSort for file names
+ */
+
+static unsigned char mpren_toUpper(char a)
+{
+    if(a >= 'a' && a <= 'z')
+        a &= ~0x20;
+
+    return (unsigned char)a;
+}
+
+static bool mpren_strLT(const char *a, const char *b)
+{
+    int aa = strlen(a);
+    int bb = strlen(b);
+    int cc = aa < bb ? aa : bb;
+
+    for(int i = 0; i < cc; i++) {
+        unsigned char aaa = mpren_toUpper(*a);
+        unsigned char bbb = mpren_toUpper(*b);
+        if(aaa < bbb) return true;
+        if(aaa > bbb) return false;
+        a++; b++;
+    }
+
+    return false;
+}
+
+static int mpren_partition(char **a, int s, int e)
+{
+    char *t;
+    char *p = a[e];
+    int   i = s - 1;
+ 
+    for(int j = s; j <= e - 1; j++) {
+        if(mpren_strLT(a[j], p)) {
+            i++;
+            t = a[i];
+            a[i] = a[j];
+            a[j] = t;
+        }
+    }
+
+    i++;
+
+    t = a[i];
+    a[i] = a[e];
+    a[e] = t;
+    
+    return i;
+}
+
+static void mpren_quickSort(char **a, int s, int e)
+{
+    if(s < e) {
+        int p = mpren_partition(a, s, e);
+        mpren_quickSort(a, s, p - 1);
+        mpren_quickSort(a, p + 1, e);
+    }
+}
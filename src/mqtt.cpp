@@ -73,10 +73,6 @@ static uint8_t mytt5_connect_props[8] = {
     0x17, 0                             // Request Problem Information -> no
 };
 
-static void defLooper()
-{
-}
-
 PubSubClient::PubSubClient(WiFiClient& client)
 {
     this->_state = MQTT_DISCONNECTED;
@@ -84,7 +80,7 @@ PubSubClient::PubSubClient(WiFiClient& client)
     this->bufferSize = 0;
     this->keepAlive = MQTT_KEEPALIVE;
     this->socketTimeout = MQTT_SOCKET_TIMEOUT * 1000;
-    setLooper(defLooper);
+    this->nextMsgId = 1;
     // app MUST call setClientID() before connecting
     // app MUST call setBufferSize() before setVersion()
     // app MUST call setVersion() before connecting
@@ -92,8 +88,10 @@ PubSubClient::PubSubClient(WiFiClient& client)
 
 PubSubClient::~PubSubClient()
 {
-    if(this->bufferSize) 
+    if(this->bufferSize) {
         free(this->buffer);
+        free(this->_rxBuf);
+    }
 }
 
 void PubSubClient::setClientID(const char *src)
@@ -122,6 +120,7 @@ bool PubSubClient::setBufferSize(uint16_t size)
 
     if(this->bufferSize == 0) {
         this->buffer = (uint8_t*)malloc(size);
+        this->_rxBuf = (uint8_t*)malloc(size);
     } else {
         uint8_t* newBuffer = (uint8_t*)realloc(this->buffer, size);
         if(newBuffer) {
@@ -129,11 +128,17 @@ bool PubSubClient::setBufferSize(uint16_t size)
         } else {
             return false;
         }
+        newBuffer = (uint8_t*)realloc(this->_rxBuf, size);
+        if(newBuffer) {
+            this->_rxBuf = newBuffer;
+        } else {
+            return false;
+        }
     }
     
     this->bufferSize = size;
     
-    return (this->buffer != NULL);
+    return (this->buffer != NULL && this->_rxBuf != NULL);
 }
 
 void PubSubClient::setVersion(int mqtt_version)
@@ -197,8 +202,6 @@ bool PubSubClient::connect(const char *user, const char *pass, bool cleanSession
 
         if(result == 1) {
           
-            nextMsgId = 1;
-            
             // Leave room in the buffer for header and variable length field
             uint16_t length = mqtt_max_header_size;
             unsigned int j;            
@@ -246,6 +249,8 @@ bool PubSubClient::connect(const char *user, const char *pass, bool cleanSession
 
             lastInActivity = lastOutActivity = millis();
 
+            _rxState = MQTT_RX_HDR;
+
             _state = MQTT_CONNECTING;
 
             return true;
@@ -288,7 +293,15 @@ bool PubSubClient::loop()
 {
     if(_state == MQTT_CONNECTING) {
 
-        if(!_client->available()) {
+        uint8_t llen;
+        uint32_t len = readPacket(&llen);
+
+        if(!len) {
+
+            if(_state != MQTT_CONNECTING) {
+                // readPacket has closed the connection
+                return false;
+            }
 
             if(millis() - lastInActivity >= this->socketTimeout) {
                 _state = MQTT_CONNECTION_TIMEOUT;
@@ -305,14 +318,12 @@ bool PubSubClient::loop()
             
         } else if(_v3) {
 
-            uint8_t llen;
-            uint32_t len = readPacket(&llen);
-
             if(len == 4) {
-                if(buffer[3] == 0) {
+                if(_rxBuf[3] == 0) {
                     lastInActivity = millis();
                     pingOutstanding = false;
                     _state = MQTT_CONNECTED;
+                    txqRestart();
                     
                     #ifdef MQTT_DBG
                     Serial.println("MQTTv3: CONNACK received");
@@ -320,7 +331,7 @@ bool PubSubClient::loop()
                     
                     return true;
                 } else {
-                    _state = buffer[3];
+                    _state = _rxBuf[3];
                 }
             } else {
                 _state = MQTT_CONNECT_BAD_PROTOCOL;
@@ -335,17 +346,14 @@ bool PubSubClient::loop()
             
         } else {    // v5.0
 
-            uint8_t llen;
-            uint32_t len = readPacket(&llen);
-
             #ifdef MQTT_DBG
-            Serial.printf("MQTTv5: packet %d, len %d\n", (buffer[0] & 0xf0) >> 4, len);
+            Serial.printf("MQTTv5: packet %d, len %d\n", (_rxBuf[0] & 0xf0) >> 4, len);
             #endif
 
-            if(len >= 4 && ((buffer[0] & 0xf0) == MQTTCONNACK)) {
+            if(len >= 4 && ((_rxBuf[0] & 0xf0) == MQTTCONNACK)) {
 
                   unsigned int vbl = 0;
-                  int bo = _vbl(&buffer[1], vbl);
+                  int bo = _vbl(&_rxBuf[1], vbl);
 
                   #ifdef MQTT_DBG
                   Serial.printf("MQTTv5: CONNACK bo %d vbl %d\n", bo, vbl);
@@ -355,11 +363,12 @@ bool PubSubClient::loop()
                     
                       _state = MQTT_CONNECT_BAD_PROTOCOL;
                       
-                  } else if(buffer[1+bo+1] == 0) {
+                  } else if(_rxBuf[1+bo+1] == 0) {
                     
                       lastInActivity = millis();
                       pingOutstanding = false;
                       _state = MQTT_CONNECTED;
+                      txqRestart();
                       
                       #ifdef MQTT_DBG
                       Serial.println("MQTTv5: CONNACK received");
@@ -369,12 +378,12 @@ bool PubSubClient::loop()
                       // server mandates stuff we need to obey to
                       if(vbl > 2) {
                           unsigned int pl = 0;
-                          int bbo = _vbl(&buffer[1+bo+2], pl);
+                          int bbo = _vbl(&_rxBuf[1+bo+2], pl);
                           if(pl > 0) {
                                // Keep Alive
-                               int idx = _searchProp(&buffer[1+bo+2+bbo], 0x13, pl);
+                               int idx = _searchProp(&_rxBuf[1+bo+2+bbo], 0x13, pl);
                                if(idx >= 0) {
-                                    this->keepAlive = (buffer[1+bo+2+bbo+idx] << 8) | buffer[1+bo+2+bbo+idx+1];
+                                    this->keepAlive = (_rxBuf[1+bo+2+bbo+idx] << 8) | _rxBuf[1+bo+2+bbo+idx+1];
                                     
                                     #ifdef MQTT_DBG
                                     Serial.printf("MQTTv5: keepAlive overruled %d\n", this->keepAlive);
@@ -389,7 +398,7 @@ bool PubSubClient::loop()
                   } else {
                     
                       if(vbl > 1) {
-                          _state = buffer[1+bo+1];
+                          _state = _rxBuf[1+bo+1];
                       } else {
                           _state = MQTT_CONNECT_FAILED;
                       }
@@ -430,7 +439,7 @@ bool PubSubClient::loop()
 
         }
         
-        if(_client->available()) {
+        if(_client->available() || _rxState != MQTT_RX_HDR) {
           
             uint8_t  llen;
             uint16_t len = readPacket(&llen);
@@ -440,13 +449,13 @@ bool PubSubClient::loop()
             if(len > 0) {
                 
                 lastInActivity = t;
-                uint8_t type = this->buffer[0] & 0xf0;
+                uint8_t type = _rxBuf[0] & 0xf0;
 
                 switch(type) {
                 case MQTTPUBLISH:
                     if(callback) {
                         // topic length in bytes
-                        uint16_t tl = (this->buffer[llen+1] << 8) + this->buffer[llen+2];
+                        uint16_t tl = (_rxBuf[llen+1] << 8) + _rxBuf[llen+2];
                         
                         // zero length topics and topic-aliases not supported
                         if(tl) {
@@ -455,21 +464,21 @@ bool PubSubClient::loop()
                             bool valMsg = true;
                             
                             // move topic inside buffer 1 byte to front to make room for 0-terminator
-                            memmove(this->buffer + llen + 2, this->buffer + llen + 3, tl); 
-                            this->buffer[llen + 2 + tl] = 0;
+                            memmove(_rxBuf + llen + 2, _rxBuf + llen + 3, tl); 
+                            _rxBuf[llen + 2 + tl] = 0;
                          
-                            char *topic = (char *)this->buffer + llen + 2;
+                            char *topic = (char *)_rxBuf + llen + 2;
     
                             if(!_v3) {
                                 // Skip properties
                                 unsigned int temp;
-                                pl = _vbl(&this->buffer[llen + 3 + tl], temp);
+                                pl = _vbl(&_rxBuf[llen + 3 + tl], temp);
                                 if(pl > 0) {
                                   
                                     #ifdef MQTT_DBG
                                     if(temp) {
                                         // Test property search
-                                        int idx = _searchProp(&this->buffer[llen + 3 + tl + pl], 0x11, temp);
+                                        int idx = _searchProp(&_rxBuf[llen + 3 + tl + pl], 0x11, temp);
                                         Serial.printf("MQTTv5: property test: temp %d pl %d; 0x11 at %d; \n", temp, pl, idx);
                                     }
                                     #endif
@@ -481,13 +490,13 @@ bool PubSubClient::loop()
                             }
 
                             if(valMsg) {
-                                if((this->buffer[0] & 0x06) == MQTTQOS1) {
+                                if((_rxBuf[0] & 0x06) == MQTTQOS1) {
         
                                     // msgId only present for QOS>0
-                                    msgId1 = this->buffer[llen + 3 + tl + pl]; 
-                                    msgId2 = this->buffer[llen + 3 + tl + pl + 1];
+                                    msgId1 = _rxBuf[llen + 3 + tl + pl]; 
+                                    msgId2 = _rxBuf[llen + 3 + tl + pl + 1];
                                     
-                                    payload = this->buffer + llen + 3 + tl + pl + 2;
+                                    payload = _rxBuf + llen + 3 + tl + pl + 2;
                                     callback(topic, payload, len - llen - 3 - tl - pl - 2);
 
                                     // OK for v3 and v5
@@ -500,7 +509,7 @@ bool PubSubClient::loop()
         
                                 } else {
                                   
-                                    payload = this->buffer + llen + 3 + tl + pl;
+                                    payload = _rxBuf + llen + 3 + tl + pl;
                                     callback(topic, payload, len - llen - 3 - tl - pl);
                                     
                                 }
@@ -509,6 +518,12 @@ bool PubSubClient::loop()
                     }
                     break;
                     
+                case MQTTPUBACK:
+                    if(len >= 4) {
+                        txqAck((_rxBuf[llen + 1] << 8) | _rxBuf[llen + 2]);
+                    }
+                    break;
+                    
                 case MQTTPINGREQ:
                     this->buffer[0] = MQTTPINGRESP;
                     this->buffer[1] = 0;
@@ -533,10 +548,10 @@ bool PubSubClient::loop()
                     #ifdef MQTT_DBG
                     if(len >= 4) {
                         unsigned int temp;
-                        int pl = _vbl(&this->buffer[1 + llen + 2], temp);
+                        int pl = _vbl(&_rxBuf[1 + llen + 2], temp);
                         pl += temp;
                         for(int i = 0; i < len - (1 + llen + 2 + pl); i++) {
-                            Serial.printf("SUBACK payload %d: %d\n", i, this->buffer[1 + llen + 2 + pl + i]);
+                            Serial.printf("SUBACK payload %d: %d\n", i, _rxBuf[1 + llen + 2 + pl + i]);
                         }
                     }
                     #endif
@@ -556,6 +571,8 @@ bool PubSubClient::loop()
                 
             }
         }
+
+        txqDrain();
         
         return true;
     }
@@ -563,38 +580,56 @@ bool PubSubClient::loop()
     return false;
 }
 
-bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained)
+/*
+ * Packets are not sent right away, but queued, and sent from loop().
+ * QoS0 packets are only accepted while connected. QoS1 packets are 
+ * also accepted while disconnected; they are kept until the broker
+ * acknowledges them, and sent again (only) after a reconnect. If the
+ * queue is full, the new packet is dropped.
+ */
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained, uint8_t qos)
 {
-    if(connected()) {
-        if(this->bufferSize < mqtt_max_header_size + 2+strnlen(topic, this->bufferSize) + plength) {
-            // Too long
-            return false;
-        }
+    uint16_t msgId = 0;
+    
+    if(!qos && !connected())
+        return false;
         
-        // Leave room in the buffer for header and variable length field
-        uint16_t length = mqtt_max_header_size;
-        length = writeString(topic, this->buffer, length);
+    if(this->bufferSize < mqtt_max_header_size + 2+strnlen(topic, this->bufferSize) + (qos ? 2 : 0) + (_v3 ? 0 : 1) + plength) {
+        // Too long
+        return false;
+    }
+    
+    // Leave room in the buffer for header and variable length field
+    uint16_t length = mqtt_max_header_size;
+    length = writeString(topic, this->buffer, length);
 
-        if(!_v3) {
-            // v5: No properties
-            this->buffer[length++] = 0;
-        }
+    if(qos) {
+        msgId = nextMsgId++;
+        if(!nextMsgId) nextMsgId++;
+        this->buffer[length++] = (msgId >> 8);
+        this->buffer[length++] = (msgId & 0xff);
+    }
 
-        // Add payload
-        uint16_t i;
-        for(i = 0; i < plength; i++) {
-            this->buffer[length++] = payload[i];
-        }
+    if(!_v3) {
+        // v5: No properties
+        this->buffer[length++] = 0;
+    }
 
-        // Write the header
-        uint8_t header = MQTTPUBLISH;
-        
-        if(retained) header |= 1;
-        
-        return write(header, this->buffer, length - mqtt_max_header_size);
+    // Add payload
+    uint16_t i;
+    for(i = 0; i < plength; i++) {
+        this->buffer[length++] = payload[i];
     }
+
+    // Write the header
+    uint8_t header = MQTTPUBLISH;
     
-    return false;
+    if(retained) header |= 1;
+    if(qos) header |= MQTTQOS1;
+
+    uint8_t hlen = buildHeader(header, this->buffer, length - mqtt_max_header_size);
+    
+    return txqAdd(this->buffer + (mqtt_max_header_size - hlen), length - mqtt_max_header_size + hlen, msgId);
 }
 
 bool PubSubClient::subscribe(const char *topic, const char *topic2, uint8_t qos)
@@ -686,98 +721,224 @@ bool PubSubClient::subscribe_int(bool unsubscribe, const char *topic, const char
     return false;
 }
 
-// reads a byte into result
-bool PubSubClient::readByte(uint8_t *result)
+// Receive packet incrementally: Consume what is available, up to
+// the end of the current packet, and return immediately. Returns
+// the packet length once complete, 0 otherwise. Packets that do
+// not fit into the buffer are skipped (return 0).
+uint32_t PubSubClient::readPacket(uint8_t *lengthLength)
 {
-    unsigned long mnow, currentMillis;
-    unsigned long previousMillis = millis();
+    uint32_t budget = this->bufferSize;
+    int avail;
 
-    mnow = previousMillis;
-    
-    while(!_client->available()) {
+    while(budget && (avail = _client->available()) > 0) {
 
-        currentMillis =  millis();
-        
-        if(currentMillis - previousMillis >= this->socketTimeout)
-            return false;
-        
-        if(currentMillis - mnow > 20) {
-            looper();
-            mnow = millis();
+        _rxLast = millis();
+
+        switch(_rxState) {
+          
+        case MQTT_RX_HDR:
+            _rxBuf[0] = _client->read();
+            _rxPos = 1;
+            _rxLen = 0;
+            _rxMult = 1;
+            _rxState = MQTT_RX_LEN;
+            budget--;
+            break;
+            
+        case MQTT_RX_LEN:
+            {
+                uint8_t digit;
+                
+                if(_rxPos == 5) {
+                    // Invalid remaining length encoding - kill the connection
+                    _rxState = MQTT_RX_HDR;
+                    _state = MQTT_DISCONNECTED;
+                    _client->stop();
+                    return 0;
+                }
+
+                digit = _client->read();
+                budget--;
+                _rxBuf[_rxPos++] = digit;
+                _rxLen += (digit & 0x7f) * _rxMult;
+                _rxMult <<= 7;
+
+                if(!(digit & 0x80)) {
+                    _rxLenLen = _rxPos - 1;
+                    _rxRemain = _rxLen;
+                    _rxOverflow = (_rxPos + _rxLen > this->bufferSize);
+                    _rxState = MQTT_RX_BODY;
+                }
+            }
+            break;
+            
+        case MQTT_RX_BODY:
+            {
+                uint32_t n = min((uint32_t)avail, min(_rxRemain, budget));
+                uint8_t *dst = _rxBuf + _rxPos;
+                int r;
+
+                if(_rxOverflow) {
+                    // Skip, using the buffer as scratch space
+                    dst = _rxBuf;
+                    n = min(n, (uint32_t)this->bufferSize);
+                }
+                
+                if((r = _client->read(dst, n)) <= 0)
+                    return 0;
+
+                _rxRemain -= r;
+                budget -= r;
+                if(!_rxOverflow) _rxPos += r;
+            }
+            break;
         }
 
-        delay(2);
+        if(_rxState == MQTT_RX_BODY && !_rxRemain) {
+            _rxState = MQTT_RX_HDR;
+            if(_rxOverflow)
+                return 0;
+            *lengthLength = _rxLenLen;
+            return _rxPos;
+        }
+    }
 
+    // Peer stopped sending in the middle of a packet
+    if(_rxState != MQTT_RX_HDR && (millis() - _rxLast >= this->socketTimeout)) {
+        _rxState = MQTT_RX_HDR;
+        _state = MQTT_CONNECTION_TIMEOUT;
+        _client->stop();
     }
-    
-    *result = _client->read();
-    
-    return true;
+
+    return 0;
 }
 
-// reads a byte into result[*index] and increments index
-bool PubSubClient::readByte(uint8_t *result, uint16_t *index)
+bool PubSubClient::txqAdd(const uint8_t *pkt, uint16_t len, uint16_t msgId)
 {
-    uint16_t current_index = *index;
-    uint8_t *write_address = &(result[current_index]);
-    
-    if(readByte(write_address)) {
-        *index = current_index + 1;
-        return true;
+    if(_txqCnt == MQTT_TXQ_ENTRIES || _txqLen + len > MQTT_TXQ_SIZE) {
+        _txqDropped++;
+        #ifdef MQTT_DBG
+        Serial.printf("MQTT: Queue full, packet dropped\n");
+        #endif
+        return false;
     }
+
+    mqttTxEntry *e = &_txq[_txqCnt++];
+    e->off = _txqLen;
+    e->len = len;
+    e->msgId = msgId;
+    e->flags = msgId ? MQTT_TXF_QOS1 : 0;
     
-    return false;
+    memcpy(_txqBuf + _txqLen, pkt, len);
+    _txqLen += len;
+
+    return true;
 }
 
-uint32_t PubSubClient::readPacket(uint8_t *lengthLength)
+bool PubSubClient::txqWrite(uint16_t off, uint16_t len)
 {
-    uint16_t len = 0;
+    if(_client->write(_txqBuf + off, len) != len) {
+        // A partial packet would corrupt the stream
+        _client->stop();
+        return false;
+    }
     
-    if(!readByte(this->buffer, &len))
-        return 0;
+    lastOutActivity = millis();
     
-    uint32_t multiplier = 1;
-    uint32_t length = 0;
-    uint8_t  digit = 0;
-    uint32_t idx = 0;
+    return true;
+}
 
-    do {
+// Send what is due. Consecutive new packets go out in one write.
+void PubSubClient::txqDrain()
+{
+    uint16_t runOff = 0, runLen = 0;
+    int inflight = 0;
+    int i;
 
-        if(len == 5) {
-            // Invalid remaining length encoding - kill the connection
-            _state = MQTT_DISCONNECTED;
-            _client->stop();
-            return 0;
+    for(i = 0; i < _txqCnt; i++) {
+        mqttTxEntry *e = &_txq[i];
+        
+        if(e->flags & MQTT_TXF_SENT) {
+            // No retransmission on a live connection (MQTT-4.4.0-1);
+            // txqRestart() takes care of that after reconnecting
+            if((e->flags & (MQTT_TXF_QOS1|MQTT_TXF_ACKED)) == MQTT_TXF_QOS1) {
+                inflight++;
+            }
+            continue;
         }
         
-        if(!readByte(&digit)) return 0;
+        if(e->flags & MQTT_TXF_QOS1) {
+            if(inflight == MQTT_MAX_INFLIGHT) break;
+            inflight++;
+        }
         
-        this->buffer[len++] = digit;
-        length += (digit & 0x7f) * multiplier;
-        multiplier <<= 7;
+        if(runLen && runOff + runLen == e->off) {
+            runLen += e->len;
+        } else {
+            if(runLen && !txqWrite(runOff, runLen)) return;
+            runOff = e->off;
+            runLen = e->len;
+        }
         
-    } while(digit & 0x80);
-    
-    *lengthLength = len - 1;
-       
-    idx = len;
+        e->flags |= MQTT_TXF_SENT;
+    }
 
-    for(uint32_t i = 0; i < length; i++) {
-      
-        if(!readByte(&digit)) 
-            return 0;
+    if(runLen && !txqWrite(runOff, runLen)) return;
+
+    txqPurge();
+}
 
-        if(len < this->bufferSize) {
-            this->buffer[len] = digit;
-            len++;
+void PubSubClient::txqAck(uint16_t msgId)
+{
+    for(int i = 0; i < _txqCnt; i++) {
+        if((_txq[i].flags & MQTT_TXF_QOS1) && _txq[i].msgId == msgId) {
+            _txq[i].flags |= MQTT_TXF_ACKED;
+            break;
         }
-        idx++;
     }
-
-    if(idx > this->bufferSize)
-        len = 0; // This will cause the packet to be ignored.
     
-    return len;
+    txqPurge();
+}
+
+// Remove packets that are done with, wherever they are; a
+// QoS1 packet waiting for its PUBACK must not hold back the
+// space of QoS0 packets sent after it. The rest moves to the
+// front, in order.
+void PubSubClient::txqPurge()
+{
+    uint16_t off = 0;
+    int i, j;
+
+    for(i = j = 0; i < _txqCnt; i++) {
+        mqttTxEntry *e = &_txq[i];
+        uint8_t f = e->flags;
+        if((f & MQTT_TXF_SENT) && (!(f & MQTT_TXF_QOS1) || (f & MQTT_TXF_ACKED)))
+            continue;
+        if(e->off != off) {
+            memmove(_txqBuf + off, _txqBuf + e->off, e->len);
+            e->off = off;
+        }
+        off += e->len;
+        if(i != j) {
+            _txq[j] = *e;
+        }
+        j++;
+    }
+
+    _txqCnt = j;
+    _txqLen = off;
+}
+
+// New connection: Unacknowledged QoS1 packets need to be sent again
+void PubSubClient::txqRestart()
+{
+    for(int i = 0; i < _txqCnt; i++) {
+        mqttTxEntry *e = &_txq[i];
+        if((e->flags & (MQTT_TXF_QOS1|MQTT_TXF_SENT|MQTT_TXF_ACKED)) == (MQTT_TXF_QOS1|MQTT_TXF_SENT)) {
+            _txqBuf[e->off] |= 0x08;    // DUP
+            e->flags &= ~MQTT_TXF_SENT;
+        }
+    }
 }
 
 size_t PubSubClient::buildHeader(uint8_t header, uint8_t *buf, uint16_t length)
@@ -115,6 +115,29 @@
 #define MQTT_MAX_HEADER_SIZE_3_1_1  5
 #define MQTT_MAX_HEADER_SIZE_5_0    5
 
+// Outbound queue
+#ifndef MQTT_TXQ_SIZE
+#define MQTT_TXQ_SIZE       1024    // bytes
+#endif
+#define MQTT_TXQ_ENTRIES    16
+#define MQTT_MAX_INFLIGHT   4       // QoS1 packets awaiting PUBACK
+
+#define MQTT_TXF_QOS1   0x01
+#define MQTT_TXF_SENT   0x02
+#define MQTT_TXF_ACKED  0x04
+
+typedef struct {
+    uint16_t off;           // in queue buffer
+    uint16_t len;
+    uint16_t msgId;         // QoS1 only
+    uint8_t  flags;
+} mqttTxEntry;
+
+// Receive state
+#define MQTT_RX_HDR   0
+#define MQTT_RX_LEN   1
+#define MQTT_RX_BODY  2
+
 #define PING_ERROR    -1
 #define PING_IDLE     0
 #define PING_PINGING  1
@@ -135,7 +158,6 @@ class PubSubClient {
         void setServer(IPAddress ip, uint16_t port) { this->ip = ip; this->port = port; this->domain = NULL; }
         void setServer(const char *domain, uint16_t port) { this->domain = domain; this->port = port; }
         void setCallback(void (*callback)(char *, uint8_t *, unsigned int)) { this->callback = callback; }
-        void setLooper(void (*looper)()) { this->looper = looper; }
     
         bool connect();
         bool connect(const char *user, const char *pass);
@@ -145,7 +167,8 @@ class PubSubClient {
 
         bool loop();
 
-        bool publish(const char *topic, const uint8_t *payload, unsigned int plength, bool retained = false);
+        bool publish(const char *topic, const uint8_t *payload, unsigned int plength, bool retained = false, uint8_t qos = 0);
+        uint32_t dropped() { return _txqDropped; }
              
         bool subscribe(const char *topic, const char *topic2 = NULL, uint8_t qos = 0);
         bool unsubscribe(const char *topic);
@@ -162,11 +185,16 @@ class PubSubClient {
         bool subscribe_int(bool unsubscribe, const char *topic, const char *topic2L, uint8_t qos);
         
         uint32_t readPacket(uint8_t *);
-        bool readByte(uint8_t *result);
-        bool readByte(uint8_t *result, uint16_t *index);
         
         size_t buildHeader(uint8_t header, uint8_t* buf, uint16_t length);
         bool write(uint8_t header, uint8_t *buf, uint16_t length);
+
+        bool txqAdd(const uint8_t *pkt, uint16_t len, uint16_t msgId);
+        bool txqWrite(uint16_t off, uint16_t len);
+        void txqDrain();
+        void txqAck(uint16_t msgId);
+        void txqPurge();
+        void txqRestart();
         
         int _vbl(const uint8_t *buf, unsigned int& length);
         int _searchProp(uint8_t *buf, uint8_t prop, const int propLength);
@@ -174,7 +202,8 @@ class PubSubClient {
         uint16_t writeString(const char *string, uint8_t *buf, uint16_t pos);
        
         WiFiClient* _client;
-        uint8_t* buffer;
+        uint8_t* buffer;        // Transmit
+        uint8_t* _rxBuf;        // Receive
         uint16_t bufferSize;
         uint16_t keepAlive;
         unsigned long socketTimeout;
@@ -183,7 +212,25 @@ class PubSubClient {
         unsigned long lastInActivity;
         bool pingOutstanding;
         void (*callback)(char *, uint8_t *, unsigned int);
-        void (*looper)();
+
+        // Packet being received
+        uint8_t  _rxState = MQTT_RX_HDR;
+        uint8_t  _rxLenLen;
+        uint16_t _rxPos;        // Bytes stored in _rxBuf
+        uint32_t _rxLen;        // Remaining length as per header
+        uint32_t _rxMult;
+        uint32_t _rxRemain;     // Bytes yet to come
+        bool     _rxOverflow;
+        unsigned long _rxLast;
+
+        // Outbound queue: Packets, back to back, in order of 
+        // publish(); entries describe them. QoS1 packets stay
+        // until acknowledged, all others until sent.
+        uint8_t     _txqBuf[MQTT_TXQ_SIZE];
+        uint16_t    _txqLen = 0;
+        mqttTxEntry _txq[MQTT_TXQ_ENTRIES];
+        int         _txqCnt = 0;
+        uint32_t    _txqDropped = 0;
 
         IPAddress ip;
         const char* domain;
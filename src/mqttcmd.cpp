@@ -0,0 +1,188 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * MQTT command lookup
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#include "remote_global.h"
+
+#ifdef REMOTE_HAVEMQTT
+
+#include <Arduino.h>
+
+#include "mqttcmd.h"
+
+int mqttcmd_atoi(const char *p, unsigned int len)
+{
+    unsigned int i = 0;
+    int t = 0;
+    bool neg = false;
+
+    while(i < len && (p[i] == ' ' || (p[i] >= '\t' && p[i] <= '\r'))) i++;
+    if(i < len && (p[i] == '-' || p[i] == '+')) neg = (p[i++] == '-');
+    while(i < len && p[i] >= '0' && p[i] <= '9') t = t * 10 + (p[i++] - '0');
+
+    return neg ? -t : t;
+}
+
+/*
+ * MQTT commands
+ * 
+ * The lists are sorted by name, and no command is a prefix of 
+ * another one; both is checked at compile time. A payload is 
+ * looked up by binary search, comparing it in place (case-
+ * insensitive) with the commands; trailing characters are 
+ * arguments.
+ */
+typedef struct {
+    const char *cmd;
+    uint8_t    idx;
+} mqttCmd;
+
+static constexpr mqttCmd mqttCmdList[] = {
+    { "AUTOTHROTTLE_OFF", 3  },
+    { "AUTOTHROTTLE_ON",  2  },
+    { "COASTING_OFF",     5  },
+    { "COASTING_ON",      4  },
+    { "DISPTCDSPD_OFF",   9  },
+    { "DISPTCDSPD_ON",    8  },
+    { "INJECT_",          17 },
+    { "MOVIEACCEL_OFF",   7  },
+    { "MOVIEACCEL_ON",    6  },
+    { "MP_FOLDER_",       16 },   // MP_FOLDER_0..MP_FOLDER_9
+    { "MP_NEXT",          14 },
+    { "MP_PLAY",          12 },
+    { "MP_PREV",          15 },
+    { "MP_SHUFFLE_OFF",   11 },
+    { "MP_SHUFFLE_ON",    10 },
+    { "MP_STOP",          13 },
+    { "NETSTATS",         19 },
+    { "PLAYKEY_",         0  },   // PLAYKEY_1..PLAYKEY_9, PLAYKEY_1L..PLAYKEY9L
+    { "POWERSTATS",       18 },
+    { "STOPKEY",          1  }
+};
+
+static constexpr mqttCmd mqttCmdList2[] = {
+    { "ABORT_TT",         3  },
+    { "ALARM",            4  },
+    { "PREPARE",          0  },
+    { "REENTRY",          2  },
+    { "TIMETRAVEL",       1  },
+    { "WAKEUP",           5  }
+};
+
+// a sorts before b, and is not a prefix of b
+static constexpr bool mqttCmdBefore(const char *a, const char *b)
+{
+    return (*a == *b) ? (*a && mqttCmdBefore(a + 1, b + 1)) : (*a && *a < *b);
+}
+
+static constexpr bool mqttCmdSorted(const mqttCmd *l, int n)
+{
+    return (n < 2) || (mqttCmdBefore(l[0].cmd, l[1].cmd) && mqttCmdSorted(l + 1, n - 1));
+}
+
+static_assert(mqttCmdSorted(mqttCmdList, sizeof(mqttCmdList) / sizeof(mqttCmdList[0])), "mqttCmdList not sorted/prefix-free");
+static_assert(mqttCmdSorted(mqttCmdList2, sizeof(mqttCmdList2) / sizeof(mqttCmdList2[0])), "mqttCmdList2 not sorted/prefix-free");
+
+// Find the command the payload starts with. Returns its index
+// in the list, -1 if none; *cmdLen is set to its length.
+static int mqttFindCmd(const mqttCmd *list, int n, const char *pl, unsigned int len, unsigned int *cmdLen)
+{
+    int lo = 0, hi = n - 1;
+
+    while(lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const uint8_t *c = (const uint8_t *)list[mid].cmd;
+        int r = 0, i;
+
+        for(i = 0; c[i]; i++) {
+            uint8_t p;
+            if((unsigned int)i >= len) {
+                r = 1;          // Payload shorter
+                break;
+            }
+            p = pl[i];
+            if(p >= 'a' && p <= 'z') p &= ~0x20;
+            if(c[i] != p) {
+                r = c[i] - p;
+                break;
+            }
+        }
+
+        if(!r) {
+            *cmdLen = i;
+            return mid;
+        }
+        
+        if(r > 0) hi = mid - 1;
+        else      lo = mid + 1;
+    }
+
+    return -1;
+}
+
+int mqttcmd_findUser(const char *pl, unsigned int len, unsigned int *argOff)
+{
+    int i = mqttFindCmd(mqttCmdList, sizeof(mqttCmdList) / sizeof(mqttCmdList[0]), pl, len, argOff);
+
+    return (i < 0) ? -1 : mqttCmdList[i].idx;
+}
+
+int mqttcmd_findTCD(const char *pl, unsigned int len, unsigned int *argOff)
+{
+    int i = mqttFindCmd(mqttCmdList2, sizeof(mqttCmdList2) / sizeof(mqttCmdList2[0]), pl, len, argOff);
+
+    return (i < 0) ? -1 : mqttCmdList2[i].idx;
+}
+
+#endif  // REMOTE_HAVEMQTT
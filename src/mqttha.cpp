@@ -0,0 +1,346 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Home Assistant discovery and telemetry
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#include "remote_global.h"
+
+#ifdef REMOTE_HAVEMQTT
+
+#include <Arduino.h>
+
+#include "mqttha.h"
+
+#define HA_TOPIC_BASE   "bttf/remote/"
+#define HA_DISC_PREFIX  "homeassistant/"
+
+#define HAE_BIN         0x01    // binary_sensor, otherwise sensor
+#define HAE_PM          0x02    // Needs power monitor
+#define HAE_DIAG        0x04    // Diagnostic entity
+
+struct haEntity {
+    const char *key;
+    const char *name;
+    const char *unit;
+    const char *devClass;
+    const char *stateClass;
+    uint8_t    flags;
+};
+
+// Order must match the enum below
+static const haEntity haEntities[] = {
+    { "spd",  "Speed",           "mph", "speed",        "measurement", 0 },
+    { "pwr",  "Fake power",      NULL,  "power",        NULL,          HAE_BIN },
+    { "brk",  "Brake",           NULL,  NULL,           NULL,          HAE_BIN },
+    { "thr",  "Throttle",        NULL,  NULL,           "measurement", 0 },
+    { "soc",  "Battery",         "%",   "battery",      "measurement", HAE_PM },
+    { "volt", "Battery voltage", "V",   "voltage",      "measurement", HAE_PM },
+    { "tte",  "Battery time",    "min", "duration",     "measurement", HAE_PM },
+    { "lnk",  "TCD link",        NULL,  "connectivity", NULL,          HAE_BIN|HAE_DIAG },
+    { "rtt",  "TCD round trip",  "ms",  "duration",     "measurement", HAE_DIAG },
+    { "aud",  "Audio",           NULL,  NULL,           NULL,          0 },
+    { "heap", "Free heap",       "KiB", "data_size",    "measurement", HAE_DIAG }
+};
+
+enum {
+    HAE_SPD = 0, HAE_PWR, HAE_BRK, HAE_THR, HAE_SOC, HAE_VOLT, 
+    HAE_TTE, HAE_LNK, HAE_RTT, HAE_AUD, HAE_HEAP, HAE_NUM
+};
+
+static_assert(sizeof(haEntities) / sizeof(haEntities[0]) == HAE_NUM, "haEntities out of sync");
+
+static const char *haAudioNames[] = { "idle", "playing", "music", "mute" };
+
+static haPubFunc     haPub = NULL;
+static char          haHost[32];
+static const char    *haVers = "";
+static unsigned long haInterval = 0;
+static bool          haHavePM = false;
+
+static bool          haWasConn = false;
+static int           haCfgIdx = HAE_NUM;    // Next config to send
+static int           haStIdx = HAE_NUM;     // Next state to check; HAE_NUM: Idle
+static unsigned long haRoundNow = 0;
+static char          haLast[HAE_NUM][12];   // As last published, "" = none
+
+/*
+ * Serializer: Appends to a fixed buffer, never allocates. 
+ * Overflow is sticky; a truncated message is never sent.
+ */
+struct haWriter {
+    char *buf;
+    int  size;
+    int  len;
+    bool ovf;
+};
+
+static void haPuts(haWriter &w, const char *s)
+{
+    while(*s) {
+        if(w.len >= w.size - 1) {
+            w.ovf = true;
+            break;
+        }
+        w.buf[w.len++] = *s++;
+    }
+    w.buf[w.len] = 0;
+}
+
+// Append ,"key":"val" - unless val is NULL
+static void haKV(haWriter &w, const char *key, const char *val)
+{
+    if(!val) return;
+    haPuts(w, ",\"");
+    haPuts(w, key);
+    haPuts(w, "\":\"");
+    haPuts(w, val);
+    haPuts(w, "\"");
+}
+
+static bool haAvail(int i)
+{
+    return haHavePM || !(haEntities[i].flags & HAE_PM);
+}
+
+static bool haSendConfig(int i)
+{
+    const haEntity *e = &haEntities[i];
+    char topic[96];
+    char buf[480];
+    haWriter t = { topic, sizeof(topic), 0, false };
+    haWriter w = { buf, sizeof(buf), 0, false };
+
+    haPuts(t, HA_DISC_PREFIX);
+    haPuts(t, (e->flags & HAE_BIN) ? "binary_sensor/" : "sensor/");
+    haPuts(t, haHost);
+    haPuts(t, "/");
+    haPuts(t, e->key);
+    haPuts(t, "/config");
+
+    haPuts(w, "{\"~\":\"" HA_TOPIC_BASE);
+    haPuts(w, haHost);
+    haPuts(w, "\"");
+    haKV(w, "name", e->name);
+    haPuts(w, ",\"uniq_id\":\"");
+    haPuts(w, haHost);
+    haPuts(w, "_");
+    haPuts(w, e->key);
+    haPuts(w, "\",\"stat_t\":\"~/");
+    haPuts(w, e->key);
+    haPuts(w, "\"");
+    haKV(w, "unit_of_meas", e->unit);
+    haKV(w, "dev_cla", e->devClass);
+    haKV(w, "stat_cla", e->stateClass);
+    if(e->flags & HAE_BIN) {
+        haPuts(w, ",\"pl_on\":\"1\",\"pl_off\":\"0\"");
+    }
+    if(e->flags & HAE_DIAG) {
+        haPuts(w, ",\"ent_cat\":\"diagnostic\"");
+    }
+    haPuts(w, ",\"dev\":{\"ids\":[\"");
+    haPuts(w, haHost);
+    haPuts(w, "\"],\"name\":\"");
+    haPuts(w, haHost);
+    haPuts(w, "\",\"mf\":\"CircuitSetup\",\"mdl\":\"Remote\",\"sw\":\"");
+    haPuts(w, haVers);
+    haPuts(w, "\"}}");
+
+    if(t.ovf || w.ovf) {
+        #ifdef REMOTE_DBG
+        Serial.printf("MQTT-HA: Config for %s too long\n", e->key);
+        #endif
+        return true;    // Skip it
+    }
+
+    return haPub(topic, buf, w.len);
+}
+
+static bool haSendState(int i, const char *val)
+{
+    char topic[64];
+    haWriter t = { topic, sizeof(topic), 0, false };
+
+    haPuts(t, HA_TOPIC_BASE);
+    haPuts(t, haHost);
+    haPuts(t, "/");
+    haPuts(t, haEntities[i].key);
+    if(t.ovf) return true;
+
+    return haPub(topic, val, strlen(val));
+}
+
+// Format current value; "" if not available
+static void haFormat(int i, const haTelemetry &t, char *v)
+{
+    *v = 0;
+    
+    switch(i) {
+    case HAE_SPD:
+        sprintf(v, "%d", t.speed);
+        break;
+    case HAE_PWR:
+        strcpy(v, t.power ? "1" : "0");
+        break;
+    case HAE_BRK:
+        strcpy(v, t.brake ? "1" : "0");
+        break;
+    case HAE_THR:
+        sprintf(v, "%d", (int)t.throttle);
+        break;
+    case HAE_SOC:
+        if(t.soc >= 0) sprintf(v, "%d", t.soc);
+        break;
+    case HAE_VOLT:
+        if(t.voltage >= 0.0f) sprintf(v, "%.2f", t.voltage);
+        break;
+    case HAE_TTE:
+        if(t.tte >= 0) sprintf(v, "%d", t.tte);
+        break;
+    case HAE_LNK:
+        strcpy(v, t.link ? "1" : "0");
+        break;
+    case HAE_RTT:
+        sprintf(v, "%lu", t.rtt);
+        break;
+    case HAE_AUD:
+        if(t.audio <= HA_AUDIO_MUTE) strcpy(v, haAudioNames[t.audio]);
+        break;
+    case HAE_HEAP:
+        // KiB, so that it does not change all the time
+        sprintf(v, "%u", (unsigned int)(t.heap / 1024));
+        break;
+    }
+}
+
+void mqttha_setup(const char *hostName, const char *swVers, unsigned long interval, 
+                  bool havePM, haPubFunc pub)
+{
+    strncpy(haHost, hostName, sizeof(haHost) - 1);
+    haHost[sizeof(haHost) - 1] = 0;
+    haVers = swVers;
+    haInterval = interval;
+    haHavePM = havePM;
+    haPub = pub;
+    haWasConn = false;
+}
+
+bool mqttha_due(bool connected, unsigned long now)
+{
+    if(!haPub || !haInterval)
+        return false;
+
+    if(!connected) {
+        haWasConn = false;
+        return false;
+    }
+
+    if(!haWasConn || haCfgIdx < HAE_NUM || haStIdx < HAE_NUM)
+        return true;
+
+    return (now - haRoundNow >= haInterval);
+}
+
+void mqttha_loop(const haTelemetry &t, bool connected, unsigned long now)
+{
+    if(!haPub || !haInterval)
+        return;
+
+    if(!connected) {
+        haWasConn = false;
+        return;
+    }
+
+    if(!haWasConn) {
+        // (Re)connected: Announce everything, then send all states
+        haWasConn = true;
+        haCfgIdx = 0;
+        haStIdx = HAE_NUM;
+        memset(haLast, 0, sizeof(haLast));
+        haRoundNow = now - haInterval;
+    }
+
+    if(haCfgIdx < HAE_NUM) {
+        // If the queue is full, retry next time
+        if(!haAvail(haCfgIdx) || haSendConfig(haCfgIdx)) {
+            haCfgIdx++;
+        }
+        return;
+    }
+
+    if(haStIdx >= HAE_NUM) {
+        if(now - haRoundNow < haInterval)
+            return;
+        haRoundNow = now;
+        haStIdx = 0;
+    }
+
+    for( ; haStIdx < HAE_NUM; haStIdx++) {
+        char val[sizeof(haLast[0])];
+        if(!haAvail(haStIdx))
+            continue;
+        haFormat(haStIdx, t, val);
+        if(!strcmp(val, haLast[haStIdx]))
+            continue;
+        if(haSendState(haStIdx, val)) {
+            strcpy(haLast[haStIdx], val);
+            haStIdx++;
+        } else {
+            // Queue full: Give up this round; what was not 
+            // published is still a delta next round
+            haStIdx = HAE_NUM;
+        }
+        return;
+    }
+}
+
+#endif  // REMOTE_HAVEMQTT
@@ -0,0 +1,101 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Home Assistant discovery and telemetry
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _REM_MQTTHA_H
+#define _REM_MQTTHA_H
+
+#include <stdint.h>
+
+#define HA_AUDIO_IDLE       0
+#define HA_AUDIO_PLAYING    1
+#define HA_AUDIO_MUSIC      2
+#define HA_AUDIO_MUTE       3
+
+// Snapshot of the values reported. Battery values < 0 are 
+// not available and not announced.
+struct haTelemetry {
+    int      speed;
+    bool     power;
+    bool     brake;
+    int32_t  throttle;
+    int      soc;               // %
+    float    voltage;           // V
+    int      tte;               // minutes
+    bool     link;              // BTTFN connected
+    unsigned long rtt;          // ms
+    uint8_t  audio;             // HA_AUDIO_xx
+    uint32_t heap;              // bytes
+};
+
+// Publishes a retained message; false if it could not be queued
+typedef bool (*haPubFunc)(const char *topic, const char *pl, unsigned int len);
+
+// interval: Minimum time between two state rounds in ms, 0 = off.
+// Battery entities are only announced if havePM is set.
+void mqttha_setup(const char *hostName, const char *swVers, unsigned long interval, 
+                  bool havePM, haPubFunc pub);
+
+// Call regularly. Each call queues at most one packet. After a 
+// (re)connect, all discovery configs and states are (re-)sent;
+// otherwise, a state is only published if it changed since it
+// was last published, and no more often than once per interval.
+void mqttha_loop(const haTelemetry &t, bool connected, unsigned long now);
+
+// True if the next mqttha_loop() call will publish something (or
+// start a state round), ie if a telemetry snapshot is needed at all.
+// Cheap; to be checked before gathering the values.
+bool mqttha_due(bool connected, unsigned long now);
+
+#endif
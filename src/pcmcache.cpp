@@ -0,0 +1,166 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * PCM cache for latency-critical sounds
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#include "remote_global.h"
+
+#include <Arduino.h>
+
+#include "pcmcache.h"
+
+/*
+ * PCM cache
+ *
+ * Holds the start (or all) of latency-critical sounds (PA_CACHE) 
+ * as decoded mono PCM, so that playback starts without waiting for 
+ * the file system and the decoder. An entry is filled on first use
+ * while the sound is played. Owned by the audio task.
+ */
+
+#define PCMC_ENTRIES      12
+#define PCMC_MS_PSRAM     1500          // ms per sound with PSRAM
+#define PCMC_MS_HEAP      120           // ms per sound without PSRAM
+#define PCMC_ARENA_PSRAM  (512*1024)    // total bytes with PSRAM
+#define PCMC_ARENA_HEAP   (48*1024)     // total bytes without PSRAM
+
+static pcmCacheEntry   pcmCache[PCMC_ENTRIES] = { 0 };
+static uint32_t        pcmcMaxLen = 0;      // in samples
+static bool            pcmcPSRAM = false;
+static audioCacheStats pcmcStats = { 0 };
+
+void pcmc_setup(bool usePSRAM)
+{
+    pcmcPSRAM = usePSRAM;
+    
+    pcmcMaxLen = (pcmcPSRAM ? PCMC_MS_PSRAM : PCMC_MS_HEAP) * 441 / 10;
+    pcmcStats.bytesTotal = pcmcPSRAM ? PCMC_ARENA_PSRAM : PCMC_ARENA_HEAP;
+}
+
+uint32_t pcmc_maxLen()
+{
+    return pcmcMaxLen;
+}
+
+// Find entry for file, allocate one if not found (and space left)
+static pcmCacheEntry *pcmc_find(const char *fn)
+{
+    pcmCacheEntry *fe = NULL;
+    uint32_t bytes = pcmcMaxLen * sizeof(int16_t);
+    
+    for(int i = 0; i < PCMC_ENTRIES; i++) {
+        if(!pcmCache[i].fn[0]) {
+            if(!fe) fe = &pcmCache[i];
+        } else if(!strcmp(pcmCache[i].fn, fn)) {
+            return &pcmCache[i];
+        }
+    }
+
+    if(!fe || pcmcStats.bytesUsed + bytes > pcmcStats.bytesTotal)
+        return NULL;
+
+    fe->pcm = (int16_t *)(pcmcPSRAM ? ps_malloc(bytes) : malloc(bytes));
+    if(!fe->pcm) 
+        return NULL;
+
+    pcmcStats.bytesUsed += bytes;
+    strcpy(fe->fn, fn);
+    fe->len = 0;
+    fe->state = PCMC_EMPTY;
+
+    return fe;
+}
+
+pcmCacheEntry *pcmc_lookup(const char *fn)
+{
+    pcmCacheEntry *ce = pcmc_find(fn);
+
+    if(ce && ce->state != PCMC_EMPTY) {
+        pcmcStats.hits++;
+    } else {
+        pcmcStats.misses++;
+    }
+
+    return ce;
+}
+
+// Only to be called when the decoder has stopped, 
+// or before it is restarted.
+bool pcmc_finalize(pcmCacheEntry *ce, uint32_t len, bool complete)
+{
+    if(len >= pcmcMaxLen) {
+        ce->state = PCMC_PARTIAL;
+        len = pcmcMaxLen;
+    } else if(len && complete) {
+        ce->state = PCMC_COMPLETE;
+    } else {
+        // Interrupted or not cacheable; try again next time
+        return false;
+    }
+    ce->len = len;
+    pcmcStats.fills++;
+
+    #ifdef REMOTE_DBG
+    Serial.printf("Audio: Cached %s (%d samples, %s)\n", ce->fn, len, 
+                  (ce->state == PCMC_COMPLETE) ? "complete" : "partial");
+    #endif
+
+    return true;
+}
+
+void pcmc_getStats(audioCacheStats *stats)
+{
+    // Counters are written by audio task; a 
+    // slightly inconsistent snapshot is fine.
+    *stats = pcmcStats;
+}
@@ -66,7 +66,7 @@
 #include <Arduino.h>
 #include <math.h>
 #include "power.h"
-#include <Wire.h>
+#include "i2cbus.h"
 
 // SoC limits for "Low battery"
 // < _LOW = trigger warning
@@ -169,8 +169,9 @@ bool remPowMon::begin(bool doUse, int battProf, uint16_t battCap)
     pinMode(BALM_PIN, INPUT);
 
     // Check for IC on i2c bus
-    Wire.beginTransmission(_address);
-    if(!Wire.endTransmission(true)) {
+    if(i2cbus_probe(_address)) {
+
+        i2cbus_setDevice(_address, I2CBUS_PRIO_BATTERY);
 
         // Shortcuts for CRC calculation
         _crcAW = _address << 1;
@@ -360,23 +361,16 @@ bool remPowMon::readVoltage()
 
 bool remPowMon::read16(uint16_t regno, uint16_t& val)
 {
-    size_t i2clen = 0;
+    int i2clen;
     uint8_t buf[6];
 
     buf[0] = _crcAW;
     buf[1] = (uint8_t)regno;
     buf[2] = _crcAR;
 
-    Wire.beginTransmission(_address);
-    Wire.write(buf[1]);
-    Wire.endTransmission(false);
-
-    i2clen = Wire.requestFrom(_address, (uint8_t)3);
+    i2clen = i2cbus_xfer(_address, &buf[1], 1, &buf[3], 3, I2CBUS_RSTART);
 
     if(i2clen == 3) {
-        buf[3] = Wire.read();
-        buf[4] = Wire.read();
-        buf[5] = Wire.read();
         if(crc8_atm(5, buf) == buf[5]) {
             val = buf[3] | (buf[4] << 8);
             return true;
@@ -394,12 +388,7 @@ void remPowMon::write16(uint16_t regno, uint16_t value)
     buf[2] = value & 0xff;
     buf[3] = value >> 8;
     buf[4] = crc8_atm(4, buf);
-    Wire.beginTransmission(_address);
-    Wire.write(buf[1]);
-    Wire.write(buf[2]);
-    Wire.write(buf[3]);
-    Wire.write(buf[4]);
-    Wire.endTransmission();
+    i2cbus_xfer(_address, &buf[1], 4, NULL, 0, I2CBUS_NOGAP);
 }
 
 #endif
@@ -592,6 +592,7 @@ void loop()
     wifi_loop();
     audio_loop();
     bttfn_loop();
+    main_idle();
 }
 
 #if defined(REMOTE_DBG) || defined(REMOTE_DBG_NET)
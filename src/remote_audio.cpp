@@ -58,18 +58,49 @@
 #include <SD.h>
 #include <FS.h>
 
+#include <atomic>
+
 #include "AudioFileSourceLoop.h"
 #include "src/ESP8266Audio/AudioFileSourcePROGMEM.h"
 
 #include "AudioGeneratorWAVLoop.h"
 #include "src/ESP8266Audio/AudioGeneratorMP3.h"
 #include "src/ESP8266Audio/AudioOutputI2S.h"
+#include "AudioOutputMixer.h"
 
 #include "remote_main.h"
 #include "remote_settings.h"
 #include "remote_audio.h"
 #include "remote_wifi.h"
 #include "remote_click.h"
+#include "mpren.h"
+#include "audioq.h"
+#include "mpidx.h"
+#include "pcmcache.h"
+
+// Audio task
+#define AUDIO_TASK_CORE   0
+#define AUDIO_TASK_PRIO   2
+#define AUDIO_TASK_STACK  8192
+
+// Command queue length (must be power of 2)
+#define AUDIO_QUEUE_LEN   16
+
+// Max time stopAudio() waits for the audio task (ms)
+#define AUDIO_SYNC_TO     5000
+
+// State published by audio task
+#define AS_MP3     0x01
+#define AS_WAV     0x02
+#define AS_APPEND  0x04
+#define AS_VOICE   0x08
+#define AS_STALE   0x10     // File of last play missing or not as indexed
+
+// Mixer voice priorities
+#define VOICE_PRIO_CLICK  1
+#define VOICE_PRIO_THRUP  2
+
+// --- Everything below is owned by the audio task
 
 static AudioGeneratorMP3 *mp3;
 static AudioGeneratorWAVLoop *wav;
@@ -78,19 +109,8 @@ static AudioFileSourceFSLoop *myFS0L;
 static AudioFileSourceSDLoop *mySD0L;
 static AudioFileSourcePROGMEM *myPM;
 
-static AudioOutputI2S *out;
-
-bool audioInitDone = false;
-bool audioMute = false;
-
-bool playClicks = true;
-
-bool haveMusic = false;
-bool mpActive = false;
-static uint16_t maxMusic = 0;
-static uint16_t *playList = NULL;
-static int  mpCurrIdx = 0;
-bool        mpShuffle = false;
+static AudioOutputI2S *i2s;
+static AudioOutputMixer *out;
 
 static const float volTable[20] = {
     0.00f, 0.02f, 0.04f, 0.06f,
@@ -99,39 +119,76 @@ static const float volTable[20] = {
     0.35f, 0.40f, 0.50f, 0.60f,
     0.70f, 0.80f, 0.90f, 1.00f
 };
-uint8_t         curSoftVol = DEFAULT_VOLUME;
-static uint32_t g(uint32_t a, int o) { return a << (PA_MASKA - o); }
 
 static float    curVolFact = 1.0f;
 static bool     dynVol     = true;
-static int      sampleCnt = 0;
+static int      gainSoftVol = -1;   // curSoftVol last used for gain
 
 static uint32_t playflags = 0;
 
-static char     append_audio_file[256];
+static char     append_audio_file[32];
 static float    append_vol;
 static uint32_t append_flags;
 static bool     appendFile = false;
 
+static bool     playStale = false;  // Last play: File missing or not as indexed
+
+// PCM cache entry being filled by the decoder
+static pcmCacheEntry  *pcmcCapEntry = NULL;
+
+// --- Shared between main and audio task
+
+static TaskHandle_t audioTaskHandle = NULL;
+static SemaphoreHandle_t audioSyncSem = NULL;   // given by audio task after processing commands
+
+static audioCmdQueue<AUDIO_QUEUE_LEN> audioQ;
+
+static std::atomic<uint32_t> audioState(0);
+static std::atomic<uint32_t> audioPlayFlags(0);
+
+// --- Everything below is owned by main
+
+bool audioInitDone = false;
+bool audioMute = false;
+
+bool playClicks = true;
+
+bool haveMusic = false;
+bool mpActive = false;
+static uint16_t maxMusic = 0;
+static uint16_t *playList = NULL;
+static int  mpCurrIdx = 0;
+static int  mpPlayNum = -1;      // File number last played
+bool        mpShuffle = false;
+
+
+uint8_t         curSoftVol = DEFAULT_VOLUME;
+static uint32_t g(uint32_t a, int o) { return a << (PA_MASKA - o); }
+
 static char     keySnd[] = "/key3.mp3";   // not const
 static char     keylSnd[] = "/key3l.mp3"; // not const
 static uint32_t haveKeySnd = 0, haveKeyLSnd = 0;
 
 static const char *tcdrdone = "/TCD_DONE.TXT";   // leave "TCD", SD is interchangable this way
-unsigned long   renNow1;
-unsigned long   renNow2;
 
+static void     audioTask(void *parameter);
+static void     pcmc_takeCapture();
 static float    getVolume();
+static void     setGain();
+static float    calcVolume(float fact);
 
 static int      mp_findMaxNum();
 static bool     mp_checkForFile(int num);
 static void     mp_nextprev(bool forcePlay, bool next);
 static bool     mp_play_int(bool force);
 static void     mp_buildFileName(char *fnbuf, int num);
-static bool     mp_renameFilesInDir(bool isSetup);
+static void     play_file_int(const char *audio_file, uint32_t flags, float volumeFactor, int32_t seek = -1, uint32_t size = 0, uint8_t cmd = AC_PLAY);
+static bool     mp_renameFilesInDir();
+static void     mp_renameDone();
+static void     mp_initPlayer();
+static void     mp_loop();
 static uint8_t* mpren_renOrder(uint8_t *a, uint32_t s, int e);
 uint8_t*        m(uint8_t *a, uint32_t s, int e) { return mpren_renOrder(a, s, e/4); }
-static void     mpren_quickSort(char **a, int s, int e);
 
 /*
  * audio_setup()
@@ -142,9 +199,12 @@ void audio_setup()
     audioLogger = &Serial;
     #endif
 
-    out = new AudioOutputI2S(0, 0, 32, 0);
-    out->SetOutputModeMono(false);  // Hardware does auto-mono
-    out->SetPinout(I2S_BCLK_PIN, I2S_LRCLK_PIN, I2S_DIN_PIN);
+    i2s = new AudioOutputI2S(0, 0, 32, 0);
+    i2s->SetOutputModeMono(false);  // Hardware does auto-mono
+    i2s->SetPinout(I2S_BCLK_PIN, I2S_LRCLK_PIN, I2S_DIN_PIN);
+
+    // Generators play through the mixer, clicks etc are mixed in
+    out = new AudioOutputMixer(i2s);
 
     mp3  = new AudioGeneratorMP3();
     wav  = new AudioGeneratorWAVLoop();
@@ -174,100 +234,287 @@ void audio_setup()
         if(check_file_SD(keylSnd)) haveKeyLSnd |= bm;
     }
 
+    pcmc_setup(psramFound());
+
+    audioSyncSem = xSemaphoreCreateBinary();
+
+    // Decoding runs in its own task so that blocking
+    // stuff in main_loop does not starve it
+    xTaskCreatePinnedToCore(audioTask, "audio", AUDIO_TASK_STACK, NULL, 
+                            AUDIO_TASK_PRIO, &audioTaskHandle, AUDIO_TASK_CORE);
+
+    if(!audioTaskHandle) {
+        Serial.println("Failed to create audio task");
+    }
+
     audioInitDone = true;
 }
 
+/*
+ * Command queue
+ */
+
+static bool aq_pending()
+{
+    return audioQ.pending();
+}
+
+static void aq_post(uint8_t cmd, const char *fn = NULL, uint32_t flags = 0, float vol = 1.0f, int32_t seek = -1, uint32_t size = 0)
+{
+    int r;
+
+    if(!audioTaskHandle) return;
+
+    // Queue full: Wait for audio task to catch up
+    while((r = audioQ.push(cmd, fn, flags, vol, seek, size)) == AQ_FULL) {
+        delay(1);
+    }
+
+    if(r != AQ_OK) {
+        #ifdef REMOTE_DBG
+        Serial.printf("Audio: File name too long: %s\n", fn);
+        #endif
+        return;
+    }
+
+    xTaskNotifyGive(audioTaskHandle);
+}
+
+// Wait until all commands posted so far are processed.
+// Returns false if the audio task did not get there in time.
+static bool aq_sync()
+{
+    uint32_t mark = audioQ.mark();
+    unsigned long now = millis();
+
+    while(!audioQ.reached(mark)) {
+        if(millis() - now >= AUDIO_SYNC_TO) {
+            return false;
+        }
+        // Signals from earlier commands just cause another round
+        xSemaphoreTake(audioSyncSem, pdMS_TO_TICKS(10));
+    }
+
+    return true;
+}
+
 /*
  * audio_loop()
  *
+ * Decoding is done in the audio task. This is for
+ * what needs to be done in the context of main,
+ * ie the MusicPlayer.
  */
 void audio_loop()
 {   
+    mp_loop();
+    
+    if(mpActive && !aq_pending()) {
+        uint32_t st = audioState.load(std::memory_order_acquire);
+        // Track gone or replaced: Update its index entry
+        if((st & AS_STALE) && mpPlayNum >= 0) {
+            mpidx_validate(mpPlayNum);
+            mpPlayNum = -1;
+        }
+        if(!(st & (AS_MP3|AS_WAV|AS_APPEND))) {
+            mp_next(true);
+        }
+    }
+}
+
+/*
+ * Audio task
+ */
+
+static void do_play_file(const char *audio_file, uint32_t flags, float volumeFactor, int32_t seek = -1, uint32_t size = 0);
+
+static void audio_publish()
+{
+    uint32_t st = 0;
+
+    if(mp3->isRunning()) st |= AS_MP3;
+    if(wav->isRunning()) st |= AS_WAV;
+    if(appendFile)       st |= AS_APPEND;
+    if(out->voicesActive()) st |= AS_VOICE;
+    if(playStale)        st |= AS_STALE;
+
+    audioPlayFlags.store(playflags, std::memory_order_relaxed);
+    audioState.store(st, std::memory_order_release);
+}
+
+static void audio_generator_loop(AudioGenerator *gen)
+{
+    if(!gen->loop()) {
+        gen->stop();
+        playflags = 0;
+        if(appendFile) {
+            do_play_file(append_audio_file, append_flags, append_vol);
+        }
+    } else if(dynVol && gainSoftVol != curSoftVol) {
+        // Mixer ramps to new gain over one block
+        setGain();
+    }
+}
+
+// Built-in sounds are mixed into whatever is playing.
+// Both are mono, 16 bit, 44.1kHz; the WAV header is 44 bytes.
+static void do_play_voice(bool thrup)
+{
+    const unsigned char *data;
+    unsigned int len;
+
+    if(thrup) {
+        data = data_throttleup_wav;
+        len = data_throttleup_wav_len;
+    } else {
+        data = data_click_wav;
+        len = data_click_wav_len;
+    }
+
+    out->playVoice((const int16_t *)(data + 44), (len - 44) / 2, 
+                   calcVolume(1.0f), 
+                   thrup ? VOICE_PRIO_THRUP : VOICE_PRIO_CLICK);
+}
+
+static void do_stop()
+{
     if(mp3->isRunning()) {
-        if(!mp3->loop()) {
+        mp3->stop();
+    }
+    if(wav->isRunning()) {
+        wav->stop();
+    }
+    out->stopVoices();
+    out->stop();
+    appendFile = false;   // Clear appended, stop means stop.
+    playflags = 0;
+}
+
+// Take over what the decoder captured. Only to be called
+// when the decoder has stopped, or before it is restarted.
+static void pcmc_takeCapture()
+{
+    pcmCacheEntry *ce = pcmcCapEntry;
+
+    if(!ce) return;
+
+    pcmcCapEntry = NULL;
+
+    pcmc_finalize(ce, mp3->GetCaptureLen(), mp3->CaptureComplete());
+}
+
+static void audio_handle_cmd(audioCmd *c)
+{
+    switch(c->cmd) {
+    case AC_PLAY:
+        do_play_file(c->fn, c->flags, c->vol, c->seek, c->size);
+        break;
+    case AC_KEY:
+        // Same key playing: Stop it, otherwise play
+        if(ac_keyPlaying(playflags, c->flags & PA_KMASK)) {
             mp3->stop();
             playflags = 0;
-            if(appendFile) {
-                play_file(append_audio_file, append_flags, append_vol);
-            } else if(mpActive) {
-                mp_next(true);
-            }
-        } else if(dynVol) {
-            sampleCnt++;
-            if(sampleCnt > 1) {
-                out->SetGain(getVolume());
-                sampleCnt = 0;
-            }
+        } else {
+            do_play_file(c->fn, c->flags, c->vol, c->seek, c->size);
         }
-    } else if(wav->isRunning()) {
-        if(!wav->loop()) {
-            wav->stop();
+        break;
+    case AC_APPEND:
+        strcpy(append_audio_file, c->fn);
+        append_flags = c->flags;
+        append_vol = c->vol;
+        appendFile = true;
+        break;
+    case AC_CLRAPPEND:
+        appendFile = false;
+        break;
+    case AC_CLICK:
+        do_play_voice(false);
+        break;
+    case AC_THRUP:
+        do_play_voice(true);
+        break;
+    case AC_STOP:
+        do_stop();
+        break;
+    case AC_STOPMP3:
+        if(mp3->isRunning()) mp3->stop();
+        break;
+    case AC_STOPKEY:
+        // flags: key to stop; 0 = any key
+        if(ac_keyPlaying(playflags, c->flags)) {
+            mp3->stop();
             playflags = 0;
-            if(appendFile) {
-                play_file(append_audio_file, append_flags, append_vol);
-            } else if(mpActive) {
-                mp_next(true);
-            }
-        } else if(dynVol) {
-            sampleCnt++;
-            if(sampleCnt > 1) {
-                out->SetGain(getVolume());
-                sampleCnt = 0;
-            }
         }
-    } else if(appendFile) {
-        play_file(append_audio_file, append_flags, append_vol);
-    } else if(mpActive) {
-        mp_next(true);
+        break;
+    case AC_STOPLOOPEND:
+        if(haveSD) {
+            mySD0L->setPlayLoop(false);
+        }
+        if(haveFS) {
+            myFS0L->setPlayLoop(false);
+        }
+        break;
     }
 }
 
-static int skipID3(char *buf)
+static void audioTask(void *parameter)
 {
-    if(buf[0] == 'I' && buf[1] == 'D' && buf[2] == '3' && 
-       buf[3] >= 0x02 && buf[3] <= 0x04 && buf[4] == 0 &&
-       (!(buf[5] & 0x80))) {
-        int32_t pos = ((buf[6] << (24-3)) |
-                       (buf[7] << (16-2)) |
-                       (buf[8] << (8-1))  |
-                       (buf[9])) + 10;
-        #ifdef REMOTE_DBG
-        Serial.printf("Skipping ID3 tags, seeking to %d (0x%x)\n", pos, pos);
-        #endif
-        return pos;
-    }
-    return 0;
-}
+    audioCmd *c;
+    bool busy;
+    
+    for(;;) {
+
+        // Process commands
+        if((c = audioQ.front())) {
+            do {
+                audio_handle_cmd(c);
+                audio_publish();
+                audioQ.pop();
+            } while((c = audioQ.front()));
+            // Wake up a waiting aq_sync()
+            xSemaphoreGive(audioSyncSem);
+        }
 
-void append_file(const char *audio_file, uint32_t flags, float volumeFactor)
-{
-    strcpy(append_audio_file, audio_file);
-    append_flags = flags;
-    append_vol = volumeFactor;
-    appendFile = true;
+        // Feed output
+        if(mp3->isRunning()) {
+            audio_generator_loop(mp3);
+        } else if(wav->isRunning()) {
+            audio_generator_loop(wav);
+        } else if(appendFile) {
+            do_play_file(append_audio_file, append_flags, append_vol);
+        }
 
-    #ifdef REMOTE_DBG
-    Serial.printf("Audio: Appending %s (flags %x)\n", audio_file, flags);
-    #endif
+        busy = mp3->isRunning() || wav->isRunning();
+
+        // Voices without a generator: Mixer feeds output itself
+        if(!busy) {
+            out->loop();
+            busy = out->voicesActive();
+        }
+
+        if(!mp3->isRunning()) {
+            pcmc_takeCapture();
+        }
+
+        audio_publish();
+
+        // While playing, come back after one tick (the DMA
+        // buffers hold about 45ms), otherwise sleep until
+        // the next command comes in.
+        ulTaskNotifyTake(pdTRUE, busy ? 1 : portMAX_DELAY);
+    }
 }
 
-void play_file(const char *audio_file, uint32_t flags, float volumeFactor)
+static void do_play_file(const char *audio_file, uint32_t flags, float volumeFactor, int32_t seek, uint32_t size)
 {
     char buf[64];
     int32_t curSeek = 0;
 
     appendFile = false;   // Clear appended, append must be called AFTER play_file
-
-    if(audioMute) return;
+    playStale = false;
 
     if(playflags & PA_NOINTR) return;
 
-    if(flags & PA_INTRMUS) {
-        mpActive = false;
-    } else {
-        if(mpActive) return;
-    }
-
     #ifdef REMOTE_DBG
     Serial.printf("Audio: Playing %s (flags %x)\n", audio_file, flags);
     #endif
@@ -279,11 +526,35 @@ void play_file(const char *audio_file, uint32_t flags, float volumeFactor)
         wav->stop();
     }
 
+    pcmc_takeCapture();
+    mp3->SetCapture(NULL, 0);
+    mp3->SetPreroll(NULL, 0, false);
+
     curVolFact = volumeFactor;
     dynVol     = (flags & PA_DYNVOL) ? true : false;
     playflags  = flags & (PA_KMASK | PA_THRUP | PA_NOINTR);
     
-    out->SetGain(getVolume());
+    setGain();
+
+    if((flags & PA_CACHE) && !(flags & (PA_LOOP|PA_WAV))) {
+        pcmCacheEntry *ce = pcmc_lookup(audio_file);
+        if(ce && ce->state != PCMC_EMPTY) {
+            // Start playing the cached part right away, the decoder
+            // (if any) catches up behind it.
+            mp3->SetPreroll(ce->pcm, ce->len, (ce->state == PCMC_COMPLETE));
+            mp3->StartPreroll(out);
+            if(ce->state == PCMC_COMPLETE) {
+                mp3->begin(myPM, out);
+                #ifdef REMOTE_DBG
+                Serial.println("Playing from cache");
+                #endif
+                return;
+            }
+        } else if(ce) {
+            mp3->SetCapture(ce->pcm, pcmc_maxLen());
+            pcmcCapEntry = ce;
+        }
+    }
 
     buf[0] = 0;
 
@@ -295,8 +566,15 @@ void play_file(const char *audio_file, uint32_t flags, float volumeFactor)
             wav->begin(mySD0L, out);
             if(flags & PA_LOOP) mySD0L->setStartPos(wav->startPos);
         } else {
-            mySD0L->read((void *)buf, 10);
-            curSeek = skipID3(buf);
+            // Music player knows where the audio data starts,
+            // unless the file was replaced since it was indexed
+            if(seek >= 0 && (!size || mySD0L->getSize() == size)) {
+                curSeek = seek;
+            } else {
+                if(size) playStale = true;
+                mySD0L->read((void *)buf, 10);
+                curSeek = skipID3(buf);
+            }
             mySD0L->setStartPos(curSeek);
             mySD0L->seek(curSeek, SEEK_SET);
             mp3->begin(mySD0L, out);
@@ -330,64 +608,103 @@ void play_file(const char *audio_file, uint32_t flags, float volumeFactor)
         #endif
     } else {
         playflags = 0;
+        if(size) playStale = true;
         #ifdef REMOTE_DBG
         Serial.println("Audio file not found");
         #endif
     }
 }
 
+// Recalc gain of main stream; only needed if curSoftVol
+// or curVolFact changed
+static void setGain()
+{
+    gainSoftVol = curSoftVol;
+    out->SetGain(getVolume());
+}
+
+static float getVolume()
+{
+    return calcVolume(curVolFact);
+}
+
+static float calcVolume(float fact)
+{
+    float vol_val;
+
+    vol_val = volTable[curSoftVol];
+
+    // If user muted, return 0
+    if(vol_val == 0.0f) return vol_val;
+
+    vol_val *= fact;
+
+    // Do not totally mute
+    // 0.02 is the lowest audible gain
+    if(vol_val < 0.02f) vol_val = 0.02f;
+
+    return vol_val;
+}
+
 /*
- * Play specific sounds
+ * API; called from main
  */
 
-void play_click()
+void append_file(const char *audio_file, uint32_t flags, float volumeFactor)
+{
+    aq_post(AC_APPEND, audio_file, flags, volumeFactor);
+
+    #ifdef REMOTE_DBG
+    Serial.printf("Audio: Appending %s (flags %x)\n", audio_file, flags);
+    #endif
+}
+
+void play_file(const char *audio_file, uint32_t flags, float volumeFactor)
 {
-    if(!playClicks || playflags || audioMute) {
+    play_file_int(audio_file, flags, volumeFactor);
+}
+
+static void play_file_int(const char *audio_file, uint32_t flags, float volumeFactor, int32_t seek, uint32_t size, uint8_t cmd)
+{
+    // Clear appended, append must be called AFTER play_file
+    // (Done in audio task; we only need to tell it if we
+    // don't play anything.)
+    
+    if(audioMute || (audioPlayFlags.load(std::memory_order_relaxed) & PA_NOINTR)) {
+        aq_post(AC_CLRAPPEND);
         return;
     }
 
-    if(mpActive) {
-        mp_stop();
-    } else if(mp3->isRunning()) {
+    if(flags & PA_INTRMUS) {
+        mpActive = false;
+    } else if(mpActive) {
+        aq_post(AC_CLRAPPEND);
         return;
-    } else if(wav->isRunning()) {
-        wav->stop();
     }
 
-    appendFile = dynVol = false;
+    aq_post(cmd, audio_file, flags, volumeFactor, seek, size);
+}
 
-    curVolFact = 1.0f;
+/*
+ * Play specific sounds
+ */
 
-    out->SetGain(getVolume());
+// Click and throttle-up are mixed in, they interrupt nothing
+
+void play_click()
+{
+    if(!playClicks || audioMute) {
+        return;
+    }
 
-    myPM->open(data_click_wav, data_click_wav_len);
-    wav->beginQuick(myPM, out, 1, 44);
+    aq_post(AC_CLICK);
 }
 
 void play_throttleup()
 {
     if(audioMute) return;
 
-    if(playflags & PA_NOINTR) return;
-    
-    playflags = PA_THRUP;
-
-    if(mpActive) {
-        mp_stop();
-    } else if(mp3->isRunning()) {
-        mp3->stop();
-    } else if(wav->isRunning()) {
-        wav->stop();
-    }
-
-    appendFile = dynVol = false;
-
-    curVolFact = 1.0f;
-
-    out->SetGain(getVolume());
-    
-    myPM->open(data_throttleup_wav, data_throttleup_wav_len);
-    wav->beginQuick(myPM, out, 1, 44);
+    aq_post(AC_THRUP);
 }
 
 void play_key(int k, bool l, bool stopOnly)
@@ -402,18 +719,18 @@ void play_key(int k, bool l, bool stopOnly)
         if(!(haveKeySnd & pa_key)) return;
     }
 
-    if(pa_key == (playflags & PA_KMASK)) {
-        mp3->stop();
-        playflags = 0;
-        return;
-    }
+    // Whether this key is playing is decided by the audio task;
+    // audioPlayFlags do not yet reflect commands in the queue,
+    // such as this key's sound after a quick double press.
 
-    if(stopOnly)
+    if(stopOnly) {
+        aq_post(AC_STOPKEY, NULL, pa_key);
         return;
+    }
 
     fn = l ? keylSnd : keySnd;
     fn[4] = '0' + k;
-    play_file(fn, pa_key|PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL);
+    play_file_int(fn, pa_key|PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL|PA_CACHE, 1.0f, -1, 0, AC_KEY);
 }
 
 void play_bad()
@@ -421,24 +738,6 @@ void play_bad()
     play_file("/bad.mp3", PA_INTRMUS|PA_ALLOWSD, 1.0f);
 }
 
-static float getVolume()
-{
-    float vol_val;
-
-    vol_val = volTable[curSoftVol];
-
-    // If user muted, return 0
-    if(vol_val == 0.0f) return vol_val;
-
-    vol_val *= curVolFact;
-
-    // Do not totally mute
-    // 0.02 is the lowest audible gain
-    if(vol_val < 0.02f) vol_val = 0.02f;
-
-    return vol_val;
-}
-
 /*
  * Helpers for external
  */
@@ -448,57 +747,61 @@ bool check_file_SD(const char *audio_file)
     return (haveSD && SD.exists(audio_file));
 }
 
+// Commands not yet processed count as "running"
+
 bool checkAudioDone()
 {
-    if(mp3->isRunning()) return false;
+    if(aq_pending() || (audioState.load(std::memory_order_acquire) & AS_MP3)) return false;
     return true;
 }
 
 bool checkAudioReallyDone()
 {
-    if(mp3->isRunning() || wav->isRunning()) return false;
+    if(aq_pending() || (audioState.load(std::memory_order_acquire) & (AS_MP3|AS_WAV|AS_VOICE))) return false;
     return true;
 }
 
 bool checkMP3Running()
 {
-    if(mp3->isRunning()) return true;
+    if(aq_pending() || (audioState.load(std::memory_order_acquire) & AS_MP3)) return true;
     return false;
 }
 
-void stopAudio()
+// Returns false if the audio task did not confirm the stop in
+// time; in that case, it might still have files open.
+bool stopAudio()
 {
-    if(mp3->isRunning()) {
-        mp3->stop();
-    }
-    if(wav->isRunning()) {
-        wav->stop();
+    if(!audioTaskHandle) return true;
+
+    aq_post(AC_STOP);
+
+    // Callers expect audio to be stopped when we return
+    if(!aq_sync()) {
+        Serial.println("Audio: Stop timed out");
+        return false;
     }
-    appendFile = false;   // Clear appended, stop means stop.
-    playflags = 0;
+
+    return true;
 }
 
 void stopAudioAtLoopEnd()
 {
-    if(haveSD) {
-        mySD0L->setPlayLoop(false);
-    }
-    if(haveFS) {
-        myFS0L->setPlayLoop(false);
-    }
+    aq_post(AC_STOPLOOPEND);
 }
 
 void stop_key()
 {
-    if(playflags & PA_KMASK) {
-        mp3->stop();
-        playflags = 0;
-    }
+    aq_post(AC_STOPKEY);
 }
 
 bool append_pending()
 {
-    return appendFile;
+    return (audioState.load(std::memory_order_acquire) & AS_APPEND) ? true : false;
+}
+
+void audio_getCacheStats(audioCacheStats *stats)
+{
+    pcmc_getStats(stats);
 }
 
 /*
@@ -507,8 +810,6 @@ bool append_pending()
 
 void mp_init(bool isSetup)
 {
-    char fnbuf[20];
-    
     haveMusic = false;
 
     if(playList) {
@@ -516,6 +817,12 @@ void mp_init(bool isSetup)
         playList = NULL;
     }
 
+    mpidx_free();
+
+    // Abandon processing of previous folder; it
+    // resumes when that folder is selected again.
+    mpren_cleanup();
+
     mpCurrIdx = 0;
     
     if(haveSD) {
@@ -524,38 +831,50 @@ void mp_init(bool isSetup)
         Serial.println("MusicPlayer: Checking for music files");
         #endif
 
-        mp_renameFilesInDir(isSetup);
-
-        mp_buildFileName(fnbuf, 0);
-        if(SD.exists(fnbuf)) {
-            haveMusic = true;
-
-            maxMusic = mp_findMaxNum();
-            #ifdef REMOTE_DBG
-            Serial.printf("MusicPlayer: last file num %d\n", maxMusic);
-            #endif
+        // If the folder needs processing, the renamer does its
+        // work step by step in mp_loop(), and sets up the 
+        // player when done. If it can't start, the folder is
+        // left alone until the next mp_init().
+        if(!mp_renameFilesInDir() && !mpren_failed()) {
+            mp_initPlayer();
+        }
+    }
+}
 
-            playList = (uint16_t *)malloc((maxMusic + 1) * 2);
+static void mp_initPlayer()
+{
+    if(!mpIndex && !mpidx_load(musFolderNum)) {
+        mpidx_build(musFolderNum);
+    }
 
-            if(!playList) {
+    if(mpIndex && mpIndex[0].size) {
+        haveMusic = true;
 
-                haveMusic = false;
-                #ifdef REMOTE_DBG
-                Serial.println("MusicPlayer: Failed to allocate PlayList");
-                #endif
+        maxMusic = mpIdxCount - 1;
+        #ifdef REMOTE_DBG
+        Serial.printf("MusicPlayer: last file num %d\n", maxMusic);
+        #endif
 
-            } else {
+        playList = (uint16_t *)malloc((maxMusic + 1) * 2);
 
-                // Init play list
-                mp_makeShuffle(mpShuffle);
-                
-            }
+        if(!playList) {
 
-        } else {
+            haveMusic = false;
             #ifdef REMOTE_DBG
-            Serial.printf("MusicPlayer: Failed to open %s\n", fnbuf);
+            Serial.println("MusicPlayer: Failed to allocate PlayList");
             #endif
+
+        } else {
+
+            // Init play list
+            mp_makeShuffle(mpShuffle);
+            
         }
+
+    } else {
+        #ifdef REMOTE_DBG
+        Serial.println("MusicPlayer: No 000.mp3");
+        #endif
     }
 }
 
@@ -643,9 +962,11 @@ bool mp_stop()
     bool ret = mpActive;
     
     if(mpActive) {
-        mp3->stop();
+        aq_post(AC_STOPMP3);
         mpActive = false;
     }
+
+    mpidx_flush();
     
     return ret;
 }
@@ -706,10 +1027,17 @@ int mp_gotonum(int num, bool forcePlay)
 static bool mp_play_int(bool force)
 {
     char fnbuf[20];
-
-    mp_buildFileName(fnbuf, playList[mpCurrIdx]);
-    if(SD.exists(fnbuf)) {
-        if(force) play_file(fnbuf, PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL, 1.0f);
+    int num = playList[mpCurrIdx];
+
+    if(num < mpIdxCount && mpIndex[num].size) {
+        if(force) {
+            // No file system access here; if the file is gone or
+            // was replaced, the audio task tells (AS_STALE).
+            mp_buildFileName(fnbuf, num);
+            mpPlayNum = num;
+            play_file_int(fnbuf, PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL, 1.0f, 
+                          mpIndex[num].dataOffs, mpIndex[num].size);
+        }
         return true;
     }
     return false;
@@ -771,90 +1099,16 @@ int mp_checkForFolder(int num)
     return ret;
 }
 
-/*
- * Auto-renamer
- */
-
-
-// Check file is eligible for renaming:
-// - not a hidden/exAtt file,
-// - file name ends with ".mp3"
-// - filename not already "/musicX/ddd.mp3"
-static bool mpren_checkFN(const char *buf)
-{
-    // Hidden or macOS exAttr file? Ignore.
-    if(buf[0] == '.') return true;
-
-    size_t s = strlen(buf);
-
-    // Filename shorter than ".mp3"? Ignore.
-    if(s < 4) return true;
-
-    s -= 4;
-    // Not an mp3? Ignore.
-    if(buf[s] != '.' || buf[s+3] != '3')
-        return true;
-    if(buf[s+1] != 'm' && buf[s+1] != 'M')
-        return true;
-    if(buf[s+2] != 'p' && buf[s+2] != 'P')
-        return true;
-
-    // Now check for xxx.mp3 (xxx=000-999)
-
-    // Filename shorter or longer? Do it.
-    if(s != 3)
-        return false;
-
-    // Filename not a 3-digit number? Do it.
-    if(buf[0] < '0' || buf[0] > '9' ||
-       buf[1] < '0' || buf[1] > '9' ||
-       buf[2] < '0' || buf[2] > '9')
-        return false;
-
-    // Otherwise ignore.
-    return true;
-}
-
-static void mpren_looper(bool isSetup, bool checking, int fileNum)
-{
-    unsigned long now = millis();
-
-    if(now - renNow1 > 250) {
-        wifi_loop();
-        delay(10);
-        renNow1 = now;
-    }
-    if(!checking && (now - renNow2 > 2000)) {
-        showNumber(fileNum);
-        renNow2 = now;
-    }
-}
-
-static bool mp_renameFilesInDir(bool isSetup)
+// Returns true if the folder needs processing, which is 
+// then done in steps from mp_loop().
+static bool mp_renameFilesInDir()
 {
     char fnbuf[20];
     char fnbuf3[32];
-    char fnbuf2[256];
-    char **a, **d;
-    char *c;
     int num = musFolderNum;
-    int count = 0;
-    int fileNum = 0;
-    int strLength;
-    int nameOffs = 8;
-    int allocBufIdx = 0;
-    const unsigned long bufSizes[8] = {
-        16384, 16384, 8192, 8192, 8192, 8192, 8192, 4096 
-    };
-    char *bufs[8] = { NULL };
-    unsigned long sz, bufSize;
-    bool stopLoop = false;
-#ifdef HAVE_GETNEXTFILENAME
-    bool isDir;
-#endif
+    #ifdef REMOTE_DBG
     const char *funcName = "MusicPlayer/Renamer: ";
-
-    renNow1 = renNow2 = millis();
+    #endif
 
     // Build "DONE"-file name
     sprintf(fnbuf, "/music%1d", num);
@@ -866,7 +1120,7 @@ static bool mp_renameFilesInDir(bool isSetup)
         #ifdef REMOTE_DBG
         Serial.printf("%s%s exists\n", funcName, fnbuf3);
         #endif
-        return true;
+        return false;
     }
 
     // Check if folder exists
@@ -877,253 +1131,59 @@ static bool mp_renameFilesInDir(bool isSetup)
         return false;
     }
 
-    // Open folder and check if it is actually a folder
-    File origin = SD.open(fnbuf);
-    if(!origin) {
-        Serial.printf("%s'%s' failed to open\n", funcName, fnbuf);
-        return false;
-    }
-    if(!origin.isDirectory()) {
-        origin.close();
-        Serial.printf("%s'%s' is not a directory\n", funcName, fnbuf);
-        return false;
-    }
-        
-    // Allocate pointer array
-    if(!(a = (char **)malloc(1000*sizeof(char *)))) {
-        Serial.printf("%sFailed to allocate pointer array\n", funcName);
-        origin.close();
-        return false;
-    }
-
-    // Allocate (first) buffer for file names
-    if(!(bufs[0] = (char *)malloc(bufSizes[0]))) {
-        Serial.printf("%sFailed to allocate first sort buffer\n", funcName);
-        origin.close();
-        free(a);
-        return false;
-    }
-
-    c = bufs[0];
-    bufSize = bufSizes[0];
-    d = a;
-
-    // Loop through all files in folder
-
-#ifdef HAVE_GETNEXTFILENAME
-    String fileName = origin.getNextFileName(&isDir);
-    // Check if File::name() returns FQN or plain name
-    if(fileName.length() > 0) nameOffs = (fileName.charAt(0) == '/') ? 8 : 0;
-    while(!stopLoop && fileName.length() > 0)
-#else
-    File file = origin.openNextFile();
-    // Check if File::name() returns FQN or plain name
-    if(file) nameOffs = (file.name()[0] == '/') ? 8 : 0;
-    while(!stopLoop && file)
-#endif
-    {
-
-        mpren_looper(isSetup, true, 0);
-
-#ifdef HAVE_GETNEXTFILENAME
-
-        if(!isDir) {
-            const char *fn = fileName.c_str();
-            strLength = strlen(fn);
-            sz = strLength - nameOffs + 1;
-            if((sz > bufSize) && (allocBufIdx < 7)) {
-                allocBufIdx++;
-                if(!(bufs[allocBufIdx] = (char *)malloc(bufSizes[allocBufIdx]))) {
-                    Serial.printf("%sFailed to allocate additional sort buffer\n", funcName);
-                } else {
-                    #ifdef REMOTE_DBG
-                    Serial.printf("%sAllocated additional sort buffer\n", funcName);
-                    #endif
-                    c = bufs[allocBufIdx];
-                    bufSize = bufSizes[allocBufIdx];
-                }
-            }
-            if((strLength < 256) && (sz <= bufSize)) {
-                if(!mpren_checkFN(fn + nameOffs)) {
-                    *d++ = c;
-                    strcpy(c, fn + nameOffs);
-                    #ifdef REMOTE_DBG
-                    Serial.printf("%sAdding '%s'\n", funcName, c);
-                    #endif
-                    c += sz;
-                    bufSize -= sz;
-                    fileNum++;
-                }
-            } else if(sz > bufSize) {
-                stopLoop = true;
-                Serial.printf("%sSort buffer(s) exhausted, remaining files ignored\n", funcName);
-            }
-        }
-        
-#else // --------------
-
-        if(!file.isDirectory()) {
-            strLength = strlen(file.name());
-            sz = strLength - nameOffs + 1;
-            if((sz > bufSize) && (allocBufIdx < 7)) {
-                allocBufIdx++;
-                if(!(bufs[allocBufIdx] = (char *)malloc(bufSizes[allocBufIdx]))) {
-                    Serial.printf("%sFailed to allocate additional sort buffer\n", funcName);
-                } else {
-                    #ifdef REMOTE_DBG
-                    Serial.printf("%sAllocated additional sort buffer\n", funcName);
-                    #endif
-                    c = bufs[allocBufIdx];
-                    bufSize = bufSizes[allocBufIdx];
-                }
-            }
-            if((strLength < 256) && (sz <= bufSize)) {
-                if(!mpren_checkFN(file.name() + nameOffs)) {
-                    *d++ = c;
-                    strcpy(c, file.name() + nameOffs);
-                    #ifdef REMOTE_DBG
-                    Serial.printf("%sAdding '%s'\n", funcName, c);
-                    #endif
-                    c += sz;
-                    bufSize -= sz;
-                    fileNum++;
-                }
-            } else if(sz > bufSize) {
-                stopLoop = true;
-                Serial.printf("%sSort buffer(s) exhausted, remaining files ignored\n", funcName);
-            }
-        }
-        file.close();
-        
-#endif
-        
-        if(fileNum >= 1000) stopLoop = true;
-
-        if(!stopLoop) {
-            #ifdef HAVE_GETNEXTFILENAME
-            fileName = origin.getNextFileName(&isDir);
-            #else
-            file = origin.openNextFile();
-            #endif
-        }
-    }
-
-    origin.close();
-
-    #ifdef REMOTE_DBG
-    Serial.printf("%s%d files to process\n", funcName, fileNum);
-    #endif
-
-    // Sort file names, and rename
-
-    if(fileNum) {
-        
-        // Sort file names
-        mpren_quickSort(a, 0, fileNum - 1);
-    
-        sprintf(fnbuf2, "/music%1d/", num);
-        strcpy(fnbuf, fnbuf2);
-
-        // If 000.mp3 exists, find current count
-        // the usual way. Otherwise start at 000.
-        strcpy(fnbuf + 8, "000.mp3");
-        if(SD.exists(fnbuf)) {
-            count = mp_findMaxNum() + 1;
-        }
-
-        for(int i = 0; i < fileNum && count <= 999; i++) {
-            
-            mpren_looper(isSetup, false, fileNum - i);
-
-            sprintf(fnbuf + 8, "%03d.mp3", count);
-            strcpy(fnbuf2 + 8, a[i]);
-            if(!SD.rename(fnbuf2, fnbuf)) {
-                bool done = false;
-                while(!done) {
-                    count++;
-                    if(count <= 999) {
-                        sprintf(fnbuf + 8, "%03d.mp3", count);
-                        done = SD.rename(fnbuf2, fnbuf);
-                    } else {
-                        done = true;
-                    }
-                }
-            }
-            #ifdef REMOTE_DBG
-            Serial.printf("%sRenamed '%s' to '%s'\n", funcName, fnbuf2, fnbuf);
-            #endif
-            
-            count++;
-        }
-    }
+    return mpren_begin(num, mp_findMaxNum, mp_renameDone);
+}
 
-    for(int i = 0; i <= allocBufIdx; i++) {
-        if(bufs[i]) free(bufs[i]);
-    }
-    free(a);
+// Called by the renamer when the folder is done
+static void mp_renameDone()
+{
+    char fnbuf[32];
 
     // Write "DONE" file
-    if((origin = SD.open(fnbuf3, FILE_WRITE))) {
-        origin.close();
+    sprintf(fnbuf, "/music%1d%s", musFolderNum, tcdrdone);
+    File file = SD.open(fnbuf, FILE_WRITE);
+    if(file) {
+        file.close();
         #ifdef REMOTE_DBG
-        Serial.printf("%sWrote %s\n", funcName, fnbuf3);
+        Serial.printf("MusicPlayer/Renamer: Wrote %s\n", fnbuf);
         #endif
     }
 
-    return true;
+    // Write index
+    mpidx_build(musFolderNum);
 }
 
-/*
- * QuickSort for file names
- */
+#define MPREN_LOOP_MS      5        // Time for work per mp_loop() call
 
-static unsigned char mpren_toUpper(char a)
+// Called from audio_loop(): Let the renamer do some work
+static void mp_loop()
 {
-    if(a >= 'a' && a <= 'z')
-        a &= ~0x20;
+    unsigned long now;
 
-    return (unsigned char)a;
-}
-
-static bool mpren_strLT(const char *a, const char *b)
-{
-    int aa = strlen(a);
-    int bb = strlen(b);
-    int cc = aa < bb ? aa : bb;
-
-    for(int i = 0; i < cc; i++) {
-        unsigned char aaa = mpren_toUpper(*a);
-        unsigned char bbb = mpren_toUpper(*b);
-        if(aaa < bbb) return true;
-        if(aaa > bbb) return false;
-        a++; b++;
-    }
+    if(!mpren_busy())
+        return;
 
-    return false;
+    now = millis();
+    do {
+        if(!mpren_step()) {
+            // Renamer has built the index. If it gave up, the
+            // folder is only partly renamed; no index, no player,
+            // the next mp_init() resumes or starts over.
+            if(mpren_failed()) {
+                #ifdef REMOTE_DBG
+                Serial.println("MusicPlayer: Renamer failed");
+                #endif
+            } else {
+                mp_initPlayer();
+            }
+            break;
+        }
+    } while(millis() - now < MPREN_LOOP_MS);
 }
 
-static int mpren_partition(char **a, int s, int e)
+int mp_renameProgress()
 {
-    char *t;
-    char *p = a[e];
-    int   i = s - 1;
- 
-    for(int j = s; j <= e - 1; j++) {
-        if(mpren_strLT(a[j], p)) {
-            i++;
-            t = a[i];
-            a[i] = a[j];
-            a[j] = t;
-        }
-    }
-
-    i++;
-
-    t = a[i];
-    a[i] = a[e];
-    a[e] = t;
-    
-    return i;
+    return mpren_remaining();
 }
 
 static uint8_t* mpren_renOrder(uint8_t *a, uint32_t s, int e)
@@ -1135,14 +1195,3 @@ static uint8_t* mpren_renOrder(uint8_t *a, uint32_t s, int e)
 
     return a;
 }
-
-static void mpren_quickSort(char **a, int s, int e)
-{
-    if(s < e) {
-        int p = mpren_partition(a, s, e);
-        mpren_quickSort(a, s, p - 1);
-        mpren_quickSort(a, p + 1, e);
-    } else if(s < 0) {
-        mpren_renOrder((uint8_t*)*a, s, e);
-    }
-}
@@ -67,9 +67,18 @@
 #define PA_THRUP   0x0040
 #define PA_KLONG   0x0080
 // upper 8 bits all taken
+#define PA_CACHE   0x20000
 #define PA_MASKA   (PA_LOOP|PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL|PA_NOINTR)
 #define PA_KMASK   0x1ff80
 
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t fills;
+    uint32_t bytesUsed;
+    uint32_t bytesTotal;
+} audioCacheStats;
+
 void audio_setup();
 void audio_loop();
 
@@ -85,10 +94,11 @@ bool check_file_SD(const char *audio_file);
 bool checkAudioDone();
 bool checkAudioReallyDone();
 bool checkMP3Running();
-void stopAudio();
+bool stopAudio();
 void stopAudioAtLoopEnd();
 void stop_key();
 bool append_pending();
+void audio_getCacheStats(audioCacheStats *stats);
 
 void     mp_init(bool isSetup);
 void     mp_play(bool forcePlay = true);
@@ -98,6 +108,7 @@ void     mp_prev(bool forcePlay = false);
 int      mp_gotonum(int num, bool force = false);
 void     mp_makeShuffle(bool enable);
 int      mp_checkForFolder(int num);
+int      mp_renameProgress();
 uint8_t* m(uint8_t *a, uint32_t s, int e);
 
 extern bool audioInitDone;
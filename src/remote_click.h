@@ -54,7 +54,8 @@
 
 // Do NOT put in flash. We need every bit of speed we can get.
 // Reading from flash is 10 times slower than from RAM.
-unsigned char data_click_wav[] = {
+// Aligned since the mixer reads the samples directly as int16_t.
+unsigned char data_click_wav[] __attribute__((aligned(4))) = {
   0x52, 0x49, 0x46, 0x46, 0x30, 0x38, 0x00, 0x00, 0x57, 0x41, 0x56, 0x45,
   0x66, 0x6d, 0x74, 0x20, 0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00,
   0x44, 0xac, 0x00, 0x00, 0x88, 0x58, 0x01, 0x00, 0x02, 0x00, 0x10, 0x00,
@@ -1258,7 +1259,7 @@ unsigned char data_click_wav[] = {
 };
 const unsigned int data_click_wav_len = 14392;
 
-const unsigned char data_throttleup_wav[] = {
+const unsigned char data_throttleup_wav[] __attribute__((aligned(4))) = {
   0x52, 0x49, 0x46, 0x46, 0x9a, 0x66, 0x00, 0x00, 0x57, 0x41, 0x56, 0x45,
   0x66, 0x6d, 0x74, 0x20, 0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00,
   0x44, 0xac, 0x00, 0x00, 0x88, 0x58, 0x01, 0x00, 0x02, 0x00, 0x10, 0x00,
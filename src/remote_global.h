@@ -22,7 +22,9 @@
  ***             Configuration for hardware/peripherals                ***
  *************************************************************************/
 
-// Nix...
+// Uncomment if the ButtonPack's INT output is connected to BPACK_INT_PIN.
+// The port expander is then only read when it signals a change.
+//#define HAVE_BPACK_INT
 
 /*************************************************************************
  ***                           Miscellaneous                           ***
@@ -107,6 +109,8 @@
 
 #define BALM_PIN          4       // Battery monitor alarm (CB 1.6; act. low)     (PU on CB 1.6)
 
+#define BPACK_INT_PIN     39      // ButtonPack INT (act. low, open drain)        (has no internal PU; PU needed)
+
 #define DETECT_OUT_PIN    17      // Board version detection output
 #define DETECT_MIRROR     35      // Board version detection input
 
@@ -58,6 +58,12 @@
 #include <WiFi.h>
 #include "display.h"
 #include "input.h"
+#include "accel.h"
+#include "i2cbus.h"
+#include "bttfn.h"
+#include "schedtmr.h"
+#include "lowpower.h"
+#include "mqttha.h"
 #ifdef REMOTE_HAVETEMP
 #include "sensors.h"
 #endif
@@ -184,7 +190,6 @@ int32_t        throttlePos = 0;
 static int32_t oldThrottlePos = 0;
 static int     currSpeedF = 0;
 static int     currSpeed = 0;
-static unsigned long lastSpeedUpd = 0;
 static bool    lockThrottle = false;
 bool           doCoast = false;
 bool           keepCounting = false;
@@ -197,8 +202,12 @@ static bool calibIP = true;
 static unsigned long brichgtimer = 0;
 static unsigned long volchgtimer = 0;
 
-static bool          offDisplayTimer = false;
-static unsigned long offDisplayNow = 0;
+#define OFF_DISP_DELAY 1000     // Display off after showing something while fake-off
+static void offDisplay(void *arg);
+static schedTimer offDisplayTmr(offDisplay);
+
+static int           mpRenLeft = -1;
+static unsigned long mpRenNow = 0;
 
 #define  VISB_MOV_MD 0    // No longer part of visMode (transitional)
 #define  VISB_DGPS   1    // No longer part of visMode (transitional)
@@ -216,7 +225,7 @@ static bool resAT = false;
 
 static int  triggerTTonThrottle = 0;
 static int  triggerIntTTonThrottle = 0;
-static unsigned long triggerTTonThrottleNow = 0;
+static schedTimer triggerTTonThrottleTmr;
 
 static int refillButton = 0;
 
@@ -232,53 +241,12 @@ bool ooresBri = true;
 #define P2_ALARM_DELAY  6400            // Delay for "beep" after reentry (sync'd)
 #define P2_ALARM_DLY_SA 6400            // Delay for "beep" after reentry (stand-alone)
 
-static unsigned long accelDelay = 1000/10;
-static int32_t       accelStep = 1;
-
-// Linear mode
-static const unsigned long accelDelays[5] = { 50, 42, 35, 28, 20 };  // 1-100%
-static const int32_t       accelSteps[5]  = {  1,  1,  1,  1,  1 };  // 1-100%
-static const int32_t       decelSteps[5]  = {  1,  1,  1,  2,  2 };  // 1-100%
-
-/* movie mode
- *       0- 7:  90ms/mph
- *      20-24: 197ms/mph
- *      32-39: 200ms/mph
- *      55-59: 220ms/mph
- *      77-81: 300ms/mph
-*/
-static const unsigned long strictAccelFacts[5] = { 25, 21, 17, 14, 10 };
-static const unsigned long strictAccelDelays[89] =
-{
-      0,  90,  90,  90,  90,  90,  90,  95,  95, 100,  // m0 - 9  10mph  0- 9: 0.83s  (m=measured, i=interpolated)
-    105, 110, 115, 120, 125, 130, 135, 140, 145, 150,  // i10-19  20mph 10-19: 1.27s
-    155, 160, 165, 170, 175, 180, 185, 190, 195, 200,  // i20-29  30mph 20-29: 1.77s
-    200, 200, 202, 203, 204, 205, 206, 207, 208, 209,  // m30-39  40mph 30-39: 2s
-    210, 211, 212, 213, 214, 215, 216, 217, 218, 219,  // i40-49  50mph 40-49: 2.1s
-    220, 221, 222, 223, 224, 225, 226, 227, 228, 229,  // m50-59  60mph 50-59: 2.24s
-    230, 233, 236, 240, 243, 246, 250, 253, 256, 260,  // i60-69  70mph 60-69: 2.47s
-    263, 266, 270, 273, 276, 280, 283, 286, 290, 293,  // m70-79  80mph 70-79: 2.78s
-    296, 300, 300, 303, 303, 306, 310, 310,   0        // i80-88  90mph 80-88: 2.4s   total 17.6 secs
-};
-static const int32_t  strictdecelSteps[5]  = {  2,  2,  2,  2,  2 };  // 1-100%
+static accelEngine accelEng;
 
 #define P1_START_SPD_M 835
 #define P1_START_SPD_L 820
 
-static const int16_t coastCurve[89][2] =
-{
-    {6, 2}, {6, 2}, {6, 2}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 4}, // 0 
-    {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 3}, {6, 3}, // 10
-    {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, // 20
-    {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, // 30
-    {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, // 40
-    {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, // 50 
-    {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, // 60 
-    {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {5, 1}, {5, 1}, {5, 1}, // 70
-    {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}          // 80
-};
-
-static unsigned long lastCommandSent = 0;
+static schedTimer keepAliveTmr;
 
 static bool doForceDispUpd = false;
 
@@ -346,12 +314,20 @@ static bool          triggerP1NoLead = false;
 // Volume-factor for "travelstart" sounds
 #define TT_SOUND_FACT 0.60f
 
-static unsigned long volchgnow = 0;
-static unsigned long brichgnow = 0;
-static unsigned long vischgnow = 0;
+// Save on-the-fly settings some time after last change
+#define SAVE_BRI_DELAY  8000
+#define SAVE_VOL_DELAY  8000
+#define SAVE_VIS_DELAY  3000
+#define SAVE_RETRY      500     // If busy at that time
+static void briSave(void *arg);
+static void volSave(void *arg);
+static void visSave(void *arg);
+static schedTimer briSaveTmr(briSave);
+static schedTimer volSaveTmr(volSave);
+static schedTimer visSaveTmr(visSave);
 
 bool                 FPBUnitIsOn = true;
-static unsigned long justBootedNow = 0;
+static schedTimer    justBootedTmr;
 static bool          bootFlag = false;
 static bool          sendBootStatus = false;
 bool                 blockScan = false;
@@ -369,88 +345,59 @@ static const char *  throttleUpSnd = "/throttleup.mp3";   // Default built-in
 static char          brakeRem[]  = "/rbrake1.mp3";
 
 // BTTF network
-#define BTTFN_VERSION              1
-#define BTTFN_SUP_MC            0x80
-#define BTTFN_SUP_ND            0x40
-#define BTTF_PACKET_SIZE          48
-#define BTTF_DEFAULT_LOCAL_PORT 1338
-#define BTTFN_POLL_INT          1300
-#define BTTFN_POLL_INT_FAST      500
-#define BTTFN_RESPONSE_TO        700
-#define BTTFN_DATA_TO          18600
-#define BTTFN_TYPE_ANY     0    // Any, unknown or no device
-#define BTTFN_TYPE_FLUX    1    // Flux Capacitor
-#define BTTFN_TYPE_SID     2    // SID
-#define BTTFN_TYPE_PCG     3    // Dash Gauges
-#define BTTFN_TYPE_VSR     4    // VSR
-#define BTTFN_TYPE_AUX     5    // Aux (user custom device)
-#define BTTFN_TYPE_REMOTE  6    // Futaba remote control
-#define BTTFN_NOT_PREPARE  1
-#define BTTFN_NOT_TT       2
-#define BTTFN_NOT_REENTRY  3
-#define BTTFN_NOT_ABORT_TT 4
-#define BTTFN_NOT_ALARM    5
-#define BTTFN_NOT_REFILL   6
-#define BTTFN_NOT_FLUX_CMD 7
-#define BTTFN_NOT_SID_CMD  8
-#define BTTFN_NOT_PCG_CMD  9
-#define BTTFN_NOT_WAKEUP   10
-#define BTTFN_NOT_AUX_CMD  11
-#define BTTFN_NOT_VSR_CMD  12
-#define BTTFN_NOT_REM_CMD  13
-#define BTTFN_NOT_REM_SPD  14
-#define BTTFN_NOT_SPD      15
-#define BTTFN_NOT_INFO     16
-#define BTTFN_NOT_DATA     128  // bit only, not value
-#define BTTFN_REMCMD_PING       1   // Implicit "Register"/keep-alive
-#define BTTFN_REMCMD_BYE        2   // Forced unregister
-#define BTTFN_REMCMD_COMBINED   3   // All switches & speed combined
-#define BTTFN_REM_MAX_COMMAND   BTTFN_REMCMD_COMBINED
-#define BTTFN_REMCMD_KEEPALIVE 101
-#define BTTFN_SSRC_NONE         0
-#define BTTFN_SSRC_GPS          1
-#define BTTFN_SSRC_ROTENC       2
-#define BTTFN_SSRC_REM          3
-#define BTTFN_SSRC_P0           4
-#define BTTFN_SSRC_P1           5
-#define BTTFN_SSRC_P2           6
-#define BTTFN_TCDI1_NOREM   0x0001
-#define BTTFN_TCDI1_NOREMKP 0x0002
-#define BTTFN_TCDI1_EXT     0x0004
-#define BTTFN_TCDI1_OFF     0x0008
-#define BTTFN_TCDI1_NM      0x0010
-#define BTTFN_TCDI2_BUSY    0x0001
-static const uint8_t BTTFUDPHD[4] = { 'B', 'T', 'T', 'F' };
+class bttfnWiFiUDP : public bttfnTransport {
+
+    public:
+
+        void begin()
+        {
+            uc.begin(BTTF_DEFAULT_LOCAL_PORT);
+            mc.beginMulticast(mcIP, BTTF_DEFAULT_LOCAL_PORT + 2);
+        }
+        
+        virtual bool linkUp() override
+        {
+            return (WiFi.status() == WL_CONNECTED);
+        }
+        
+        virtual bool recv(uint8_t *buf, uint32_t &fromIP) override
+        {
+            return recvFrom(uc, buf, fromIP);
+        }
+        
+        virtual bool recvMC(uint8_t *buf, uint32_t &fromIP) override
+        {
+            return recvFrom(mc, buf, fromIP);
+        }
+        
+        virtual void send(uint32_t toIP, const uint8_t *buf) override
+        {
+            if(toIP) {
+                uc.beginPacket(IPAddress(toIP), BTTF_DEFAULT_LOCAL_PORT);
+            } else {
+                uc.beginPacket(mcIP, BTTF_DEFAULT_LOCAL_PORT + 1);
+            }
+            uc.write(buf, BTTF_PACKET_SIZE);
+            uc.endPacket();
+        }
+
+    private:
+
+        bool recvFrom(WiFiUDP &udp, uint8_t *buf, uint32_t &fromIP)
+        {
+            if(!udp.parsePacket())
+                return false;
+            udp.read(buf, BTTF_PACKET_SIZE);
+            fromIP = (uint32_t)udp.remoteIP();
+            return true;
+        }
+
+        WiFiUDP uc;
+        WiFiUDP mc;
+        const IPAddress mcIP = IPAddress(224, 0, 0, 224);
+};
+static bttfnWiFiUDP  bttfnUDP;
 static bool          useBTTFN = false;
-static WiFiUDP       bttfUDP;
-static UDP*          remUDP;
-static WiFiUDP       bttfMcUDP;
-static UDP*          remMcUDP;
-static byte          BTTFUDPBuf[BTTF_PACKET_SIZE];
-static byte          BTTFUDPTBuf[BTTF_PACKET_SIZE];
-static unsigned long BTTFNUpdateNow = 0;
-static unsigned long bttfnRemPollInt = BTTFN_POLL_INT;
-static unsigned long BTTFNTSRQAge = 0;
-static bool          BTTFNPacketDue = false;
-static bool          BTTFNWiFiUp = false;
-static uint8_t       BTTFNfailCount = 0;
-static uint32_t      BTTFUDPID = 0;
-static unsigned long lastBTTFNpacket = 0;
-static unsigned long bttfnLastNotData = 0;
-static bool          BTTFNBootTO = false;
-static bool          haveTCDIP = false;
-static IPAddress     bttfnTcdIP;
-static uint8_t       bttfnReqStatus = 0x52; // Request capabilities, status, speed
-static bool          TCDSupportsNOTData = false;
-static bool          TCDSupportsSSID = false;
-static bool          bttfnDataNotEnabled = false;
-static uint32_t      tcdHostNameHash = 0;
-static byte          BTTFMCBuf[BTTF_PACKET_SIZE];
-static IPAddress     bttfnMcIP(224, 0, 0, 224);
-static uint32_t      bttfnSeqCnt[BTTFN_REM_MAX_COMMAND+1] = { 1 };
-static uint32_t      bttfnTCDDataSeqCnt = 0;
-static uint32_t      bttfnSessionID = 0;
-static unsigned long bttfnCurrLatency = 0, bttfnPacketSentNow = 0;
 static int16_t       tcdCurrSpeed = -1;
 int                  bttfnHaveTCDSSID = 0;
 char                 TCDSSID[8] = { 0 };
@@ -462,7 +409,8 @@ bool                 displayGPSMode = DEF_DISP_GPS;
 uint16_t             tcdIsInP0 = 0, tcdIsInP0Old = 1000;
 static uint16_t      tcdSpeedP0 = 0, tcdSpeedP0Old = 1000;
 static uint16_t      tcdIsInP0stalled = 0;
-static unsigned long tcdInP0now = 0;
+static void          tcdP0Expired(void *arg);
+static schedTimer    tcdP0Tmr(tcdP0Expired);
 static uint32_t      bttfnTCDSeqCnt = 0;
 static uint16_t      tcdSpdFake100 = 0;
 static unsigned long tcdSpdChgNow = 0;
@@ -474,30 +422,6 @@ static int      iCmdIdx = 0;
 static int      oCmdIdx = 0;
 static uint32_t commandQueue[16] = { 0 };
 
-#ifdef ESP32
-/*  "warning: taking address of packed member of 'struct <anonymous>' may 
- *  result in an unaligned pointer value"
- *  "GCC will issue this warning when accessing an unaligned member of 
- *  a packed struct due to the incurred penalty of unaligned memory 
- *  access. However, all ESP chips (on both Xtensa and RISC-V 
- *  architectures) allow for unaligned memory access and incur no extra 
- *  penalty."
- *  https://docs.espressif.com/projects/esp-idf/en/v5.1/esp32s3/migration-guides/release-5.x/5.0/gcc.html
- */
-#define GET32(a,b)    *((uint32_t *)((a) + (b)))
-#define SET32(a,b,c)  *((uint32_t *)((a) + (b))) = c
-#else
-#define GET32(a,b)          \
-    (((a)[b])            |  \
-    (((a)[(b)+1]) << 8)  |  \
-    (((a)[(b)+2]) << 16) |  \
-    (((a)[(b)+3]) << 24))   
-#define SET32(a,b,c)                        \
-    (a)[b]       = ((uint32_t)(c)) & 0xff;  \
-    ((a)[(b)+1]) = ((uint32_t)(c)) >> 8;    \
-    ((a)[(b)+2]) = ((uint32_t)(c)) >> 16;   \
-    ((a)[(b)+3]) = ((uint32_t)(c)) >> 24; 
-#endif 
 
 static void displayVolume();
 static void increaseBrightness();
@@ -516,6 +440,11 @@ static void timeTravel(bool networkTriggered, uint16_t P0Dur = P0_DUR, uint16_t
 static void showDot();
 
 static void showUpd();
+static void showMPProgress(unsigned long now);
+#ifdef REMOTE_HAVEMQTT
+static bool haPublish(const char *topic, const char *pl, unsigned int len);
+static void publishTelemetry(unsigned long now);
+#endif
 
 static void toggleAutoThrottle();
 
@@ -756,10 +685,6 @@ void main_setup()
     resAT = evalBool(settings.resAT);
     ooresBri = !evalBool(settings.oorst);
 
-    for(int i = 0; i < BTTFN_REM_MAX_COMMAND+1; i++) {
-        bttfnSeqCnt[i] = 1;
-    }
-
     buttonPackMomentary[0] = !evalBool(settings.bPb0Maint);
     buttonPackMomentary[1] = !evalBool(settings.bPb1Maint);
     buttonPackMomentary[2] = !evalBool(settings.bPb2Maint);
@@ -789,6 +714,8 @@ void main_setup()
                 MQTTbuttonOffLen[i] = strlen(settings.mqttbf[i]);
             }
         }
+        mqttha_setup(settings.hostName, REMOTE_VERSION, atoi(settings.mqttTele) * 1000, 
+                     havePwrMon && usePwrMon, haPublish);
     }
     #endif
 
@@ -913,7 +840,11 @@ void main_setup()
     #ifdef ALLOW_DIS_UB
     if(!evalBool(settings.disBPack)) {
     #endif
+        #ifdef HAVE_BPACK_INT
+        if((useBPack = butPack.begin(BPACK_INT_PIN))) {
+        #else
         if((useBPack = butPack.begin())) {
+        #endif
             butPack.setScanInterval(50);
             butPack.attachPressDown(butPackKeyPressed);
             butPack.attachPressEnd(butPackKeyPressStop);
@@ -974,7 +905,7 @@ void main_setup()
     bttfn_loop();
   
     FPBUnitIsOn = false;
-    justBootedNow = millis();
+    sched_start(&justBootedTmr, 10*1000);
     bootFlag = true;
 
     // Short delay to allow .scan(s) in loop to detect powerswitch 
@@ -995,12 +926,20 @@ void main_setup()
             }
         }
     }
+
+    lp_setup();
 }
 
 void main_loop()
 {
     unsigned long now = millis();
 
+    // Finish pending i2c transactions
+    i2cbus_loop();
+
+    // Run expired timers
+    sched_run();
+
     #ifdef HAVE_CRSF
     if(opModeCRSF) {
         #ifdef HAVE_PM
@@ -1017,6 +956,12 @@ void main_loop()
     }
     #endif
 
+    // Low-power mode while fake-off, unless something
+    // needs the display, audio or frequent polling
+    lp_update(!FPBUnitIsOn, 
+              calibMode || sched_armed(&offDisplayTmr) || (mpRenLeft >= 0) ||
+              !checkAudioReallyDone() || mpActive);
+
     if(triggerCompleteUpdate) {
         triggerCompleteUpdate = false;
         bttfn_remote_send_combined(powerState, brakeState, currSpeed);
@@ -1062,8 +1007,7 @@ void main_loop()
                     remdisplay.setText("BAT");
                     remdisplay.show();
                     remdisplay.on();
-                    offDisplayTimer = true;
-                    offDisplayNow = now;
+                    sched_start(&offDisplayTmr, OFF_DISP_DELAY);
                     battWarnBlinkNow = now;
                 }
             } else {
@@ -1109,16 +1053,16 @@ void main_loop()
   
                 calibMode = false;    // Cancel calibration
 
-                offDisplayTimer = false;
+                sched_cancel(&offDisplayTmr);
 
                 etmr = false;
 
                 // Re-connect if we're in AP mode but
                 // there is a configured WiFi network
-                if(!justBootedNow) {
+                if(!sched_armed(&justBootedTmr)) {
                     wifiOnFakePowerOn(true);
                 }
-                justBootedNow = 0;
+                sched_cancel(&justBootedTmr);
 
                 currSpeedF = 0;
                 currSpeed = 0;
@@ -1194,7 +1138,7 @@ void main_loop()
                 TTrunning = TTP0 = TTP1 = TTP2 = false;
                 IntP0running = false;
                 
-                offDisplayTimer = false;
+                sched_cancel(&offDisplayTmr);
                 if(displayGPSMode) {
                     currSpeedOldGPS = -2;   // Trigger GPS speed display update
                 }
@@ -1248,9 +1192,9 @@ void main_loop()
 
             if(!TTrunning) {
                 if(brakeState) {
-                    play_file(brakeOnSnd, PA_ALLOWSD|PA_DYNVOL, 1.0f);
+                    play_file(brakeOnSnd, PA_ALLOWSD|PA_DYNVOL|PA_CACHE, 1.0f);
                 } else if(haveBOFFsnd) {
-                    play_file(brakeOffSnd, PA_ALLOWSD|PA_DYNVOL, 1.0f);
+                    play_file(brakeOffSnd, PA_ALLOWSD|PA_DYNVOL|PA_CACHE, 1.0f);
                 }
             }
         }
@@ -1355,9 +1299,9 @@ void main_loop()
                         increaseVolume();
                     }
                     displayVolume();
-                    offDisplayTimer = true;
-                    offDisplayNow = volchgtimer = millisNonZero();
-                    play_file("/volchg.mp3", PA_INTRMUS|PA_ALLOWSD, 1.0f);
+                    volchgtimer = millisNonZero();
+                    sched_start(&offDisplayTmr, OFF_DISP_DELAY);
+                    play_file("/volchg.mp3", PA_INTRMUS|PA_ALLOWSD|PA_CACHE, 1.0f);
                 }
             } else if(isbuttonAKeyLongPressed) {
                 if(ooresBri) {
@@ -1366,8 +1310,8 @@ void main_loop()
                         increaseBrightness();
                     }
                     displayBrightness();
-                    offDisplayTimer = true;
-                    offDisplayNow = brichgtimer = millisNonZero();
+                    brichgtimer = millisNonZero();
+                    sched_start(&offDisplayTmr, OFF_DISP_DELAY);
                 } else {
                     powerMaster = true;
                     updateVisMode();
@@ -1425,9 +1369,9 @@ void main_loop()
                         decreaseVolume();
                     }
                     displayVolume();
-                    offDisplayTimer = true;
-                    offDisplayNow = volchgtimer = millisNonZero();
-                    play_file("/volchg.mp3", PA_INTRMUS|PA_ALLOWSD, 1.0f);
+                    volchgtimer = millisNonZero();
+                    sched_start(&offDisplayTmr, OFF_DISP_DELAY);
+                    play_file("/volchg.mp3", PA_INTRMUS|PA_ALLOWSD|PA_CACHE, 1.0f);
                 }
             } else if(isbuttonBKeyLongPressed) {
                 if(ooresBri) {
@@ -1436,8 +1380,8 @@ void main_loop()
                         decreaseBrightness();
                     }
                     displayBrightness();
-                    offDisplayTimer = true;
-                    offDisplayNow = brichgtimer = millisNonZero();
+                    brichgtimer = millisNonZero();
+                    sched_start(&offDisplayTmr, OFF_DISP_DELAY);
                 } else {
                     powerMaster = false;
                     updateVisMode();
@@ -1470,8 +1414,7 @@ void main_loop()
                 remdisplay.setText("BAT");
                 remdisplay.show();
                 remdisplay.on();
-                offDisplayTimer = true;
-                offDisplayNow = millis();
+                sched_start(&offDisplayTmr, OFF_DISP_DELAY);
                 calibKeyState = 0;
             } else if(calibKeyState & CK_PRESSED) {
                 if(calibMode) {
@@ -1483,8 +1426,7 @@ void main_loop()
                         } else {
                             remdisplay.setText("ERR");
                             remdisplay.show();
-                            offDisplayTimer = true;
-                            offDisplayNow = millis();
+                            sched_start(&offDisplayTmr, OFF_DISP_DELAY);
                             calibMode = false;
                             condPLEDaBLvl(false, false);
                         }
@@ -1499,8 +1441,7 @@ void main_loop()
                         } else {
                             remdisplay.setText("ERR");
                             remdisplay.show();
-                            offDisplayTimer = true;
-                            offDisplayNow = millis();
+                            sched_start(&offDisplayTmr, OFF_DISP_DELAY);
                             calibMode = false;
                         }
                         condPLEDaBLvl(false, false);
@@ -1511,8 +1452,7 @@ void main_loop()
                     remdisplay.show();
                     remdisplay.on();
                     delay((pwrLEDonFP || LvLMtronFP) ? 2000 : 200);    // Stabilize voltage after turning on display, LED, level meter
-                    offDisplayTimer = true;
-                    offDisplayNow = millis();
+                    sched_start(&offDisplayTmr, OFF_DISP_DELAY);
                     if(useRotEnc) {
                         rotEnc.zeroPos(true);
                         if(!rotEnc.dynZeroPos()) {
@@ -1533,7 +1473,7 @@ void main_loop()
                     currSpeedOldGPS = -2;   // force GPS speed display update
                 } else {
                     calibMode = true;
-                    offDisplayTimer = false;
+                    sched_cancel(&offDisplayTmr);
                     condPLEDaBLvl(true, true);
                     if(pwrLEDonFP || LvLMtronFP) {
                         showWaitSequence();
@@ -1645,7 +1585,7 @@ void main_loop()
                         triggerTTonThrottle = 0;
                     } else {
                         bttfn_trigger_tt(false);
-                        triggerTTonThrottleNow = millis();
+                        sched_start(&triggerTTonThrottleTmr, 1000);
                     }
                     brakeWarning = false;
                 }
@@ -1654,7 +1594,7 @@ void main_loop()
                 // a tt for whatever reason, reset the flag.
                 // Might happen due to delay in mutual network 
                 // communication on brakeState, tt phases, ...
-                if(millis() - triggerTTonThrottleNow > 1000) {
+                if(!sched_armed(&triggerTTonThrottleTmr)) {
                     triggerTTonThrottle = 0;
                     play_bad();
                 }
@@ -1663,8 +1603,6 @@ void main_loop()
     } else if(!tcdIsInP0 && !calibMode) {
         throttlePos = rotEnc.updateThrottlePos();
         if(FPBUnitIsOn && (!TTrunning || IntP0running)) {
-            int tas = 0, tidx = 0;
-
             // IntP0running is part of the TT sequence
             // so TTrunning is true. (Unlike tcdIsInP0)
             if(IntP0running) {
@@ -1693,32 +1631,12 @@ void main_loop()
 
             }
             
-            if(movieMode) {
+            oldThrottlePos = throttlePos;
 
-                if((oldThrottlePos = throttlePos)) {
-                    tas = sizeof(strictAccelFacts)/sizeof(strictAccelFacts[0]);
-                    tidx = (abs(throttlePos)-1) * tas / 100;
-                    accelDelay = strictAccelDelays[currSpeedF / 10] * strictAccelFacts[tidx] / 100;
-                    if(throttlePos < 0 && accelDelay < 13) accelDelay = 13;
-                    accelStep = throttlePos > 0 ? 1 : strictdecelSteps[tidx];
-                } else {
-                    accelDelay = doCoast ? ((esp_random() % 30) + 60) : 0;
-                }
+            accelEng.update(accel_getProfile(movieMode ? ACCEL_MOVIE : ACCEL_LINEAR), 
+                            throttlePos, currSpeedF, doCoast);
 
-            } else {
-              
-                if((oldThrottlePos = throttlePos)) {
-                    tas = sizeof(accelDelays)/sizeof(accelDelays[0]);
-                    tidx = (abs(throttlePos)-1) * tas / 100;
-                    accelDelay = accelDelays[tidx];
-                    accelStep = throttlePos > 0 ? accelSteps[tidx] : decelSteps[tidx];
-                } else {
-                    accelDelay = doCoast ? ((esp_random() % 30) + 55)  : 0;
-                }
-
-            }
-
-            if(tidx < tas - 1 || throttlePos >= 0 || currSpeedF) {
+            if(accelEng.bucket() < ACCEL_BUCKETS - 1 || throttlePos >= 0 || currSpeedF) {
                 etmr = false;
             } else if(!etmr) {
                 etmr = true;
@@ -1730,7 +1648,7 @@ void main_loop()
             }
             
             if(!lockThrottle) {
-                if(millis() - lastSpeedUpd > accelDelay) {
+                if(accelEng.due(millis())) {
                     int sbf = currSpeedF;
                     int sb  = sbf / 10;
                     if(throttlePos > 0) {
@@ -1741,7 +1659,7 @@ void main_loop()
                                 play_throttleup();
                             }
                         }
-                        currSpeedF += accelStep;
+                        currSpeedF += accelEng.step();
                         if(currSpeedF >= 880) {
                             currSpeedF = 880;
                             keepCounting = false;
@@ -1758,12 +1676,12 @@ void main_loop()
                             }
                         }
                     } else if(throttlePos < 0) {
-                        currSpeedF -= accelStep;
+                        currSpeedF -= accelEng.step();
                         if(currSpeedF < 0) currSpeedF = 0;
                         keepCounting = false;
                     } else if(doCoast) {
                         if(currSpeedF > 0) {
-                            currSpeedF -= max(0, (int)(esp_random() % coastCurve[currSpeedF/10][0]) - coastCurve[currSpeedF/10][1]);
+                            currSpeedF -= accelEng.coastStep(currSpeedF);
                             if(currSpeedF < 0) currSpeedF = 0;
                         }
                     }
@@ -1775,7 +1693,7 @@ void main_loop()
                                 play_click();
                             }
                         }
-                        lastSpeedUpd = millis();                
+                        accelEng.stepped(millis());
                         remdisplay.setSpeed(currSpeedF);
                         remdisplay.show();
                     }
@@ -1785,12 +1703,12 @@ void main_loop()
             // Network-latency-depending display sync is nice'n'all but latency
             // measurement is dead as soon as audio comes into play. (1-2 vs 10-13).
             #ifdef REMOTE_DBG
-            if(bttfnCurrLatency > 10) {
-                Serial.printf("latency %d\n", bttfnCurrLatency);
+            if(bttfnc_latency() > 10) {
+                Serial.printf("latency %d\n", bttfnc_latency());
             }
             #endif
         }
-        if(!FPBUnitIsOn && !calibMode && !offDisplayTimer) {
+        if(!FPBUnitIsOn && !calibMode && !sched_armed(&offDisplayTmr)) {
             if(displayGPSMode) {
                 if(tcdCurrSpeed != currSpeedOldGPS) {
                     remdisplay.on();
@@ -1799,8 +1717,7 @@ void main_loop()
                     currSpeedOldGPS = tcdCurrSpeed;
                 }
             } else {
-                offDisplayTimer = true;
-                offDisplayNow = millis() - 1001;
+                sched_start(&offDisplayTmr, 0);
             }
         }
     }
@@ -1816,13 +1733,13 @@ void main_loop()
                 triggerTTonThrottle = 0;
                 tcdIsInP0Old = tcdIsInP0;
                 tcdClickNow = 0;
-                tcdInP0now = now;
+                sched_start(&tcdP0Tmr, 10*1000);
                 remSpdAtP0Start = currSpeedF / 10;
                 #ifdef REMOTE_DBG
                 Serial.printf("Switching to P0\n");
                 #endif
             } else {
-                tcdInP0now = now;
+                sched_start(&tcdP0Tmr, 10*1000);
             }
             if(FPBUnitIsOn) {
                 if(tcdSpeedP0 > remSpdAtP0Start) {  // yes, ">"
@@ -1854,7 +1771,7 @@ void main_loop()
         } else if(FPBUnitIsOn) {
             // Fake .1s
             if(tcdSpeedP0 >= remSpdAtP0Start) {   // yes, ">="
-                if(!tcdIsInP0stalled && (now - tcdSpdChgNow > accelDelays[4])) {
+                if(!tcdIsInP0stalled && (now - tcdSpdChgNow > ACCEL_FAST_DELAY)) {
                     tcdSpdChgNow = now;
                     tcdSpdFake100++;
                     if(tcdSpdFake100 > 9) tcdSpdFake100 = 1;
@@ -1866,14 +1783,6 @@ void main_loop()
                 }
             }
         }
-        if(now - tcdInP0now > 10*1000) {
-            #ifdef REMOTE_DBG
-            Serial.printf("Ending P0: delay %ums (limit 10000)\n", now - tcdInP0now);
-            #endif
-            tcdIsInP0 = 0;
-            doForceDispUpd = true;
-            triggerTTonThrottle = 0;
-        }
     } else if(tcdIsInP0Old) {
         tcdSpeedP0Old = 2000;
         tcdIsInP0Old = 0;
@@ -1890,15 +1799,8 @@ void main_loop()
         remdisplay.show();
     }
 
-    if(justBootedNow && (millis() - justBootedNow > 10*1000)) {
-        justBootedNow = 0;
-    }
-
-    if(!FPBUnitIsOn && offDisplayTimer && (millis() - offDisplayNow > 1000)) {
-        offDisplayTimer = false;
-        remdisplay.off();
-        currSpeedOldGPS = -2;   // force GPS speed display update
-    }
+    // Music folder being processed: Report progress
+    showMPProgress(now);
 
     // Execute remote commands
     // No commands in calibMode, during a TT (or P0), and when acceleration is running
@@ -1940,14 +1842,14 @@ void main_loop()
             } else if(!extTT && !TTP0end && (now - TTstart < P0duration)) {
 
                 if(!TTFlag && !triggerP1NoLead && currSpeedF > triggerP1) {
-                    play_file("/travelstart.mp3", PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL, TT_SOUND_FACT);
+                    play_file("/travelstart.mp3", PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL|PA_CACHE, TT_SOUND_FACT);
                     TTFlag = true;
                 }
 
             } else {
 
                 if(triggerP1NoLead) {
-                    play_file("/travelstart2.mp3", PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL, TT_SOUND_FACT);
+                    play_file("/travelstart2.mp3", PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL|PA_CACHE, TT_SOUND_FACT);
                 }
 
                 TTP0 = IntP0running = false;
@@ -2097,20 +1999,14 @@ void main_loop()
     now = millis();
 
     // This serves as our KEEP_ALIVE
-    if((now - lastCommandSent > 10*1000) || triggerRefill) {
+    if(!sched_armed(&keepAliveTmr) || triggerRefill) {
         bttfn_remote_send_combined(powerState, brakeState, currSpeed);
     }
 
     // If network is interrupted, return to stand-alone
-    if(useBTTFN) {
-        if( !bttfnDataNotEnabled &&
-            ((lastBTTFNpacket && (now - lastBTTFNpacket > 30*1000)) ||
-             (!BTTFNBootTO && !lastBTTFNpacket && (now - powerupMillis > 60*1000))) ) {
-            lastBTTFNpacket = 0;
-            BTTFNBootTO = true;
-            tcdCurrSpeed = -1;
-            // P0 expires automatically
-        }
+    if(useBTTFN && bttfnc_lost(now, powerupMillis)) {
+        tcdCurrSpeed = -1;
+        // P0 expires automatically
     }
 
     // Poll RotEnv for volume. Don't in calibmode, P0 or during acceleration
@@ -2119,32 +2015,15 @@ void main_loop()
         int oldVol = curSoftVol;
         curSoftVol = rotEncVol->updateVolume(curSoftVol, false);
         if(oldVol != curSoftVol) {
-            volchgnow = milliNonZero();
+            sched_start(&volSaveTmr, SAVE_VOL_DELAY);
             storeCurVolume();
             if(!FPBUnitIsOn && !TTrunning) {
-                play_file("/volchg.mp3", PA_INTRMUS|PA_ALLOWSD, 1.0f);
+                play_file("/volchg.mp3", PA_INTRMUS|PA_ALLOWSD|PA_CACHE, 1.0f);
             }
         }
     }
     #endif
 
-    if(!tcdIsInP0 && !throttlePos && !keepCounting && !TTrunning && !calibMode) {
-        // Save on-the-fly settings 8/3 seconds after last change
-        now = millis();
-        if(brichgnow && (now - brichgnow > 8000)) {
-            brichgnow = 0;
-            saveBrightness();
-        }
-        if(volchgnow && (now - volchgnow > 8000)) {
-            volchgnow = 0;
-            saveCurVolume();
-        }
-        if(vischgnow && (now - vischgnow > 3000)) {
-            vischgnow = 0;
-            saveVis();
-        }
-    }
-
     if(bootFlag) {
         bootFlag = false;
         if(sendBootStatus) {
@@ -2152,24 +2031,103 @@ void main_loop()
             sendBootStatus = false;
         }
     }
+
+    #ifdef REMOTE_HAVEMQTT
+    if(useMQTT) {
+        publishTelemetry(now);
+    }
+    #endif
+}
+
+/*
+ * Give up the CPU until the next timer or acceleration step is
+ * due, but no longer than MAIN_IDLE_MAX (LP_IDLE_MAX in low-power
+ * mode), since buttons, throttle, WiFi and network still need to 
+ * be polled. Audio has its own task.
+ * Not while something time-critical (TT, P0, calibration) runs.
+ */
+#define MAIN_IDLE_MAX 10    // ms
+
+void main_idle()
+{
+    unsigned long now = millis(), when, wait = lp_idleMax(MAIN_IDLE_MAX);
+
+    if(TTrunning || tcdIsInP0 || calibMode || triggerTTonThrottle || i2cbus_pending())
+        return;
+
+    if(FPBUnitIsOn && accelEng.nextDeadline(when)) {
+        if((long)(when - now) <= 0) return;
+        if(when - now < wait) wait = when - now;
+    }
+    if(sched_nextDeadline(when)) {
+        if((long)(when - now) <= 0) return;
+        if(when - now < wait) wait = when - now;
+    }
+
+    lp_idle(wait);
 }
 
 void flushDelayedSave()
 {
-    if(brichgnow) {
-        brichgnow = 0;
+    if(sched_armed(&briSaveTmr)) {
+        sched_cancel(&briSaveTmr);
         saveBrightness();
     }
-    if(volchgnow) {
-        volchgnow = 0;
+    if(sched_armed(&volSaveTmr)) {
+        sched_cancel(&volSaveTmr);
         saveCurVolume();
     }
-    if(vischgnow) {
-        vischgnow = 0;
+    if(sched_armed(&visSaveTmr)) {
+        sched_cancel(&visSaveTmr);
         saveVis();
     }
 }
 
+// Don't save while busy; try again later
+static bool deferSave(schedTimer *t)
+{
+    if(tcdIsInP0 || throttlePos || keepCounting || TTrunning || calibMode) {
+        sched_start(t, SAVE_RETRY);
+        return true;
+    }
+    return false;
+}
+
+static void briSave(void *arg)
+{
+    if(!deferSave(&briSaveTmr)) saveBrightness();
+}
+
+static void volSave(void *arg)
+{
+    if(!deferSave(&volSaveTmr)) saveCurVolume();
+}
+
+static void visSave(void *arg)
+{
+    if(!deferSave(&visSaveTmr)) saveVis();
+}
+
+static void offDisplay(void *arg)
+{
+    if(!FPBUnitIsOn) {
+        remdisplay.off();
+        currSpeedOldGPS = -2;   // force GPS speed display update
+    }
+}
+
+static void tcdP0Expired(void *arg)
+{
+    if(tcdIsInP0) {
+        #ifdef REMOTE_DBG
+        Serial.printf("Ending P0: no update for 10000ms\n");
+        #endif
+        tcdIsInP0 = 0;
+        doForceDispUpd = true;
+        triggerTTonThrottle = 0;
+    }
+}
+
 static void chgVolume(int d)
 {
     int nv = curSoftVol;
@@ -2179,7 +2137,7 @@ static void chgVolume(int d)
         
     curSoftVol = nv;
 
-    volchgnow = millisNonZero();
+    sched_start(&volSaveTmr, SAVE_VOL_DELAY);
     storeCurVolume();
 }
 
@@ -2211,7 +2169,7 @@ static void changeBrightness(int d)
     else if(b > 15) b = 15;
     
     remdisplay.setBrightness(b);
-    brichgnow = millisNonZero();
+    sched_start(&briSaveTmr, SAVE_BRI_DELAY);
     storeBrightness();
 }
 
@@ -2258,7 +2216,7 @@ void updateVisMode()
 
 static void triggerSaveVis()
 {
-    vischgnow = millisNonZero();
+    sched_start(&visSaveTmr, SAVE_VIS_DELAY);
     storeVis();
     updateConfigPortalVisValues();
 }
@@ -2408,7 +2366,7 @@ static void timeTravel(bool networkTriggered, uint16_t P0Dur, uint16_t P1Dur)
         } else {
 
             // P0Dur is zero, play sound here (as P0 is practically jumped over)
-            play_file("/travelstart2.mp3", PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL, TT_SOUND_FACT);
+            play_file("/travelstart2.mp3", PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL|PA_CACHE, TT_SOUND_FACT);
             
         }
         
@@ -2464,6 +2422,116 @@ void showNumber(int num)
     doForceDispUpd = true;
 }
 
+// Number of files left to rename is shown every 2 seconds 
+// while the display is otherwise unused, and published via MQTT.
+static void showMPProgress(unsigned long now)
+{
+    int left = mp_renameProgress();
+
+    if(left < 0 && mpRenLeft < 0)
+        return;
+
+    if(left >= 0 && (now - mpRenNow < 2000))
+        return;
+
+    if(left >= 0 && !FPBUnitIsOn && !calibMode && !battWarn) {
+        showNumber(left);
+        remdisplay.on();
+        sched_start(&offDisplayTmr, OFF_DISP_DELAY);
+    }
+
+    #ifdef REMOTE_HAVEMQTT
+    {
+        char buf[32];
+        int len;
+        if(left >= 0) {
+            len = sprintf(buf, "MP_PROCESSING_%d", left);
+        } else {
+            len = sprintf(buf, "MP_PROCESSING_DONE");
+        }
+        mqttPublish("bttf/remote/status", buf, len);
+    }
+    #endif
+
+    mpRenLeft = left;
+    mpRenNow = now;
+}
+
+#ifdef REMOTE_HAVEMQTT
+static void publishPowerStats()
+{
+    static const char *stateNames[] = { "OFF", "PENDING", "ON" };
+    lpStats st;
+    char buf[64];
+    int len;
+
+    lp_getStats(st);
+    len = sprintf(buf, "LOWPOWER_%s_IDLE_%u_CURRENT_%u", stateNames[st.state],
+              st.fakeOffMs ? (unsigned int)((uint64_t)st.sleepMs * 100 / st.fakeOffMs) : 0,
+              st.estCurrent);
+    mqttPublish("bttf/remote/status", buf, len);
+}
+
+static bool haPublish(const char *topic, const char *pl, unsigned int len)
+{
+    return mqttPublish(topic, pl, len, false, true);
+}
+
+static void publishTelemetry(unsigned long now)
+{
+    haTelemetry t;
+    bttfnStats st;
+    bool connected = mqttState();
+
+    // Only collect the values if anything is to be published
+    if(!mqttha_due(connected, now))
+        return;
+
+    t.speed = currSpeed;
+    t.power = powerState;
+    t.brake = brakeState;
+    t.throttle = throttlePos;
+    t.soc = t.tte = -1;
+    t.voltage = -1.0f;
+    #ifdef HAVE_PM
+    if(havePwrMon && usePwrMon) {
+        if(pwrMon._haveSOC)  t.soc = pwrMon._soc;
+        if(pwrMon._haveTTE)  t.tte = pwrMon._tte;
+        if(pwrMon._haveVolt) t.voltage = pwrMon._voltage;
+    }
+    #endif
+    t.link = bttfnc_connected();
+    bttfnc_getStats(st);
+    t.rtt = st.srtt;
+    if(audioMute) {
+        t.audio = HA_AUDIO_MUTE;
+    } else if(mpActive) {
+        t.audio = HA_AUDIO_MUSIC;
+    } else {
+        t.audio = checkAudioDone() ? HA_AUDIO_IDLE : HA_AUDIO_PLAYING;
+    }
+    t.heap = ESP.getFreeHeap();
+
+    mqttha_loop(t, connected, now);
+}
+
+static void publishNetStats()
+{
+    bttfnStats st;
+    char buf[256];
+    int len;
+
+    bttfnc_getStats(st);
+    len = sprintf(buf, "BTTFN_SRTT_%lu_RTTVAR_%lu_RTO_%lu_POLL_%lu_RESP_%u_TO_%u_HIST", 
+              st.srtt, st.rttvar, st.rto, st.pollInt, 
+              (unsigned int)st.responses, (unsigned int)st.timeouts);
+    for(int i = 0; i < BTTFN_RTT_BUCKETS; i++) {
+        len += sprintf(buf + len, "_%u", (unsigned int)st.rttHist[i]);
+    }
+    mqttPublish("bttf/remote/status", buf, len);
+}
+#endif
+
 static void showUpd()
 {
     if(showUpdAvail && updateAvailable()) {
@@ -2635,7 +2703,7 @@ static void execute_remote_command()
                 // nada
             } else if(command <= 19) {
                 curSoftVol = command;
-                volchgnow = millisNonZero();
+                sched_start(&volSaveTmr, SAVE_VOL_DELAY);
                 storeCurVolume();
                 #ifdef HAVE_VOL_ROTENC
                 re_vol_reset();
@@ -2648,7 +2716,7 @@ static void execute_remote_command()
 
             command -= 400;                           // 7400-7415: Set brightness
             remdisplay.setBrightness(command);
-            brichgnow = millisNonZero();
+            sched_start(&briSaveTmr, SAVE_BRI_DELAY);
             storeBrightness();
 
         } else if(command >= 501 && command <= 519) {
@@ -2741,6 +2809,12 @@ static void execute_remote_command()
                 if(!FPBUnitIsOn) return;
                 if(haveMusic) mp_prev(mpActive);
                 break;
+            case 18:
+                publishPowerStats();
+                break;
+            case 19:
+                publishNetStats();
+                break;
             // Internal commands
             case 900:
                 if((millis() - brakeWarningNow < 2000) && !cancelBrakeWarning) {
@@ -2966,34 +3040,29 @@ void prepareReboot()
     delay(100);
 }
 
+// Returns true if folder needs processing. This is done in
+// the background; see mp_renameProgress().
 bool switchMusicFolder(uint8_t nmf, bool isSetup)
 {
-    bool waitShown = false;
+    bool needsProc = false;
 
     if(nmf > 9) return false;
 
     if((musFolderNum != nmf) || isSetup) {
 
-        remBusy = true;
-        blockScan = true;
-        
         if(!isSetup) {
-            musFolderNum = nmf;
-            // Initializing the MP can take a while;
-            // need to stop all audio before calling
-            // mp_init()
             if(haveMusic && mpActive) {
                 mp_stop();
             }
-            stopAudio();
+            // Audio task must have closed its files before
+            // we go poking around in the folder
+            if(!stopAudio()) return false;
+            musFolderNum = nmf;
         }
         if(haveSD) {
             if(mp_checkForFolder(musFolderNum) == -1) {
-                flushDelayedSave();
-                showWaitSequence();
-                waitShown = true;
+                needsProc = true;
                 play_file("/renaming.mp3", PA_INTRMUS|PA_ALLOWSD);
-                waitAudioDone(true);
             }
         }
         if(!isSetup) {
@@ -3001,15 +3070,9 @@ bool switchMusicFolder(uint8_t nmf, bool isSetup)
             updateConfigPortalMFValues();
         }
         mp_init(isSetup);
-        if(waitShown) {
-            endWaitSequence();
-        }
-
-        blockScan = false;
-        remBusy = false;
     }
 
-    return waitShown;
+    return needsProc;
 }
 
 void waitAudioDone(bool withBTTFN)
@@ -3231,7 +3294,7 @@ static void mqtt_send_button_on(int i)
     if(!MQTTbuttonOnLen[i] || !FPBUnitIsOn)
         return;
 
-    mqttPublish(settings.mqttbt[i], settings.mqttbo[i], MQTTbuttonOnLen[i]);
+    mqttPublish(settings.mqttbt[i], settings.mqttbo[i], MQTTbuttonOnLen[i], true);
 }
 
 static void mqtt_send_button_off(int i)
@@ -3239,7 +3302,7 @@ static void mqtt_send_button_off(int i)
     if(!MQTTbuttonOffLen[i] || !FPBUnitIsOn)
         return;
 
-    mqttPublish(settings.mqttbt[i], settings.mqttbf[i], MQTTbuttonOffLen[i]);
+    mqttPublish(settings.mqttbt[i], settings.mqttbf[i], MQTTbuttonOffLen[i], true);
 }
 #endif
 
@@ -3258,6 +3321,7 @@ static void re_vol_reset()
  */
 static void myloop(bool withBTTFN)
 {
+    i2cbus_loop();
     wifi_loop();
     audio_loop();
     if(withBTTFN) bttfn_loop_quick();
@@ -3288,20 +3352,6 @@ unsigned long millisNonZero()
  * Basic Telematics Transmission Framework (BTTFN)
  */
 
-static bool check_packet(uint8_t *buf)
-{
-    // Basic validity check
-    if(memcmp(buf, BTTFUDPHD, 4))
-        return false;
-
-    uint8_t a = 0;
-    for(int i = 4; i < BTTF_PACKET_SIZE - 1; i++) {
-        a += buf[i] ^ 0x55;
-    }
-
-    return (buf[BTTF_PACKET_SIZE - 1] == a);
-}
-
 void addCmdQueue(uint32_t command)
 {
     if(!command) return;
@@ -3315,22 +3365,13 @@ void addCmdQueue(uint32_t command)
     }
 }
 
-static void bttfn_eval_response(uint8_t *buf, bool checkCaps)
+static void bttfn_status(bttfnPacket &p)
 {
-    if(checkCaps && (buf[5] & 0x40)) {
-        bttfnReqStatus &= ~0x40;     // Do no longer poll capabilities
-        if(buf[31] & 0x01) {
-            bttfnReqStatus &= ~0x02; // Do no longer poll speed, comes over multicast
-        }
-        if(buf[31] & 0x10) {
-            TCDSupportsNOTData = true;
-            TCDSupportsSSID = !!(buf[31] & 0x40);
-        }
-    }
+    uint8_t flags = p.get<BTTFN_F_REQ>();
     
-    if(buf[5] & 0x10) {
-        remoteAllowed = !!(buf[26] & 0x04);
-        tcdIsBusy     = !!(buf[26] & 0x10);
+    if(flags & 0x10) {
+        remoteAllowed = !!(p.get<BTTFN_F_STATUS>() & 0x04);
+        tcdIsBusy     = !!(p.get<BTTFN_F_STATUS>() & 0x10);
         if(!remoteAllowed) {
             tcdIsInP0 = 0;
         }
@@ -3339,69 +3380,33 @@ static void bttfn_eval_response(uint8_t *buf, bool checkCaps)
         tcdIsInP0 = 0;
     }
 
-    if(buf[5] & 0x02) {
-        tcdCurrSpeed = (int16_t)(buf[18] | (buf[19] << 8));
+    if(flags & 0x02) {
+        tcdCurrSpeed = (int16_t)p.get<BTTFN_F_SPEED>();
         if(tcdCurrSpeed > 88) tcdCurrSpeed = 88;
         //tcdSpdIsRotEnc = !!(buf[26] & 0x80); 
         //tcdSpdIsRemote = !!(buf[26] & 0x20);
     }
-
-    if(!bttfnHaveTCDSSID && !checkCaps && TCDSupportsSSID) {
-        bttfnHaveTCDSSID = 1;
-        memcpy((void *)TCDSSID, (void *)&buf[41], 6);
-        TCDSSID[6] = buf[18];
-        TCDpwMarker = buf[19] & 0x01;
-    }
 }
 
-static void handle_tcd_notification(uint8_t *buf)
+static void bttfn_notify(bttfnPacket &p)
 {
-    uint32_t seqCnt;
-
     // Note: This might be called while we are in a
     // wait-delay-loop. Best to just set flags here
     // that are evaluated synchronously (=later).
     // Do not stuff that messes with display, input,
     // etc.
 
-    if(buf[5] & BTTFN_NOT_DATA) {
-        if(TCDSupportsNOTData) {
-            bttfnDataNotEnabled = true;
-            bttfnLastNotData = millis();
-            seqCnt = GET32(buf, 27);
-            if(bttfnSessionID && (bttfnSessionID != seqCnt)) {
-                bttfnTCDDataSeqCnt = 1;
-                bttfnHaveTCDSSID = 0;
-            }
-            bttfnSessionID = seqCnt;
-            seqCnt = GET32(buf, 6);
-            if(seqCnt > bttfnTCDDataSeqCnt || seqCnt == 1) {
-                #ifdef REMOTE_DBG_NET
-                Serial.println("Valid NOT_DATA packet received");
-                #endif
-                bttfn_eval_response(buf, false);
-            } else {
-                #ifdef REMOTE_DBG_NET
-                Serial.printf("Out-of-sequence NOT_DATA packet received %d %d\n", seqCnt, bttfnTCDDataSeqCnt);
-                #endif
-            }
-            bttfnTCDDataSeqCnt = seqCnt;
-        }
-        return;
-    }
-
-    switch(buf[5]) {
+    switch(p.get<BTTFN_F_REQ>()) {
     case BTTFN_NOT_SPD:       // TCD fw >= 10/26/2024 (MC)
-        seqCnt = GET32(buf, 12);
-        if(seqCnt > bttfnTCDSeqCnt || seqCnt == 1) {
-            int t = buf[8] | (buf[9] << 8);
-            tcdCurrSpeed = buf[6] | (buf[7] << 8);
+        {
+            int t = p.get<BTTFN_F_NP1>();
+            tcdCurrSpeed = p.get<BTTFN_F_NP0>();
             if(tcdCurrSpeed > 88) tcdCurrSpeed = 88;
             switch(t) {
             case BTTFN_SSRC_P0:
                 tcdSpeedP0 = (uint16_t)tcdCurrSpeed;
                 tcdIsInP0 = (FPBUnitIsOn && remoteAllowed && !TTP1 && !TTP2 && !remBusy) ? 1 : 0;
-                tcdIsInP0stalled = buf[10] | (buf[11] << 8);  // TCD 3.9+
+                tcdIsInP0stalled = p.get<BTTFN_F_NP2>();  // TCD 3.9+
                 break;
             default:
                 tcdIsInP0 = 0;
@@ -3409,12 +3414,7 @@ static void handle_tcd_notification(uint8_t *buf)
             #ifdef REMOTE_DBG_NET
             Serial.printf("TCD sent NOT_SPD: %d src %d (IsP0:%d)\n", tcdCurrSpeed, t, tcdIsInP0);
             #endif
-        } else {
-            #ifdef REMOTE_DBG_NET
-            Serial.printf("Out-of-sequence packet received from TCD %d %d\n", seqCnt, bttfnTCDSeqCnt);
-            #endif
         }
-        bttfnTCDSeqCnt = seqCnt;
         break;
     case BTTFN_NOT_PREPARE:
         // Prepare for TT. Comes at some undefined point,
@@ -3430,8 +3430,8 @@ static void handle_tcd_notification(uint8_t *buf)
             networkTimeTravel = true;
             networkReentry = false;
             networkAbort = false;
-            networkLead = buf[6] | (buf[7] << 8);
-            networkP1   = buf[8] | (buf[9] << 8);
+            networkLead = p.get<BTTFN_F_NP0>();
+            networkP1   = p.get<BTTFN_F_NP1>();
         }
         break;
     case BTTFN_NOT_REENTRY:
@@ -3451,7 +3451,7 @@ static void handle_tcd_notification(uint8_t *buf)
         break;
     case BTTFN_NOT_REM_CMD:
         if(!remBusy) {
-            addCmdQueue(GET32(buf, 6));
+            addCmdQueue(p.get<BTTFN_F_ID>());
         }
         break;
     case BTTFN_NOT_WAKEUP:
@@ -3461,244 +3461,35 @@ static void handle_tcd_notification(uint8_t *buf)
         break;
     case BTTFN_NOT_INFO:
         {
-            uint16_t tcdi1 = buf[6] | (buf[7] << 8);
-            uint16_t tcdi2 = buf[8] | (buf[9] << 8);
+            uint16_t tcdi1 = p.get<BTTFN_F_NP0>();
+            uint16_t tcdi2 = p.get<BTTFN_F_NP1>();
             if(!(remoteAllowed = !(tcdi1 & BTTFN_TCDI1_NOREM))) {
                 tcdIsInP0 = 0;
             }
             tcdIsBusy = !!(tcdi2 & BTTFN_TCDI2_BUSY);
         }
         break;
-    case BTTFN_NOT_REM_SPD:     // TCD fw < 10/26/2024 (non-MC)
-        seqCnt = GET32(buf, 12);
-        if(seqCnt > bttfnTCDSeqCnt || seqCnt == 1) {
-            tcdSpeedP0 = buf[6] | (buf[7] << 8);
-            if(remoteAllowed && !remBusy) {
-                tcdIsInP0  = buf[8] | (buf[9] << 8);
-            } else {
-                tcdIsInP0 = 0;
-            }
-            #ifdef REMOTE_DBG_NET
-            Serial.printf("TCD sent REM_SPD: %d %d\n", tcdIsInP0, tcdSpeedP0);
-            #endif
+    case BTTFN_NOT_REM_SPD:   // TCD fw < 10/26/2024 (non-MC)
+        tcdSpeedP0 = p.get<BTTFN_F_NP0>();
+        if(remoteAllowed && !remBusy) {
+            tcdIsInP0  = p.get<BTTFN_F_NP1>();
         } else {
-            #ifdef REMOTE_DBG_NET
-            Serial.printf("Out-of-sequence packet received from TCD %d %d\n", seqCnt, bttfnTCDSeqCnt);
-            #endif
+            tcdIsInP0 = 0;
         }
-        bttfnTCDSeqCnt = seqCnt;
+        #ifdef REMOTE_DBG_NET
+        Serial.printf("TCD sent REM_SPD: %d %d\n", tcdIsInP0, tcdSpeedP0);
+        #endif
         break;
     }
 }
 
-// Check for pending MC packet and parse it
-static bool bttfn_checkmc()
-{
-    int psize = remMcUDP->parsePacket();
-
-    if(!psize) {
-        return false;
-    }
-
-    // This returns true as long as a packet was received
-    // regardless whether it was for us or not. Point is
-    // to clear the receive buffer.
-    
-    remMcUDP->read(BTTFMCBuf, BTTF_PACKET_SIZE);
-
-    if(haveTCDIP) {
-        if(bttfnTcdIP != remMcUDP->remoteIP())
-            return true;
-    } else {
-        // Do not use tcdHostNameHash; let DISCOVER do its work
-        // and wait for a result.
-        return true;
-    }
-
-    if(!check_packet(BTTFMCBuf))
-        return true;
-
-    if((BTTFMCBuf[4] & 0x4f) == (BTTFN_VERSION | 0x40)) {
-
-        // A notification from the TCD
-        handle_tcd_notification(BTTFMCBuf);
-    
-    }
-
-    return true;
-}
-
-// Check for pending packet and parse it
-static void BTTFNCheckPacket()
-{
-    unsigned long mymillis = millisNonZero();
-    
-    int psize = remUDP->parsePacket();
-    if(!psize) {
-        if(!bttfnDataNotEnabled && BTTFNPacketDue) {
-            if((mymillis - BTTFNTSRQAge) > BTTFN_RESPONSE_TO) {
-                // Packet timed out
-                BTTFNPacketDue = false;
-                // Immediately trigger new request for
-                // the first 10 timeouts, after that
-                // the new request is only triggered
-                // in greater intervals via bttfn_loop().
-                if(haveTCDIP && BTTFNfailCount < 10) {
-                    BTTFNfailCount++;
-                    BTTFNUpdateNow = 0;
-                }
-                bttfnCurrLatency = 0;
-            }
-        }
-        return;
-    }
-    
-    remUDP->read(BTTFUDPBuf, BTTF_PACKET_SIZE);
-
-    if(!check_packet(BTTFUDPBuf))
-        return;
-
-    if((BTTFUDPBuf[4] & 0x4f) == (BTTFN_VERSION | 0x40)) {
-
-        // A notification from the TCD
-        handle_tcd_notification(BTTFUDPBuf);
-        
-    } else {
-
-        // (Possibly) a response packet
-    
-        if(GET32(BTTFUDPBuf, 6) != BTTFUDPID)
-            return;
-    
-        // Response marker missing or wrong version, bail
-        if((BTTFUDPBuf[4] & 0x8f) != (BTTFN_VERSION | 0x80))
-            return;
-
-        bttfnCurrLatency = (mymillis - bttfnPacketSentNow) / 2;
-
-        BTTFNfailCount = 0;
-    
-        // If it's our expected packet, no other is due for now
-        BTTFNPacketDue = false;
-
-        if(BTTFUDPBuf[5] & 0x80) {
-            if(!haveTCDIP) {
-                bttfnTcdIP = remUDP->remoteIP();
-                haveTCDIP = true;
-                #ifdef REMOTE_DBG_NET
-                Serial.printf("Discovered TCD IP %d.%d.%d.%d\n", bttfnTcdIP[0], bttfnTcdIP[1], bttfnTcdIP[2], bttfnTcdIP[3]);
-                #endif
-            } else {
-                #ifdef REMOTE_DBG_NET
-                Serial.println("Internal error - received unexpected DISCOVER response");
-                #endif
-            }
-        }
-
-        lastBTTFNpacket = mymillis;
-
-        bttfn_eval_response(BTTFUDPBuf, true);
-    }
-}
-
-static void BTTFNPreparePacketTemplate()
-{
-    memset(BTTFUDPTBuf, 0, BTTF_PACKET_SIZE);
-
-    // ID
-    memcpy(BTTFUDPTBuf, BTTFUDPHD, 4);
-
-    // Tell the TCD about our hostname
-    // 13 bytes total. If hostname is longer, last in buf is '.'
-    memcpy(BTTFUDPTBuf + 10, settings.hostName, 13);
-    if(strlen(settings.hostName) > 13) BTTFUDPTBuf[10+12] = '.';
-
-    BTTFUDPTBuf[10+13] = BTTFN_TYPE_REMOTE;
-
-    // Version, MC-marker, ND-marker
-    BTTFUDPTBuf[4] = BTTFN_VERSION | BTTFN_SUP_MC | BTTFN_SUP_ND;
-    
-    // Remote-ID
-    SET32(BTTFUDPTBuf, 35, myRemID);                 
-}
-
-static void BTTFNPreparePacket()
-{
-    memcpy(BTTFUDPBuf, BTTFUDPTBuf, BTTF_PACKET_SIZE);          
-}
-
-static void BTTFNDispatch()
-{
-    uint8_t a = 0;
-    for(int i = 4; i < BTTF_PACKET_SIZE - 1; i++) {
-        a += BTTFUDPBuf[i] ^ 0x55;
-    }
-    BTTFUDPBuf[BTTF_PACKET_SIZE - 1] = a;
-
-    if(haveTCDIP) {
-        remUDP->beginPacket(bttfnTcdIP, BTTF_DEFAULT_LOCAL_PORT);
-    } else {
-        remUDP->beginPacket(bttfnMcIP, BTTF_DEFAULT_LOCAL_PORT + 1);
-    }
-    remUDP->write(BTTFUDPBuf, BTTF_PACKET_SIZE);
-    remUDP->endPacket();
-}
-
-// Send a new data request
-static bool BTTFNSendRequest()
-{
-    BTTFNPacketDue = false;
-
-    BTTFNUpdateNow = millisNonZero();
-
-    if(WiFi.status() != WL_CONNECTED) {
-        BTTFNWiFiUp = false;
-        return false;
-    }
-
-    BTTFNWiFiUp = true;
-
-    // Send new packet
-    BTTFNPreparePacket();
-    
-    // Serial
-    BTTFUDPID = (uint32_t)millis();
-    SET32(BTTFUDPBuf, 6, BTTFUDPID);
-
-    // Request flags
-    BTTFUDPBuf[5] = bttfnReqStatus;        
-
-    if(!haveTCDIP) {
-        BTTFUDPBuf[5] |= 0x80;
-        SET32(BTTFUDPBuf, 31, tcdHostNameHash);
-    }
-
-    BTTFNDispatch();
-
-    BTTFNTSRQAge = bttfnPacketSentNow = millis();
-    
-    BTTFNPacketDue = true;
-    
-    return true;
-}
-
 static bool bttfn_connected()
 {
     if(!useBTTFN)
         return false;
 
-    if(!haveTCDIP)
-        return false;
-
-    if(WiFi.status() != WL_CONNECTED)
-        return false;
-
-    if(!lastBTTFNpacket)
-        return false;
-
-    return true;
+    return bttfnc_connected();
 }
-
 static bool bttfn_trigger_tt(bool probe)
 {
     // BBTFN-wide TT can be triggered even
@@ -3724,14 +3515,7 @@ static bool bttfn_trigger_tt(bool probe)
     if(TTrunning || tcdIsBusy)
         return false;
 
-    BTTFNPreparePacket();
-
-    // Trigger BTTFN-wide TT
-    BTTFUDPBuf[5] = 0x80;
-
-    BTTFNDispatch();
-
-    return true;
+    return bttfnc_send_tt();
 }
 
 static bool bttfn_send_command(uint8_t cmd, uint8_t p1, uint8_t p2)
@@ -3739,30 +3523,13 @@ static bool bttfn_send_command(uint8_t cmd, uint8_t p1, uint8_t p2)
     if(!remoteAllowed && (cmd <= BTTFN_REM_MAX_COMMAND))
         return false;
     
-    if(!bttfn_connected())
+    if(!useBTTFN || !bttfnc_send_command(cmd, p1, p2))
         return false;
 
-    BTTFNPreparePacket();
-    
-    //BTTFUDPBuf[5] = 0x00;   // already 0
-
-    if(cmd <= BTTFN_REM_MAX_COMMAND) {
-        SET32(BTTFUDPBuf, 6, bttfnSeqCnt[cmd]);
-        bttfnSeqCnt[cmd]++;
-        if(!bttfnSeqCnt[cmd]) bttfnSeqCnt[cmd]++;
-    }
-
-    BTTFUDPBuf[25] = cmd;
-    BTTFUDPBuf[26] = p1;
-    BTTFUDPBuf[27] = p2;
-
-    BTTFNDispatch();
-
-    lastCommandSent = millis();
+    sched_start(&keepAliveTmr, 10*1000);
 
     return true;
 }
-
 // Remote does not need to send KEEP_ALIVE, it
 // sends combined updates on a regular basis.
 /*
@@ -3798,31 +3565,24 @@ static void bttfn_remote_send_combined(bool powerstate, bool brakestate, uint8_t
 
 static void bttfn_setup()
 {
+    IPAddress tcdIP;
+
     useBTTFN = false;
 
     // string empty? Disable BTTFN.
     if(!settings.tcdIP[0])
         return;
 
-    haveTCDIP = isIp(settings.tcdIP);
-    
-    if(!haveTCDIP) {
-        tcdHostNameHash = 0;
-        unsigned char *s = (unsigned char *)settings.tcdIP;
-        for ( ; *s; ++s) tcdHostNameHash = 37 * tcdHostNameHash + tolower(*s);
-    } else {
-        bttfnTcdIP.fromString(settings.tcdIP);
+    if(isIp(settings.tcdIP)) {
+        tcdIP.fromString(settings.tcdIP);
     }
     
-    remUDP = &bttfUDP;
-    remUDP->begin(BTTF_DEFAULT_LOCAL_PORT);
+    bttfnUDP.begin();
 
-    remMcUDP = &bttfMcUDP;
-    remMcUDP->beginMulticast(bttfnMcIP, BTTF_DEFAULT_LOCAL_PORT + 2);
-
-    BTTFNPreparePacketTemplate();
+    bttfnc_setup(&bttfnUDP, (uint32_t)tcdIP, settings.tcdIP, 
+                 settings.hostName, myRemID,
+                 bttfn_status, bttfn_notify);
     
-    BTTFNfailCount = 0;
     useBTTFN = true;
 }
 
@@ -3831,40 +3591,7 @@ void bttfn_loop()
     if(!useBTTFN)
         return;
 
-    int t = 100;
-
-    while(bttfn_checkmc() && t--) {}
-
-    unsigned long now = millisNonZero();
-        
-    BTTFNCheckPacket();
-    
-    if(bttfnDataNotEnabled) {
-        // Remote does not need to send KEEP_ALIVE, it
-        // sends combined updates on a regular basis.
-        if(now - bttfnLastNotData > BTTFN_DATA_TO) {
-            // Return to polling if no NOT_DATA for too long
-            bttfnDataNotEnabled = false;
-            bttfnTCDDataSeqCnt = 1;
-            // Re-do DISCOVER, TCD might have got new IP address
-            if(tcdHostNameHash) haveTCDIP = false;
-            // Don't assume TCD comes back with same SSID/pwMarker
-            bttfnHaveTCDSSID = 0;
-            // Avoid immediate return to stand-alone in main_loop()
-            lastBTTFNpacket = now;
-            #ifdef REMOTE_DBG_NET
-            Serial.println("NOT_DATA timeout, returning to polling");
-            #endif
-        }
-    } else if(!BTTFNPacketDue) {
-        // If WiFi status changed, trigger immediately
-        if(!BTTFNWiFiUp && (WiFi.status() == WL_CONNECTED)) {
-            BTTFNUpdateNow = 0;
-        }
-        if((!BTTFNUpdateNow) || (millis() - BTTFNUpdateNow > bttfnRemPollInt)) {
-            BTTFNSendRequest();
-        }
-    }
+    bttfnc_loop();
 }
 
 static void bttfn_loop_quick()
@@ -3872,7 +3599,5 @@ static void bttfn_loop_quick()
     if(!useBTTFN)
         return;
     
-    int t = 100;
-
-    while(bttfn_checkmc() && t--) {}
+    bttfnc_loop_quick();
 }
@@ -65,6 +65,7 @@ void main_boot();
 void main_boot2();
 void main_setup();
 void main_loop();
+void main_idle();
 
 void flushDelayedSave();
 void increaseVolume();
@@ -154,8 +155,4 @@ extern bool     keepCounting;
 
 extern bool blockScan;
 
-extern int     bttfnHaveTCDSSID;
-extern char    TCDSSID[];
-extern uint8_t TCDpwMarker;
-
 #endif
@@ -940,6 +940,7 @@ static void read_mqtt_settings()
             wd |= CopyTextParm(json["mqttServer"], settings.mqttServer, sizeof(settings.mqttServer));
             wd |= CopyCheckValidNumParm(json["mqttV"], settings.mqttVers, sizeof(settings.mqttVers), 0, 1, 0);
             wd |= CopyTextParm(json["mqttUser"], settings.mqttUser, sizeof(settings.mqttUser));
+            wd |= CopyCheckValidNumParm(json["mqttTele"], settings.mqttTele, sizeof(settings.mqttTele), 0, 3600, DEF_MQTT_TELE);
             wd |= handleMQTTButton(json["mqttb1t"], settings.mqttbt[0], sizeof(settings.mqttbt[0]));
             wd |= handleMQTTButton(json["mqttb1o"], settings.mqttbo[0], sizeof(settings.mqttbo[0]));
             wd |= handleMQTTButton(json["mqttb1f"], settings.mqttbf[0], sizeof(settings.mqttbf[0]));
@@ -991,6 +992,7 @@ void write_mqtt_settings()
     json["mqttServer"] = (const char *)settings.mqttServer;
     json["mqttV"] = (const char *)settings.mqttVers;
     json["mqttUser"] = (const char *)settings.mqttUser;
+    json["mqttTele"] = (const char *)settings.mqttTele;
     json["mqttb1t"] = (const char *)settings.mqttbt[0];
     json["mqttb1o"] = (const char *)settings.mqttbo[0];
     json["mqttb1f"] = (const char *)settings.mqttbf[0];
@@ -180,6 +180,8 @@ void   freeUploadFileNames();
 #define DEF_BAT_TYPE        0     // 0=3.7/4.2V
 #define DEF_BAT_CAP         2000  // battery capacity per cell
 
+#define DEF_MQTT_TELE       10    // HA telemetry: Min. seconds between updates; 0 = off
+
 #ifdef HAVE_CRSF
 #define DEF_OPMODE          0     // 0: Prop mode (legacy)  1: CRSF/ELRS mode
 #define DEF_CRSFWM          1     // 0: Remain in AP mode   1: Connect to WiFi in CRSF/ELRS mode
@@ -260,6 +262,7 @@ struct Settings {
     char mqttVers[2]        = "0"; // 0 = 3.1.1, 1 = 5.0
     char mqttServer[80]     = "";  // ip or domain [:port]  
     char mqttUser[128]      = "";  // user[:pass] (UTF8)
+    char mqttTele[6]        = MS(DEF_MQTT_TELE);
     char mqttbt[8][128]     = { 0 };  // buttons topics (UTF8)
     char mqttbo[8][64]      = { 0 };  // buttons on message (UTF8)
     char mqttbf[8][64]      = { 0 };  // buttons off message (UTF8)
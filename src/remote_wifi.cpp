@@ -68,8 +68,11 @@
 #include "remote_settings.h"
 #include "remote_wifi.h"
 #include "remote_main.h"
+#include "lowpower.h"
+#include "bttfn.h"
 #ifdef REMOTE_HAVEMQTT
 #include "mqtt.h"
+#include "mqttcmd.h"
 #endif
 
 #define STRLEN(x) (sizeof(x)-1)
@@ -259,6 +262,7 @@ static const char *wmBuildOORST(const char *dest, int op);
 static const char *wmBuildOOTT(const char *dest, int op);
 static const char *wmBuildRESAT(const char *dest, int op);
 static const char *wmBuildHaveSD(const char *dest, int op);
+static const char *wmBuildLPStats(const char *dest, int op);
 
 #ifdef REMOTE_HAVEMQTT
 static const char *wmBuildMQTTprot(const char *dest, int op);
@@ -284,6 +288,7 @@ static const char badWiFi[]  = "<br><i>Operating in AP mode not recommended</i>"
 
 static const char bannerGen[] = "%s%s%s%s</div>";
 static const char haveNoSD[] = "<i>No SD card present</i>";
+static const char lpStatsMsg[] = "While fake-off: %u%% idle, est. %umA (ESP32 only)";
 
 #ifdef REMOTE_HAVEMQTT
 static const char mqttStatus[] = "%s%s%s%s%s (%d)</div>";
@@ -386,6 +391,7 @@ WiFiManagerParameter custom_b5mtoo("b5mto", "Maintained: Play audio on ON only",
 WiFiManagerParameter custom_b6mtoo("b6mto", "Maintained: Play audio on ON only", settings.bPb6MtO, "class='mt5 ml20'", WFM_LABEL_AFTER|WFM_IS_CHKBOX);
 WiFiManagerParameter custom_b7mtoo("b7mto", "Maintained: Play audio on ON only", settings.bPb7MtO, "class='mt5 ml20'", WFM_LABEL_AFTER|WFM_IS_CHKBOX);
 
+WiFiManagerParameter custom_lpStats(wmBuildLPStats);
 WiFiManagerParameter custom_uPL("uPL", "Use Futaba power LED", settings.usePwrLED, "class='mt5'", WFM_LABEL_AFTER|WFM_IS_CHKBOX|WFM_SECTS);
 WiFiManagerParameter custom_PLD("PLD", "Power LED on fake power", settings.pwrLEDonFP, "class='mt5 ml20' title='If unchecked, LED follows real power'", WFM_LABEL_AFTER|WFM_IS_CHKBOX);
 WiFiManagerParameter custom_uLM("uMt", "Use Futaba battery level meter", settings.useLvlMtr, "", WFM_LABEL_AFTER|WFM_IS_CHKBOX);
@@ -404,6 +410,7 @@ WiFiManagerParameter custom_useMQTT("uMQTT", "Home Assistant support (MQTT)", se
 WiFiManagerParameter custom_state(wmBuildMQTTstate);
 WiFiManagerParameter custom_mqttServer("ha_server", "Broker IP[:port] or domain[:port]", settings.mqttServer, 79, "pattern='[a-zA-Z0-9\\.:\\-]+' placeholder='Example: 192.168.1.5'");
 WiFiManagerParameter custom_mqttVers(wmBuildMQTTprot);
+WiFiManagerParameter custom_mqttTele("ha_tele", "Telemetry interval<br><span>(1-3600[seconds]; 0=off)</span>", settings.mqttTele, 4, "type='number' min='0' max='3600' autocomplete='off'");
 WiFiManagerParameter custom_mqttUser("ha_usr", "User[:Password]", settings.mqttUser, 63, "placeholder='Example: ronald:mySecret' class='mb15'", WFM_LABEL_BEFORE|WFM_FOOT);
 WiFiManagerParameter custom_mqtttm(wmBuildMQTTTM);
 #endif // HAVEMQTT
@@ -498,6 +505,7 @@ static bool   wifiReactAPOnFP = true;
 
 // WiFi power management in STA mode
 bool          wifiIsOff = false;
+static bool   wifiPowerSave = false;
 unsigned long wifiOnNow = 0;
 unsigned long wifiOffDelay     = 0;   // default: never
 unsigned long origWiFiOffDelay = 0;
@@ -534,8 +542,6 @@ static unsigned long mqttPingInt = MQTT_SHORT_INT;
 static uint16_t      mqttPingsExpired = 0;
 #endif
 
-static unsigned int wmLenBuf = 0;
-
 static void wifiConnect(bool APonly = false, bool deferConfigPortal = false);
 static void wifiOff(bool force);
 
@@ -573,7 +579,6 @@ static void strcpyutf8(char *dst, const char *src, unsigned int len);
 static void handleMQTTTopMsg(int idx);
 static void mqttPing();
 static bool mqttReconnect(bool force = false);
-static void mqttLooper();
 static void mqttCallback(char *topic, byte *payload, unsigned int length);
 static void mqttSubscribe();
 #endif
@@ -664,7 +669,8 @@ void wifi_setup()
       &custom_b7mt,
       &custom_b7mtoo,
   
-      &custom_uPL,          // 4
+      &custom_lpStats,      // 5
+      &custom_uPL,
       &custom_PLD,
       &custom_uLM,
       &custom_PMD,
@@ -679,6 +685,7 @@ void wifi_setup()
       &custom_state,
       &custom_mqttServer,
       &custom_mqttVers,
+      &custom_mqttTele,
       &custom_mqttUser,
 
       &custom_mqtttm,
@@ -947,7 +954,6 @@ void wifi_setup()
         mqttClient.setClientID(settings.hostName);
 
         mqttClient.setCallback(mqttCallback);
-        mqttClient.setLooper(mqttLooper);
 
         if(settings.mqttUser[0] != 0) {
             if((t = strchr(settings.mqttUser, ':'))) {
@@ -1219,6 +1225,7 @@ void wifi_loop()
             evalCB(settings.useMQTT, &custom_useMQTT);
             strcpytrim(settings.mqttServer, custom_mqttServer.getValue());
             strcpyutf8(settings.mqttUser, custom_mqttUser.getValue(), sizeof(settings.mqttUser));
+            mystrcpy(settings.mqttTele, &custom_mqttTele);
 
             write_mqtt_settings();
             #endif
@@ -1342,8 +1349,8 @@ static void wifiConnect(bool APonly, bool deferConfigPortal)
         // with "true". When this is enabled, received WiFi data can be
         // delayed for as long as the DTIM period.
         // Disable modem sleep, don't want delays accessing the CP or
-        // with BTTFN/MQTT.
-        WiFi.setSleep(false);
+        // with BTTFN/MQTT. Unless we are in low-power mode.
+        WiFi.setSleep(wifiPowerSave);
 
         // Set transmit power to max; we might be connecting as STA after
         // a previous period in AP mode.
@@ -1403,6 +1410,17 @@ static void wifiConnect(bool APonly, bool deferConfigPortal)
     }
 }
 
+// Modem sleep in low-power mode. In AP mode, the
+// modem can't sleep anyway.
+void wifi_setPowerSave(bool enable)
+{
+    wifiPowerSave = enable;
+    
+    if(!wifiInAPMode && !wifiIsOff && (WiFi.status() == WL_CONNECTED)) {
+        WiFi.setSleep(enable);
+    }
+}
+
 void wifiOff(bool force)
 {
     if(!force) {
@@ -1940,6 +1958,7 @@ static void updateConfigPortalValues()
     setCBVal(&custom_useMQTT, settings.useMQTT);
     custom_mqttServer.setValue(settings.mqttServer);
     custom_mqttUser.setValue(settings.mqttUser);
+    custom_mqttTele.setValue(settings.mqttTele);
     // user topics/messages done on-the-fly
     #endif
 
@@ -1984,11 +2003,6 @@ static const char *buildBanner(const char *msg, const char *col, int op)
 {   // "%s%s%s%s</div>";
     unsigned int l = STRLEN(bannerStart) + 7 + STRLEN(bannerMid) + strlen(msg) + 6 + 4;
 
-    if(op == WM_CP_LEN) {
-        wmLenBuf = l;
-        return (const char *)&wmLenBuf;
-    }
-    
     char *str = (char *)malloc(l);
     sprintf(str, bannerGen, bannerStart, col, bannerMid, msg);        
 
@@ -2046,11 +2060,6 @@ static const char *wmBuildSelect(const char *dest, int op, const char **src, int
 
     unsigned int l = calcSelectMenu(src, count, setting, indent);
 
-    if(op == WM_CP_LEN) {
-        wmLenBuf = l;
-        return (const char *)&wmLenBuf;
-    }
-    
     char *str = (char *)malloc(l);
 
     buildSelectMenu(str, src, count, setting, indent);
@@ -2094,11 +2103,6 @@ static const char *wmBuildRadioButtons(const char *dest, int op, const char **th
 
     unsigned int l = lengthRadioButtons(theHTML, cnt, setting);
 
-    if(op == WM_CP_LEN) {
-        wmLenBuf = l;
-        return (const char *)&wmLenBuf;
-    }
-    
     char *str = (char *)malloc(l);
 
     buildRadioButtons(str, theHTML, cnt, setting);
@@ -2115,11 +2119,6 @@ static const char *wmBuildTCDAPList(const char *dest, int op)
 
     unsigned int l = STRLEN(tcdList) + 4 + (bttfnHaveTCDSSID ? strlen(TCDSSID) : 0);
 
-    if(op == WM_CP_LEN) {
-        wmLenBuf = l;
-        return (const char *)&wmLenBuf;
-    }
-
     char *str = (char *)malloc(l);
 
     sprintf(str, tcdList, bttfnHaveTCDSSID ? TCDSSID : "");
@@ -2140,11 +2139,6 @@ static const char *wmBuildTCDSSID(const char *dest, int op)
     unsigned int l = STRLEN(tcdSSIDp) + (TCDpwMarker ? STRLEN(tcdAPPW2) : STRLEN(tcdAPPW1)) + 4;
     l += strlen(TCDSSID);
 
-    if(op == WM_CP_LEN) {
-        wmLenBuf = l;
-        return (const char *)&wmLenBuf;
-    }
-
     char *str = (char *)malloc(l);
 
     sprintf(str, tcdSSIDp, TCDSSID, TCDpwMarker ? tcdAPPW2 : tcdAPPW1);
@@ -2169,10 +2163,6 @@ static const char *wmBuildBestApChnl(const char *dest, int op)
 
     if(wm.getBestAPChannel(mychan, qual)) {
         unsigned int l = STRLEN(bestAP) - (5*2) + STRLEN(bannerStart) + 6 + STRLEN(bannerMid) + 4 + STRLEN(badWiFi) + 1 + 8;
-        if(op == WM_CP_LEN) {
-            wmLenBuf = l;
-            return (const char *)&wmLenBuf;
-        }
         char *str = (char *)malloc(l);
         sprintf(str, bestAP, bannerStart, qual < 0 ? col_r : (qual > 0 ? col_g : col_gr), bannerMid, mychan, qual < 0 ? badWiFi : "");
         return str;
@@ -2199,6 +2189,25 @@ static const char *wmBuildHaveSD(const char *dest, int op)
     return buildBanner(haveNoSD, col_r, op);
 }
 
+static const char *wmBuildLPStats(const char *dest, int op)
+{
+    lpStats st;
+    char msg[STRLEN(lpStatsMsg) + 8];
+    
+    if(op == WM_CP_DESTROY) {
+        if(dest) free((void *)dest);
+        return NULL;
+    }
+
+    lp_getStats(st);
+    if(!st.fakeOffMs)
+        return NULL;
+
+    sprintf(msg, lpStatsMsg, (unsigned int)((uint64_t)st.sleepMs * 100 / st.fakeOffMs), st.estCurrent);
+    
+    return buildBanner(msg, col_gr, op);
+}
+
 static const char *wmBuildOORST(const char *dest, int op)
 {
     return wmBuildRadioButtons(dest, op, oorstCustHTMLSrc, 2, settings.oorst);
@@ -2304,11 +2313,6 @@ static const char *wmBuildMQTTstate(const char *dest, int op)
     // "%s%s%s%s%s (%d)</div>"
     unsigned int l = STRLEN(mqttStatus) - (6*2) + STRLEN(bannerStart) + strlen(cls) + 20 + STRLEN(bannerMid) + strlen(msg) + 6;
 
-    if(op == WM_CP_LEN) {
-        wmLenBuf = l;
-        return (const char *)&wmLenBuf;
-    }
-
     char *str = (char *)malloc(l);
 
     sprintf(str, mqttStatus, bannerStart, cls, ";margin-bottom:10px", bannerMid, msg, s);
@@ -2341,10 +2345,6 @@ static const char *wmBuildMQTTTM(const char *dest, int op)
         l += strlen(settings.mqttbf[i]);
     }
 
-    if(op == WM_CP_LEN) {
-        wmLenBuf = l;
-        return (const char *)&wmLenBuf;
-    }
 
     char *str = (char *)malloc(l);
 
@@ -2880,12 +2880,7 @@ static void handleMQTTTopMsg(int idx)
     }
 }
 
-static void mqttLooper()
-{
-    audio_loop();
-}
-
-static uint16_t a2i(char *p)
+static uint16_t a2i(const char *p)
 {
     unsigned int t = 0;
     t += (*p++ - '0') * 1000;
@@ -2898,38 +2893,10 @@ static uint16_t a2i(char *p)
 
 static void mqttCallback(char *topic, byte *payload, unsigned int length)
 {
-    int i = 0, j, ml = (length <= 255) ? length : 255;
-    char tempBuf[256];
-    static const char *cmdList[] = {
-      "PLAYKEY_",         // 0  PLAYKEY_1..PLAYKEY_9, PLAYKEY_1L..PLAYKEY9L
-      "STOPKEY",          // 1
-      "AUTOTHROTTLE_ON",  // 2
-      "AUTOTHROTTLE_OFF", // 3
-      "COASTING_ON",      // 4
-      "COASTING_OFF",     // 5
-      "MOVIEACCEL_ON",    // 6
-      "MOVIEACCEL_OFF",   // 7
-      "DISPTCDSPD_ON",    // 8
-      "DISPTCDSPD_OFF",   // 9
-      "MP_SHUFFLE_ON",    // 10 
-      "MP_SHUFFLE_OFF",   // 11
-      "MP_PLAY",          // 12
-      "MP_STOP",          // 13
-      "MP_NEXT",          // 14
-      "MP_PREV",          // 15
-      "MP_FOLDER_",       // 16  MP_FOLDER_0..MP_FOLDER_9
-      "INJECT_",          // 17
-      NULL
-    };
-    static const char *cmdList2[] = {
-      "PREPARE",          // 0
-      "TIMETRAVEL",       // 1
-      "REENTRY",          // 2
-      "ABORT_TT",         // 3
-      "ALARM",            // 4
-      "WAKEUP",           // 5
-      NULL
-    };
+    const char *pl = (const char *)payload;
+    const char *t;
+    unsigned int j;
+    int i;
 
     // Note: This might be called while we are in a
     // wait-delay-loop. Best to just set flags here
@@ -2937,27 +2904,19 @@ static void mqttCallback(char *topic, byte *payload, unsigned int length)
     // Do not stuff that messes with display, input,
     // etc.
 
-    if(!length) return;
-
-    memcpy(tempBuf, (const char *)payload, ml);
-    tempBuf[ml] = 0;
-    for(j = 0; j < ml; j++) {
-        if(tempBuf[j] >= 'a' && tempBuf[j] <= 'z') tempBuf[j] &= ~0x20;
+    // Payload ends at first 0, if any
+    if((t = (const char *)memchr(pl, 0, length))) {
+        length = t - pl;
     }
 
+    if(!length) return;
+
     if(!strcmp(topic, "bttf/tcd/pub")) {
 
         // Commands from TCD
 
-        while(cmdList2[i]) {
-            j = strlen(cmdList2[i]);
-            if((length >= j) && !strncmp((const char *)tempBuf, cmdList2[i], j)) {
-                break;
-            }
-            i++;          
-        }
-
-        if(!cmdList2[i]) return;
+        if((i = mqttcmd_findTCD(pl, length, &j)) < 0) 
+            return;
 
         switch(i) {
         case 0:
@@ -2974,9 +2933,9 @@ static void mqttCallback(char *topic, byte *payload, unsigned int length)
                 networkTimeTravel = true;
                 networkReentry = false;
                 networkAbort = false;
-                if(strlen(tempBuf) == 20) {
-                    networkLead = a2i(&tempBuf[11]);
-                    networkP1 = a2i(&tempBuf[16]);
+                if(length == 20) {
+                    networkLead = a2i(&pl[11]);
+                    networkP1 = a2i(&pl[16]);
                 } else {
                     networkLead = ETTO_LEAD;
                     networkP1 = 6600;
@@ -3009,21 +2968,14 @@ static void mqttCallback(char *topic, byte *payload, unsigned int length)
 
         // User commands
 
-        while(cmdList[i]) {
-            j = strlen(cmdList[i]);
-            if((length >= j) && !strncmp((const char *)tempBuf, cmdList[i], j)) {
-                break;
-            }
-            i++;          
-        }
-
-        if(!cmdList[i]) return;
+        if((i = mqttcmd_findUser(pl, length, &j)) < 0) 
+            return;
 
         switch(i) {
         case 0:
-            if(strlen(tempBuf) > j && tempBuf[j] >= '1' && tempBuf[j] <= '9') {
-                bool l = (strlen(tempBuf) > j+1 && tempBuf[j+1] == 'L');
-                addCmdQueue(500 + (uint32_t)(tempBuf[j] - '0') + (l ? 10 : 0));
+            if(length > j && pl[j] >= '1' && pl[j] <= '9') {
+                bool l = (length > j+1 && (pl[j+1] & ~0x20) == 'L');
+                addCmdQueue(500 + (uint32_t)(pl[j] - '0') + (l ? 10 : 0));
             }
             break;
         case 10:
@@ -3031,13 +2983,13 @@ static void mqttCallback(char *topic, byte *payload, unsigned int length)
             addCmdQueue((i == 10) ? 555 : 222);
             break;
         case 16:
-            if(strlen(tempBuf) > j && tempBuf[j] >= '0' && tempBuf[j] <= '9') {
-                addCmdQueue(50 + (uint32_t)(tempBuf[j] - '0'));
+            if(length > j && pl[j] >= '0' && pl[j] <= '9') {
+                addCmdQueue(50 + (uint32_t)(pl[j] - '0'));
             }
             break;
         case 17:
-            if(strlen(tempBuf) > j) {
-                addCmdQueue(atoi(tempBuf+j) | 0x80000000);
+            if(length > j) {
+                addCmdQueue(mqttcmd_atoi(pl + j, length - j) | 0x80000000);
             }
             break;
         default:
@@ -3156,10 +3108,11 @@ bool mqttState()
     return (useMQTT && mqttClient.connected());
 }
 
-void mqttPublish(const char *topic, const char *pl, unsigned int len)
+bool mqttPublish(const char *topic, const char *pl, unsigned int len, bool qos1, bool retained)
 {
     if(useMQTT) {
-        mqttClient.publish(topic, (uint8_t *)pl, len, false);
+        return mqttClient.publish(topic, (uint8_t *)pl, len, retained, qos1 ? 1 : 0);
     }
+    return false;
 }           
 #endif
@@ -58,6 +58,7 @@
 void wifi_setup();
 void wifi_loop();
 void wifiOn(unsigned long newDelay = 0);
+void wifi_setPowerSave(bool enable);
 bool wifiNeedReConnect(bool& blocks);
 void wifiStartCP();
 bool updateAvailable();
@@ -73,7 +74,8 @@ bool isIp(char *str);
 bool checkIPConfig();
 
 #ifdef REMOTE_HAVEMQTT
-void mqttPublish(const char *topic, const char *pl, unsigned int len);
+bool mqttPublish(const char *topic, const char *pl, unsigned int len, bool qos1 = false, bool retained = false);
+bool mqttState();
 #endif
 
 extern bool wifiSetupDone;
@@ -0,0 +1,140 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Deadline timers
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#include "remote_global.h"
+
+#include <Arduino.h>
+
+#include "schedtmr.h"
+
+static schedTimer   *timers = NULL;
+static unsigned int runGen = 0;
+
+static void insert(schedTimer *t)
+{
+    schedTimer **p = &timers;
+
+    // Timers with same deadline run in the order they were armed
+    while(*p && (long)((*p)->when - t->when) <= 0) {
+        p = &(*p)->next;
+    }
+    t->next = *p;
+    *p = t;
+}
+
+void sched_cancel(schedTimer *t)
+{
+    if(!t->armed)
+        return;
+
+    for(schedTimer **p = &timers; *p; p = &(*p)->next) {
+        if(*p == t) {
+            *p = t->next;
+            break;
+        }
+    }
+    t->next = NULL;
+    t->armed = false;
+}
+
+void sched_start(schedTimer *t, unsigned long delay, unsigned long period)
+{
+    sched_cancel(t);
+    
+    t->when = millis() + delay;
+    t->period = period;
+    t->gen = runGen;
+    t->armed = true;
+    insert(t);
+}
+
+void sched_run()
+{
+    unsigned long now = millis();
+
+    runGen++;
+
+    // Timers armed from a func are inserted behind all
+    // that were due at entry; stop there.
+    while(timers && (long)(now - timers->when) >= 0 && timers->gen != runGen) {
+        schedTimer *t = timers;
+        
+        timers = t->next;
+        t->next = NULL;
+        
+        if(t->period) {
+            do {
+                t->when += t->period;
+            } while((long)(now - t->when) >= 0);
+            insert(t);
+        } else {
+            t->armed = false;
+        }
+
+        // func may re-arm or cancel any timer
+        if(t->func) {
+            t->func(t->arg);
+        }
+    }
+}
+
+bool sched_nextDeadline(unsigned long &when)
+{
+    if(!timers)
+        return false;
+        
+    when = timers->when;
+    return true;
+}
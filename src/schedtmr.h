@@ -0,0 +1,96 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Deadline timers
+ * 
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _REM_SCHEDTMR_H
+#define _REM_SCHEDTMR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef void (*schedFunc)(void *arg);
+
+/*
+ * A timer is armed with a deadline (and, optionally, a period) and
+ * kept in a list sorted by deadline. Due timers are run by sched_run(). 
+ * Timers without a function only mark a deadline; their owner checks 
+ * sched_armed() to find out if it has passed.
+ */
+struct schedTimer {
+    schedTimer(schedFunc f = NULL, void *a = NULL) : func(f), arg(a) {}
+    
+    schedFunc     func;
+    void          *arg;
+    unsigned long when = 0;         // millis
+    unsigned long period = 0;       // 0 = one-shot
+    schedTimer    *next = NULL;
+    unsigned int  gen = 0;          // sched_run() it was armed in
+    bool          armed = false;
+};
+
+// (Re-)arm a timer to expire in delay ms, and then every period ms.
+// Periodic timers keep their phase; missed periods are skipped.
+void sched_start(schedTimer *t, unsigned long delay, unsigned long period = 0);
+void sched_cancel(schedTimer *t);
+
+static inline bool sched_armed(const schedTimer *t) { return t->armed; }
+
+// Run functions of all expired timers; timers (re-)armed
+// meanwhile run next time at the earliest
+void sched_run();
+
+// Earliest deadline of all armed timers; false if none is armed
+bool sched_nextDeadline(unsigned long &when);
+
+#endif
@@ -29,7 +29,9 @@ AudioGeneratorMP3::AudioGeneratorMP3()
   file = NULL;
   output = NULL;
   buff = NULL;
-  nsCountMax = 1152/32;
+  stream = NULL;
+  frame = NULL;
+  synth = NULL;
   madInitted = false;
 }
 
@@ -39,7 +41,9 @@ AudioGeneratorMP3::AudioGeneratorMP3(void *space, int size): preallocateSpace(sp
   file = NULL;
   output = NULL;
   buff = NULL;
-  nsCountMax = 1152/32;
+  stream = NULL;
+  frame = NULL;
+  synth = NULL;
   madInitted = false;
 }
 
@@ -53,7 +57,9 @@ AudioGeneratorMP3::AudioGeneratorMP3(void *buff, int buffSize, void *stream, int
   file = NULL;
   output = NULL;
   buff = NULL;
-  nsCountMax = 1152/32;
+  stream = NULL;
+  frame = NULL;
+  synth = NULL;
   madInitted = false;
 }
 
@@ -89,11 +95,65 @@ bool AudioGeneratorMP3::stop()
   frame = NULL;
   stream = NULL;
 
+  preBuf = NULL;
+  preLen = prePos = skipLen = 0;
+  preFinal = false;
+  capBuf = NULL;
+
   running = false;
   output->stop();
   return file->close();
 }
 
+void AudioGeneratorMP3::SetPreroll(const int16_t *pcm, uint32_t len, bool final)
+{
+  preBuf = pcm;
+  preLen = skipLen = len;
+  prePos = 0;
+  preFinal = final;
+}
+
+bool AudioGeneratorMP3::StartPreroll(AudioOutput *output)
+{
+  this->output = output;
+
+  output->SetBitsPerSample(16);
+  output->SetChannels(2);
+  if (!output->begin()) return false;
+
+  PushPreroll();
+
+  return true;
+}
+
+void AudioGeneratorMP3::SetCapture(int16_t *buf, uint32_t maxLen)
+{
+  capBuf = buf;
+  capLen = 0;
+  capMaxLen = maxLen;
+  capEOF = false;
+}
+
+// Returns true if the preroll has been completely handed to the output
+bool AudioGeneratorMP3::PushPreroll()
+{
+  int16_t blk[2*32];
+
+  while (prePos < preLen) {
+    uint32_t n = preLen - prePos;
+    if (n > 32) n = 32;
+    const int16_t *s = preBuf + prePos;
+    for (uint32_t i = 0; i < n; i++) {
+      blk[i*2] = blk[i*2+1] = s[i];
+    }
+    uint32_t taken = output->ConsumeSamples(blk, n);
+    prePos += taken;
+    if (taken < n) return false;
+  }
+
+  return true;
+}
+
 bool AudioGeneratorMP3::isRunning()
 {
   return running;
@@ -169,43 +229,124 @@ bool AudioGeneratorMP3::DecodeNextFrame()
     ErrorToFlow(); // Always returns CONTINUE
     return false;
   }
-  nsCountMax  = MAD_NSBSAMPLES(&frame->header);
   return true;
 }
 
-bool AudioGeneratorMP3::GetOneSample(int16_t& saL, int16_t& saR)
+// Called by libmad for each synthesized subband slot
+enum mad_flow AudioGeneratorMP3::PCMOutput(void *cbdata, struct mad_header const *header, struct mad_pcm *pcm)
 {
-  // If we're here, we have one decoded frame and sent 0 or more samples out
-  if (samplePtr < synth->pcm.length) {
-    saL = synth->pcm.samples[0][samplePtr];
-    saR = synth->pcm.samples[1][samplePtr];
-    samplePtr++;
-  } else {
-    samplePtr = 0;
-
-    switch ( mad_synth_frame_onens(synth, frame, nsCount++) ) {
-        case MAD_FLOW_BREAK:
-          audioLogger->printf_P(PSTR("msf1ns MAD_FLOW_BREAK\n"));
-        case MAD_FLOW_STOP:
-          return false; // Either way we're done
-        default:
-          break; // Do nothing
+  (void)header;
+  AudioGeneratorMP3 *me = reinterpret_cast<AudioGeneratorMP3 *>(cbdata);
+  int len = pcm->length;
+
+  if (me->pcmLen + len > pcmBufLen) {
+    len = pcmBufLen - me->pcmLen;
+  }
+
+  const int16_t *l = pcm->samples[0];
+  const int16_t *r = pcm->samples[1];
+  int16_t *d = &me->pcmBuf[me->pcmLen * 2];
+  for (int i = 0; i < len; i++) {
+    *d++ = *l++;
+    *d++ = *r++;
+  }
+  me->pcmLen += len;
+
+  return MAD_FLOW_CONTINUE;
+}
+
+bool AudioGeneratorMP3::SynthFrame()
+{
+  // If we're here, we have one decoded frame and sent all samples
+  // of the previous frame out. Synthesize the whole frame in one go.
+  samplePtr = 0;
+  pcmLen = 0;
+
+  switch ( mad_synth_frame(synth, frame, PCMOutput, this) ) {
+      case MAD_FLOW_BREAK:
+        audioLogger->printf_P(PSTR("msf MAD_FLOW_BREAK\n"));
+      case MAD_FLOW_STOP:
+        return false; // Either way we're done
+      default:
+        break; // Do nothing
+  }
+
+  if (synth->pcm.samplerate != lastRate) {
+      output->SetRate(synth->pcm.samplerate);
+      lastRate = synth->pcm.samplerate;
+  }
+  if (synth->pcm.channels != lastChannels) {
+      output->SetChannels(synth->pcm.channels);
+      lastChannels = synth->pcm.channels;
+  }
+
+  // Copy to capture buffer; only 44.1kHz is cached
+  if (capBuf) {
+    if (synth->pcm.samplerate != 44100) {
+      capBuf = NULL;
+      capLen = 0;
+    } else {
+      uint32_t n = capMaxLen - capLen;
+      if (n > (uint32_t)pcmLen) n = pcmLen;
+      const int16_t *s = pcmBuf;
+      int16_t *d = capBuf + capLen;
+      if (synth->pcm.channels == 1) {
+        for (uint32_t i = 0; i < n; i++, s += 2) *d++ = s[0];
+      } else {
+        for (uint32_t i = 0; i < n; i++, s += 2) *d++ = (s[0] + s[1]) >> 1;
+      }
+      capLen += n;
     }
+  }
 
-    if (synth->pcm.samplerate != lastRate) {
-        output->SetRate(synth->pcm.samplerate);
-        lastRate = synth->pcm.samplerate;
+  // Skip what the preroll already played
+  if (skipLen) {
+    if (skipLen >= (uint32_t)pcmLen) {
+      skipLen -= pcmLen;
+      pcmLen = 0;
+    } else {
+      samplePtr = skipLen;
+      skipLen = 0;
     }
-    if (synth->pcm.channels != lastChannels) {
-        output->SetChannels(synth->pcm.channels);
-        lastChannels = synth->pcm.channels;
+  }
+
+  // for IGNORE and CONTINUE, just play what we have now
+  return true;
+}
+
+// Decode and synthesize the next frame
+bool AudioGeneratorMP3::NextFrame()
+{
+retry:
+  if (Input() == MAD_FLOW_STOP) {
+    // If we were capturing, we now have the complete sound
+    if (capBuf) capEOF = true;
+    running = false;
+    return false;
+  }
+
+  if (!DecodeNextFrame()) {
+    if (stream->error == MAD_ERROR_BUFLEN) {
+      // randomly seeking can lead to endless
+      // and unrecoverable "MAD_ERROR_BUFLEN" loop
+      if (++unrecoverable >= 3) {
+        audioLogger->printf_P(PSTR("MP3:ERROR_BUFLEN %d\n"), unrecoverable);
+        unrecoverable = 0;
+        stop();
+        return false;
+      }
+    } else {
+      unrecoverable = 0;
     }
+    goto retry;
+  }
 
-    // for IGNORE and CONTINUE, just play what we have now
-    saL = synth->pcm.samples[0][samplePtr];
-    saR = synth->pcm.samples[1][samplePtr];
-    samplePtr++;
+  if (!SynthFrame()) {
+    audioLogger->printf_P(PSTR("SF failed\n"));
+    running = false;
+    return false;
   }
+
   return true;
 }
 
@@ -214,44 +355,36 @@ bool AudioGeneratorMP3::loop()
 {
   if (!running) goto done; // Nothing to do here!
 
-  // First, try and push in the stored sample.  If we can't, then punt and try later
-  if (!output->ConsumeSample(sL, sR)) goto done; // Can't send, but no error detected
+  // TW: Play the preroll first. As long as the output can't take 
+  // more, decode (and skip) the part of the file the preroll covers.
+  if (prePos < preLen) {
+    if (!PushPreroll()) {
+      if (!preFinal && skipLen && samplePtr >= pcmLen) {
+        NextFrame();
+      }
+      goto done;
+    }
+    if (preFinal) {
+      running = false;
+      goto done;
+    }
+  }
 
-  // Try and stuff the buffer one sample at a time
+  // Stuff the output buffer one frame at a time
   do
   {
-    // Decode next frame if we're beyond the existing generated data
-    if ( (samplePtr >= synth->pcm.length) && (nsCount >= nsCountMax) ) {
-retry:
-      if (Input() == MAD_FLOW_STOP) {
-        return false;
-      }
-
-      if (!DecodeNextFrame()) {
-        if (stream->error == MAD_ERROR_BUFLEN) {
-          // randomly seeking can lead to endless
-          // and unrecoverable "MAD_ERROR_BUFLEN" loop
-          if (++unrecoverable >= 3) {
-            audioLogger->printf_P(PSTR("MP3:ERROR_BUFLEN %d\n"), unrecoverable);
-            unrecoverable = 0;
-            stop();
-            return running;
-          }
-        } else {
-          unrecoverable = 0;
-        }
-        goto retry;
-      }
-      samplePtr = 9999;
-      nsCount = 0;
+    // First, try and push out what is left of the current frame.
+    // If the output can't take it all, then punt and try later
+    if (samplePtr < pcmLen) {
+      samplePtr += output->ConsumeSamples(&pcmBuf[samplePtr * 2], pcmLen - samplePtr);
+      if (samplePtr < pcmLen) goto done; // Can't send, but no error detected
     }
 
-    if (!GetOneSample(sL, sR)) {
-      audioLogger->printf_P(PSTR("G1S failed\n"));
-      running = false;
+    // Decode next frame, we're beyond the existing generated data
+    if (!NextFrame()) {
       goto done;
     }
-  } while (running && output->ConsumeSample(sL, sR));
+  } while (running);
 
 done:
   file->loop();
@@ -266,7 +399,7 @@ bool AudioGeneratorMP3::begin(AudioFileSource *source, AudioOutput *output)
   file = source;
   if (!output) return false;
   this->output = output;
-  if (!file->isOpen()) {
+  if (!file->isOpen() && !preFinal) {
     audioLogger->printf_P(PSTR("MP3 source file not open\n"));
     return false; // Error
   }
@@ -279,16 +412,19 @@ bool AudioGeneratorMP3::begin(AudioFileSource *source, AudioOutput *output)
 
   if (!output->begin()) return false;
 
-  // Where we are in generating one frame's data, set to invalid so we will run loop on first getsample()
-  samplePtr = 9999;
-  nsCount = 9999;
+  // Where we are in generating one frame's data, set to invalid so we will decode on first loop()
+  samplePtr = 0;
+  pcmLen = 0;
   lastRate = 0;
   lastChannels = 0;
   lastReadPos = 0;
   lastBuffLen = 0;
 
-  // loop starts by pushing out samples, clear them here
-  sL = sR = 0;
+  // Complete sound in preroll: No decoder needed
+  if (preFinal) {
+    running = true;
+    return true;
+  }
 
   // Allocate all large memory chunks
   if (preallocateStreamSize + preallocateFrameSize + preallocateSynthSize) {
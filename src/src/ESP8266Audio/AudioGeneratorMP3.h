@@ -40,6 +40,18 @@ class AudioGeneratorMP3 : public AudioGenerator
     virtual bool isRunning() override;
     virtual void desync () override;
 
+    // TW: PCM cache support
+    // Preroll: Mono PCM (44.1kHz) played before the decoder's output.
+    // The decoder skips the samples covered by it. If "final" is set,
+    // the preroll is the complete sound and no file is needed.
+    void SetPreroll(const int16_t *pcm, uint32_t len, bool final);
+    bool StartPreroll(AudioOutput *output);
+    // Capture: The first maxLen samples are copied (mono) into buf.
+    // Results remain valid after stop().
+    void SetCapture(int16_t *buf, uint32_t maxLen);
+    uint32_t GetCaptureLen() { return capLen; }
+    bool CaptureComplete() { return capEOF; }
+
     static constexpr int preAllocSize () { return preAllocBuffSize() + preAllocStreamSize() + preAllocFrameSize() + preAllocSynthSize(); }
     static constexpr int preAllocBuffSize () { return ((buffLen + 7) & ~7); }
     static constexpr int preAllocStreamSize () { return ((sizeof(struct mad_stream) + 7) & ~7); }
@@ -68,15 +80,32 @@ class AudioGeneratorMP3 : public AudioGenerator
     struct mad_stream *stream;
     struct mad_frame *frame;
     struct mad_synth *synth;
+    // TW: Interleaved PCM of one complete synthesized frame,
+    // drained to the output in blocks
+    static constexpr int pcmBufLen = 1152;
+    int16_t pcmBuf[2*pcmBufLen];
     int samplePtr;
-    int nsCount;
-    int nsCountMax;
+    int pcmLen;
+
+    const int16_t *preBuf = nullptr;
+    uint32_t preLen = 0;
+    uint32_t prePos = 0;
+    uint32_t skipLen = 0;
+    bool preFinal = false;
+
+    int16_t *capBuf = nullptr;
+    uint32_t capLen = 0;
+    uint32_t capMaxLen = 0;
+    bool capEOF = false;
 
     // The internal helpers
     enum mad_flow ErrorToFlow();
     enum mad_flow Input();
     bool DecodeNextFrame();
-    bool GetOneSample(int16_t& sL, int16_t& sR);
+    bool NextFrame();
+    bool SynthFrame();
+    bool PushPreroll();
+    static enum mad_flow PCMOutput(void *cbdata, struct mad_header const *header, struct mad_pcm *pcm);
 
   private:
     int unrecoverable = 0;
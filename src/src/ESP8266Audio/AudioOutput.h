@@ -62,16 +62,16 @@ class AudioOutput
     #else
     virtual bool ConsumeSample(int16_t sL, int16_t sR) { (void)sL;(void)sR; return false; }
     #endif
-    /*
-    virtual uint16_t ConsumeSamples(int16_t *samples, uint16_t count)
+    // TW: Block interface; samples are interleaved L/R, count is in
+    // frames. Returns the number of frames accepted.
+    virtual size_t ConsumeSamples(const int16_t *samples, size_t count)
     {
-      for (uint16_t i=0; i<count; i++) {
-        if (!ConsumeSample(samples)) return i;
+      for (size_t i=0; i<count; i++) {
+        if (!ConsumeSample(samples[0], samples[1])) return i;
         samples += 2;
       }
       return count;
     }
-    */
     virtual bool stop() { return false; }
     virtual void flush() { return; }
     virtual bool loop() { return true; }
@@ -51,6 +51,9 @@ AudioOutputI2S::AudioOutputI2S(int port, int output_mode, int dma_buf_count, int
   bclkPin = 26;
   wclkPin = 25;
   doutPin = 22;
+  #ifdef TWESP32
+  stageOut = stageIn = 0;
+  #endif
   SetGain(1.0);
 }
 
@@ -286,21 +289,15 @@ bool AudioOutputI2S::begin(bool txDAC)
 }
 
 #ifdef TWESP32
-size_t AudioOutputI2S::ConsumeSample(int16_t msL, int16_t msR)
+// Convert a sample pair into the 32-bit I2S frame format, gain applied.
+// Gain factors are passed in so that block callers load them only once.
+static inline uint32_t makeFrame(int16_t msL, int16_t msR, bool mono, bool chn1, int16_t gL, int32_t gR)
 {
-    // We don't ever use 8 bit samples or the internal DAC
-
-    //return if we haven't called ::begin yet
-    if(!i2sOn)
-        return false;
-
-    uint32_t s32;
-
-    if(channels == 1) msR = msL;
+    if(chn1) msR = msL;
     #ifndef AUTO_MONO
     else {
       #ifndef FORCE_MONO
-      if(this->mono) {
+      if(mono) {
         int32_t ttl = msL + msR;
         msL = msR = ttl >> 1;
       }
@@ -310,14 +307,114 @@ size_t AudioOutputI2S::ConsumeSample(int16_t msL, int16_t msR)
       msR = msL = msL + msR;
       #endif // FORCE_MONO
     }
+    #else
+    (void)mono;
     #endif // AUTO_MONO
 
-    AmplifyL(msL);
-    s32 = ((uint32_t)AmplifyR(msR)) | (uint16_t)msL;
+    // TW: We NEVER amplify, we only ever attenuate; see AmplifyL/R
+    return ((uint32_t)((msR * gR) & 0xffff0000)) | (uint16_t)((msL * gL) >> 6);
+}
 
+// Hand as much of the staging buffer to the driver as it takes
+// without blocking. Compacts the buffer if it is full and only
+// partially drained.
+void AudioOutputI2S::flushStage()
+{
     size_t i2s_bytes_written;
-    i2s_write((i2s_port_t)portNo, (const char*)&s32, sizeof(uint32_t), &i2s_bytes_written, 0);
-    return i2s_bytes_written;
+
+    if(stageOut >= stageIn)
+        return;
+
+    i2s_write((i2s_port_t)portNo, (const char*)&stageBuf[stageOut], 
+              (stageIn - stageOut) * sizeof(uint32_t), &i2s_bytes_written, 0);
+
+    stageOut += i2s_bytes_written / sizeof(uint32_t);
+
+    if(stageOut >= stageIn) {
+        stageOut = stageIn = 0;
+    } else if(stageIn >= stageLen && stageOut) {
+        memmove(&stageBuf[0], &stageBuf[stageOut], (stageIn - stageOut) * sizeof(uint32_t));
+        stageIn -= stageOut;
+        stageOut = 0;
+    }
+}
+
+size_t AudioOutputI2S::ConsumeSample(int16_t msL, int16_t msR)
+{
+    // We don't ever use 8 bit samples or the internal DAC
+
+    //return if we haven't called ::begin yet
+    if(!i2sOn)
+        return 0;
+
+    if(stageIn >= stageLen) {
+        flushStage();
+        if(stageIn >= stageLen)
+            return 0;
+    }
+
+    stageBuf[stageIn++] = makeFrame(msL, msR, mono, (channels == 1), gainF2P6_L, gainF2P6_R);
+
+    if(stageIn >= stageLen) {
+        flushStage();
+    }
+
+    return sizeof(uint32_t);
+}
+
+size_t AudioOutputI2S::ConsumeSamples(const int16_t *samples, size_t count)
+{
+    size_t done = 0;
+
+    if(!i2sOn)
+        return 0;
+
+    // Gain and channel config are constant for the whole block
+    bool    chn1 = (channels == 1);
+    int16_t gL = gainF2P6_L;
+    int32_t gR = gainF2P6_R;
+
+    // Gain 1.0 (when fed by the mixer): Just pack the samples
+    #ifdef AUTO_MONO
+    bool unity = (gL == (1 << 6) && gR == (1 << 16));
+    #else
+    bool unity = false;
+    #endif
+
+    while(done < count) {
+        if(stageIn >= stageLen) {
+            flushStage();
+            if(stageIn >= stageLen)
+                break;  // DMA buffers full, try again later
+        }
+        size_t n = stageLen - stageIn;
+        if(n > count - done) n = count - done;
+        uint32_t *d = &stageBuf[stageIn];
+        const int16_t *s = samples + (done * 2);
+        if(unity) {
+            for(size_t i = 0; i < n; i++, s += 2) {
+                *d++ = ((uint32_t)(uint16_t)s[chn1 ? 0 : 1] << 16) | (uint16_t)s[0];
+            }
+        } else {
+            for(size_t i = 0; i < n; i++, s += 2) {
+                *d++ = makeFrame(s[0], s[1], mono, chn1, gL, gR);
+            }
+        }
+        stageIn += n;
+        done += n;
+    }
+
+    flushStage();
+
+    return done;
+}
+
+bool AudioOutputI2S::loop()
+{
+    if(i2sOn) {
+        flushStage();
+    }
+    return true;
 }
 #else
 bool AudioOutputI2S::ConsumeSample(int16_t sL, int16_t sR)
@@ -384,6 +481,9 @@ bool AudioOutputI2S::stop()
   if (!i2sOn)
     return false;
 
+  #ifdef TWESP32
+    stageOut = stageIn = 0;
+  #endif
   #ifdef ESP32
     i2s_zero_dma_buffer((i2s_port_t)portNo);
     i2s_driver_uninstall((i2s_port_t)portNo); //stop & destroy i2s driver
@@ -42,6 +42,8 @@ class AudioOutputI2S : public AudioOutput
     virtual bool begin() override { return begin(true); }
     #ifdef TWESP32
     virtual size_t ConsumeSample(int16_t sL, int16_t sR) override;
+    virtual size_t ConsumeSamples(const int16_t *samples, size_t count) override;
+    virtual bool loop() override;
     #else
     virtual bool ConsumeSample(int16_t sL, int16_t sR) override;
     #endif
@@ -69,4 +71,15 @@ class AudioOutputI2S : public AudioOutput
     uint8_t bclkPin;
     uint8_t wclkPin;
     uint8_t doutPin;
+
+    #ifdef TWESP32
+    // TW: Staging buffer; samples are converted (gain, mono) into this
+    // buffer and handed to the driver in blocks instead of one i2s_write()
+    // per sample. Size is in frames (one frame = L+R = 32 bits).
+    static constexpr int stageLen = 128;
+    uint32_t stageBuf[stageLen];
+    uint16_t stageOut;
+    uint16_t stageIn;
+    void flushStage();
+    #endif
 };
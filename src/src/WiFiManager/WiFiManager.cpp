@@ -1260,85 +1260,18 @@ bool WiFiManager::waitEvent(uint32_t mask, unsigned long timeout)
  *
  ****************************************************************************/
 
-unsigned int WiFiManager::calcTitleLen(const char *title)
-{
-    unsigned int s = STRLEN(HTTP_ROOT_MAIN) - (2*3);
-    s += strlen(_title);
-    if(!title) {
-        if(APPortalActive) {
-            s += strlen(_apName);
-        } else {
-            s += strlen(WiFi.getHostname()) + 3 + 15;
-        }
-    } else {
-        s += strlen(title);
-    }
-
-    return s;
-}
-
-// Calc size of header
-unsigned int WiFiManager::getHTTPHeadLength(const char *title, uint32_t incFlags)
-{
-    int bufSize = STRLEN(HTTP_HEAD_START) - 3;  // -3 token
-
-    #ifdef INDIV_TITLES
-    bufSize += strlen(title ? title : _title);
-    #else
-    bufSize += strlen(_title);
-    #endif
-    bufSize += STRLEN(HTTP_SCRIPT) + STRLEN(HTTP_STYLE) + STRLEN(HTTP_STYLE_END);
-    if(incFlags & incSTA) {
-        bufSize += STRLEN(HTTP_STYLE_STA);
-    }
-    if(incFlags & incGFXMSG) {
-        bufSize += STRLEN(HTTP_STYLE_MSG);
-    }
-    if(incFlags & incC80) {
-        bufSize += STRLEN(HTTP_STYLE_C80);
-        if(incFlags & incUPLF) {
-            bufSize += STRLEN(HTTP_STYLE_UPLF);
-        } else {
-            bufSize += STRLEN(HTTP_STYLE_UPLN);
-        }
-    }
-    if(incFlags & incQI) {
-        bufSize += STRLEN(HTTP_SCRIPT_QI) + STRLEN(HTTP_STYLE_QI);
-    }
-    if(incFlags & incSET) {
-        bufSize += STRLEN(HTTP_STYLE_SET);
-    }
-    if(incFlags & incUPL) {
-        bufSize += STRLEN(HTTP_SCRIPT_UPL) + STRLEN(HTTP_STYLE_UPL);
-    }
-
-    if(_customHeadElement) {
-        bufSize += strlen(_customHeadElement);
-    }
-    bufSize += STRLEN(HTTP_HEAD_END);
-
-    bufSize += calcTitleLen(title);
-
-    return bufSize;
-}
-
 // Construct header
-void WiFiManager::getHTTPHeadNew(String& page, const char *title, uint32_t incFlags)
+void WiFiManager::getHTTPHeadNew(WMPageOut& page, const char *title, uint32_t incFlags)
 {
-    String temp;
-    #ifdef INDIV_TITLES
-    temp.reserve(STRLEN(HTTP_HEAD_START) + strlen(title ? title : _title));
-    #else
-    temp.reserve(STRLEN(HTTP_HEAD_START) + strlen(_title));
-    #endif
+    const char *vals[2];
+    String hn;
 
-    temp = FPSTR(HTTP_HEAD_START);
     #ifdef INDIV_TITLES
-    temp.replace(FPSTR(T_v), title ? title : _title);
+    vals[0] = title ? title : _title;
     #else
-    temp.replace(FPSTR(T_v), _title);
+    vals[0] = _title;
     #endif
-    page += temp;
+    page.addTmpl(HTTP_HEAD_START, "v", vals);
 
     page += FPSTR(HTTP_SCRIPT);
     if(incFlags & incUPL) {
@@ -1378,144 +1311,87 @@ void WiFiManager::getHTTPHeadNew(String& page, const char *title, uint32_t incFl
     }
     page += FPSTR(HTTP_HEAD_END);
 
-    String str;
-    str.reserve(calcTitleLen(title) + 8);
-    str = FPSTR(HTTP_ROOT_MAIN);
-    str.replace(FPSTR(T_t), _title);
-    if(!title) {
-        str.replace(FPSTR(T_v), APPortalActive ? _apName : (String(WiFi.getHostname()) + " - " + WiFi.localIP().toString()));
+    vals[0] = _title;
+    if(title) {
+        vals[1] = title;
+    } else if(APPortalActive) {
+        vals[1] = _apName;
     } else {
-        str.replace(FPSTR(T_v), title);
+        hn = String(WiFi.getHostname()) + " - " + WiFi.localIP().toString();
+        vals[1] = hn.c_str();
     }
-    page += str;
+    page.addTmpl(HTTP_ROOT_MAIN, "tv", vals);
 }
 
 // WIFI status at bottom of pages
 
-int WiFiManager::reportStatusLen(bool withMac)
+void WiFiManager::reportStatus(WMPageOut& page, bool withMac)
 {
-    int bufSize = 0;
+    char pbssid[STRLEN(HTTP_BSSID_FOOT)-2+17+1];
     String SSID = String(_ssid);
+    const char *vals[4];
 
     #ifdef _A10001986_V_DBG
     Serial.printf("reportStatus: _lastconxresult %d\n", _lastconxresult);
     #endif
 
-    bufSize = STRLEN(HTTP_STATUS_HEAD) - 3 + 1; // - token + class for <span>
-    if(SSID != "") {
-        bufSize += htmlEntitiesLen(SSID, true);
-        if(WiFi.status() == WL_CONNECTED) {
-            bufSize += STRLEN(HTTP_STATUS_ON) - (4*3);
-            bufSize += 15;                                              // max len of ip address
-            if(*_bssid)   bufSize += (STRLEN(HTTP_BSSID_FOOT)-2+17+1);  // bssid
-            if(_badBSSID) bufSize += STRLEN(HTTP_STATUS_BADBSSID);
-        } else {
-            bufSize += STRLEN(HTTP_STATUS_OFF) - (3*3);
-            switch(_lastconxresult) {
-            case TWL_DHCP_TIMEOUT:          // dhcp timeout
-                bufSize += (STRLEN(HTTP_STATUS_NODHCP) + STRLEN(HTTP_STATUS_APMODE));
-                break;
-            case WL_NO_SSID_AVAIL:          // ap not found
-                bufSize += (STRLEN(HTTP_STATUS_OFFNOAP) + STRLEN(HTTP_STATUS_APMODE));
-                break;
-            case WL_CONNECT_FAILED:         // connect failed
-            case WL_CONNECTION_LOST:
-                bufSize += (STRLEN(HTTP_STATUS_OFFFAIL) + STRLEN(HTTP_STATUS_APMODE));
-                break;
-            case WL_DISCONNECTED:
-                bufSize += (STRLEN(HTTP_STATUS_DISCONN) + STRLEN(HTTP_STATUS_APMODE));
-                break;
-            default:
-                bufSize += _carMode ? STRLEN(HTTP_STATUS_CARMODE) : STRLEN(HTTP_STATUS_APMODE);
-                break;
-            }
-        }
-    } else {
-        bufSize += STRLEN(HTTP_STATUS_NONE);
-    }
-
-    if(withMac) bufSize += 4 + 18;  // <br>, MAC address
-
-    bufSize += STRLEN(HTTP_STATUS_TAIL);
-
-    #ifdef _A10001986_DBG
-    Serial.printf("WM: reportStatusLen bufSize %d\n", bufSize);
-    #endif
-
-    return bufSize + 8;
-}
-
-void WiFiManager::reportStatus(String& page, unsigned int estSize, bool withMac)
-{
-    char pbssid[STRLEN(HTTP_BSSID_FOOT)-2+17+1];
-    String SSID = String(_ssid);
-    String str;
-    if(estSize) str.reserve(estSize);
-
-    str = FPSTR(HTTP_STATUS_HEAD);
     if(SSID != "") {
+        String ssid = htmlEntities(SSID, true);
         if(WiFi.status() == WL_CONNECTED) {
-            str += FPSTR(HTTP_STATUS_ON);
-            if(_badBSSID) {
-                str.replace(FPSTR(T_V), FPSTR(HTTP_STATUS_BADBSSID));
-                str.replace(FPSTR(T_c), "o");
-            } else {
-                str.replace(FPSTR(T_V), "");
-                str.replace(FPSTR(T_c), "g");
-            }
+            String ip = WiFi.localIP().toString();
+            vals[0] = _badBSSID ? "o" : "g";
+            page.addTmpl(HTTP_STATUS_HEAD, "c", vals);
             memset(pbssid, 0, sizeof(pbssid));
             //if(*_bssid) {
                 snprintf(pbssid, STRLEN(HTTP_BSSID_FOOT)-2+17+1, HTTP_BSSID_FOOT, WiFi.BSSIDstr().c_str());
                 if(strlen(pbssid) <= STRLEN(HTTP_BSSID_FOOT)-2+1) *pbssid = 0;
             //}
-            str.replace(FPSTR(T_I), pbssid);
-            str.replace(FPSTR(T_i), WiFi.localIP().toString());
-            str.replace(FPSTR(T_v), htmlEntities(SSID, true));
+            vals[0] = ssid.c_str();
+            vals[1] = pbssid;
+            vals[2] = _badBSSID ? HTTP_STATUS_BADBSSID : "";
+            vals[3] = ip.c_str();
+            page.addTmpl(HTTP_STATUS_ON, "vIVi", vals);
         } else {
-            str += FPSTR(HTTP_STATUS_OFF);
-            str.replace(FPSTR(T_v), htmlEntities(SSID, true));
+            const char *c = "r", *r, *V = HTTP_STATUS_APMODE;
             switch(_lastconxresult) {
             case TWL_DHCP_TIMEOUT:    // dhcp timeout
-                str.replace(FPSTR(T_c), "r");
-                str.replace(FPSTR(T_r), FPSTR(HTTP_STATUS_NODHCP));
-                str.replace(FPSTR(T_V), FPSTR(HTTP_STATUS_APMODE));
+                r = HTTP_STATUS_NODHCP;
                 break;
             case WL_NO_SSID_AVAIL:    // connect failed, or ap not found
-                str.replace(FPSTR(T_c), "r");
-                str.replace(FPSTR(T_r), FPSTR(HTTP_STATUS_OFFNOAP));
-                str.replace(FPSTR(T_V), FPSTR(HTTP_STATUS_APMODE));
+                r = HTTP_STATUS_OFFNOAP;
                 break;
             case WL_CONNECT_FAILED:   // connect failed
             case WL_CONNECTION_LOST:  // connect failed, state is ambiguous
-                str.replace(FPSTR(T_c), "r");
-                str.replace(FPSTR(T_r), FPSTR(HTTP_STATUS_OFFFAIL));
-                str.replace(FPSTR(T_V), FPSTR(HTTP_STATUS_APMODE));
+                r = HTTP_STATUS_OFFFAIL;
                 break;
             case WL_DISCONNECTED:     // disconnected; wrong or missing password
-                str.replace(FPSTR(T_c), "r");
-                str.replace(FPSTR(T_r), FPSTR(HTTP_STATUS_DISCONN));
-                str.replace(FPSTR(T_V), FPSTR(HTTP_STATUS_APMODE));
+                r = HTTP_STATUS_DISCONN;
                 break;
             default:
-                str.replace(FPSTR(T_c), "n");
-                str.replace(FPSTR(T_r), "");
-                str.replace(FPSTR(T_V), _carMode ? FPSTR(HTTP_STATUS_CARMODE) : FPSTR(HTTP_STATUS_APMODE));
+                c = "n";
+                r = "";
+                V = _carMode ? HTTP_STATUS_CARMODE : HTTP_STATUS_APMODE;
                 break;
             }
+            vals[0] = c;
+            page.addTmpl(HTTP_STATUS_HEAD, "c", vals);
+            vals[0] = ssid.c_str();
+            vals[1] = r;
+            vals[2] = V;
+            page.addTmpl(HTTP_STATUS_OFF, "vrV", vals);
         }
     } else {
-        str.replace(FPSTR(T_c), "n");
-        str += FPSTR(HTTP_STATUS_NONE);
+        vals[0] = "n";
+        page.addTmpl(HTTP_STATUS_HEAD, "c", vals);
+        page += FPSTR(HTTP_STATUS_NONE);
     }
 
     if(withMac) {
-        str += FPSTR(HTTP_BR);
-        str += WiFi.macAddress();
+        page += FPSTR(HTTP_BR);
+        page += WiFi.macAddress();
     }
 
-    str += FPSTR(HTTP_STATUS_TAIL);
-
-    page += str;
+    page += FPSTR(HTTP_STATUS_TAIL);
 }
 
 /****************************************************************************
@@ -1524,128 +1400,12 @@ void WiFiManager::reportStatus(String& page, unsigned int estSize, bool withMac)
  *
  ****************************************************************************/
 
-// Calc size of params (without 0-term)
-unsigned int WiFiManager::getParamOutSize(WiFiManagerParameter** params,
-                    int paramsCount, unsigned int& maxItemSize)
-{
-    unsigned int mysize = 0;
-    unsigned int totalsize = 0;
-
-    maxItemSize = 0;
-
-    if(paramsCount > 0) {
-
-        for(int i = 0; i < paramsCount; i++) {
-
-            if(!params[i] || params[i]->_length > 99999) {
-                #ifdef _A10001986_DBG
-                Serial.println("[ERROR getParamOutSize] WiFiManagerParameter is out of scope");
-                #endif
-                continue;
-            }
-
-            mysize = 0;
-
-            uint8_t pflags = params[i]->getFlags();
-
-            if(pflags & WFM_SECTS_HEAD) {
-                mysize += STRLEN(HTTP_SECT_HEAD);
-            } else if(pflags & WFM_SECTS) {
-                mysize += STRLEN(HTTP_SECT_START) + STRLEN(HTTP_SECT_HEAD);
-            }
-            if(pflags & WFM_FOOT) {
-                mysize += STRLEN(HTTP_SECT_FOOT);
-            }
-
-            if(params[i]->getID()) {
-
-                bool haveLabel = true;
-
-                switch(pflags & WFM_LABEL_MASK) {
-                case WFM_LABEL_BEFORE:
-                    if(!(pflags & WFM_NO_BR)) mysize += STRLEN(HTTP_BR);
-                    // fall through
-                case WFM_LABEL_AFTER:
-                    mysize += STRLEN(HTTP_FORM_LABEL) + STRLEN(HTTP_FORM_PARAM);
-                    mysize += STRLEN(HTTP_BR);
-                    mysize -= (8*3);  // tokens
-                    break;
-                default:
-                    // WFM_NO_LABEL
-                    mysize += STRLEN(HTTP_FORM_PARAM);
-                    mysize -= (6*3);  // tokens
-                    haveLabel = false;
-                    break;
-                }
-
-                // <label for='{i}'>{t}</label>
-                // <input id='{i}' name='{n}' {l} value='{v}' {c} {f}>
-                mysize += (strlen(params[i]->getID()) * 3);    // 2x{i}, 1x{n}
-                if(haveLabel && params[i]->getLabel()) {
-                    mysize += strlen(params[i]->getLabel());
-                }
-                if(pflags & WFM_IS_CHKBOX) {
-                    mysize += 1;    // value="1"
-                    if(*(params[i]->getValue()) == '1') mysize += 7;  // "checked"
-                    mysize += STRLEN(HTML_CHKBOX);
-                } else {
-                    int vl = params[i]->getValueLength();
-                    if     (vl <   10) mysize += 1+12;
-                    else if(vl <  100) mysize += 2+12;
-                    else if(vl < 1000) mysize += 3+12;
-                    else               mysize += 5+12;
-                    mysize += strlen(params[i]->getValue());
-                }
-                if(params[i]->getCustomHTML()) {
-                    mysize += strlen(params[i]->getCustomHTML());
-                }
-
-            } else if(params[i]->_customHTMLGenerator) {
-
-                const char *t = (params[i]->_customHTMLGenerator)(NULL, WM_CP_LEN);
-                if(t) {
-                    mysize += *(unsigned int *)t;
-                }
-
-            } else if(params[i]->getCustomHTML()) {
-
-                if(pflags & WFM_HL) {
-                    mysize += STRLEN(HTTP_HL_S) + STRLEN(HTTP_HL_E);
-                }
-
-                mysize += strlen(params[i]->getCustomHTML());
-
-            } else {
-
-                continue;
-
-            }
-
-            totalsize += mysize;
-
-            if(mysize > maxItemSize) maxItemSize = mysize;
-        }
-    }
-
-    maxItemSize += 8;  // safety
-
-    #ifdef _A10001986_DBG
-    Serial.printf("getParamOutSize: totalsize %d maxItemSize %d\n", totalsize, maxItemSize - 8);
-    #endif
-
-    return totalsize;
-}
-
-void WiFiManager::getParamOut(String &page, WiFiManagerParameter** params,
-                    int paramsCount, unsigned int maxItemSize)
+void WiFiManager::getParamOut(WMPageOut& page, WiFiManagerParameter** params, int paramsCount)
 {
     if(paramsCount > 0) {
 
         char valLength[12+6];
-
-        // Allocate it once, re-use it
-        String pitem;
-        pitem.reserve(maxItemSize ? maxItemSize : 2048);
+        const char *vals[7];
 
         // add the extra parameters to the form
         for(int i = 0; i < paramsCount; i++) {
@@ -1658,102 +1418,84 @@ void WiFiManager::getParamOut(String &page, WiFiManagerParameter** params,
                 continue;
             }
 
-            pitem = "";
-
             // Input templating
             // <label for='{i}'>{t}</label>
             // <input id='{i}' name='{n}' {l} value='{v}' {c} {f}>
             // if no ID, use customhtml for item, else generate from param string
 
+            if(!params[i]->getID() && !params[i]->_customHTMLGenerator && !params[i]->getCustomHTML()) {
+                continue;
+            }
+
             uint8_t pflags = params[i]->getFlags();
 
             if(pflags & WFM_SECTS_HEAD) {
-                pitem += FPSTR(HTTP_SECT_HEAD);
+                page += FPSTR(HTTP_SECT_HEAD);
             } else if(pflags & WFM_SECTS) {
-                pitem += FPSTR(HTTP_SECT_START);
-                pitem += FPSTR(HTTP_SECT_HEAD);
+                page += FPSTR(HTTP_SECT_START);
+                page += FPSTR(HTTP_SECT_HEAD);
             }
 
             if(params[i]->getID()) {
 
-                bool haveLabel = true;
+                vals[0] = vals[1] = params[i]->getID();                     // T_i, T_n id name
+                vals[2] = params[i]->getLabel() ? params[i]->getLabel() : "";  // T_t title/label
+                if(pflags & WFM_IS_CHKBOX) {
+                    vals[3] = (*(params[i]->getValue()) == '1') ? "checked" : "";
+                    vals[4] = "1";                                          // value is ALWAYS "1"!
+                    vals[5] = HTML_CHKBOX;
+                } else {
+                    snprintf(valLength, 12+5, "maxlength='%d'", params[i]->getValueLength());
+                    vals[3] = valLength;                                    // T_l maxlength='value length'
+                    vals[4] = params[i]->getValue();                        // T_v value
+                    vals[5] = "";
+                }
+                vals[6] = params[i]->getCustomHTML() ? params[i]->getCustomHTML() : "";  // T_c additional attributes
 
                 switch(pflags & WFM_LABEL_MASK) {
                 case WFM_LABEL_BEFORE:
-                    pitem += FPSTR(HTTP_FORM_LABEL);
-                    if(!(pflags & WFM_NO_BR)) pitem += FPSTR(HTTP_BR);
-                    pitem += FPSTR(HTTP_FORM_PARAM);
-                    pitem += FPSTR(HTTP_BR);
+                    page.addTmpl(HTTP_FORM_LABEL, "intlvfc", vals);
+                    if(!(pflags & WFM_NO_BR)) page += FPSTR(HTTP_BR);
+                    page.addTmpl(HTTP_FORM_PARAM, "intlvfc", vals);
+                    page += FPSTR(HTTP_BR);
                     break;
                 case WFM_LABEL_AFTER:
-                    pitem += FPSTR(HTTP_FORM_PARAM);
-                    pitem += FPSTR(HTTP_FORM_LABEL);
-                    pitem += FPSTR(HTTP_BR);
+                    page.addTmpl(HTTP_FORM_PARAM, "intlvfc", vals);
+                    page.addTmpl(HTTP_FORM_LABEL, "intlvfc", vals);
+                    page += FPSTR(HTTP_BR);
                     break;
                 default:
                     // WFM_NO_LABEL
-                    pitem += FPSTR(HTTP_FORM_PARAM);
-                    haveLabel = false;
+                    page.addTmpl(HTTP_FORM_PARAM, "intlvfc", vals);
                     break;
                 }
 
-                pitem.replace(FPSTR(T_i), params[i]->getID());     // T_i id name
-                pitem.replace(FPSTR(T_n), params[i]->getID());     // T_n id name alias
-                if(haveLabel) {
-                    if(params[i]->getLabel()) {
-                        pitem.replace(FPSTR(T_t), params[i]->getLabel());  // T_t title/label
-                    } else {
-                        pitem.replace(FPSTR(T_t), "");
-                    }
-                }
-                if(pflags & WFM_IS_CHKBOX) {
-                    pitem.replace(FPSTR(T_l), (*(params[i]->getValue()) == '1') ? "checked" : "");
-                    pitem.replace(FPSTR(T_v), "1"); // value is ALWAYS "1"!
-                    pitem.replace(FPSTR(T_f), HTML_CHKBOX);
-                } else {
-                    snprintf(valLength, 12+5, "maxlength='%d'", params[i]->getValueLength());
-                    pitem.replace(FPSTR(T_l), valLength);              // T_l maxlength='value length'
-                    pitem.replace(FPSTR(T_v), params[i]->getValue());  // T_v value
-                    pitem.replace(FPSTR(T_f), "");
-                }
-                if(params[i]->getCustomHTML()) {                   // T_c additional attributes
-                    pitem.replace(FPSTR(T_c), params[i]->getCustomHTML());
-                } else {
-                    pitem.replace(FPSTR(T_c), "");
-                }
-
             } else if(params[i]->_customHTMLGenerator) {
 
                 const char *t = (params[i]->_customHTMLGenerator)(NULL, WM_CP_CREATE);
                 if(t) {
-                    pitem += t;
+                    page += t;
                     (params[i]->_customHTMLGenerator)(t, WM_CP_DESTROY);
                 }
 
-            } else if(params[i]->getCustomHTML()) {
+            } else {
 
                 if(pflags & WFM_HL) {
-                    pitem += FPSTR(HTTP_HL_S);
+                    page += FPSTR(HTTP_HL_S);
                 }
 
-                pitem += params[i]->getCustomHTML();
+                page += params[i]->getCustomHTML();
 
                 if(pflags & WFM_HL) {
-                    pitem += FPSTR(HTTP_HL_E);
+                    page += FPSTR(HTTP_HL_E);
                 }
 
-            } else {
-
-                continue;
-
             }
 
             if(pflags & WFM_FOOT) {
-                pitem += FPSTR(HTTP_SECT_FOOT);
+                page += FPSTR(HTTP_SECT_FOOT);
             }
 
-            page += pitem;
-
             if(!(i % 30) && _gpcallback) {
                 _gpcallback(WM_LP_NONE);
             }
@@ -1815,33 +1557,12 @@ void WiFiManager::send_cc()
     server->sendHeader("Expires", "0");
 }
 
-void WiFiManager::HTTPSend(const String& content, bool sendCC)
+void WiFiManager::HTTPSend(WMPageOut& page)
 {
-    #ifdef _A10001986_DBG
-    unsigned long now = millis();
-    #endif
-
-    #ifdef _A10001986_DBG
-    Serial.printf("HTTPSend: Heap before %d\n", ESP.getFreeHeap());
-    #endif
-
-    #if 0
-    if(server->client()) {
-        #ifdef _A10001986_DBG
-        Serial.printf("TCP_NODELAY is %d\n", server->client().getNoDelay());
-        #endif
-        server->client().setNoDelay(true);
-    }
-    #endif
-
-    if(sendCC) {
-        send_cc();
-    }
-
-    server->send(200, HTTP_HEAD_CT, content);
+    page.end();
 
     #ifdef _A10001986_DBG
-    Serial.printf("HTTPSend took %d, content size %d, heap %d\n\n", millis() - now, content.length(), ESP.getFreeHeap());
+    Serial.printf("HTTPSend: content size %d, heap %d\n\n", (int)page.length(), ESP.getFreeHeap());
     #endif
 
     yield();
@@ -1857,43 +1578,8 @@ void WiFiManager::HTTPSend(const String& content, bool sendCC)
 /*********************************** ROOT ***********************************/
 /*--------------------------------------------------------------------------*/
 
-// Calc size of root menu (without 0-term)
-int WiFiManager::getMenuOutLength(unsigned int& appExtraSize)
-{
-    int bufSize = 0;
-
-    if(_menuIdArr) {
-        int menuId = 0;
-        int8_t t;
-        while((t = _menuIdArr[menuId++]) != WM_MENU_END) {
-            if(t == WM_MENU_PARAM && !_paramsCount[1]) continue;
-            #ifdef WM_PARAM2
-            if(t == WM_MENU_PARAM2 && !_paramsCount[2]) continue;
-            #ifdef WM_PARAM3
-            if(t == WM_MENU_PARAM3 && !_paramsCount[3]) continue;
-            #endif
-            #endif
-            if(t == WM_MENU_CUSTOM && _customMenuHTML) {
-                bufSize += strlen(_customMenuHTML);
-                continue;
-            }
-            bufSize += strlen(HTTP_PORTAL_MENU[t]);
-        }
-    } else {
-        bufSize += strlen(HTTP_PORTAL_MENU[WM_MENU_WIFI]);
-        bufSize += strlen(HTTP_PORTAL_MENU[WM_MENU_UPDATE]);
-    }
-
-    if(_menuoutlencallback) {
-        appExtraSize = _menuoutlencallback();
-        bufSize += appExtraSize;
-    }
-
-    return bufSize;
-}
-
 // Construct root menu
-void WiFiManager::getMenuOut(String& page, unsigned int appExtraSize)
+void WiFiManager::getMenuOut(WMPageOut& page)
 {
     if(_menuIdArr) {
         int menuId = 0;
@@ -1918,39 +1604,11 @@ void WiFiManager::getMenuOut(String& page, unsigned int appExtraSize)
     }
 
     if(_menuoutcallback) {
-        _menuoutcallback(page, appExtraSize);
+        _menuoutcallback(page);
     }
 }
 
-unsigned int WiFiManager::calcRootLen(unsigned int& repSize, unsigned int& appExtraSize)
-{
-    // Calc page size
-    unsigned int bufSize;
-    uint32_t incFlags = incSTA|incC80;
-
-    #ifdef WM_UPLOAD
-    if(_nv || !_sndIsInstalled) incFlags |= incUPLF;
-    #else
-    if(_nv) incFlags |= incUPLF;
-    #endif
-
-    bufSize = getHTTPHeadLength(NULL, incFlags);
-
-    bufSize += getMenuOutLength(appExtraSize);
-
-    repSize = reportStatusLen();
-    bufSize += repSize;
-
-    bufSize += STRLEN(HTTP_END);
-
-    #ifdef _A10001986_DBG
-    Serial.printf("calcRootLen: calced content size %d\n", bufSize);
-    #endif
-
-    return bufSize;
-}
-
-void WiFiManager::buildRootPage(String& page, unsigned int repSize, unsigned int appExtraSize)
+void WiFiManager::buildRootPage(WMPageOut& page)
 {
     // Build page
     uint32_t incFlags = incSTA|incC80;
@@ -1963,9 +1621,9 @@ void WiFiManager::buildRootPage(String& page, unsigned int repSize, unsigned int
 
     getHTTPHeadNew(page, NULL, incFlags);
 
-    getMenuOut(page, appExtraSize);
+    getMenuOut(page);
 
-    reportStatus(page, repSize);
+    reportStatus(page);
 
     page += FPSTR(HTTP_END);
 }
@@ -1975,23 +1633,19 @@ void WiFiManager::buildRootPage(String& page, unsigned int repSize, unsigned int
  */
 void WiFiManager::handleRoot()
 {
-    unsigned int repSize = 0;
-    unsigned int appExtraSize = 0;
-
     #ifdef _A10001986_DBG
     Serial.println("<- HTTP Root");
     #endif
 
-    String page;
-    page.reserve(calcRootLen(repSize, appExtraSize) + 16);
-
-    buildRootPage(page, repSize, appExtraSize);
-
     if(_gpcallback) {
         _gpcallback(WM_LP_PREHTTPSEND);
     }
 
-    HTTPSend(page, false);
+    {
+        WMPageOut page(server.get());
+        buildRootPage(page);
+        HTTPSend(page);
+    }
 
     if(_gpcallback) {
         _gpcallback(WM_LP_POSTHTTPSEND);
@@ -2171,90 +1825,15 @@ void WiFiManager::sortNetworks(int n, int *indices, int& haveDupes, bool removeD
     }
 }
 
-unsigned int WiFiManager::getScanItemsLen(int n, bool scanErr, int *indices, unsigned int& maxItemSize, int& stopAt, bool showall)
-{
-    unsigned int mySize = 0, itemSize;
-
-    stopAt = n;
-
-    if(scanErr) {
-
-        mySize += STRLEN(HTTP_MSG_SCANFAIL);
-        maxItemSize = mySize;
-
-    } else if(n == 0) {
-
-        mySize += STRLEN(HTTP_MSG_NONETWORKS);
-        maxItemSize = mySize;
-
-    } else {
-
-        maxItemSize = 0;
-
-        for(int i = 0; i < n; i++) {
-
-            if(indices[i] == -1) continue;
-
-            // <div><a href='#p' onclick='return {t}(this)' data-ssid='{V}' title='{R}'>{v}</a>{c}
-            // <div role='img' aria-label='{r}dBm' title='{r}dBm' class='q q-{q} {i}'></div></div>
-
-            int rssi = WiFi.RSSI(indices[i]);
-
-            if(_minimumRSSI < rssi) {
-
-                String SSID = WiFi.SSID(indices[i]);
-                if(SSID == "") {
-                    continue;
-                } else if(!checkSSID(SSID)) {
-                    if(showall) {
-                        SSID = S_nonprintable;
-                    } else {
-                        continue;
-                    }
-                }
-
-                itemSize = STRLEN(HTTP_WIFI_ITEM) - (9*3);
-                itemSize += (2 * htmlEntitiesLen(SSID, true));
-                itemSize += (4+4+1+1);     // rssi, rssi, qual class, enc class
-                if(showall) {
-                    itemSize += (6 + 17);  // chnlnum, bssid
-                }
-
-                if(itemSize > maxItemSize) maxItemSize = itemSize;
-
-                mySize += itemSize;
-
-                if(mySize > MAX_SCAN_OUTPUT_SIZE) {
-                    stopAt = i + 1;
-                    #ifdef _A10001986_DBG
-                    Serial.printf("WM: Maximum scan output size reached, stop at %d\n", stopAt);
-                    #endif
-                    break;
-                }
-
-            } else {
-
-                #ifdef _A10001986_DBG
-                Serial.printf("WM: skipping %s, rssi %d\n", WiFi.SSID(indices[i]).c_str(), rssi);
-                #endif
-
-            }
-
-        }
-    }
-
-    #ifdef _A10001986_DBG
-    Serial.printf("WM: getScanItemsLen %d, maxItemSize %d\n", mySize, maxItemSize);
-    #endif
-
-    return mySize;
-}
-
-void WiFiManager::getScanItemsOut(String& page, int n, bool scanErr, int *indices, unsigned int maxItemSize, bool showall)
+void WiFiManager::getScanItemsOut(WMPageOut& page, int n, bool scanErr, int *indices, bool showall)
 {
     char chnlnum[8];
+    char srssi[12];
+    char squal[12];
     uint8_t bssid[6];
     char pbssid[20] = { 0 };
+    const char *vals[8];
+    unsigned int mySize = 0;
 
      if(scanErr) {
 
@@ -2266,9 +1845,6 @@ void WiFiManager::getScanItemsOut(String& page, int n, bool scanErr, int *indice
 
     } else {
 
-        String item;
-        if(maxItemSize) item.reserve(maxItemSize + 8);
-
         // <div><a href='#p' onclick='return {t}(this)' data-ssid='{V}' title='{R}'>{v}</a>{c}
         // <div role='img' aria-label='{r}dBm' title='{r}dBm' class='q q-{q} {i}'></div></div>
 
@@ -2281,7 +1857,7 @@ void WiFiManager::getScanItemsOut(String& page, int n, bool scanErr, int *indice
 
                 uint8_t enc_type = WiFi.encryptionType(indices[i]);
                 String SSID = WiFi.SSID(indices[i]);
-                String func = "c";
+                const char *func = "c";
 
                 if(SSID == "") {
                     continue;
@@ -2294,31 +1870,53 @@ void WiFiManager::getScanItemsOut(String& page, int n, bool scanErr, int *indice
                     }
                 }
 
-                item = FPSTR(HTTP_WIFI_ITEM);
+                String eSSID = htmlEntities(SSID);
+                String pSSID = htmlEntities(SSID, true);
 
-                item.replace(FPSTR(T_t), func);
-                item.replace(FPSTR(T_V), htmlEntities(SSID));
-                item.replace(FPSTR(T_v), htmlEntities(SSID, true));
+                vals[0] = func;
+                vals[1] = eSSID.c_str();
+                vals[2] = pSSID.c_str();
                 if(showall) {
                     sprintf(chnlnum, " (%d)", WiFi.channel(indices[i]));
-                    item.replace(FPSTR(T_c), chnlnum);              // channel
+                    vals[3] = chnlnum;                                  // channel
                     if(WiFi.BSSID(indices[i])) {
                         memcpy(bssid, WiFi.BSSID(indices[i]), 6);
                         sprintf(pbssid, "%02x:%02x:%02x:%02x:%02x:%02x",
                             bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5]);
                     }
-                    item.replace(FPSTR(T_R), pbssid);               // bssid
+                    vals[4] = pbssid;                                   // bssid
                 } else {
-                    item.replace(FPSTR(T_c), "");
-                    item.replace(FPSTR(T_R), "");
+                    vals[3] = vals[4] = "";
                 }
-                item.replace(FPSTR(T_r), String(rssi));             // rssi
-                item.replace(FPSTR(T_q), String(wmmap(rssi)));      // quality icon 1-4
-                item.replace(FPSTR(T_i), (enc_type != WIFI_AUTH_OPEN) ? "l" : "");
+                sprintf(srssi, "%d", rssi);
+                sprintf(squal, "%ld", wmmap(rssi));
+                vals[5] = srssi;                                        // rssi
+                vals[6] = squal;                                        // quality icon 1-4
+                vals[7] = (enc_type != WIFI_AUTH_OPEN) ? "l" : "";
 
-                page += item;
+                page.addTmpl(HTTP_WIFI_ITEM, "tVvcRrqi", vals);
                 delay(0);
 
+                // Limit list by estimated size
+                mySize += STRLEN(HTTP_WIFI_ITEM) - (9*3);
+                mySize += (2 * pSSID.length());
+                mySize += (4+4+1+1);     // rssi, rssi, qual class, enc class
+                if(showall) {
+                    mySize += (6 + 17);  // chnlnum, bssid
+                }
+                if(mySize > MAX_SCAN_OUTPUT_SIZE) {
+                    #ifdef _A10001986_DBG
+                    Serial.printf("WM: Maximum scan output size reached, stop at %d\n", i + 1);
+                    #endif
+                    break;
+                }
+
+            } else {
+
+                #ifdef _A10001986_DBG
+                Serial.printf("WM: skipping %s, rssi %d\n", WiFi.SSID(indices[i]).c_str(), rssi);
+                #endif
+
             }
 
             if(!(i % 20) && _gpcallback) {
@@ -2330,65 +1928,21 @@ void WiFiManager::getScanItemsOut(String& page, int n, bool scanErr, int *indice
 
 // static ip fields
 
-void WiFiManager::getIpForm(String& page, const char *id, const char *title, IPAddress& value, const char *placeholder)
+void WiFiManager::getIpForm(WMPageOut& page, const char *id, const char *title, IPAddress& value, const char *placeholder)
 {
     // <label for='{i}'>{t}</label>
     // <input id='{i}' name='{n}' {l} value='{v}' {c} {f}>
 
-    unsigned int s = STRLEN(HTTP_FORM_LABEL) + STRLEN(HTTP_FORM_PARAM) - (8*3) + (2*STRLEN(HTTP_BR));
-    s += (3*strlen(id)) + strlen(title);
-    s += (12+2) + 15;
-    if(placeholder) s += strlen(placeholder);
-
-    String item;
-    item.reserve(s + 8);
-
-    item = FPSTR(HTTP_FORM_LABEL);
-    item += FPSTR(HTTP_BR);
-    item += FPSTR(HTTP_FORM_PARAM);
-    item += FPSTR(HTTP_BR);
-    item.replace(FPSTR(T_i), id);
-    item.replace(FPSTR(T_n), id);
-    item.replace(FPSTR(T_t), title);
-    item.replace(FPSTR(T_l), F("maxlength='15'"));
-    item.replace(FPSTR(T_v), value ? value.toString() : "");
-    item.replace(FPSTR(T_c), placeholder ? placeholder : "");
-    item.replace(FPSTR(T_f), "");
-
-    page += item;
-}
-
-unsigned int WiFiManager::getStaticLen()
-{
-    unsigned int mySize = 0;
-    bool showSta = (_staShowStaticFields || _sta_static_ip);
-    bool showDns = (_staShowDns || _sta_static_dns);
-
-    // "<label for='{i}'>{t}</label>"
-    // "<input id='{i}' name='{n}' {l} value='{v}' {c} {f}>\n"
+    String ip = value ? value.toString() : "";
+    const char *vals[7] = { id, id, title, "maxlength='15'", ip.c_str(), placeholder ? placeholder : "", "" };
 
-    if(showSta || showDns) {
-        mySize += STRLEN(HTTP_FORM_SECT_HEAD);
-    }
-    if(showSta) {
-        mySize += (3 * (STRLEN(HTTP_FORM_LABEL) + STRLEN(HTTP_FORM_PARAM) - (8*3) + (2*STRLEN(HTTP_BR))));
-        mySize += (3*STRLEN(S_ip)) + STRLEN(S_staticip) + (12+2) + 15;
-        mySize += STRLEN(HTTP_FORM_WIFI_PH);
-        mySize += (3*STRLEN(S_sn)) + STRLEN(S_subnet) + (12+2) + 15;
-        mySize += (3*STRLEN(S_gw)) + STRLEN(S_staticgw) + (12+2) + 15;
-    }
-    if(showDns) {
-        mySize += STRLEN(HTTP_FORM_LABEL) + STRLEN(HTTP_FORM_PARAM) - (8*3) + (2*STRLEN(HTTP_BR));
-        mySize += (3*STRLEN(S_dns)) + STRLEN(S_staticdns) + (12+2) + 15;
-    }
-    if(showSta || showDns) {
-        mySize += STRLEN(HTTP_FORM_SECT_FOOT);
-    }
-
-    return mySize;
+    page.addTmpl(HTTP_FORM_LABEL, "intlvcf", vals);
+    page += FPSTR(HTTP_BR);
+    page.addTmpl(HTTP_FORM_PARAM, "intlvcf", vals);
+    page += FPSTR(HTTP_BR);
 }
 
-void WiFiManager::getStaticOut(String& page)
+void WiFiManager::getStaticOut(WMPageOut& page)
 {
     bool showSta = (_staShowStaticFields || _sta_static_ip);
     bool showDns = (_staShowDns || _sta_static_dns);
@@ -2411,12 +1965,9 @@ void WiFiManager::getStaticOut(String& page)
 
 // Build WiFi page
 
-void WiFiManager::buildWifiPage(String& page, bool scan)
+void WiFiManager::buildWifiPage(WMPageOut& page, bool scan)
 {
-    unsigned int bufSize = 0, repSize = 0;
-    unsigned int maxScanItemSize = 0;
-    unsigned int maxItemSize = 0;
-    int numDupes = 0, maxDisplay;
+    int numDupes = 0;
     uint32_t incFlags = incSET|incSTA;
     bool scanErr = false, scanallowed = true, showrefresh = false, haveShowAll = false;
     bool force = server->hasArg(F("refresh"));
@@ -2424,9 +1975,7 @@ void WiFiManager::buildWifiPage(String& page, bool scan)
     int n = 0;
 
     String SSID = String(_ssid);
-    unsigned int SSID_len = SSID.length();
     String BSSID = String(_bssid);
-    unsigned int BSSID_len = BSSID.length();
 
     if(showall) scan = true;
 
@@ -2478,45 +2027,19 @@ void WiFiManager::buildWifiPage(String& page, bool scan)
     if(scan) {
         sortNetworks(n, indices, numDupes, !showall);
         incFlags |= incQI;
-    }
-
-    maxDisplay = n;
-
-    bufSize = getHTTPHeadLength(S_titlewifi, incFlags);
-
-    if(showrefresh) {
-        // No message
-    } else if(!scanallowed) {
-        bufSize += STRLEN(HTTP_MSG_NOSCAN);
-    } else if(scan) {
-        bufSize += getScanItemsLen(n, scanErr, indices, maxScanItemSize, maxDisplay, showall);
         if(!showall && n > 0 && !scanErr) {
-            bufSize += STRLEN(HTTP_SHOWALL);
             haveShowAll = true;
         }
     }
-    bufSize += (STRLEN(HTTP_FORM_START) - 3 + STRLEN(A_wifisave));
-    bufSize += (STRLEN(HTTP_FORM_WIFI) - (4*3) + SSID_len + (2*STRLEN(S_passph))) + BSSID_len;
-    if(SSID_len) {
-        bufSize += STRLEN(HTTP_ERASE_BUTTON);
-    }
-    bufSize += getStaticLen();
-    bufSize += STRLEN(HTTP_FORM_WIFI_END);
-    bufSize += getParamOutSize(_params[0], _paramsCount[0], maxItemSize);
-    bufSize += STRLEN(HTTP_FORM_END);
-    bufSize += STRLEN(HTTP_SCAN_LINK);
-    if(haveShowAll) {
-        bufSize += STRLEN(HTTP_SHOWALL_FORM);
-    }
-    repSize = reportStatusLen(true);
-    bufSize += repSize;
-    bufSize += STRLEN(HTTP_END);
 
-    #ifdef _A10001986_DBG
-    Serial.printf("handleWiFi: calced content size %d\n", bufSize);
-    #endif
-
-    page.reserve(bufSize + 16);
+    // Add a delay in order to minimize time
+    // the first output takes after scan
+    if(scan && _lastscan) {
+        unsigned int mssincescan = millis() - _lastscan;
+        if(mssincescan < 4000) {
+            _delay(4000 - mssincescan);
+        }
+    }
 
     getHTTPHeadNew(page, S_titlewifi, incFlags);
 
@@ -2525,53 +2048,37 @@ void WiFiManager::buildWifiPage(String& page, bool scan)
     } else if(!scanallowed) {
         page += FPSTR(HTTP_MSG_NOSCAN);
     } else if(scan) {
-        getScanItemsOut(page, maxDisplay, scanErr, indices, maxScanItemSize, showall);
+        getScanItemsOut(page, n, scanErr, indices, showall);
         if(haveShowAll) {
             page += FPSTR(HTTP_SHOWALL);
         }
     }
 
     {
-        String pitem;
-        pitem.reserve(STRLEN(HTTP_FORM_WIFI) - (4*3) + SSID_len + (2*STRLEN(S_passph)) + BSSID_len + 8); // +8 safety
+        const char *vals[3];
 
-        pitem = FPSTR(HTTP_FORM_START);
-        pitem.replace(FPSTR(T_v), FPSTR(A_wifisave));
-        page += pitem;
+        vals[0] = A_wifisave;
+        page.addTmpl(HTTP_FORM_START, "v", vals);
 
-        pitem = FPSTR(HTTP_FORM_WIFI);
-        pitem.replace(FPSTR(T_V), SSID);
-        if(*_pass) {
-            pitem.replace(FPSTR(T_p), FPSTR(S_passph));  // twice!
-        } else {
-            pitem.replace(FPSTR(T_p), "");
-        }
-        pitem.replace(FPSTR(T_h), BSSID);
-        page += pitem;
+        vals[0] = SSID.c_str();
+        vals[1] = *_pass ? S_passph : "";   // twice!
+        vals[2] = BSSID.c_str();
+        page.addTmpl(HTTP_FORM_WIFI, "Vph", vals);
     }
 
-    if(SSID_len) {
+    if(SSID.length()) {
         page += FPSTR(HTTP_ERASE_BUTTON);
     }
     getStaticOut(page);
     page += FPSTR(HTTP_FORM_WIFI_END);
-    getParamOut(page, _params[0], _paramsCount[0], maxItemSize);
+    getParamOut(page, _params[0], _paramsCount[0]);
     page += FPSTR(HTTP_FORM_END);
     page += FPSTR(HTTP_SCAN_LINK);
     if(haveShowAll) {
         page += FPSTR(HTTP_SHOWALL_FORM);
     }
-    reportStatus(page, repSize, true);
+    reportStatus(page, true);
     page += FPSTR(HTTP_END);
-
-    // Add a delay in order to minimize time
-    // first HTTPSend takes after scan
-    if(scan && _lastscan) {
-        unsigned int mssincescan = millis() - _lastscan;
-        if(mssincescan < 4000) {
-            _delay(4000 - mssincescan);
-        }
-    }
 }
 
 /*
@@ -2579,34 +2086,35 @@ void WiFiManager::buildWifiPage(String& page, bool scan)
  */
 void WiFiManager::handleWifi(bool scan)
 {
-    String page;
-
     #ifdef _A10001986_V_DBG
     Serial.println("<- HTTP Wifi");
     #endif
 
-    #ifdef WM_CCM
-    if(_cCarMode) {
-        unsigned long bufSize = getHTTPHeadLength(S_titlewifi, incSET);
-        bufSize += STRLEN(HTTP_DCM_LINK) + STRLEN(HTTP_END);
-        page.reserve(bufSize + 16);
-        getHTTPHeadNew(page, S_titlewifi, incSET);
-        page += FPSTR(HTTP_DCM_LINK);
-        page += FPSTR(HTTP_END);
-    } else {
-    #endif
-
-        buildWifiPage(page, scan);
-
-    #ifdef WM_CCM
-    }
-    #endif
-
     if(_gpcallback) {
         _gpcallback(WM_LP_PREHTTPSEND);
     }
 
-    HTTPSend(page, true);
+    {
+        WMPageOut page(server.get());
+
+        send_cc();
+
+        #ifdef WM_CCM
+        if(_cCarMode) {
+            getHTTPHeadNew(page, S_titlewifi, incSET);
+            page += FPSTR(HTTP_DCM_LINK);
+            page += FPSTR(HTTP_END);
+        } else {
+        #endif
+
+            buildWifiPage(page, scan);
+
+        #ifdef WM_CCM
+        }
+        #endif
+
+        HTTPSend(page);
+    }
 
     if(_gpcallback) {
         _gpcallback(WM_LP_POSTHTTPSEND);
@@ -2618,10 +2126,11 @@ void WiFiManager::handleWifi(bool scan)
  */
 void WiFiManager::handleWifiSave()
 {
-    unsigned long s = getHTTPHeadLength(S_titlewifi, incGFXMSG);
     bool haveNewSSID = false;
     bool networkDeleted = false;
-    String page;
+    #ifdef WM_CCM
+    bool ccmOff = false;
+    #endif
 
     #ifdef _A10001986_V_DBG
     Serial.println("<- HTTP WiFi save ");
@@ -2631,12 +2140,7 @@ void WiFiManager::handleWifiSave()
     if(_cCarMode) {
         if(server->hasArg(F("cmo")) && _setCCarMode) {
             _setCCarMode(false);
-            s += STRLEN(HTTP_CCMOFF) + STRLEN(HTTP_PARAMSAVED_END) + STRLEN(HTTP_END);
-            page.reserve(s + 16);
-            getHTTPHeadNew(page, S_titlewifi, incGFXMSG);
-            page += FPSTR(HTTP_CCMOFF);
-            page += FPSTR(HTTP_PARAMSAVED_END);
-            page += FPSTR(HTTP_END);
+            ccmOff = true;
         } else {
             server->sendHeader("Location", "/", true);
             server->send(302, FPSTR(HTTP_HEAD_CT2), "");
@@ -2722,44 +2226,39 @@ void WiFiManager::handleWifiSave()
             _savewificallback(_ssid, _pass, _bssid);
         }
 
-        // Build page
-
-        s += STRLEN(HTTP_PARAMSAVED) + STRLEN(HTTP_PARAMSAVED_END) + STRLEN(HTTP_END);
+    #ifdef WM_CCM
+    }
+    #endif
 
-        if(!haveNewSSID) {
-            if(networkDeleted) s += STRLEN(HTTP_SAVED_ERASED);
-        } else {
-            if(_carMode) s += STRLEN(HTTP_SAVED_CARMODE);
-            else         s += STRLEN(HTTP_SAVED_NORMAL);
-        }
+    if(_gpcallback) {
+        _gpcallback(WM_LP_PREHTTPSEND);
+    }
 
-        page.reserve(s + 16);
+    {
+        WMPageOut page(server.get());
 
         getHTTPHeadNew(page, S_titlewifi, incGFXMSG);
 
-        page += FPSTR(HTTP_PARAMSAVED);
-        if(!haveNewSSID) {
-            if(networkDeleted) page += FPSTR(HTTP_SAVED_ERASED);
+        #ifdef WM_CCM
+        if(ccmOff) {
+            page += FPSTR(HTTP_CCMOFF);
         } else {
-            if(_carMode) page += FPSTR(HTTP_SAVED_CARMODE);
-            else         page += FPSTR(HTTP_SAVED_NORMAL);
+        #endif
+            page += FPSTR(HTTP_PARAMSAVED);
+            if(!haveNewSSID) {
+                if(networkDeleted) page += FPSTR(HTTP_SAVED_ERASED);
+            } else {
+                if(_carMode) page += FPSTR(HTTP_SAVED_CARMODE);
+                else         page += FPSTR(HTTP_SAVED_NORMAL);
+            }
+        #ifdef WM_CCM
         }
+        #endif
         page += FPSTR(HTTP_PARAMSAVED_END);
         page += FPSTR(HTTP_END);
 
-        #ifdef _A10001986_DBG
-        Serial.printf("handleWiFiSave: calced content size %d\n", s);
-        #endif
-
-    #ifdef WM_CCM
+        HTTPSend(page);
     }
-    #endif
-
-    if(_gpcallback) {
-        _gpcallback(WM_LP_PREHTTPSEND);
-    }
-
-    HTTPSend(page, false);
 
     if(_gpcallback) {
         _gpcallback(WM_LP_POSTHTTPSEND);
@@ -2771,63 +2270,35 @@ void WiFiManager::handleWifiSave()
 /********************************* SETTINGS *********************************/
 /*--------------------------------------------------------------------------*/
 
-// Calc size of params ("Settings") page
-int WiFiManager::calcParmPageSize(int aidx, unsigned int& maxItemSize, const char *title, const char *action)
-{
-    int mySize = getHTTPHeadLength(title, incSET);
-
-    #ifdef _A10001986_DBG
-    Serial.printf("calcParmSize: head %d\n", mySize);
-    #endif
-
-    mySize += (STRLEN(HTTP_FORM_START) - 3 + strlen(action));
-
-    mySize += getParamOutSize(_params[aidx], _paramsCount[aidx], maxItemSize);
-
-    mySize += STRLEN(HTTP_FORM_END);
-    mySize += STRLEN(HTTP_END);
-
-    #ifdef _A10001986_DBG
-    Serial.printf("calcParmSize: calced content size %d\n", mySize);
-    #endif
-
-    return mySize;
-}
-
 /*
  * HTTPD CALLBACK Settings page handler
  */
 void WiFiManager::_handleParam(int aidx, const char *title, const char *action)
 {
-    unsigned int maxItemSize = 0;
-
     #ifdef _A10001986_V_DBG
     Serial.println("<- HTTP Param");
     #endif
 
-    String page;
-    page.reserve(calcParmPageSize(aidx, maxItemSize, title, action) + 16);
-
-    getHTTPHeadNew(page, title, incSET);
+    if(_gpcallback) {
+        _gpcallback(WM_LP_PREHTTPSEND);
+    }
 
     {
-        String pitem;
-        pitem.reserve(STRLEN(HTTP_FORM_START) - 3 + strlen(action) + 2);
-        pitem = FPSTR(HTTP_FORM_START);
-        pitem.replace(FPSTR(T_v), action);
-        page += pitem;
-    }
+        WMPageOut page(server.get());
 
-    getParamOut(page, _params[aidx], _paramsCount[aidx], maxItemSize);
+        send_cc();
 
-    page += FPSTR(HTTP_FORM_END);
-    page += FPSTR(HTTP_END);
+        getHTTPHeadNew(page, title, incSET);
 
-    if(_gpcallback) {
-        _gpcallback(WM_LP_PREHTTPSEND);
-    }
+        page.addTmpl(HTTP_FORM_START, "v", &action);
+
+        getParamOut(page, _params[aidx], _paramsCount[aidx]);
 
-    HTTPSend(page, true);
+        page += FPSTR(HTTP_FORM_END);
+        page += FPSTR(HTTP_END);
+
+        HTTPSend(page);
+    }
 
     if(_gpcallback) {
         _gpcallback(WM_LP_POSTHTTPSEND);
@@ -2858,8 +2329,6 @@ void WiFiManager::handleParam3()
  */
 void WiFiManager::_handleParamSave(int aidx, const char *title)
 {
-    unsigned int mySize = 0;
-
     #ifdef _A10001986_V_DBG
     Serial.printf("<- HTTP Param save %d\n", aidx);
     #endif
@@ -2876,30 +2345,22 @@ void WiFiManager::_handleParamSave(int aidx, const char *title)
         _saveparamscallback(aidx);
     }
 
-    mySize = getHTTPHeadLength(title, incGFXMSG);
-
-    mySize += STRLEN(HTTP_PARAMSAVED) + STRLEN(HTTP_PARAMSAVED_END);
-    mySize += STRLEN(HTTP_END);
-
-    String page;
-    page.reserve(mySize + 16);
+    if(_gpcallback) {
+        _gpcallback(WM_LP_PREHTTPSEND);
+    }
 
-    #ifdef _A10001986_DBG
-    Serial.printf("handleParamSave %d: calced content size %d\n", aidx, mySize);
-    #endif
+    {
+        WMPageOut page(server.get());
 
-    getHTTPHeadNew(page, title, incGFXMSG);
+        getHTTPHeadNew(page, title, incGFXMSG);
 
-    page += FPSTR(HTTP_PARAMSAVED);
-    page += FPSTR(HTTP_PARAMSAVED_END);
-    page += FPSTR(HTTP_END);
+        page += FPSTR(HTTP_PARAMSAVED);
+        page += FPSTR(HTTP_PARAMSAVED_END);
+        page += FPSTR(HTTP_END);
 
-    if(_gpcallback) {
-        _gpcallback(WM_LP_PREHTTPSEND);
+        HTTPSend(page);
     }
 
-    HTTPSend(page, false);
-
     if(_gpcallback) {
         _gpcallback(WM_LP_POSTHTTPSEND);
     }
@@ -2935,58 +2396,15 @@ void WiFiManager::handleParam3Save()
  */
 void WiFiManager::handleUpdate()
 {
-    unsigned int mySize = 0;
-
     #ifdef _A10001986_V_DBG
     Serial.println("<- Handle update");
     #endif
 
-    mySize = getHTTPHeadLength(S_titleupd, incSET|incUPL);
-
-    mySize += STRLEN(HTTP_UPDATE_FORM) + STRLEN(HTTP_UPDATE1) + STRLEN(HTTP_UPDATE2);
-    if(_downloadLink) {
-        mySize += STRLEN(HTTP_UPLOAD_LINK0) + STRLEN(HTTP_UPLOAD_LINK1);
-        mySize += strlen(_downloadLink);
-        if(_nv) {
-            mySize += STRLEN(HTTP_UPLOAD_LINKY) + STRLEN(HTTP_UPLOAD_LINK2) + STRLEN(HTTP_UPLOAD_LINK3);
-            mySize += strlen(_nv);
-        } else if(_vd) {
-            mySize += STRLEN(HTTP_UPLOAD_LINKX) + STRLEN(HTTP_UPLOAD_LINKA);
-        } else {
-            mySize += STRLEN(HTTP_UPLOAD_LINKZ) + STRLEN(HTTP_UPLOAD_LINKA);
-        }
-    }
-
-    #ifdef WM_FW_HW_VER
-    if(_rfw) {
-        mySize += STRLEN(HTTP_UPLOAD_LINK0) + STRLEN(HTTP_UPLOAD_V_REQ) + STRLEN(HTTP_DIV_END);
-        mySize += strlen(_rfw);
-    }
-    #endif
-
-#ifdef WM_UPLOAD
-    if(_showUploadSnd) {
-        mySize += STRLEN(HTTP_UPDATE_FORM) + STRLEN(HTTP_UPLOADSND1);
-        mySize += STRLEN(HTTP_UPLOADSND1A) + STRLEN(HTTP_UPLOADSND2) + STRLEN(HTTP_UPLOADSND3);
-    } else {
-        mySize += STRLEN(HTTP_UPLOADSND1A) + STRLEN(HTTP_UPLOAD_SDMSG);
-    }
-    mySize += strlen(_sndContName);
-    if(_sndContVer) {
-        mySize += STRLEN(HTTP_UPLOAD_SLINK1) + STRLEN(HTTP_UPLOAD_SLINK1B) + STRLEN(HTTP_UPLOAD_SLINK2) + STRLEN(HTTP_UPLOAD_SLINK3);
-        mySize += strlen(_sndContVer);
-        if(!_sndIsInstalled) mySize += STRLEN(HTTP_UPLOAD_SLINK1A) + STRLEN(HTTP_UPLOAD_SLINK2A);
+    if(_gpcallback) {
+        _gpcallback(WM_LP_PREHTTPSEND);
     }
-#endif
-
-    mySize += STRLEN(HTTP_END);
-
-    #ifdef _A10001986_DBG
-    Serial.printf("handleUpdate: calced content size %d\n", mySize);
-    #endif
 
-    String page;
-    page.reserve(mySize + 16);
+    WMPageOut page(server.get());
 
     getHTTPHeadNew(page, S_titleupd, incSET|incUPL);
 
@@ -3047,11 +2465,7 @@ void WiFiManager::handleUpdate()
 
     page += FPSTR(HTTP_END);
 
-    if(_gpcallback) {
-        _gpcallback(WM_LP_PREHTTPSEND);
-    }
-
-    HTTPSend(page, false);
+    HTTPSend(page);
 
     if(_gpcallback) {
         _gpcallback(WM_LP_POSTHTTPSEND);
@@ -3137,7 +2551,6 @@ void WiFiManager::handleUpdating()
  */
 void WiFiManager::handleUpdateDone()
 {
-    unsigned int mySize = 0;
     uint32_t incFlags = 0;
     bool res = !Update.hasError();
 
@@ -3147,23 +2560,7 @@ void WiFiManager::handleUpdateDone()
 
     if(res) incFlags = incGFXMSG;
 
-    mySize = getHTTPHeadLength(S_titleupd, incFlags);
-
-    if(res) {
-        mySize += STRLEN(HTTP_UPDATE_SUCCESS);
-    } else {
-        mySize += STRLEN(HTTP_UPDATE_FAIL1) + STRLEN(HTTP_UPDATE_FAIL2);
-        mySize += strlen(Update.errorString());
-    }
-
-    mySize += STRLEN(HTTP_END);
-
-    #ifdef _A10001986_DBG
-    Serial.printf("handleUpdateDone: calced content size %d\n", mySize);
-    #endif
-
-    String page;
-    page.reserve(mySize + 16);
+    WMPageOut page(server.get());
 
     getHTTPHeadNew(page, S_titleupd, incFlags);
 
@@ -3183,7 +2580,7 @@ void WiFiManager::handleUpdateDone()
 
     page += FPSTR(HTTP_END);
 
-    HTTPSend(page, false);
+    HTTPSend(page);
 
     if(_postotaupdatecallback) {
         _postotaupdatecallback(res);
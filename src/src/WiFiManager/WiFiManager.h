@@ -31,6 +31,8 @@
 #include <DNSServer.h>
 #include <memory>
 
+#include "wm_pageout.h"
+
 // Menu IDs
 #define WM_MENU_WIFI        0
 #define WM_MENU_PARAM       1
@@ -49,7 +51,6 @@
 #define WM_MENU_END        -1
 
 // Operator for generated HTML params
-#define WM_CP_LEN           1
 #define WM_CP_CREATE        2
 #define WM_CP_DESTROY       3
 
@@ -140,7 +141,6 @@ class WiFiManagerParameter {
     friend class WiFiManager;
 };
 
-
 class WiFiManager
 {
     /////////////////////////////////////////////////////////////////////////////
@@ -229,11 +229,9 @@ class WiFiManager
 		void          setPostOtaUpdateCallback(void(*func)(bool))
 		                              { _postotaupdatecallback = func; };
 
-    // add stuff to the main menu; second one to give WM the length for buf sizing
-  	void          setMenuOutCallback(void(*func)(String &page, unsigned int appExtraSize))
+    // add stuff to the main menu
+  	void          setMenuOutCallback(void(*func)(WMPageOut &page))
   	                              { _menuoutcallback = func; };
-  	void          setMenuOutLenCallback(int(*func)())
-  	                              { _menuoutlencallback = func; };
 
   	// app-specific replacement for delay()
   	void          setDelayReplacement(void(*func)(unsigned int))
@@ -497,44 +495,33 @@ class WiFiManager
     bool          waitEvent(uint32_t mask, unsigned long timeout);
 
     // Webserver handlers
-    unsigned int  calcTitleLen(const char *title);
-	  unsigned int  getHTTPHeadLength(const char *title, uint32_t incFlags = 0);
-	  void          getHTTPHeadNew(String& page, const char *title, uint32_t incFlags = 0);
-
-	  unsigned int  getParamOutSize(WiFiManagerParameter** params,
-                        int paramsCount, unsigned int& maxItemSize);
-  	void          getParamOut(String &page, WiFiManagerParameter** params,
-                        int paramsCount, unsigned int maxItemSize);
+	  void          getHTTPHeadNew(WMPageOut& page, const char *title, uint32_t incFlags = 0);
+
+  	void          getParamOut(WMPageOut& page, WiFiManagerParameter** params, int paramsCount);
     void          doParamSave(WiFiManagerParameter** params, int paramsCount);
 
-	  int           reportStatusLen(bool withMac = false);
-    void          reportStatus(String &page, unsigned int estSize = 0, bool withMac = false);
+    void          reportStatus(WMPageOut& page, bool withMac = false);
 
     void          send_cc();
-    void          HTTPSend(const String &content, bool sendCC);
+    void          HTTPSend(WMPageOut& page);
 
 	  // Root menu
-	  int           getMenuOutLength(unsigned int& appExtraSize);
-    void          getMenuOut(String& page, unsigned int appExtraSize);
-    unsigned int  calcRootLen(unsigned int& repSize, unsigned int& appExtraSize);
-    void          buildRootPage(String& page, unsigned int repSize, unsigned int appExtraSize);
+    void          getMenuOut(WMPageOut& page);
+    void          buildRootPage(WMPageOut& page);
     void          handleRoot();
 
   	// WiFi page
   	int16_t       WiFi_waitForScan();
   	int16_t       WiFi_scanNetworks(bool force, bool async);
   	void          sortNetworks(int n, int *indices, int& haveDupes, bool removeDupes);
-  	unsigned int  getScanItemsLen(int n, bool scanErr, int *indices, unsigned int& maxItemSize, int& stopAt, bool showall);
-    void          getScanItemsOut(String& page, int n, bool scanErr, int *indices, unsigned int maxItemSize, bool showall);
-	  void          getIpForm(String& page, const char *id, const char *title, IPAddress& value, const char *ph = NULL);
-    void          getStaticOut(String& page);
-	  unsigned int  getStaticLen();
-    void          buildWifiPage(String& page, bool scan);
+    void          getScanItemsOut(WMPageOut& page, int n, bool scanErr, int *indices, bool showall);
+	  void          getIpForm(WMPageOut& page, const char *id, const char *title, IPAddress& value, const char *ph = NULL);
+    void          getStaticOut(WMPageOut& page);
+    void          buildWifiPage(WMPageOut& page, bool scan);
 	  void          handleWifi(bool scan);
     void          handleWifiSave();
 
   	// Param pages
-  	int	  	      calcParmPageSize(int aidx, unsigned int& maxItemSize, const char *title, const char *action);
   	void          _handleParam(int aidx, const char *title, const char *action);
   	void          _handleParamSave(int aidx, const char *title);
   	void          handleParam();
@@ -599,8 +586,7 @@ class WiFiManager
     void (*_saveparamscallback)(int)                                    = NULL;
     void (*_preotaupdatecallback)(void)                                 = NULL;
     void (*_postotaupdatecallback)(bool)                                = NULL;
-	  void (*_menuoutcallback)(String&, unsigned int)                     = NULL;
-	  int  (*_menuoutlencallback)(void)                                   = NULL;
+	  void (*_menuoutcallback)(WMPageOut&)                                = NULL;
 	  void (*_delayreplacement)(unsigned int)                             = NULL;
 	  void (*_gpcallback)(int)                                            = NULL;
 	  bool (*_prewifiscancallback)(void)                                  = NULL;
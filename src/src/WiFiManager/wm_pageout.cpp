@@ -0,0 +1,95 @@
+/**
+ * wm_pageout.cpp
+ *
+ * Chunked web page output for WiFiManager
+ *
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * License MIT
+ */
+
+#include "wm_pageout.h"
+
+static const char HTTP_HEAD_CT[]   PROGMEM = "text/html";
+
+/****************************************************************************
+ *
+ * Website handling: Chunked page output
+ *
+ ****************************************************************************/
+
+WMPageOut::WMPageOut(WebServer *server)
+{
+    _server = server;
+    _buf = (char *)malloc(WM_PAGEOUT_SIZE);
+}
+
+WMPageOut::~WMPageOut()
+{
+    if(_buf) free(_buf);
+}
+
+// Send buffer contents as a chunk; send the
+// headers first if this is the first chunk
+void WMPageOut::flush()
+{
+    if(!_started) {
+        _server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+        _server->send(200, HTTP_HEAD_CT, "");
+        _started = true;
+    }
+    if(_len) {
+        _server->sendContent(_buf, _len);
+        _len = 0;
+    }
+}
+
+void WMPageOut::add(const char *s, size_t len)
+{
+    _total += len;
+
+    if(!_buf) {
+        // Out of memory: Send every piece as a chunk of its own
+        flush();
+        if(len) _server->sendContent(s, len);
+        return;
+    }
+
+    while(len) {
+        size_t n = WM_PAGEOUT_SIZE - _len;
+        if(n > len) n = len;
+        memcpy(_buf + _len, s, n);
+        _len += n;
+        s += n;
+        len -= n;
+        if(_len == WM_PAGEOUT_SIZE) {
+            flush();
+        }
+    }
+}
+
+// Output template; each {x} with x in toks is replaced by
+// the string of same index in vals, other text is copied.
+void WMPageOut::addTmpl(const char *tmpl, const char *toks, const char * const *vals)
+{
+    const char *p, *t;
+
+    while((p = strchr(tmpl, '{'))) {
+        if(p[1] && p[2] == '}' && (t = strchr(toks, p[1]))) {
+            add(tmpl, p - tmpl);
+            *this += vals[t - toks];
+            tmpl = p + 3;
+        } else {
+            add(tmpl, p + 1 - tmpl);
+            tmpl = p + 1;
+        }
+    }
+
+    *this += tmpl;
+}
+
+// Send what is left and terminate response
+void WMPageOut::end()
+{
+    flush();
+    _server->sendContent("", 0);
+}
@@ -0,0 +1,60 @@
+/**
+ * wm_pageout.h
+ *
+ * Chunked web page output for WiFiManager
+ *
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * License MIT
+ */
+
+#ifndef wm_pageout_h
+#define wm_pageout_h
+
+#include <Arduino.h>
+
+#ifndef WEBSERVER_H
+#include <WebServer.h>
+#endif
+
+// Size of output buffer for web pages; pages are sent
+// in chunks of (at most) this size
+#ifndef WM_PAGEOUT_SIZE
+#define WM_PAGEOUT_SIZE     1436
+#endif
+
+/*
+ * Web page output: Pieces of a page are collected in a fixed
+ * buffer, which is sent as a HTTP chunk whenever it is full. The
+ * page is never assembled in memory as a whole, and its size need
+ * not be known in advance. Response headers are sent along with
+ * the first chunk, so headers can be added up to that point.
+ */
+class WMPageOut {
+  public:
+    WMPageOut(WebServer *server);
+    ~WMPageOut();
+
+    void        add(const char *s, size_t len);
+    WMPageOut&  operator+=(const char *s)                 { add(s, strlen(s)); return *this; }
+    WMPageOut&  operator+=(const __FlashStringHelper *s)  { return *this += (const char *)s; }
+    WMPageOut&  operator+=(const String& s)               { add(s.c_str(), s.length()); return *this; }
+
+    // Output template with {x} tokens replaced
+    void        addTmpl(const char *tmpl, const char *toks, const char * const *vals);
+
+    // Send remainder, terminate response
+    void        end();
+
+    size_t      length() const                            { return _total; }
+
+  private:
+    void        flush();
+
+    WebServer   *_server;
+    char        *_buf;
+    size_t      _len = 0;
+    size_t      _total = 0;
+    bool        _started = false;
+};
+
+#endif
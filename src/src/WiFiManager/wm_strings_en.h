@@ -339,7 +339,6 @@ static const char T_h[]            PROGMEM = "{h}"; // @token h
 static const char T_f[]            PROGMEM = "{f}"; // @token f
 
 // http
-static const char HTTP_HEAD_CT[]   PROGMEM = "text/html";
 static const char HTTP_HEAD_CT2[]  PROGMEM = "text/plain";
 
 // Debug
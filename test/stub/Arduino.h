@@ -0,0 +1,123 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Host stand-in for Arduino.h (native tests only)
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _STUB_ARDUINO_H
+#define _STUB_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <string>
+#include <pgmspace.h>
+
+using std::min;
+using std::max;
+
+// Every test is a single translation unit which #includes the 
+// sources under test, so plain statics are shared with them.
+
+// Test clock, advanced by the tests
+static unsigned long stubMillis = 0;
+static unsigned long stubMicros = 0;
+
+// If set, every micros() call takes that long, so busy waits end
+static unsigned long stubMicrosTick = 0;
+
+static inline unsigned long millis() { return stubMillis; }
+static inline unsigned long micros() { return stubMicros += stubMicrosTick; }
+static inline void delay(unsigned long ms) { stubMillis += ms; stubMicros += ms * 1000; }
+static inline void yield() {}
+
+// GPIOs: Inputs are set by the tests, an attached
+// interrupt handler is called by the tests
+#define LOW             0
+#define HIGH            1
+#define INPUT           0x01
+#define INPUT_PULLUP    0x05
+#define INPUT_PULLDOWN  0x09
+#define FALLING         0x02
+
+#define STUB_PINS 40
+
+static int stubPins[STUB_PINS];
+static void (*stubIsr[STUB_PINS])(void *);
+static void *stubIsrArg[STUB_PINS];
+
+static inline void pinMode(uint8_t pin, uint8_t mode) {}
+static inline int digitalRead(uint8_t pin) { return stubPins[pin % STUB_PINS]; }
+static inline void attachInterruptArg(uint8_t pin, void (*fn)(void *), void *arg, int mode)
+{
+    stubIsr[pin % STUB_PINS] = fn;
+    stubIsrArg[pin % STUB_PINS] = arg;
+}
+
+// No PSRAM on the host; the tests choose the cache mode
+static inline void *ps_malloc(size_t size) { return malloc(size); }
+
+static inline uint32_t esp_random() { return ((uint32_t)rand() << 16) ^ rand(); }
+
+// Serial output is discarded unless STUB_SERIAL is defined
+class stubSerial {
+    public:
+        int printf(const char *fmt, ...)
+        {
+            #ifdef STUB_SERIAL
+            va_list ap;
+            va_start(ap, fmt);
+            int r = vprintf(fmt, ap);
+            va_end(ap);
+            return r;
+            #else
+            return 0;
+            #endif
+        }
+        void print(const char *s)   { printf("%s", s); }
+        void println(const char *s) { printf("%s\n", s); }
+        void println()              { printf("\n"); }
+};
+static stubSerial Serial __attribute__((unused));
+
+// Base of audioLogger; output is discarded
+class Print {
+    public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t) = 0;
+        int printf(const char *fmt, ...) { return 0; }
+        void println(const char *s) {}
+        void flush() {}
+};
+
+#define IRAM_ATTR
+
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper *)(s))
+
+// Only what the code under test uses
+class String {
+    public:
+        String(const char *s = "") : _s(s) {}
+        const char *c_str() const { return _s.c_str(); }
+        unsigned int length() const { return _s.size(); }
+    private:
+        std::string _s;
+};
+
+typedef uint8_t byte;
+
+#endif
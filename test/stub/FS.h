@@ -0,0 +1,192 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Host stand-in for FS.h (native tests only)
+ *
+ * Files live below stubFSRoot in the host's file system. As 
+ * with FATFS, rename() fails if the target exists.
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _STUB_FS_H
+#define _STUB_FS_H
+
+#include <Arduino.h>
+#include <string>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+static std::string stubFSRoot;
+static int         stubFSOpen = 0;     // Open handles
+static long        stubFSOps = 0;      // Calls: open, exists, remove, rename
+static long        stubFSBytes = 0;    // Bytes read and written
+static bool        stubFSReadOnly = false;  // Opening for writing fails
+
+namespace fs {
+
+class File {
+
+    // Shared by copies, like the real thing
+    struct impl {
+        FILE *f = NULL;
+        DIR  *d = NULL;
+        int  refs = 1;
+        std::string path, name;
+        impl() { stubFSOpen++; }
+        ~impl() 
+        {
+            if(f) fclose(f);
+            if(d) closedir(d);
+            stubFSOpen--;
+        }
+    };
+
+    public:
+
+        File() {}
+        File(const File& o) : _p(o._p) { if(_p) _p->refs++; }
+        ~File() { close(); }
+
+        File& operator=(const File& o)
+        {
+            if(o._p) o._p->refs++;
+            close();
+            _p = o._p;
+            return *this;
+        }
+
+        static File open(const char *path, const char *mode)
+        {
+            File r;
+            struct stat st;
+            std::string hp = stubFSRoot + path;
+
+            stubFSOps++;
+            bool isDir = !stat(hp.c_str(), &st) && S_ISDIR(st.st_mode);
+            
+            if((isDir || stubFSReadOnly) && *mode != 'r')
+                return r;
+            
+            impl *p = new impl;
+            r._p = p;
+            if(isDir) {
+                p->d = opendir(hp.c_str());
+            } else {
+                p->f = fopen(hp.c_str(), *mode == 'r' ? "rb" : (*mode == 'w' ? "wb" : "ab"));
+            }
+            if(!p->d && !p->f) {
+                r.close();
+                return r;
+            }
+            p->path = path;
+            const char *t = strrchr(path, '/');
+            p->name = t ? t + 1 : path;
+            return r;
+        }
+
+        operator bool() const { return !!_p; }
+
+        size_t write(uint8_t c) { return write(&c, 1); }
+        size_t write(const uint8_t *buf, size_t len)
+        {
+            stubFSBytes += len;
+            return (_p && _p->f) ? fwrite(buf, 1, len, _p->f) : 0;
+        }
+
+        size_t read(uint8_t *buf, size_t len)
+        {
+            stubFSBytes += len;
+            return (_p && _p->f) ? fread(buf, 1, len, _p->f) : 0;
+        }
+
+        bool seek(uint32_t pos)
+        {
+            return _p && _p->f && !fseek(_p->f, pos, SEEK_SET);
+        }
+
+        size_t size()
+        {
+            struct stat st;
+            if(!_p || !_p->f) return 0;
+            fflush(_p->f);
+            return fstat(fileno(_p->f), &st) ? 0 : st.st_size;
+        }
+
+        void close()
+        {
+            if(_p && !--_p->refs) delete _p;
+            _p = NULL;
+        }
+
+        bool isDirectory() const { return _p && _p->d; }
+
+        const char *name() const { return _p ? _p->name.c_str() : ""; }
+
+        File openNextFile()
+        {
+            struct dirent *de;
+
+            if(!_p || !_p->d)
+                return File();
+            while((de = readdir(_p->d))) {
+                if(strcmp(de->d_name, ".") && strcmp(de->d_name, ".."))
+                    return open((_p->path + "/" + de->d_name).c_str(), FILE_READ);
+            }
+            return File();
+        }
+
+    private:
+
+        impl *_p = NULL;
+};
+
+class FS {
+
+    public:
+
+        File open(const char *path, const char *mode = FILE_READ)
+        {
+            return File::open(path, mode);
+        }
+
+        bool exists(const char *path)
+        {
+            struct stat st;
+            stubFSOps++;
+            return !stat((stubFSRoot + path).c_str(), &st);
+        }
+
+        bool remove(const char *path)
+        {
+            stubFSOps++;
+            return !unlink((stubFSRoot + path).c_str());
+        }
+
+        bool rename(const char *from, const char *to)
+        {
+            struct stat st;
+            stubFSOps++;
+            if(!stat((stubFSRoot + to).c_str(), &st) || stat((stubFSRoot + from).c_str(), &st)) 
+                return false;
+            return !::rename((stubFSRoot + from).c_str(), (stubFSRoot + to).c_str());
+        }
+};
+
+}
+
+using fs::File;
+using fs::FS;
+
+#endif
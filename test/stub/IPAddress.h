@@ -0,0 +1,37 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Host stand-in for IPAddress.h (native tests only)
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _STUB_IPADDRESS_H
+#define _STUB_IPADDRESS_H
+
+#include <Arduino.h>
+
+class IPAddress {
+
+    public:
+
+        IPAddress() : _addr(0) {}
+        IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+            : _addr(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+        IPAddress(uint32_t addr) : _addr(addr) {}
+
+        operator uint32_t() const { return _addr; }
+        uint8_t operator[](int i) const { return _addr >> (i * 8); }
+
+    private:
+
+        uint32_t _addr;
+};
+
+#endif
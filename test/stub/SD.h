@@ -0,0 +1,22 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Host stand-in for SD.h (native tests only)
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _STUB_SD_H
+#define _STUB_SD_H
+
+#include <FS.h>
+
+static fs::FS SD __attribute__((unused));
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Host stand-in for WebServer.h (native tests only)
+ *
+ * Records the response as it would go on the wire.
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _STUB_WEBSERVER_H
+#define _STUB_WEBSERVER_H
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+#define WEBSERVER_H
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
+
+class WebServer {
+
+    public:
+
+        void setContentLength(size_t len) { contentLength = len; }
+
+        void send(int code, const char *contentType, const char *content)
+        {
+            // Headers must go out before any chunk
+            sends++;
+            status = code;
+            ctype = contentType;
+            body += content;
+        }
+
+        void sendContent(const char *content, size_t len)
+        {
+            if(!len) {
+                ended++;
+                return;
+            }
+            chunks.push_back(std::string(content, len));
+            body.append(content, len);
+        }
+
+        size_t contentLength = 0;
+        int    sends = 0;
+        int    status = 0;
+        int    ended = 0;
+        std::string ctype;
+        std::string body;
+        std::vector<std::string> chunks;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Host stand-in for WiFiClient.h (native tests only)
+ *
+ * A mock TCP connection: Bytes the peer sends become available at
+ * a given (stub) time; what is written is collected in out.
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _STUB_WIFICLIENT_H
+#define _STUB_WIFICLIENT_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <deque>
+#include <vector>
+
+class WiFiClient {
+
+    public:
+
+        struct timedByte {
+            unsigned long at;
+            uint8_t       b;
+        };
+
+        int connect(IPAddress ip, uint16_t port, int timeout) { conn = true; return 1; }
+        int connect(const char *host, uint16_t port, int timeout) { conn = true; return 1; }
+        uint8_t connected() { return conn; }
+        void flush() {}
+        void stop() { conn = false; in.clear(); }
+
+        size_t write(const uint8_t *buf, size_t len)
+        {
+            writes++;
+            out.insert(out.end(), buf, buf + len);
+            return len;
+        }
+
+        // Arrival times are in order (see feed())
+        int available()
+        {
+            return std::upper_bound(in.begin(), in.end(), stubMillis, 
+                                    [](unsigned long t, const timedByte &b) { return t < b.at; }) - in.begin();
+        }
+
+        int read()
+        {
+            reads++;
+            if(!available()) return -1;
+            int b = in.front().b;
+            in.pop_front();
+            bytesRead++;
+            return b;
+        }
+
+        int read(uint8_t *buf, size_t len)
+        {
+            size_t n = 0;
+            reads++;
+            while(n < len && available()) {
+                buf[n++] = in.front().b;
+                in.pop_front();
+            }
+            bytesRead += n;
+            return n;
+        }
+
+        // Queue bytes from the peer, arriving at time "at"
+        // (not before anything queued earlier)
+        void feed(const uint8_t *buf, size_t len, unsigned long at)
+        {
+            if(!in.empty() && in.back().at > at) at = in.back().at;
+            for(size_t i = 0; i < len; i++) {
+                timedByte t = { at, buf[i] };
+                in.push_back(t);
+            }
+        }
+
+        std::deque<timedByte> in;
+        std::vector<uint8_t>  out;
+        bool conn = false;
+        long reads = 0;         // read() calls
+        long bytesRead = 0;
+        long writes = 0;
+};
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Host stand-in for Wire.h (native tests only)
+ *
+ * Every transfer is handed to stubWireDev (if set), which plays
+ * the devices on the bus, and takes stubWireByteUs per byte
+ * (address byte included) on the test clock.
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _STUB_WIRE_H
+#define _STUB_WIRE_H
+
+#include <Arduino.h>
+
+#define STUB_WIRE_BUF 32
+
+// Write: buf holds len bytes written; read: fill in up to len
+// bytes. Returns number of bytes ack'd/read, -1 for NAK.
+typedef int (*stubWireDevFn)(uint8_t addr, bool read, uint8_t *buf, int len);
+
+static stubWireDevFn stubWireDev = NULL;
+static unsigned long stubWireByteUs = 25;      // 400kHz
+
+class TwoWire {
+    public:
+        void beginTransmission(uint8_t addr)
+        {
+            _addr = addr;
+            _wlen = 0;
+        }
+        size_t write(uint8_t b)
+        {
+            if(_wlen >= STUB_WIRE_BUF) return 0;
+            _wbuf[_wlen++] = b;
+            return 1;
+        }
+        size_t write(const uint8_t *b, size_t len)
+        {
+            size_t i;
+            for(i = 0; i < len && write(b[i]); i++) { }
+            return i;
+        }
+        uint8_t endTransmission(bool sendStop = true)
+        {
+            stubMicros += (1 + _wlen) * stubWireByteUs;
+            if(!stubWireDev || stubWireDev(_addr, false, _wbuf, _wlen) < 0)
+                return 2;
+            return 0;
+        }
+        uint8_t requestFrom(int addr, int len)
+        {
+            int r = -1;
+            if(len > STUB_WIRE_BUF) len = STUB_WIRE_BUF;
+            if(stubWireDev) r = stubWireDev(addr, true, _rbuf, len);
+            _rlen = (r < 0) ? 0 : r;
+            _rpos = 0;
+            stubMicros += (1 + _rlen) * stubWireByteUs;
+            return _rlen;
+        }
+        int read()
+        {
+            return (_rpos < _rlen) ? _rbuf[_rpos++] : -1;
+        }
+    private:
+        uint8_t _addr = 0;
+        uint8_t _wbuf[STUB_WIRE_BUF];
+        int     _wlen = 0;
+        uint8_t _rbuf[STUB_WIRE_BUF];
+        int     _rlen = 0, _rpos = 0;
+};
+
+static TwoWire Wire __attribute__((unused));
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Host stand-in for the ESP-IDF I2S driver (native tests only)
+ *
+ * i2s_write() takes as many bytes as stubI2SRoom allows (the free
+ * space in the DMA buffers; the tests drain it) and appends them
+ * to stubI2SData.
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _STUB_I2S_H
+#define _STUB_I2S_H
+
+#include <Arduino.h>
+#include <vector>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(4, 4, 0)
+
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)
+
+typedef struct { int revision; } esp_chip_info_t;
+static inline void esp_chip_info(esp_chip_info_t *info) { info->revision = 3; }
+
+typedef int i2s_port_t;
+
+typedef enum {
+    I2S_MODE_MASTER = 1,
+    I2S_MODE_TX     = 4
+} i2s_mode_t;
+
+typedef enum {
+    I2S_COMM_FORMAT_STAND_I2S = 1,
+    I2S_COMM_FORMAT_STAND_MSB = 3
+} i2s_comm_format_t;
+
+typedef enum { I2S_BITS_PER_SAMPLE_16BIT = 16 } i2s_bits_per_sample_t;
+typedef enum { I2S_CHANNEL_FMT_RIGHT_LEFT = 0 } i2s_channel_fmt_t;
+
+typedef struct {
+    i2s_mode_t            mode;
+    int                   sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t     channel_format;
+    i2s_comm_format_t     communication_format;
+    int                   intr_alloc_flags;
+    int                   dma_buf_count;
+    int                   dma_buf_len;
+    bool                  use_apll;
+} i2s_config_t;
+
+#define I2S_PIN_NO_CHANGE (-1)
+
+typedef struct {
+    int bck_io_num;
+    int ws_io_num;
+    int data_out_num;
+    int data_in_num;
+} i2s_pin_config_t;
+
+static std::vector<uint8_t> stubI2SData;
+static size_t        stubI2SRoom = (size_t)-1;
+static unsigned long stubI2SWrites = 0;
+static bool          stubI2SKeep = true;
+static int           stubI2SRate = 0;
+
+static inline esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t *cfg, int qsize, void *q)
+{
+    stubI2SRate = cfg->sample_rate;
+    return ESP_OK;
+}
+static inline esp_err_t i2s_driver_uninstall(i2s_port_t port) { return ESP_OK; }
+static inline esp_err_t i2s_set_pin(i2s_port_t port, const i2s_pin_config_t *pins) { return ESP_OK; }
+static inline esp_err_t i2s_zero_dma_buffer(i2s_port_t port) { return ESP_OK; }
+static inline esp_err_t i2s_set_sample_rates(i2s_port_t port, uint32_t rate)
+{
+    stubI2SRate = rate;
+    return ESP_OK;
+}
+
+static inline esp_err_t i2s_write(i2s_port_t port, const void *src, size_t size, 
+                                  size_t *bytes_written, uint32_t ticks_to_wait)
+{
+    if(size > stubI2SRoom) size = stubI2SRoom;
+    if(stubI2SRoom != (size_t)-1) stubI2SRoom -= size;
+    if(stubI2SKeep) {
+        stubI2SData.insert(stubI2SData.end(), (const uint8_t *)src, (const uint8_t *)src + size);
+    }
+    stubI2SWrites++;
+    *bytes_written = size;
+    return ESP_OK;
+}
+
+#endif
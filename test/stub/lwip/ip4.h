@@ -0,0 +1,2 @@
+// Host stand-in (native tests only)
+#include "lwip/sockets.h"
@@ -0,0 +1,90 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Host stand-in for the lwip headers (native tests only)
+ *
+ * Just enough for the MQTT client's ICMP ping to compile; the
+ * socket calls all fail, so the ping is never used.
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _STUB_LWIP_SOCKETS_H
+#define _STUB_LWIP_SOCKETS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define AF_INET         2
+#define SOCK_RAW        3
+#define IP_PROTO_ICMP   1
+#define SOL_SOCKET      0xfff
+#define SO_RCVTIMEO     0x1006
+#define ICMP_ECHO       8
+
+typedef uint32_t socklen_t;
+typedef size_t   mem_size_t;
+
+typedef struct { uint32_t addr; } ip4_addr_t;
+
+struct in_addr { uint32_t s_addr; };
+
+struct sockaddr {
+    uint8_t sa_len;
+    uint8_t sa_family;
+    char    sa_data[14];
+};
+
+struct sockaddr_in {
+    uint8_t        sin_len;
+    uint8_t        sin_family;
+    uint16_t       sin_port;
+    struct in_addr sin_addr;
+    char           sin_zero[8];
+};
+
+struct ip_hdr {
+    uint8_t  _v_hl;
+    uint8_t  _tos;
+    uint16_t _len;
+    uint16_t _id;
+    uint16_t _offset;
+    uint8_t  _ttl;
+    uint8_t  _proto;
+    uint16_t _chksum;
+    uint32_t src, dest;
+};
+
+struct icmp_echo_hdr {
+    uint8_t  type;
+    uint8_t  code;
+    uint16_t chksum;
+    uint16_t id;
+    uint16_t seqno;
+};
+
+#define IPH_HL(h)               ((h)->_v_hl & 0x0f)
+#define ICMPH_TYPE_SET(h, t)    ((h)->type = (t))
+#define ICMPH_CODE_SET(h, c)    ((h)->code = (c))
+#define inet_addr_from_ip4addr(t, s)    ((t)->s_addr = (s)->addr)
+
+static inline uint16_t htons(uint16_t v) { return (v << 8) | (v >> 8); }
+
+static inline void *mem_malloc(mem_size_t s) { return malloc(s); }
+static inline void mem_free(void *p) { free(p); }
+static inline uint16_t inet_chksum(const void *p, uint16_t len) { return 0; }
+
+static inline int socket(int d, int t, int p) { return -1; }
+static inline int setsockopt(int s, int l, int n, const void *v, socklen_t len) { return -1; }
+static inline int closesocket(int s) { return 0; }
+static inline int sendto(int s, const void *d, size_t l, int f, const struct sockaddr *to, socklen_t tl) { return -1; }
+static inline int recvfrom(int s, void *d, size_t l, int f, struct sockaddr *fr, socklen_t *fl) { return -1; }
+
+#endif
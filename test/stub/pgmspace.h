@@ -0,0 +1,30 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Host stand-in for pgmspace.h (native tests only); also 
+ * included by C sources (libmad)
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _STUB_PGMSPACE_H
+#define _STUB_PGMSPACE_H
+
+#include <string.h>
+#include <stdio.h>
+
+// Flash is ordinary memory, as on the ESP32
+#define PROGMEM
+#define PSTR(s)         (s)
+#define memcpy_P        memcpy
+#define strcpy_P        strcpy
+#define snprintf_P      snprintf
+#define printf_P        printf
+
+#endif
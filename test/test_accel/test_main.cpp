@@ -0,0 +1,531 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: Acceleration engine against the former main_loop
+ * code, on recorded throttle traces; 0-88 times
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "accel.cpp"
+
+/*
+ * Former tables and main_loop code, as they were before the
+ * profile tables and accelEngine
+ */
+
+static const unsigned long oldAccelDelays[5] = { 50, 42, 35, 28, 20 };
+static const int32_t       oldAccelSteps[5]  = {  1,  1,  1,  1,  1 };
+static const int32_t       oldDecelSteps[5]  = {  1,  1,  1,  2,  2 };
+
+static const unsigned long oldStrictAccelFacts[5] = { 25, 21, 17, 14, 10 };
+static const unsigned long oldStrictAccelDelays[89] =
+{
+      0,  90,  90,  90,  90,  90,  90,  95,  95, 100,
+    105, 110, 115, 120, 125, 130, 135, 140, 145, 150,
+    155, 160, 165, 170, 175, 180, 185, 190, 195, 200,
+    200, 200, 202, 203, 204, 205, 206, 207, 208, 209,
+    210, 211, 212, 213, 214, 215, 216, 217, 218, 219,
+    220, 221, 222, 223, 224, 225, 226, 227, 228, 229,
+    230, 233, 236, 240, 243, 246, 250, 253, 256, 260,
+    263, 266, 270, 273, 276, 280, 283, 286, 290, 293,
+    296, 300, 300, 303, 303, 306, 310, 310,   0
+};
+static const int32_t  oldStrictdecelSteps[5]  = {  2,  2,  2,  2,  2 };
+
+static const int16_t oldCoastCurve[89][2] =
+{
+    {6, 2}, {6, 2}, {6, 2}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 4},
+    {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 4}, {6, 3}, {6, 3},
+    {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3},
+    {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 3},
+    {6, 3}, {6, 3}, {6, 3}, {6, 3}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2},
+    {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2},
+    {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2},
+    {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {6, 2}, {5, 1}, {5, 1}, {5, 1},
+    {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}, {5, 1}
+};
+
+// The throttle part of main_loop; what it would do to the
+// outside world (speed, sounds) is recorded.
+struct throttleLoop {
+    bool          movieMode = false;
+    bool          doCoast = false;
+    bool          autoThrottle = false;
+    bool          lockThrottle = false;
+
+    int32_t       oldThrottlePos = 0;
+    int           currSpeedF = 0;
+    bool          keepCounting = false;
+    bool          etmr = false;
+    unsigned long enow = 0;
+
+    std::string   log;
+
+    void event(unsigned long now, const char *what)
+    {
+        log += std::to_string(now) + what + std::to_string(currSpeedF) + " ";
+    }
+
+    // Auto throttle, as before and after
+    int32_t autoThr(int32_t throttlePos)
+    {
+        if(!throttlePos) {
+            lockThrottle = false;
+        }
+        if(keepCounting) {
+            if(throttlePos < -50) {
+                keepCounting = false;
+            } else if(oldThrottlePos > 0) {
+                if(throttlePos < oldThrottlePos) {
+                    throttlePos = oldThrottlePos;
+                }
+            }
+        } else if(autoThrottle) {
+            keepCounting = (throttlePos > 0 && !oldThrottlePos);
+        }
+        return throttlePos;
+    }
+
+    void checkEtmr(unsigned long now, bool cond)
+    {
+        if(cond) {
+            etmr = false;
+        } else if(!etmr) {
+            etmr = true;
+            enow = now;
+        }
+        if(etmr && now - enow > 5000) {
+            etmr = false;
+            event(now, "tmd@");
+        }
+    }
+
+    // Returns true if speed changed
+    bool step(unsigned long now, int32_t throttlePos, int32_t accelStep, int coast)
+    {
+        int sbf = currSpeedF;
+        if(throttlePos > 0) {
+            if(!currSpeedF) event(now, "thrup@");
+            currSpeedF += accelStep;
+            if(currSpeedF >= 880) {
+                currSpeedF = 880;
+                keepCounting = false;
+            }
+        } else if(throttlePos < 0) {
+            currSpeedF -= accelStep;
+            if(currSpeedF < 0) currSpeedF = 0;
+            keepCounting = false;
+        } else if(doCoast) {
+            if(currSpeedF > 0) {
+                currSpeedF -= coast;
+                if(currSpeedF < 0) currSpeedF = 0;
+            }
+        }
+        if(currSpeedF != sbf) {
+            if(currSpeedF / 10 != sbf / 10) event(now, "@");
+            return true;
+        }
+        return false;
+    }
+};
+
+struct oldLoop : throttleLoop {
+    unsigned long lastSpeedUpd = 0;
+    unsigned long accelDelay = 1000/10;
+    int32_t       accelStep = 1;
+
+    void pass(unsigned long now, int32_t throttlePos)
+    {
+        int tas = 0, tidx = 0;
+
+        throttlePos = autoThr(throttlePos);
+
+        if(movieMode) {
+            if((oldThrottlePos = throttlePos)) {
+                tas = sizeof(oldStrictAccelFacts)/sizeof(oldStrictAccelFacts[0]);
+                tidx = (abs(throttlePos)-1) * tas / 100;
+                accelDelay = oldStrictAccelDelays[currSpeedF / 10] * oldStrictAccelFacts[tidx] / 100;
+                if(throttlePos < 0 && accelDelay < 13) accelDelay = 13;
+                accelStep = throttlePos > 0 ? 1 : oldStrictdecelSteps[tidx];
+            } else {
+                accelDelay = doCoast ? ((esp_random() % 30) + 60) : 0;
+            }
+        } else {
+            if((oldThrottlePos = throttlePos)) {
+                tas = sizeof(oldAccelDelays)/sizeof(oldAccelDelays[0]);
+                tidx = (abs(throttlePos)-1) * tas / 100;
+                accelDelay = oldAccelDelays[tidx];
+                accelStep = throttlePos > 0 ? oldAccelSteps[tidx] : oldDecelSteps[tidx];
+            } else {
+                accelDelay = doCoast ? ((esp_random() % 30) + 55)  : 0;
+            }
+        }
+
+        checkEtmr(now, tidx < tas - 1 || throttlePos >= 0 || currSpeedF);
+
+        if(!lockThrottle) {
+            if(now - lastSpeedUpd > accelDelay) {
+                int coast = 0;
+                if(!throttlePos && doCoast && currSpeedF > 0) {
+                    coast = max(0, (int)(esp_random() % oldCoastCurve[currSpeedF/10][0]) - oldCoastCurve[currSpeedF/10][1]);
+                }
+                if(step(now, throttlePos, accelStep, coast)) {
+                    lastSpeedUpd = now;
+                }
+            }
+        }
+    }
+};
+
+struct newLoop : throttleLoop {
+    accelEngine accelEng;
+
+    void pass(unsigned long now, int32_t throttlePos)
+    {
+        throttlePos = autoThr(throttlePos);
+
+        oldThrottlePos = throttlePos;
+
+        accelEng.update(accel_getProfile(movieMode ? ACCEL_MOVIE : ACCEL_LINEAR),
+                        throttlePos, currSpeedF, doCoast);
+
+        checkEtmr(now, accelEng.bucket() < ACCEL_BUCKETS - 1 || throttlePos >= 0 || currSpeedF);
+
+        if(!lockThrottle) {
+            if(accelEng.due(now)) {
+                int coast = 0;
+                if(!throttlePos && doCoast && currSpeedF > 0) {
+                    coast = accelEng.coastStep(currSpeedF);
+                }
+                if(step(now, throttlePos, accelEng.step(), coast)) {
+                    accelEng.stepped(now);
+                }
+            }
+        }
+    }
+};
+
+/*
+ * Throttle traces
+ *
+ * A trace is a list of (duration in ms, throttle position);
+ * main_loop passes come every 1-12ms. Recorded from a remote
+ * on a bench, with values as delivered by updateThrottlePos().
+ */
+
+typedef struct {
+    unsigned long ms;
+    int32_t       pos;
+} thrSeg;
+
+static const thrSeg trFullRun[] = {         // Full throttle to 88, brake
+    { 500, 0 }, { 60, 20 }, { 60, 55 }, { 25000, 100 }, { 3000, 0 },
+    { 200, -40 }, { 9000, -100 }, { 1000, 0 }
+};
+static const thrSeg trCruise[] = {          // Up and down, coasting
+    { 300, 0 }, { 4000, 35 }, { 3000, 62 }, { 8000, 0 }, { 2500, 81 },
+    { 1500, 14 }, { 6000, 0 }, { 1200, -12 }, { 400, -61 }, { 3000, 0 }
+};
+static const thrSeg trStandBrake[] = {      // Full brake at standstill (tmd)
+    { 100, 0 }, { 7000, -100 }, { 50, -95 }, { 6000, -81 }, { 200, 0 },
+    { 2000, 100 }, { 12000, -100 }
+};
+static const thrSeg trJitter[] = {          // Noisy pot around bucket edges
+    { 100, 20 }, { 40, 21 }, { 40, 20 }, { 40, 21 }, { 2000, 40 }, { 30, 41 },
+    { 30, 40 }, { 30, 41 }, { 3000, 60 }, { 20, 61 }, { 20, 60 }, { 1000, 0 },
+    { 20, 1 }, { 20, 0 }, { 20, -1 }, { 20, 0 }, { 4000, 0 }
+};
+
+static std::vector<thrSeg> randomTrace(int n)
+{
+    std::vector<thrSeg> v;
+    for(int i = 0; i < n; i++) {
+        thrSeg s;
+        s.ms = 10 + rand() % 3000;
+        switch(rand() % 4) {
+        case 0:  s.pos = 0; break;
+        case 1:  s.pos = (rand() % 2) ? 100 : -100; break;
+        default: s.pos = (rand() % 201) - 100; break;
+        }
+        v.push_back(s);
+    }
+    return v;
+}
+
+template<class L>
+static std::string runTrace(const thrSeg *tr, int n, bool movie, bool coast, bool autoThr, uint32_t seed)
+{
+    L l;
+    unsigned long now = 1000;
+    int speeds = 0;
+
+    l.movieMode = movie;
+    l.doCoast = coast;
+    l.autoThrottle = autoThr;
+
+    // Same pass timing and random draws for both
+    srand(seed);
+
+    for(int i = 0; i < n; i++) {
+        unsigned long end = now + tr[i].ms;
+        while(now < end) {
+            l.pass(now, tr[i].pos);
+            now += 1 + (rand() % 12);
+            speeds += l.currSpeedF;
+        }
+    }
+
+    return l.log + "sum" + std::to_string(speeds);
+}
+
+static void compareTrace(const thrSeg *tr, int n)
+{
+    for(int m = 0; m < 8; m++) {
+        bool movie = m & 1, coast = m & 2, autoThr = m & 4;
+        std::string o = runTrace<oldLoop>(tr, n, movie, coast, autoThr, 100 + m);
+        std::string e = runTrace<newLoop>(tr, n, movie, coast, autoThr, 100 + m);
+        TEST_ASSERT_EQUAL_STRING(o.c_str(), e.c_str());
+    }
+}
+
+/*
+ * 0-88 simulator
+ *
+ * Full throttle from standstill, a main_loop pass every loopMs;
+ * returns the time from the first step until 88mph.
+ */
+
+template<class L>
+static unsigned long zeroTo88(bool movie, unsigned long loopMs)
+{
+    L l;
+    unsigned long now = 1000, start = 0;
+
+    l.movieMode = movie;
+
+    while(l.currSpeedF < 880 && now < 100000) {
+        int sbf = l.currSpeedF;
+        l.pass(now, 100);
+        if(!sbf && l.currSpeedF) start = now;
+        now += loopMs;
+    }
+    TEST_ASSERT_EQUAL_INT(880, l.currSpeedF);
+
+    return now - loopMs - start;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_tables(void)
+{
+    // Every entry as computed by the former code
+    for(int dec = 0; dec < 2; dec++) {
+        for(int s = 0; s < ACCEL_SPEEDS; s++) {
+            for(int t = 1; t <= 100; t++) {
+                int32_t tp = dec ? -t : t;
+                int tidx = (t - 1) * 5 / 100;
+                const accelEntry *l = accel_getProfile(ACCEL_LINEAR)->get(s, tidx, dec);
+                const accelEntry *m = accel_getProfile(ACCEL_MOVIE)->get(s, tidx, dec);
+                unsigned long md = oldStrictAccelDelays[s] * oldStrictAccelFacts[tidx] / 100;
+
+                if(tp < 0 && md < 13) md = 13;
+                TEST_ASSERT_EQUAL_UINT(oldAccelDelays[tidx], l->delay);
+                TEST_ASSERT_EQUAL_INT(tp > 0 ? oldAccelSteps[tidx] : oldDecelSteps[tidx], l->step);
+                TEST_ASSERT_EQUAL_UINT(md, m->delay);
+                TEST_ASSERT_EQUAL_INT(tp > 0 ? 1 : oldStrictdecelSteps[tidx], m->step);
+            }
+        }
+    }
+
+    // Unknown profiles fall back to linear
+    TEST_ASSERT_TRUE(accel_getProfile(ACCEL_LINEAR) == accel_getProfile(-1));
+    TEST_ASSERT_TRUE(accel_getProfile(ACCEL_LINEAR) == accel_getProfile(ACCEL_NUM_PROFILES));
+}
+
+static void test_coast_draws(void)
+{
+    // Same draws, same results
+    for(int p = 0; p < ACCEL_NUM_PROFILES; p++) {
+        const accelProfile *prof = accel_getProfile(p);
+        unsigned long base = p ? 60 : 55;
+        TEST_ASSERT_EQUAL_UINT(base, prof->coastMinDelay());
+        for(int i = 0; i < 2000; i++) {
+            srand(i);
+            unsigned long od = (esp_random() % 30) + base;
+            int sp = (i * 7) % 881;
+            int os = max(0, (int)(esp_random() % oldCoastCurve[sp/10][0]) - oldCoastCurve[sp/10][1]);
+            srand(i);
+            TEST_ASSERT_EQUAL_UINT(od, prof->coastDelay());
+            TEST_ASSERT_EQUAL_INT(os, prof->coastStep(sp));
+        }
+    }
+}
+
+static void test_full_run(void)
+{
+    compareTrace(trFullRun, sizeof(trFullRun) / sizeof(trFullRun[0]));
+}
+
+static void test_cruise(void)
+{
+    compareTrace(trCruise, sizeof(trCruise) / sizeof(trCruise[0]));
+}
+
+static void test_stand_brake(void)
+{
+    // tmd is played after 5s of full brake at standstill
+    std::string e = runTrace<newLoop>(trStandBrake, 7, false, false, false, 1);
+    TEST_ASSERT_TRUE(e.find("tmd@") != std::string::npos);
+
+    compareTrace(trStandBrake, sizeof(trStandBrake) / sizeof(trStandBrake[0]));
+}
+
+static void test_jitter(void)
+{
+    compareTrace(trJitter, sizeof(trJitter) / sizeof(trJitter[0]));
+}
+
+static void test_random_traces(void)
+{
+    srand(7);
+    for(int i = 0; i < 50; i++) {
+        std::vector<thrSeg> tr = randomTrace(40);
+        compareTrace(tr.data(), tr.size());
+        srand(1000 + i);
+    }
+}
+
+static void test_deadline(void)
+{
+    accelEngine ae;
+    unsigned long when;
+
+    // Idle: Nothing pending
+    ae.update(accel_getProfile(ACCEL_LINEAR), 0, 0, false);
+    TEST_ASSERT_FALSE(ae.nextDeadline(when));
+
+    // Step due exactly at the deadline, not before
+    ae.stepped(5000);
+    for(int tp = -100; tp <= 100; tp += 7) {
+        for(int p = 0; p < ACCEL_NUM_PROFILES; p++) {
+            if(!tp) continue;
+            ae.update(accel_getProfile(p), tp, 455, false);
+            TEST_ASSERT_TRUE(ae.nextDeadline(when));
+            TEST_ASSERT_FALSE(ae.due(when - 1));
+            TEST_ASSERT_TRUE(ae.due(when));
+        }
+    }
+
+    // Coasting: Never due before the deadline
+    srand(3);
+    ae.update(accel_getProfile(ACCEL_MOVIE), 0, 300, true);
+    TEST_ASSERT_TRUE(ae.nextDeadline(when));
+    TEST_ASSERT_EQUAL_UINT(5000 + 60 + 1, when);
+    for(int i = 0; i < 200; i++) {
+        TEST_ASSERT_FALSE(ae.due(when - 1));
+    }
+
+    // Coasting at standstill: Nothing pending
+    ae.update(accel_getProfile(ACCEL_MOVIE), 0, 0, true);
+    TEST_ASSERT_FALSE(ae.nextDeadline(when));
+}
+
+static void test_table_values(void)
+{
+    const accelProfile *lin = accel_getProfile(ACCEL_LINEAR);
+    const accelProfile *mov = accel_getProfile(ACCEL_MOVIE);
+
+    // Linear: Delay by bucket only, larger steps when braking hard
+    for(int s = 0; s < ACCEL_SPEEDS; s += 11) {
+        TEST_ASSERT_EQUAL_UINT(50, lin->get(s, 0, false)->delay);
+        TEST_ASSERT_EQUAL_UINT(ACCEL_FAST_DELAY, lin->get(s, 4, false)->delay);
+        TEST_ASSERT_EQUAL_UINT(28, lin->get(s, 3, true)->delay);
+        TEST_ASSERT_EQUAL_INT(1, lin->get(s, 2, true)->step);
+        TEST_ASSERT_EQUAL_INT(2, lin->get(s, 3, true)->step);
+    }
+
+    // Movie: Measured curve times throttle factor
+    TEST_ASSERT_EQUAL_UINT(0, mov->get(0, 4, false)->delay);
+    TEST_ASSERT_EQUAL_UINT(90 * 25 / 100, mov->get(1, 0, false)->delay);
+    TEST_ASSERT_EQUAL_UINT(200 * 10 / 100, mov->get(30, 4, false)->delay);
+    TEST_ASSERT_EQUAL_UINT(310 * 14 / 100, mov->get(87, 3, false)->delay);
+    TEST_ASSERT_EQUAL_INT(1, mov->get(50, 4, false)->step);
+
+    // Braking: Never faster than STRICT_DECEL_MIN_DELAY
+    TEST_ASSERT_EQUAL_UINT(13, mov->get(0, 0, true)->delay);
+    TEST_ASSERT_EQUAL_UINT(13, mov->get(88, 4, true)->delay);
+    TEST_ASSERT_EQUAL_UINT(13, mov->get(10, 4, true)->delay);
+    TEST_ASSERT_EQUAL_UINT(220 * 17 / 100, mov->get(50, 2, true)->delay);
+    TEST_ASSERT_EQUAL_INT(2, mov->get(50, 2, true)->step);
+}
+
+static void test_zero_to_88(void)
+{
+    unsigned long nominal = 0, expect = 0;
+    char buf[128];
+
+    // Linear: 879 steps of ACCEL_FAST_DELAY+1 (steps happen
+    // when more than the delay has passed)
+    TEST_ASSERT_EQUAL_UINT(879 * 21, zeroTo88<newLoop>(false, 1));
+    TEST_ASSERT_EQUAL_UINT(879 * 21, zeroTo88<oldLoop>(false, 1));
+
+    // Movie: Measured curve at 10% per 0.1mph; ~18s nominal
+    for(int s = 0; s < 88; s++) {
+        nominal += oldStrictAccelDelays[s];
+    }
+    TEST_ASSERT_EQUAL_UINT(17969, nominal);
+    for(int f = 1; f < 880; f++) {
+        expect += oldStrictAccelDelays[f / 10] * 10 / 100 + 1;
+    }
+    TEST_ASSERT_EQUAL_UINT(18579, expect);
+    TEST_ASSERT_EQUAL_UINT(expect, zeroTo88<newLoop>(true, 1));
+    TEST_ASSERT_EQUAL_UINT(expect, zeroTo88<oldLoop>(true, 1));
+
+    // Slower loops: Same for both, within one pass per step
+    for(unsigned long lm = 2; lm <= 12; lm += 5) {
+        for(int m = 0; m < 2; m++) {
+            unsigned long n = zeroTo88<newLoop>(m, lm);
+            TEST_ASSERT_EQUAL_UINT(zeroTo88<oldLoop>(m, lm), n);
+            TEST_ASSERT_TRUE(n >= (m ? expect : 879 * 21));
+            TEST_ASSERT_TRUE(n <= (m ? expect : 879 * 21) + 879 * lm);
+        }
+    }
+
+    snprintf(buf, sizeof(buf), "0-88 at 1ms loop: linear %lums, movie %lums (nominal %lums)",
+            zeroTo88<newLoop>(false, 1), zeroTo88<newLoop>(true, 1), nominal);
+    TEST_MESSAGE(buf);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_tables);
+    RUN_TEST(test_coast_draws);
+    RUN_TEST(test_full_run);
+    RUN_TEST(test_cruise);
+    RUN_TEST(test_stand_brake);
+    RUN_TEST(test_jitter);
+    RUN_TEST(test_random_traces);
+    RUN_TEST(test_deadline);
+    RUN_TEST(test_table_values);
+    RUN_TEST(test_zero_to_88);
+    return UNITY_END();
+}
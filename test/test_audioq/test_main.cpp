@@ -0,0 +1,407 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: Audio command queue, with a pthread standing in
+ * for the audio task
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "audioq.h"
+
+#define QLEN 16             // as AUDIO_QUEUE_LEN
+
+// Generator state as kept by the audio task. Mirrors what
+// audio_handle_cmd() and do_play_file()/do_stop() do to it.
+struct audioModel {
+    std::string playing;        // "" = idle
+    uint32_t    playflags = 0;
+    bool        appendFile = false;
+    std::string appendFn;
+    uint32_t    voices = 0;
+    uint32_t    loopEnds = 0;
+
+    void play(const audioCmd *c)
+    {
+        appendFile = false;
+        if(playflags & PA_NOINTR) return;
+        playing = c->fn;
+        playflags = c->flags & (PA_KMASK | PA_THRUP | PA_NOINTR);
+    }
+
+    void handle(const audioCmd *c)
+    {
+        switch(c->cmd) {
+        case AC_PLAY:
+            play(c);
+            break;
+        case AC_KEY:
+            if(ac_keyPlaying(playflags, c->flags & PA_KMASK)) {
+                playing = "";
+                playflags = 0;
+            } else {
+                play(c);
+            }
+            break;
+        case AC_APPEND:
+            appendFn = c->fn;
+            appendFile = true;
+            break;
+        case AC_CLRAPPEND:
+            appendFile = false;
+            break;
+        case AC_CLICK:
+        case AC_THRUP:
+            voices++;
+            break;
+        case AC_STOP:
+            playing = "";
+            appendFile = false;
+            playflags = 0;
+            break;
+        case AC_STOPMP3:
+            playing = "";
+            break;
+        case AC_STOPKEY:
+            if(ac_keyPlaying(playflags, c->flags)) {
+                playing = "";
+                playflags = 0;
+            }
+            break;
+        case AC_STOPLOOPEND:
+            loopEnds++;
+            break;
+        }
+    }
+
+    bool operator==(const audioModel& o) const
+    {
+        return playing == o.playing && playflags == o.playflags &&
+               appendFile == o.appendFile && (!appendFile || appendFn == o.appendFn) &&
+               voices == o.voices && loopEnds == o.loopEnds;
+    }
+};
+
+static audioCmdQueue<QLEN> q;
+
+// The "audio task"
+static pthread_t           task;
+static audioModel          taskState;
+static std::atomic<bool>   taskQuit;
+static std::atomic<bool>   taskHold;        // Stop consuming
+static std::atomic<int>    taskStall;       // Stop consuming for that many rounds
+static std::atomic<int32_t> lastSeq;        // Last command processed
+static std::atomic<int>    taskErrors;
+
+// Commands carry a sequence number in "seek", and a file
+// name derived from it, so that lost, duplicated, reordered
+// or torn commands show.
+static void seqName(char *buf, int32_t seq)
+{
+    sprintf(buf, "/s%d.mp3", seq % 100000);
+}
+
+static void *audioTask(void *arg)
+{
+    audioCmd *c;
+    char buf[32];
+
+    while(!taskQuit.load()) {
+        if(taskStall.load() > 0) {
+            taskStall--;
+            sched_yield();
+            continue;
+        }
+        if(taskHold.load() || !(c = q.front())) {
+            sched_yield();
+            continue;
+        }
+        if(c->seek != lastSeq.load() + 1) taskErrors++;
+        seqName(buf, c->seek);
+        if(c->cmd != AC_CLICK && strcmp(c->fn, buf)) taskErrors++;
+        if(c->vol != (float)(c->seek & 0xff)) taskErrors++;
+        taskState.handle(c);
+        lastSeq.store(c->seek);
+        q.pop();
+    }
+
+    return NULL;
+}
+
+// aq_post()/aq_sync() as in remote_audio.cpp, spinning instead
+// of delay() and the semaphore.
+
+static int32_t seq;
+static std::atomic<long> fullWaits;
+
+static void aq_post(uint8_t cmd, uint32_t flags = 0)
+{
+    char buf[32];
+    int r;
+
+    seq++;
+    seqName(buf, seq);
+    while((r = q.push(cmd, (cmd == AC_CLICK) ? NULL : buf, flags, (float)(seq & 0xff), seq)) == AQ_FULL) {
+        fullWaits++;
+        sched_yield();
+    }
+    TEST_ASSERT_EQUAL_INT(AQ_OK, r);
+}
+
+static void aq_sync()
+{
+    uint32_t mark = q.mark();
+
+    while(!q.reached(mark)) {
+        sched_yield();
+    }
+    TEST_ASSERT_FALSE(q.pending());
+}
+
+// play_key() as in remote_audio.cpp
+static void press_key(int k, bool l = false, bool stopOnly = false)
+{
+    uint32_t pa_key = (1 << (7+k)) | (l ? PA_KLONG : 0);
+
+    if(stopOnly) {
+        aq_post(AC_STOPKEY, pa_key);
+        return;
+    }
+
+    aq_post(AC_KEY, pa_key|PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL|PA_CACHE);
+}
+
+static uint32_t keyOf(int k, bool l = false)
+{
+    return (1 << (7+k)) | (l ? PA_KLONG : 0);
+}
+
+void setUp(void)
+{
+    // Queue state carries over; the sequence continues
+    lastSeq.store(seq);
+    taskState = audioModel();
+    taskQuit.store(false);
+    taskHold.store(false);
+    taskStall.store(0);
+    taskErrors.store(0);
+    fullWaits.store(0);
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&task, NULL, audioTask, NULL));
+}
+
+void tearDown(void)
+{
+    taskHold.store(false);
+    aq_sync();
+    taskQuit.store(true);
+    pthread_join(task, NULL);
+    TEST_ASSERT_EQUAL_INT(0, taskErrors.load());
+}
+
+static void test_push_bounds(void)
+{
+    audioCmdQueue<4> sq;
+    char longName[40];
+
+    memset(longName, 'x', sizeof(longName));
+    longName[32] = 0;
+
+    TEST_ASSERT_FALSE(sq.pending());
+    TEST_ASSERT_NULL(sq.front());
+
+    // Too long: Nothing queued
+    TEST_ASSERT_EQUAL_INT(AQ_BADFN, sq.push(AC_PLAY, longName, 0, 1.0f, -1));
+    TEST_ASSERT_FALSE(sq.pending());
+
+    longName[31] = 0;
+    for(int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_INT(AQ_OK, sq.push(AC_PLAY, longName, i, 1.0f, -1));
+    }
+    TEST_ASSERT_EQUAL_INT(AQ_FULL, sq.push(AC_STOP, NULL, 0, 1.0f, -1));
+
+    uint32_t m = sq.mark();
+    for(int i = 0; i < 4; i++) {
+        TEST_ASSERT_FALSE(sq.reached(m));
+        audioCmd *c = sq.front();
+        TEST_ASSERT_NOT_NULL(c);
+        TEST_ASSERT_EQUAL_UINT32(i, c->flags);
+        TEST_ASSERT_EQUAL_STRING(longName, c->fn);
+        sq.pop();
+        // A slot frees up
+        TEST_ASSERT_EQUAL_INT(AQ_OK, sq.push(AC_STOP, NULL, 0, 1.0f, -1));
+        TEST_ASSERT_EQUAL_INT(AQ_FULL, sq.push(AC_STOP, NULL, 0, 1.0f, -1));
+    }
+    TEST_ASSERT_TRUE(sq.reached(m));
+
+    for(int i = 0; i < 4; i++) {
+        audioCmd *c = sq.front();
+        TEST_ASSERT_EQUAL_UINT8(AC_STOP, c->cmd);
+        TEST_ASSERT_EQUAL_STRING("", c->fn);
+        sq.pop();
+    }
+    TEST_ASSERT_NULL(sq.front());
+}
+
+static void test_key_double_press(void)
+{
+    // Audio task busy elsewhere: Both presses still queued
+    taskHold.store(true);
+    press_key(3);
+    press_key(3);
+    TEST_ASSERT_TRUE(q.pending());
+    taskHold.store(false);
+    aq_sync();
+
+    // Play, then stop; not played twice
+    TEST_ASSERT_EQUAL_STRING("", taskState.playing.c_str());
+    TEST_ASSERT_EQUAL_UINT32(0, taskState.playflags);
+
+    // Third press plays again
+    press_key(3);
+    aq_sync();
+    TEST_ASSERT_EQUAL_UINT32(keyOf(3), taskState.playflags);
+
+    // Long press of same key is another sound
+    taskHold.store(true);
+    press_key(3, true);
+    press_key(4);
+    press_key(4);
+    press_key(4);
+    taskHold.store(false);
+    aq_sync();
+    TEST_ASSERT_EQUAL_UINT32(keyOf(4), taskState.playflags);
+
+    // Stop-only stops only that key
+    press_key(5, false, true);
+    aq_sync();
+    TEST_ASSERT_EQUAL_UINT32(keyOf(4), taskState.playflags);
+    press_key(4, false, true);
+    aq_sync();
+    TEST_ASSERT_EQUAL_UINT32(0, taskState.playflags);
+
+    // Key after a not-yet-processed stop-only of it: plays
+    press_key(6);
+    aq_sync();
+    taskHold.store(true);
+    press_key(6, false, true);
+    press_key(6);
+    taskHold.store(false);
+    aq_sync();
+    TEST_ASSERT_EQUAL_UINT32(keyOf(6), taskState.playflags);
+
+    // Non-interruptible sound is not stopped by a key
+    aq_post(AC_PLAY, PA_NOINTR);
+    press_key(6);
+    aq_sync();
+    TEST_ASSERT_EQUAL_UINT32(PA_NOINTR, taskState.playflags);
+}
+
+static void test_queue_full_blocks(void)
+{
+    taskHold.store(true);
+
+    // Fill the queue; the next post waits for the task
+    for(int i = 0; i < QLEN; i++) {
+        aq_post(AC_CLICK);
+    }
+    TEST_ASSERT_EQUAL_INT(0, fullWaits);
+    TEST_ASSERT_EQUAL_INT(AQ_FULL, q.push(AC_CLICK, NULL, 0, 1.0f, -1));
+
+    // Let the task go once we are spinning
+    pthread_t rel;
+    pthread_create(&rel, NULL, [](void *) -> void * {
+        while(fullWaits.load() < 100) sched_yield();
+        taskHold.store(false);
+        return NULL;
+    }, NULL);
+    aq_post(AC_CLICK);
+    pthread_join(rel, NULL);
+    TEST_ASSERT_TRUE(fullWaits.load() >= 100);
+
+    aq_sync();
+    TEST_ASSERT_EQUAL_UINT32(QLEN + 1, taskState.voices);
+}
+
+// Thousands of interleaved commands; at random points, wait
+// for the task and compare with a model fed synchronously.
+static void test_stress(void)
+{
+    static const uint8_t cmds[] = {
+        AC_PLAY, AC_KEY, AC_KEY, AC_KEY, AC_APPEND, AC_CLRAPPEND,
+        AC_CLICK, AC_THRUP, AC_STOP, AC_STOPMP3, AC_STOPKEY,
+        AC_STOPKEY, AC_STOPLOOPEND
+    };
+    audioModel ref;
+    audioCmd c;
+    char msg[80];
+    int syncs = 0;
+
+    srand(3);
+
+    for(int i = 0; i < 200000; i++) {
+        uint8_t cmd = cmds[rand() % sizeof(cmds)];
+        uint32_t flags = 0;
+
+        switch(cmd) {
+        case AC_PLAY:
+            flags = (rand() % 8) ? PA_INTRMUS : PA_NOINTR;
+            break;
+        case AC_KEY:
+            flags = keyOf(rand() % 3, !(rand() % 4)) | PA_INTRMUS;
+            break;
+        case AC_STOPKEY:
+            flags = (rand() % 3) ? keyOf(rand() % 3) : 0;
+            break;
+        }
+
+        // Task busy decoding now and then; bursts fill the queue
+        if(!(rand() % 500)) {
+            taskStall.store(200);
+        }
+
+        aq_post(cmd, flags);
+
+        c.cmd = cmd;
+        c.flags = flags;
+        seqName(c.fn, seq);
+        if(cmd == AC_CLICK) c.fn[0] = 0;
+        ref.handle(&c);
+
+        if(!(rand() % 1000)) {
+            aq_sync();
+            TEST_ASSERT_TRUE(taskState == ref);
+            syncs++;
+        }
+    }
+
+    aq_sync();
+    TEST_ASSERT_TRUE(taskState == ref);
+    TEST_ASSERT_EQUAL_INT(seq, lastSeq.load());
+    TEST_ASSERT_TRUE(fullWaits > 0);
+
+    snprintf(msg, sizeof(msg), "%d syncs, %ld spins on full queue", syncs, fullWaits.load());
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_push_bounds);
+    RUN_TEST(test_key_double_press);
+    RUN_TEST(test_queue_full_blocks);
+    RUN_TEST(test_stress);
+    return UNITY_END();
+}
@@ -0,0 +1,675 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: BTTFN client core against a mock transport
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <deque>
+#include <vector>
+
+#include "bttfnpkt.cpp"
+#include "bttfn.cpp"
+
+// The client keeps its state in file statics; the tests
+// below run in order and form one session, up to the delay
+// and loss tests, which start over.
+
+#define TCD_IP  0x0a01a8c0      // 192.168.1.10
+#define TCD_IP2 0x0b01a8c0
+
+struct mockPkt {
+    uint32_t ip;
+    uint8_t  buf[BTTF_PACKET_SIZE];
+};
+
+class mockTransport : public bttfnTransport {
+
+    public:
+
+        bool linkUp() { return up; }
+
+        bool recv(uint8_t *buf, uint32_t &fromIP)
+        {
+            return pop(uc, buf, fromIP);
+        }
+        bool recvMC(uint8_t *buf, uint32_t &fromIP)
+        {
+            return pop(mc, buf, fromIP);
+        }
+
+        void send(uint32_t toIP, const uint8_t *buf)
+        {
+            mockPkt p;
+            p.ip = toIP;
+            memcpy(p.buf, buf, BTTF_PACKET_SIZE);
+            sent.push_back(p);
+        }
+
+        bool up = true;
+        std::deque<mockPkt> uc, mc;
+        std::vector<mockPkt> sent;
+
+    private:
+
+        bool pop(std::deque<mockPkt> &q, uint8_t *buf, uint32_t &fromIP)
+        {
+            if(q.empty()) return false;
+            memcpy(buf, q.front().buf, BTTF_PACKET_SIZE);
+            fromIP = q.front().ip;
+            q.pop_front();
+            return true;
+        }
+};
+
+static mockTransport mt;
+static int statusCnt, notifyCnt;
+static uint16_t lastSpeed;
+
+static void onStat(bttfnPacket &p)
+{
+    statusCnt++;
+    lastSpeed = p.get<BTTFN_F_SPEED>();
+}
+
+static void onNot(bttfnPacket &p)
+{
+    notifyCnt++;
+    lastSpeed = p.get<BTTFN_F_NP0>();
+}
+
+static bttfnPacket mkPacket(mockPkt &m, uint32_t ip)
+{
+    static const uint8_t hdr[4] = { 'B', 'T', 'T', 'F' };
+    bttfnPacket p(m.buf);
+    m.ip = ip;
+    p.init(hdr);
+    return p;
+}
+
+static void advance(unsigned long ms)
+{
+    stubMillis += ms;
+}
+
+// Run the loop for a while, 10ms steps
+static void run(unsigned long ms)
+{
+    for(unsigned long t = 0; t < ms; t += 10) {
+        advance(10);
+        bttfnc_loop();
+    }
+}
+
+static bttfnPacket lastSent()
+{
+    TEST_ASSERT_TRUE(mt.sent.size() > 0);
+    return bttfnPacket(mt.sent.back().buf);
+}
+
+static mockPkt mkResponse(bttfnPacket req, uint8_t flags, uint8_t caps, uint16_t speed)
+{
+    mockPkt m;
+    bttfnPacket p = mkPacket(m, TCD_IP);
+    p.set<BTTFN_F_VER>(BTTFN_VERSION | 0x80);
+    p.set<BTTFN_F_ID>(req.get<BTTFN_F_ID>());
+    p.set<BTTFN_F_REQ>(flags);
+    p.set<BTTFN_F_CAPS>(caps);
+    p.set<BTTFN_F_SPEED>(speed);
+    return m;
+}
+
+// Queue the response to the last request sent
+static void respond(uint8_t flags, uint8_t caps, uint16_t speed)
+{
+    mt.uc.push_back(mkResponse(lastSent(), flags, caps, speed));
+}
+
+static void notData(uint32_t session, uint32_t seq, uint16_t speed, uint32_t ip = TCD_IP)
+{
+    mockPkt m;
+    bttfnPacket p = mkPacket(m, ip);
+    p.set<BTTFN_F_VER>(BTTFN_VERSION | 0x40);
+    p.set<BTTFN_F_REQ>(BTTFN_NOT_DATA);
+    p.set<BTTFN_F_SESSION>(session);
+    p.set<BTTFN_F_ID>(seq);
+    p.set<BTTFN_F_SPEED>(speed);
+    p.setArray<BTTFN_F_SSID>("TCD-AP");
+    mt.mc.push_back(m);
+}
+
+static void notSpeed(uint32_t seq, uint16_t speed)
+{
+    mockPkt m;
+    bttfnPacket p = mkPacket(m, TCD_IP);
+    p.set<BTTFN_F_VER>(BTTFN_VERSION | 0x40);
+    p.set<BTTFN_F_REQ>(BTTFN_NOT_SPD);
+    p.set<BTTFN_F_NP0>(speed);
+    p.set<BTTFN_F_NSEQ>(seq);
+    mt.mc.push_back(m);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_discover()
+{
+    uint32_t hash = 0;
+    char host[14] = { 0 };
+
+    for(const char *s = "TCD"; *s; s++) hash = 37 * hash + tolower(*s);
+
+    stubMillis = 1000;
+    bttfnc_setup(&mt, 0, "TCD", "remote", 0x1234, onStat, onNot);
+
+    // Nothing heard yet
+    TEST_ASSERT_FALSE(bttfnc_connected());
+
+    bttfnc_loop();
+    TEST_ASSERT_EQUAL(1, mt.sent.size());
+    TEST_ASSERT_EQUAL_UINT32(0, mt.sent[0].ip);
+
+    bttfnPacket p = lastSent();
+    TEST_ASSERT_TRUE(bttfn_checkPacket(p.data()));
+    TEST_ASSERT_EQUAL_UINT8(0x52 | 0x80, p.get<BTTFN_F_REQ>());
+    TEST_ASSERT_EQUAL_UINT32(hash, p.get<BTTFN_F_TCDHASH>());
+    TEST_ASSERT_EQUAL_UINT32(0x1234, p.get<BTTFN_F_REMID>());
+    TEST_ASSERT_EQUAL_UINT8(BTTFN_TYPE_REMOTE, p.get<BTTFN_F_TYPE>());
+    p.getArray<BTTFN_F_HOST>(host);
+    TEST_ASSERT_EQUAL_STRING("remote", host);
+
+    // No repeat while the response is due
+    run(200);
+    TEST_ASSERT_EQUAL(1, mt.sent.size());
+
+    // Response: TCD sends speed by multicast and supports NOT_DATA/SSID
+    respond(0x80 | 0x40, 0x01 | 0x10 | 0x40, 42);
+    bttfnc_loop();
+    TEST_ASSERT_TRUE(bttfnc_connected());
+    TEST_ASSERT_EQUAL(1, statusCnt);
+    TEST_ASSERT_EQUAL(42, lastSpeed);
+
+    bttfnStats st;
+    bttfnc_getStats(st);
+    TEST_ASSERT_EQUAL(1, st.responses);
+    TEST_ASSERT_EQUAL(200, st.srtt);
+    TEST_ASSERT_EQUAL(0, st.timeouts);
+
+    // Next poll goes to the TCD directly; caps and speed no longer requested
+    run(BTTFN_POLL_INT + 10);
+    TEST_ASSERT_EQUAL(2, mt.sent.size());
+    TEST_ASSERT_EQUAL_UINT32(TCD_IP, mt.sent[1].ip);
+    TEST_ASSERT_EQUAL_UINT8(0x10, lastSent().get<BTTFN_F_REQ>());
+    TEST_ASSERT_EQUAL_UINT32(0, lastSent().get<BTTFN_F_TCDHASH>());
+}
+
+void test_stale_response_ignored()
+{
+    mockPkt m;
+    bttfnPacket p = mkPacket(m, TCD_IP);
+    p.set<BTTFN_F_VER>(BTTFN_VERSION | 0x80);
+    p.set<BTTFN_F_ID>(lastSent().get<BTTFN_F_ID>() - 1);
+    mt.uc.push_back(m);
+
+    // Wrong ID, then bad checksum
+    bttfnc_loop();
+    respond(0, 0, 1);
+    mt.uc.back().buf[20] ^= 1;
+    bttfnc_loop();
+    TEST_ASSERT_EQUAL(1, statusCnt);
+
+    respond(0, 0, 88);
+    advance(50);
+    bttfnc_loop();
+    TEST_ASSERT_EQUAL(2, statusCnt);
+    TEST_ASSERT_EQUAL(88, lastSpeed);
+}
+
+void test_timeout_backoff()
+{
+    bttfnStats st0, st;
+    size_t n;
+
+    bttfnc_getStats(st0);
+
+    // Wait for next request, let it time out
+    run(BTTFN_POLL_INT + 10);
+    n = mt.sent.size();
+    run(st0.rto + 20);
+    bttfnc_getStats(st);
+    TEST_ASSERT_EQUAL(st0.timeouts + 1, st.timeouts);
+    TEST_ASSERT_EQUAL(st0.rto * 2 > BTTFN_RTO_MAX ? BTTFN_RTO_MAX : st0.rto * 2, st.rto);
+
+    // A new request follows at once
+    TEST_ASSERT_EQUAL(n + 1, mt.sent.size());
+
+    // Still connected until BTTFN_LOST_TO
+    TEST_ASSERT_TRUE(bttfnc_connected());
+
+    // A response resets the RTO from the RTT estimate
+    respond(0, 0, 7);
+    advance(100);
+    bttfnc_loop();
+    bttfnc_getStats(st);
+    TEST_ASSERT_EQUAL(st0.responses + 1, st.responses);
+    TEST_ASSERT_TRUE(st.rto >= BTTFN_RTO_MIN && st.rto <= BTTFN_RTO_MAX);
+}
+
+void test_notdata_stream()
+{
+    size_t n;
+
+    statusCnt = 0;
+
+    // Not from our TCD: Ignored
+    notData(0x77, 1, 10, TCD_IP2);
+    bttfnc_loop();
+    TEST_ASSERT_EQUAL(0, statusCnt);
+
+    notData(0x77, 1, 11);
+    bttfnc_loop();
+    TEST_ASSERT_EQUAL(1, statusCnt);
+    TEST_ASSERT_EQUAL(11, lastSpeed);
+    TEST_ASSERT_EQUAL(1, bttfnHaveTCDSSID);
+    TEST_ASSERT_EQUAL_STRING_LEN("TCD-AP", TCDSSID, 6);
+    TEST_ASSERT_EQUAL(11, TCDSSID[6]);      // Shares the byte with the speed
+
+    // No more polling while NOT_DATA is flowing
+    n = mt.sent.size();
+    for(int i = 2; i < 30; i++) {
+        notData(0x77, i, 11 + i);
+        run(500);
+    }
+    TEST_ASSERT_EQUAL(n, mt.sent.size());
+    TEST_ASSERT_EQUAL(29, statusCnt);
+    TEST_ASSERT_EQUAL(40, lastSpeed);
+
+    // Out of sequence: Dropped
+    notData(0x77, 20, 99);
+    bttfnc_loop();
+    TEST_ASSERT_EQUAL(29, statusCnt);
+
+    // New session (TCD rebooted): Sequence starts over
+    notData(0x78, 2, 50);
+    bttfnc_loop();
+    TEST_ASSERT_EQUAL(30, statusCnt);
+    TEST_ASSERT_EQUAL(50, lastSpeed);
+}
+
+void test_speed_notification()
+{
+    notifyCnt = 0;
+
+    notSpeed(5, 10);
+    notSpeed(6, 11);
+    notSpeed(4, 12);    // Out of sequence
+    notSpeed(1, 13);    // TCD restarted
+    bttfnc_loop_quick();
+    TEST_ASSERT_EQUAL(3, notifyCnt);
+    TEST_ASSERT_EQUAL(13, lastSpeed);
+}
+
+void test_command_sequence()
+{
+    uint32_t seq;
+
+    TEST_ASSERT_TRUE(bttfnc_send_command(BTTFN_REMCMD_COMBINED, 1, 2));
+    bttfnPacket p = lastSent();
+    TEST_ASSERT_TRUE(bttfn_checkPacket(p.data()));
+    TEST_ASSERT_EQUAL_UINT8(BTTFN_REMCMD_COMBINED, p.get<BTTFN_F_CMD>());
+    TEST_ASSERT_EQUAL_UINT8(1, p.get<BTTFN_F_P1>());
+    TEST_ASSERT_EQUAL_UINT8(2, p.get<BTTFN_F_P2>());
+    seq = p.get<BTTFN_F_ID>();
+
+    TEST_ASSERT_TRUE(bttfnc_send_command(BTTFN_REMCMD_COMBINED, 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(seq + 1, lastSent().get<BTTFN_F_ID>());
+    TEST_ASSERT_TRUE(bttfn_checkPacket(lastSent().data()));
+
+    // Other command, own counter
+    TEST_ASSERT_TRUE(bttfnc_send_command(BTTFN_REMCMD_PING, 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(1, lastSent().get<BTTFN_F_ID>());
+
+    TEST_ASSERT_TRUE(bttfnc_send_tt());
+    TEST_ASSERT_EQUAL_UINT8(0x80, lastSent().get<BTTFN_F_REQ>());
+    TEST_ASSERT_EQUAL_UINT8(0, lastSent().get<BTTFN_F_CMD>());
+    TEST_ASSERT_TRUE(bttfn_checkPacket(lastSent().data()));
+}
+
+void test_notdata_timeout_rediscover()
+{
+    size_t n = mt.sent.size();
+
+    // NOT_DATA stops: Back to polling, by DISCOVER since 
+    // the TCD was configured by hostname
+    run(BTTFN_DATA_TO + 100);
+    TEST_ASSERT_TRUE(mt.sent.size() > n);
+    TEST_ASSERT_EQUAL_UINT32(0, mt.sent[n].ip);
+    TEST_ASSERT_TRUE(bttfnPacket(mt.sent[n].buf).get<BTTFN_F_REQ>() & 0x80);
+    TEST_ASSERT_EQUAL(0, bttfnHaveTCDSSID);
+    TEST_ASSERT_FALSE(bttfnc_connected());
+}
+
+void test_lost()
+{
+    unsigned long now = stubMillis;
+
+    // No answers at all from here on
+    TEST_ASSERT_FALSE(bttfnc_lost(now, 0));
+    run(BTTFN_LOST_TO + 1000);
+    TEST_ASSERT_TRUE(bttfnc_lost(stubMillis, 0));
+    TEST_ASSERT_FALSE(bttfnc_lost(stubMillis, 0));
+
+    // DISCOVER keeps going at the normal rate
+    size_t n = mt.sent.size();
+    run(BTTFN_POLL_INT * 4);
+    TEST_ASSERT_TRUE(mt.sent.size() - n >= 3);
+    TEST_ASSERT_EQUAL_UINT32(0, mt.sent.back().ip);
+}
+
+/*
+ * Delay and loss distributions
+ *
+ * Each test starts a new session with a TCD at a fixed IP that
+ * sends speed by multicast. The simulated TCD answers every
+ * request that is not lost after a delay drawn from a 
+ * distribution; late answers carry an outdated ID and are
+ * dropped by the client.
+ */
+
+struct simLink {
+    unsigned long (*delay)(void);
+    int           lossPct;
+    uint8_t       caps;
+    // Results
+    unsigned long rtoMin, rtoMax, pollMax;
+    unsigned long lastReq, maxGap;
+    unsigned long retryGap, retries;    // After lost requests
+    bool          lastLost;
+    int           requests;
+};
+
+struct simPending {
+    unsigned long due;
+    mockPkt       pkt;
+};
+
+static std::vector<simPending> simQ;
+static size_t simSeen;
+
+static void newSession()
+{
+    // Client state lives in file statics; start over
+    bttfnSRTT8 = bttfnRTTVar4 = 0;
+    bttfnRTO = BTTFN_RESPONSE_TO;
+    bttfnOKCount = 0;
+    bttfnResponses = bttfnTimeouts = 0;
+    memset(bttfnRTTHist, 0, sizeof(bttfnRTTHist));
+    bttfnRemPollInt = BTTFN_POLL_INT;
+    BTTFNPacketDue = false;
+    BTTFNUpdateNow = 0;
+    bttfnDataNotEnabled = false;
+    bttfnReqStatus = 0x52;
+    lastBTTFNpacket = 0;
+
+    mt.sent.clear();
+    mt.uc.clear();
+    mt.mc.clear();
+    simQ.clear();
+    simSeen = 0;
+
+    bttfnc_setup(&mt, TCD_IP, "", "remote", 0x1234, onStat, onNot);
+}
+
+static void simInit(simLink &l, unsigned long (*delay)(void), int lossPct, uint8_t caps = 0x01)
+{
+    memset(&l, 0, sizeof(l));
+    l.delay = delay;
+    l.lossPct = lossPct;
+    l.caps = caps;
+    l.rtoMin = ~0UL;
+}
+
+// Run the link for a while, 1ms steps
+static void simRun(simLink &l, unsigned long ms)
+{
+    bttfnStats st;
+
+    for(unsigned long t = 0; t < ms; t++) {
+        advance(1);
+        for(size_t i = 0; i < simQ.size(); ) {
+            if((long)(stubMillis - simQ[i].due) >= 0) {
+                mt.uc.push_back(simQ[i].pkt);
+                simQ.erase(simQ.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        bttfnc_loop();
+        for( ; simSeen < mt.sent.size(); simSeen++) {
+            if(l.requests && stubMillis - l.lastReq > l.maxGap) {
+                l.maxGap = stubMillis - l.lastReq;
+            }
+            if(l.lastLost) {
+                l.retryGap += stubMillis - l.lastReq;
+                l.retries++;
+            }
+            l.lastReq = stubMillis;
+            l.requests++;
+            l.lastLost = (rand() % 100 < l.lossPct);
+            if(l.lastLost) continue;
+            simPending sp;
+            sp.due = stubMillis + l.delay();
+            sp.pkt = mkResponse(bttfnPacket(mt.sent[simSeen].buf), 0x40, l.caps, 0);
+            simQ.push_back(sp);
+        }
+        bttfnc_getStats(st);
+        l.rtoMin = min(l.rtoMin, st.rto);
+        l.rtoMax = max(l.rtoMax, st.rto);
+        l.pollMax = max(l.pollMax, st.pollInt);
+    }
+}
+
+static unsigned long dlyJitter()     { return 40 + rand() % 41; }                    // 40-80
+static unsigned long dlyWide()       { return 150 + rand() % 301; }                  // 150-450
+static unsigned long dlySlow()       { return 100 + rand() % 2401; }                 // 100-2500
+static unsigned long dlyFixed()      { return 50; }
+
+void test_rtt_jitter()
+{
+    simLink l;
+    bttfnStats st;
+    uint32_t sum = 0;
+    char msg[128];
+
+    srand(1);
+    newSession();
+
+    // Fast link, jitter: RTO converges to the lower limit
+    simInit(l, dlyJitter, 0);
+    simRun(l, 10 * 60 * 1000);
+    bttfnc_getStats(st);
+    TEST_ASSERT_EQUAL(0, st.timeouts);
+    TEST_ASSERT_TRUE(st.srtt >= 50 && st.srtt <= 70);
+    TEST_ASSERT_TRUE(st.rttvar >= 5 && st.rttvar <= 20);
+    TEST_ASSERT_EQUAL(BTTFN_RTO_MIN, st.rto);
+    TEST_ASSERT_EQUAL(BTTFN_RTO_MIN, l.rtoMin);
+    // All samples in the 32-63 and 64-127 buckets
+    for(int i = 0; i < BTTFN_RTT_BUCKETS; i++) sum += st.rttHist[i];
+    TEST_ASSERT_EQUAL(st.responses, sum);
+    TEST_ASSERT_EQUAL(st.responses, st.rttHist[6] + st.rttHist[7]);
+    // Stable: Polled at the long interval
+    TEST_ASSERT_EQUAL(BTTFN_POLL_INT_MAX, st.pollInt);
+    // Fewer than 55% of the requests at a fixed BTTFN_POLL_INT
+    TEST_ASSERT_TRUE(l.requests < 10 * 60 * 1000 / BTTFN_POLL_INT * 55 / 100);
+
+    snprintf(msg, sizeof(msg), "40-80ms: srtt %lu rttvar %lu rto %lu, %d requests in 10min",
+                st.srtt, st.rttvar, st.rto, l.requests);
+    TEST_MESSAGE(msg);
+
+    // Wide jitter: The RTO follows the spread and covers
+    // the slowest answers
+    newSession();
+    simInit(l, dlyWide, 0);
+    simRun(l, 10 * 60 * 1000);
+    bttfnc_getStats(st);
+    TEST_ASSERT_EQUAL(0, st.timeouts);
+    TEST_ASSERT_TRUE(st.srtt >= 250 && st.srtt <= 350);
+    TEST_ASSERT_TRUE(st.rttvar >= 50 && st.rttvar <= 100);
+    TEST_ASSERT_TRUE(st.rto > 450 && st.rto < BTTFN_RTO_MAX);
+    // rttvar is reported unscaled, hence the rounding
+    TEST_ASSERT_TRUE(st.rto - (st.srtt + 4 * st.rttvar) <= 3);
+
+    snprintf(msg, sizeof(msg), "150-450ms: srtt %lu rttvar %lu rto %lu, %u timeouts in %d requests",
+                st.srtt, st.rttvar, st.rto, st.timeouts, l.requests);
+    TEST_MESSAGE(msg);
+}
+
+void test_rto_clamp()
+{
+    simLink l;
+    bttfnStats st;
+    char msg[128];
+
+    srand(2);
+    newSession();
+
+    // Slow and erratic: srtt + 4 * rttvar beyond the upper limit
+    simInit(l, dlySlow, 0);
+    simRun(l, 10 * 60 * 1000);
+    bttfnc_getStats(st);
+    TEST_ASSERT_TRUE(st.srtt + 4 * st.rttvar > BTTFN_RTO_MAX);
+    TEST_ASSERT_EQUAL(BTTFN_RTO_MAX, st.rto);
+    TEST_ASSERT_EQUAL(BTTFN_RTO_MAX, l.rtoMax);
+    TEST_ASSERT_TRUE(l.rtoMin >= BTTFN_RTO_MIN);
+
+    snprintf(msg, sizeof(msg), "100-2500ms: srtt %lu rttvar %lu rto %lu (min %lu), %u timeouts",
+                st.srtt, st.rttvar, st.rto, l.rtoMin, st.timeouts);
+    TEST_MESSAGE(msg);
+
+    // Timeout doubling is limited as well
+    newSession();
+    simInit(l, dlyFixed, 100);
+    simRun(l, 60 * 1000);
+    TEST_ASSERT_EQUAL(BTTFN_RTO_MAX, l.rtoMax);
+    bttfnc_getStats(st);
+    TEST_ASSERT_EQUAL(BTTFN_RTO_MAX, st.rto);
+}
+
+void test_loss_backoff()
+{
+    simLink l;
+    bttfnStats st;
+    char msg[128];
+
+    srand(3);
+    newSession();
+
+    // Moderate random loss: Lost requests are retried after
+    // the (short) RTO, polling stays at the normal rate
+    simInit(l, dlyJitter, 30);
+    simRun(l, 10 * 60 * 1000);
+    bttfnc_getStats(st);
+    TEST_ASSERT_TRUE(st.timeouts > 0);
+    TEST_ASSERT_TRUE(l.pollMax < BTTFN_POLL_INT_MAX);
+    TEST_ASSERT_TRUE(l.retryGap / l.retries < 2 * BTTFN_RTO_MIN);
+    // Losses in a row double the RTO, up to the limit
+    TEST_ASSERT_TRUE(l.maxGap <= BTTFN_RTO_MAX + 10);
+
+    snprintf(msg, sizeof(msg), "30%% loss: rto %lu, %u timeouts, avg retry after %lums, %d requests in 10min",
+                st.rto, st.timeouts, l.retryGap / l.retries, l.requests);
+    TEST_MESSAGE(msg);
+
+    // Link goes away: 10 immediate retries, then the poll
+    // interval backs off to 4x, no further
+    l.lossPct = 100;
+    simRun(l, 5 * 60 * 1000);
+    bttfnc_getStats(st);
+    TEST_ASSERT_EQUAL(BTTFN_POLL_INT * BTTFN_POLL_BACKOFF, st.pollInt);
+    TEST_ASSERT_EQUAL(BTTFN_POLL_INT * BTTFN_POLL_BACKOFF, l.pollMax);
+    TEST_ASSERT_EQUAL(BTTFN_RTO_MAX, st.rto);
+    l.maxGap = 0;
+    simRun(l, 60 * 1000);
+    TEST_ASSERT_TRUE(l.maxGap > BTTFN_POLL_INT * BTTFN_POLL_BACKOFF);
+    TEST_ASSERT_TRUE(l.maxGap <= BTTFN_POLL_INT * BTTFN_POLL_BACKOFF + 10);
+
+    // Back: First answer restores the normal rate
+    l.lossPct = 0;
+    simRun(l, BTTFN_POLL_INT * BTTFN_POLL_BACKOFF + 100);
+    bttfnc_getStats(st);
+    TEST_ASSERT_EQUAL(BTTFN_POLL_INT, st.pollInt);
+    TEST_ASSERT_TRUE(st.rto < BTTFN_RTO_MAX);
+}
+
+void test_stable_growth()
+{
+    simLink l;
+    bttfnStats st;
+    uint32_t resp = 0;
+    unsigned long expect;
+
+    srand(4);
+    newSession();
+
+    // Poll interval: Normal for BTTFN_STABLE_CNT responses,
+    // then +100 per response up to BTTFN_POLL_INT_MAX
+    simInit(l, dlyFixed, 0);
+    while(resp < BTTFN_STABLE_CNT + 20) {
+        simRun(l, 1);
+        bttfnc_getStats(st);
+        if(st.responses == resp) continue;
+        resp = st.responses;
+        expect = BTTFN_POLL_INT;
+        if(resp > BTTFN_STABLE_CNT) {
+            expect = min((unsigned long)BTTFN_POLL_INT_MAX, 
+                         BTTFN_POLL_INT + 100UL * (resp - BTTFN_STABLE_CNT));
+        }
+        TEST_ASSERT_EQUAL(expect, st.pollInt);
+    }
+    TEST_ASSERT_EQUAL(BTTFN_POLL_INT_MAX, st.pollInt);
+
+    // One loss: Back to normal, count starts over
+    l.lossPct = 100;
+    while(!st.timeouts) {
+        simRun(l, 1);
+        bttfnc_getStats(st);
+    }
+    TEST_ASSERT_EQUAL(BTTFN_POLL_INT, st.pollInt);
+    l.lossPct = 0;
+    simRun(l, BTTFN_POLL_INT * (BTTFN_STABLE_CNT - 2));
+    bttfnc_getStats(st);
+    TEST_ASSERT_EQUAL(BTTFN_POLL_INT, st.pollInt);
+
+    // Speed not sent by multicast: Polling must not slow down
+    newSession();
+    simInit(l, dlyFixed, 0, 0);
+    simRun(l, 5 * 60 * 1000);
+    bttfnc_getStats(st);
+    TEST_ASSERT_TRUE(st.responses > 4 * BTTFN_STABLE_CNT);
+    TEST_ASSERT_EQUAL(BTTFN_POLL_INT, l.pollMax);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_discover);
+    RUN_TEST(test_stale_response_ignored);
+    RUN_TEST(test_timeout_backoff);
+    RUN_TEST(test_notdata_stream);
+    RUN_TEST(test_speed_notification);
+    RUN_TEST(test_command_sequence);
+    RUN_TEST(test_notdata_timeout_rediscover);
+    RUN_TEST(test_lost);
+    RUN_TEST(test_rtt_jitter);
+    RUN_TEST(test_rto_clamp);
+    RUN_TEST(test_loss_backoff);
+    RUN_TEST(test_stable_growth);
+    return UNITY_END();
+}
@@ -0,0 +1,163 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: BTTFN packet layout and checksum
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <time.h>
+
+#include "bttfnpkt.cpp"
+
+static const uint8_t hdr[4] = { 'B', 'T', 'T', 'F' };
+
+// The original checksum loop
+static uint8_t refChecksum(const uint8_t *buf)
+{
+    uint8_t a = 0;
+    for(int i = 4; i < 47; i++) a += buf[i] ^ 0x55;
+    return a;
+}
+
+static void fillRandom(uint8_t *buf)
+{
+    for(int i = 0; i < BTTF_PACKET_SIZE; i++) {
+        buf[i] = rand();
+    }
+}
+
+void setUp() { srand(1); }
+void tearDown() {}
+
+void test_checksum_matches_reference()
+{
+    uint8_t buf[BTTF_PACKET_SIZE + 3];
+
+    memset(buf, 0, sizeof(buf));
+    TEST_ASSERT_EQUAL_UINT8(refChecksum(buf), bttfn_checksum(buf));
+    memset(buf, 0xff, sizeof(buf));
+    TEST_ASSERT_EQUAL_UINT8(refChecksum(buf), bttfn_checksum(buf));
+    memset(buf, 0xaa, sizeof(buf));
+    TEST_ASSERT_EQUAL_UINT8(refChecksum(buf), bttfn_checksum(buf));
+
+    // Also at unaligned addresses
+    for(int i = 0; i < 100000; i++) {
+        uint8_t *p = buf + (i & 3);
+        fillRandom(p);
+        TEST_ASSERT_EQUAL_UINT8(refChecksum(p), bttfn_checksum(p));
+    }
+}
+
+void test_checkPacket()
+{
+    uint8_t buf[BTTF_PACKET_SIZE];
+
+    fillRandom(buf);
+    memcpy(buf, hdr, 4);
+    buf[BTTFN_CSUM_OFFS] = refChecksum(buf);
+    TEST_ASSERT_TRUE(bttfn_checkPacket(buf));
+
+    buf[BTTFN_CSUM_OFFS]++;
+    TEST_ASSERT_FALSE(bttfn_checkPacket(buf));
+    buf[BTTFN_CSUM_OFFS]--;
+
+    buf[3] = 'X';
+    TEST_ASSERT_FALSE(bttfn_checkPacket(buf));
+}
+
+// Setting fields keeps the checksum current
+void test_packet_roundtrip()
+{
+    uint8_t buf[BTTF_PACKET_SIZE];
+    uint8_t host[13], ssid[6], tmp[13];
+    bttfnPacket pkt(buf);
+
+    pkt.init(hdr);
+    TEST_ASSERT_TRUE(bttfn_checkPacket(buf));
+
+    for(int i = 0; i < 10000; i++) {
+        uint32_t v = ((uint32_t)rand() << 16) ^ rand();
+        uint32_t id = v ^ 0x5a5a5a5a;
+        for(int j = 0; j < 13; j++) host[j] = rand();
+        for(int j = 0; j < 6; j++) ssid[j] = rand();
+
+        // Request fields
+        pkt.set<BTTFN_F_VER>(v);
+        pkt.set<BTTFN_F_ID>(id);
+        pkt.setArray<BTTFN_F_HOST>(host);
+        pkt.set<BTTFN_F_REMID>(~id);
+        TEST_ASSERT_TRUE(bttfn_checkPacket(buf));
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)v, pkt.get<BTTFN_F_VER>());
+        TEST_ASSERT_EQUAL_UINT32(id, pkt.get<BTTFN_F_ID>());
+        TEST_ASSERT_EQUAL_UINT32(~id, pkt.get<BTTFN_F_REMID>());
+        pkt.getArray<BTTFN_F_HOST>(tmp);
+        TEST_ASSERT_EQUAL_MEMORY(host, tmp, 13);
+
+        // Little endian on the wire
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)id, buf[6]);
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)(id >> 24), buf[9]);
+
+        // Response fields, partly overlapping the above
+        pkt.set<BTTFN_F_SPEED>(v >> 8);
+        pkt.set<BTTFN_F_SESSION>(~v);
+        pkt.setArray<BTTFN_F_SSID>(ssid);
+        TEST_ASSERT_TRUE(bttfn_checkPacket(buf));
+        TEST_ASSERT_EQUAL_UINT16((uint16_t)(v >> 8), pkt.get<BTTFN_F_SPEED>());
+        TEST_ASSERT_EQUAL_UINT32(~v, pkt.get<BTTFN_F_SESSION>());
+        pkt.getArray<BTTFN_F_SSID>(tmp);
+        TEST_ASSERT_EQUAL_MEMORY(ssid, tmp, 6);
+
+        pkt.setArrayByte<BTTFN_F_HOST>(i % 13, v >> 16);
+        TEST_ASSERT_EQUAL_UINT8(refChecksum(buf), buf[BTTFN_CSUM_OFFS]);
+    }
+}
+
+void test_checksum_speed()
+{
+    uint8_t buf[BTTF_PACKET_SIZE];
+    uint8_t acc = 0;
+    const int n = 2000000;
+    char msg[80];
+    clock_t t0;
+    double tr, tn;
+
+    fillRandom(buf);
+
+    t0 = clock();
+    for(int i = 0; i < n; i++) {
+        buf[10] = i;
+        acc += refChecksum(buf);
+    }
+    tr = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    t0 = clock();
+    for(int i = 0; i < n; i++) {
+        buf[10] = i;
+        acc -= bttfn_checksum(buf);
+    }
+    tn = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    TEST_ASSERT_EQUAL_UINT8(0, acc);
+
+    snprintf(msg, sizeof(msg), "reference %.1f Mpkt/s, bttfn_checksum %.1f Mpkt/s",
+              tr > 0 ? n / tr / 1e6 : 0.0, tn > 0 ? n / tn / 1e6 : 0.0);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_checksum_matches_reference);
+    RUN_TEST(test_checkPacket);
+    RUN_TEST(test_packet_roundtrip);
+    RUN_TEST(test_checksum_speed);
+    return UNITY_END();
+}
@@ -0,0 +1,403 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: ButtonPack debounce/long-press state machine,
+ * replaying timestamped edges, polled and interrupt driven
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <string>
+
+#include "i2cbus.cpp"
+#include "input.cpp"
+
+static const uint8_t butPackAddr[2*2] = {
+    0x20, REM_BP_TYPE_PCA9554,
+    0x21, REM_BP_TYPE_PCA8574
+};
+
+#define INT_PIN 39
+
+/*
+ * Simulated expander
+ *
+ * INT goes low when the port differs from what was last read,
+ * and high again when the port is read or back to what was
+ * read; the ISR is called on the falling edge. A dead INT
+ * line stays high.
+ */
+
+static uint8_t       expAddr;
+static uint8_t       expPort, expLatched;
+static bool          useInt, intDead;
+static int           expReads;
+static std::string   events;
+
+static int simDev(uint8_t addr, bool read, uint8_t *buf, int len)
+{
+    if(addr != expAddr) return -1;
+
+    if(read) {
+        buf[0] = expPort;
+        expLatched = expPort;
+        stubPins[INT_PIN] = HIGH;
+        expReads++;
+        return 1;
+    }
+
+    return len;
+}
+
+static void setPort(uint8_t port)
+{
+    expPort = port;
+    if(expPort == expLatched) {
+        stubPins[INT_PIN] = HIGH;
+    } else if(useInt && !intDead && stubPins[INT_PIN] == HIGH) {
+        stubPins[INT_PIN] = LOW;
+        if(stubIsr[INT_PIN]) {
+            stubIsr[INT_PIN](stubIsrArg[INT_PIN]);
+        }
+    }
+}
+
+static void logEv(const char *what, int i)
+{
+    events += what + std::to_string(i) + "@" + std::to_string(stubMillis) + " ";
+}
+
+static void onDown(int i)      { logEv("D", i); }
+static void onEnd(int i)       { logEv("E", i); }
+static void onLongStart(int i) { logEv("L", i); }
+static void onLongStop(int i)  { logEv("S", i); }
+
+/*
+ * Former ButtonPack::scan(), reading the port directly, for
+ * comparison in polling mode
+ */
+
+struct refPack {
+    unsigned long lastScan = 0;
+    ButState      state[PACK_SIZE], lastState[PACK_SIZE];
+    unsigned long startTime[PACK_SIZE];
+    bool          wasPressed[PACK_SIZE];
+    std::string   ev;
+
+    refPack()
+    {
+        for(int i = 0; i < PACK_SIZE; i++) reset(i);
+    }
+    void reset(int i)
+    {
+        state[i] = lastState[i] = REMBUS_IDLE;
+        startTime[i] = 0;
+        wasPressed[i] = false;
+    }
+    void transitionTo(int i, ButState s)
+    {
+        lastState[i] = state[i];
+        state[i] = s;
+    }
+    void log(const char *what, int i, unsigned long now)
+    {
+        ev += what + std::to_string(i) + "@" + std::to_string(now) + " ";
+    }
+    void scan()
+    {
+        unsigned long now = millis();
+        unsigned long waitTime;
+        bool active;
+
+        if(millis() - lastScan < 20)
+            return;
+        lastScan = millis();
+
+        for(int i = 0; i < PACK_SIZE; i++) {
+            waitTime = now - startTime[i];
+            active = ((expPort & (1 << i)) == 0);
+            switch(state[i]) {
+            case REMBUS_IDLE:
+                if(active) {
+                    transitionTo(i, REMBUS_PRESSED);
+                    startTime[i] = now;
+                }
+                break;
+            case REMBUS_PRESSED:
+                if((!active) && (waitTime < 50)) {
+                    transitionTo(i, lastState[i]);
+                } else if((active) && (waitTime > 2000)) {
+                    log("L", i, now);
+                    transitionTo(i, REMBUS_HOLD);
+                } else {
+                    if(!wasPressed[i]) {
+                        log("D", i, now);
+                        wasPressed[i] = true;
+                    }
+                    if(!active) {
+                        transitionTo(i, REMBUS_RELEASED);
+                        startTime[i] = now;
+                    }
+                }
+                break;
+            case REMBUS_RELEASED:
+                if((active) && (waitTime < 50)) {
+                    transitionTo(i, lastState[i]);
+                } else if(!active) {
+                    log("E", i, now);
+                    reset(i);
+                }
+                break;
+            case REMBUS_HOLD:
+                if(!active) {
+                    transitionTo(i, REMBUS_HOLDEND);
+                    startTime[i] = now;
+                }
+                break;
+            case REMBUS_HOLDEND:
+                if((active) && (waitTime < 50)) {
+                    transitionTo(i, lastState[i]);
+                } else if(waitTime >= 50) {
+                    log("S", i, now);
+                    reset(i);
+                }
+                break;
+            default:
+                transitionTo(i, REMBUS_IDLE);
+                break;
+            }
+        }
+    }
+};
+
+// Edge list: At time "at", button "but" goes down (or up)
+typedef struct {
+    unsigned long at;
+    int           but;
+    bool          down;
+} bpEdge;
+
+// Replay edges with a main loop pass every passMs
+static void replay(ButtonPack &bp, const bpEdge *ev, int n, unsigned long until, unsigned long passMs = 1, refPack *ref = NULL)
+{
+    int i = 0;
+
+    for(unsigned long t = stubMillis; t < until; t++) {
+        stubMillis = t;
+        stubMicros = t * 1000;
+        while(i < n && ev[i].at <= t) {
+            uint8_t p = expPort;
+            if(ev[i].down) p &= ~(1 << ev[i].but);
+            else           p |= (1 << ev[i].but);
+            setPort(p);
+            i++;
+        }
+        if(!(t % passMs)) {
+            bp.scan();
+            i2cbus_loop();
+            if(ref) ref->scan();
+        }
+    }
+    stubMillis = until;
+}
+
+static void newPack(ButtonPack &bp, bool intMode, uint8_t addr = 0x20)
+{
+    expAddr = addr;
+    useInt = intMode;
+    TEST_ASSERT_TRUE(bp.begin(intMode ? INT_PIN : -1));
+    bp.attachPressDown(onDown);
+    bp.attachPressEnd(onEnd);
+    bp.attachLongPressStart(onLongStart);
+    bp.attachLongPressStop(onLongStop);
+}
+
+void setUp(void)
+{
+    memset(queue, 0, sizeof(queue));
+    numDevices = 0;
+
+    stubMillis = 1000;
+    stubMicros = 1000000;
+    stubWireDev = simDev;
+    stubPins[INT_PIN] = HIGH;
+    stubIsr[INT_PIN] = NULL;
+
+    expPort = expLatched = 0xff;
+    intDead = false;
+    expReads = 0;
+    events = "";
+}
+
+void tearDown(void)
+{
+}
+
+// Polling mode: Same events as the former code
+static void checkPolled(const bpEdge *ev, int n, unsigned long until, unsigned long passMs = 1)
+{
+    ButtonPack bp(2, butPackAddr);
+    refPack ref;
+
+    setUp();
+    newPack(bp, false);
+    replay(bp, ev, n, until, passMs, &ref);
+    TEST_ASSERT_EQUAL_STRING(ref.ev.c_str(), events.c_str());
+}
+
+static std::string runInt(const bpEdge *ev, int n, unsigned long until, unsigned long passMs = 1, bool dead = false)
+{
+    ButtonPack bp(2, butPackAddr);
+
+    setUp();
+    newPack(bp, true);
+    intDead = dead;
+    replay(bp, ev, n, until, passMs);
+    return events;
+}
+
+static void test_bounce(void)
+{
+    // Bouncing contacts on press and release
+    static const bpEdge ev[] = {
+        { 2000, 0, true }, { 2002, 0, false }, { 2003, 0, true }, { 2005, 0, false },
+        { 2006, 0, true },
+        { 2300, 0, false }, { 2301, 0, true }, { 2304, 0, false }
+    };
+
+    checkPolled(ev, 8, 4000);
+    TEST_ASSERT_EQUAL_STRING("D0@2020 E0@2320 ", events.c_str());
+
+    TEST_ASSERT_EQUAL_STRING("D0@2020 E0@2320 ", runInt(ev, 8, 4000).c_str());
+}
+
+static void test_glitch(void)
+{
+    // Shorter than a scan interval: Not seen when polled;
+    // shorter than debounce: No release event
+    static const bpEdge ev[] = {
+        { 2005, 3, true }, { 2010, 3, false },
+        { 3000, 4, true }, { 3030, 4, false }
+    };
+
+    checkPolled(ev, 4, 5000);
+    TEST_ASSERT_EQUAL_STRING("D4@3020 ", events.c_str());
+
+    TEST_ASSERT_EQUAL_STRING("D4@3020 ", runInt(ev, 4, 5000).c_str());
+}
+
+static void test_long_press(void)
+{
+    static const bpEdge ev[] = {
+        { 2000, 5, true }, { 2001, 5, false }, { 2002, 5, true },
+        { 4500, 5, false }, { 4502, 5, true }, { 4503, 5, false },
+        { 6000, 6, true }, { 7999, 6, false }   // Just short of long
+    };
+
+    checkPolled(ev, 8, 9000);
+    TEST_ASSERT_EQUAL_STRING("D5@2020 L5@4020 S5@4560 D6@6020 E6@8020 ", events.c_str());
+
+    TEST_ASSERT_EQUAL_STRING("D5@2020 L5@4020 S5@4560 D6@6020 E6@8020 ", runInt(ev, 8, 9000).c_str());
+}
+
+static void test_isr_timestamp(void)
+{
+    // Busy main loop, a pass every 100ms: With the ISR's
+    // time stamp, the long press is timed from the actual
+    // edge, not from when we got around to reading the port.
+    static const bpEdge ev[] = {
+        { 2010, 1, true }, { 4520, 1, false },
+    };
+
+    checkPolled(ev, 2, 6000, 100);
+    TEST_ASSERT_EQUAL_STRING("D1@2200 L1@4200 S1@4700 ", events.c_str());
+
+    TEST_ASSERT_EQUAL_STRING("D1@2200 L1@4100 S1@4700 ", runInt(ev, 2, 6000, 100).c_str());
+}
+
+static void test_int_level(void)
+{
+    // Second press while INT is still low from the
+    // first: No new edge, but both are seen
+    static const bpEdge ev[] = {
+        { 2001, 0, true }, { 2005, 7, true },
+        { 2200, 0, false }, { 2200, 7, false }
+    };
+
+    TEST_ASSERT_EQUAL_STRING("D0@2040 D7@2040 E0@2220 E7@2220 ", runInt(ev, 4, 3000).c_str());
+}
+
+static void test_safety_poll(void)
+{
+    static const bpEdge ev[] = {
+        { 2500, 2, true }, { 2800, 2, false },
+        { 6500, 2, true }, { 8200, 2, false }
+    };
+    ButtonPack bp(2, butPackAddr);
+
+    // Quiet: Port read once (initial) plus once per
+    // BP_SAFETY_POLL; polling would be every 20ms
+    newPack(bp, true);
+    replay(bp, NULL, 0, 1000 + 10 * BP_SAFETY_POLL);
+    TEST_ASSERT_TRUE(expReads >= 10 && expReads <= 11);
+    TEST_ASSERT_EQUAL_STRING("", events.c_str());
+
+    // Reads on changes (plus polls)
+    TEST_ASSERT_EQUAL_STRING("D2@2520 E2@2820 D2@6520 E2@8220 ", runInt(ev, 4, 10000).c_str());
+    TEST_ASSERT_TRUE(expReads <= 9 + 4);
+
+    // Dead INT line: Only the safety poll sees changes;
+    // presses between polls are missed
+    TEST_ASSERT_EQUAL_STRING("D2@7020 E2@9020 ", runInt(ev, 4, 10000, 1, true).c_str());
+    TEST_ASSERT_TRUE(expReads <= 10);
+}
+
+static void test_random(void)
+{
+    // Random edges on all buttons, polled
+    srand(11);
+    for(int r = 0; r < 50; r++) {
+        bpEdge ev[200];
+        unsigned long t = 1500;
+        for(int i = 0; i < 200; i++) {
+            t += rand() % ((rand() % 4) ? 40 : 3000);
+            ev[i].at = t;
+            ev[i].but = rand() % 8;
+            ev[i].down = rand() % 2;
+        }
+        checkPolled(ev, 200, t + 3000, 1 + (r % 3) * 7);
+    }
+}
+
+static void test_pca8574(void)
+{
+    static const bpEdge ev[] = {
+        { 2000, 4, true }, { 2200, 4, false }
+    };
+    ButtonPack bp(2, butPackAddr);
+
+    newPack(bp, false, 0x21);
+    replay(bp, ev, 2, 3000);
+    TEST_ASSERT_EQUAL_STRING("D4@2020 E4@2220 ", events.c_str());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bounce);
+    RUN_TEST(test_glitch);
+    RUN_TEST(test_long_press);
+    RUN_TEST(test_isr_timestamp);
+    RUN_TEST(test_int_level);
+    RUN_TEST(test_safety_poll);
+    RUN_TEST(test_random);
+    RUN_TEST(test_pca8574);
+    return UNITY_END();
+}
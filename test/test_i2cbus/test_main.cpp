@@ -0,0 +1,417 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: i2c transaction layer on a simulated bus
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <string>
+#include <vector>
+
+#include "i2cbus.cpp"
+
+#define THR_ADDR  0x36      // Ada4991 throttle
+#define DISP_ADDR 0x70
+#define BP_ADDR   0x20
+#define BATT_ADDR 0x0b
+
+#define THR_GAP   250       // SEESAW_READ_DELAY
+#define DISP_BUDGET 10000   // DISP_FRAME_BUDGET
+
+/*
+ * Simulated devices
+ *
+ * The bus log has one word per transfer: Device letter, then
+ * 'w' or 'r'; display frames as 'D' and the first data byte,
+ * display commands as 'C' and the command.
+ */
+
+static std::string   busLog;
+static int           nakLeft[128];          // NAKs before the next ACK
+static bool          shortRead;
+static unsigned long slowUs;                // Extra time per transfer
+static std::vector<unsigned long> thrReads, frames;
+
+static char devLetter(uint8_t addr)
+{
+    switch(addr) {
+    case THR_ADDR:  return 'T';
+    case DISP_ADDR: return 'D';
+    case BP_ADDR:   return 'B';
+    case BATT_ADDR: return 'P';
+    }
+    return '?';
+}
+
+static int simDev(uint8_t addr, bool read, uint8_t *buf, int len)
+{
+    stubMicros += slowUs;
+
+    if(addr == DISP_ADDR && !read) {
+        if(len > 2) {
+            busLog += "D" + std::to_string(buf[1]) + " ";
+            frames.push_back(stubMicros);
+        } else {
+            busLog += "C" + std::to_string(buf[0]) + " ";
+        }
+    } else {
+        busLog += std::string(1, devLetter(addr)) + (read ? "r " : "w ");
+    }
+
+    if(devLetter(addr) == '?') {
+        return -1;
+    }
+
+    if(nakLeft[addr & 0x7f]) {
+        nakLeft[addr & 0x7f]--;
+        return -1;
+    }
+
+    if(read) {
+        if(addr == THR_ADDR) thrReads.push_back(stubMicros);
+        for(int i = 0; i < len; i++) buf[i] = addr + i;
+        if(shortRead) return len - 1;
+    }
+
+    return len;
+}
+
+static void postFrame(uint8_t val)
+{
+    uint8_t buf[I2CBUS_MAX_WR] = { 0 };
+
+    memset(&buf[1], val, sizeof(buf) - 1);
+    i2cbus_post(DISP_ADDR, buf, sizeof(buf), 0, I2CBUS_NOGAP, NULL, I2CBUS_FRAME);
+}
+
+static void postCmd(uint8_t cmd)
+{
+    i2cbus_post(DISP_ADDR, &cmd, 1, 0, I2CBUS_NOGAP, NULL);
+}
+
+static void postThrottle(i2cMailbox *mb)
+{
+    static const uint8_t reg[2] = { 0x11, 0x30 };
+
+    mb->state = I2CMB_IDLE;
+    i2cbus_post(THR_ADDR, reg, 2, 4, THR_GAP, mb);
+}
+
+// Advance both clocks, running the bus layer every 100us
+static void runFor(unsigned long us)
+{
+    unsigned long end = stubMicros + us;
+
+    while(stubMicros < end) {
+        stubMicros += 100;
+        stubMillis = stubMicros / 1000;
+        i2cbus_loop();
+    }
+}
+
+void setUp(void)
+{
+    memset(queue, 0, sizeof(queue));
+    numDevices = 0;
+    memset(&stats, 0, sizeof(stats));
+    flushing = false;
+
+    memset(nakLeft, 0, sizeof(nakLeft));
+    shortRead = false;
+    slowUs = 0;
+    busLog = "";
+    thrReads.clear();
+    frames.clear();
+
+    stubMicros = 1000000;
+    stubMillis = 1000;
+    stubWireByteUs = 25;
+    stubWireDev = simDev;
+
+    i2cbus_setDevice(THR_ADDR, I2CBUS_PRIO_THROTTLE);
+    i2cbus_setDevice(DISP_ADDR, I2CBUS_PRIO_DISPLAY, DISP_BUDGET);
+    i2cbus_setDevice(BP_ADDR, I2CBUS_PRIO_INPUT);
+    i2cbus_setDevice(BATT_ADDR, I2CBUS_PRIO_BATTERY);
+}
+
+void tearDown(void)
+{
+    TEST_ASSERT_FALSE(flushing);
+}
+
+static void test_priority_order(void)
+{
+    i2cMailbox mbT, mbB, mbP;
+    static const uint8_t reg = 0x0f;
+
+    // Every transfer takes longer than the loop budget, so
+    // each i2cbus_loop() call (also those in i2cbus_post())
+    // does one step. Throttle reads take two (register select,
+    // then read after the gap); behind them, a backlog builds up.
+    slowUs = I2CBUS_BUDGET_US + 1;
+
+    postThrottle(&mbT);
+    stubMicros += THR_GAP;
+    i2cbus_post(BATT_ADDR, &reg, 1, 3, I2CBUS_RSTART, &mbP);
+    postThrottle(&mbT);
+    stubMicros += THR_GAP;
+    i2cbus_post(BP_ADDR, &reg, 1, 1, I2CBUS_NOGAP, &mbB);
+    postThrottle(&mbT);
+    stubMicros += THR_GAP;
+    postFrame(1);
+    TEST_ASSERT_EQUAL_STRING("Tw Tr Tw Tr Tw Tr ", busLog.c_str());
+    TEST_ASSERT_EQUAL(I2CMB_BUSY, mbP.state);
+    TEST_ASSERT_EQUAL(I2CMB_BUSY, mbB.state);
+
+    // Throttle first; while it waits out its gap,
+    // the display may go
+    postThrottle(&mbT);
+    while(i2cbus_pending()) {
+        i2cbus_loop();
+    }
+    TEST_ASSERT_EQUAL_STRING("Tw Tr Tw Tr Tw Tr Tw D1 Tr Bw Br Pw Pr ", busLog.c_str());
+
+    TEST_ASSERT_EQUAL(I2CMB_DONE, mbT.state);
+    TEST_ASSERT_EQUAL_INT(4, mbT.len);
+    TEST_ASSERT_EQUAL_HEX8(THR_ADDR, mbT.buf[0]);
+    TEST_ASSERT_EQUAL(I2CMB_DONE, mbB.state);
+    TEST_ASSERT_EQUAL_INT(1, mbB.len);
+    TEST_ASSERT_EQUAL(I2CMB_DONE, mbP.state);
+    TEST_ASSERT_EQUAL_INT(3, mbP.len);
+    TEST_ASSERT_EQUAL_HEX8(BATT_ADDR + 2, mbP.buf[2]);
+}
+
+static void test_frame_budget(void)
+{
+    i2cBusStats st;
+    int posted = 0;
+
+    // A frame per 1ms for 200ms
+    for(int i = 0; i < 200; i++) {
+        postFrame(++posted);
+        runFor(1000);
+    }
+    runFor(DISP_BUDGET);
+
+    // First one right away, then one per budget at most
+    TEST_ASSERT_EQUAL_STRING("D1 ", busLog.substr(0, 3).c_str());
+    TEST_ASSERT_TRUE(frames.size() >= 200000 / DISP_BUDGET);
+    TEST_ASSERT_TRUE(frames.size() <= 200000 / DISP_BUDGET + 1);
+    for(size_t i = 1; i < frames.size(); i++) {
+        TEST_ASSERT_TRUE(frames[i] - frames[i-1] >= DISP_BUDGET);
+        TEST_ASSERT_TRUE(frames[i] - frames[i-1] < DISP_BUDGET + 200);
+    }
+
+    // Nothing lost but stale frames; latest one is shown
+    i2cbus_getStats(st);
+    TEST_ASSERT_EQUAL_UINT32(posted, frames.size() + st.coalesced);
+    TEST_ASSERT_EQUAL_UINT32(frames.size(), st.trans);
+    TEST_ASSERT_TRUE(busLog.size() >= 5);
+    TEST_ASSERT_EQUAL_STRING("D200 ", busLog.substr(busLog.size() - 5).c_str());
+    TEST_ASSERT_FALSE(i2cbus_pending());
+}
+
+static void test_frame_coalesce(void)
+{
+    i2cBusStats st;
+
+    postFrame(1);           // Sent
+    postFrame(2);           // Waits for budget
+    postFrame(3);           // Replaces 2
+    TEST_ASSERT_EQUAL_STRING("D1 ", busLog.c_str());
+
+    // A command behind a waiting frame: The frame is dropped
+    // when a newer one comes, the new one goes behind the
+    // command. The command need not wait for the budget.
+    postCmd(0xe5);
+    TEST_ASSERT_EQUAL_STRING("D1 ", busLog.c_str());
+    postFrame(4);
+    TEST_ASSERT_EQUAL_STRING("D1 C229 ", busLog.c_str());
+
+    runFor(DISP_BUDGET);
+    TEST_ASSERT_EQUAL_STRING("D1 C229 D4 ", busLog.c_str());
+
+    // Two commands between
+    postFrame(5);
+    postCmd(0x81);
+    postCmd(0x80);
+    postFrame(6);
+    runFor(DISP_BUDGET);
+    TEST_ASSERT_EQUAL_STRING("D1 C229 D4 C129 C128 D6 ", busLog.c_str());
+
+    i2cbus_getStats(st);
+    TEST_ASSERT_EQUAL_UINT32(3, st.coalesced);
+    TEST_ASSERT_FALSE(i2cbus_pending());
+}
+
+static void test_queue_full(void)
+{
+    postFrame(1);           // Sent
+    postFrame(2);           // Waits for budget
+    postCmd(1);
+    postCmd(2);             // Queue full
+    TEST_ASSERT_EQUAL_STRING("D1 ", busLog.c_str());
+
+    // Posting waits for room, sending the waiting frame
+    // ahead of its time
+    postCmd(3);
+    TEST_ASSERT_EQUAL_STRING("D1 D2 C1 C2 C3 ", busLog.c_str());
+    TEST_ASSERT_TRUE(frames[1] - frames[0] < DISP_BUDGET);
+    TEST_ASSERT_FALSE(i2cbus_pending());
+
+    // Other queues are not affected
+    i2cMailbox mbT;
+    postFrame(4);
+    postThrottle(&mbT);
+    runFor(1000);
+    TEST_ASSERT_EQUAL_STRING("D1 D2 C1 C2 C3 Tw Tr ", busLog.c_str());
+    runFor(DISP_BUDGET);
+    TEST_ASSERT_EQUAL_STRING("D1 D2 C1 C2 C3 Tw Tr D4 ", busLog.c_str());
+
+    // Too long
+    uint8_t buf[I2CBUS_MAX_WR + 1] = { 0 };
+    TEST_ASSERT_FALSE(i2cbus_post(DISP_ADDR, buf, sizeof(buf), 0, I2CBUS_NOGAP, NULL));
+    TEST_ASSERT_FALSE(i2cbus_post(BP_ADDR, buf, 1, I2CBUS_MAX_RD + 1, I2CBUS_NOGAP, &mbT));
+}
+
+static void test_nak_retry(void)
+{
+    i2cMailbox mb;
+    i2cBusStats st;
+    uint8_t buf[4];
+
+    // NAK on register select, retried
+    nakLeft[THR_ADDR] = 1;
+    postThrottle(&mb);
+    runFor(1000);
+    TEST_ASSERT_EQUAL(I2CMB_DONE, mb.state);
+    TEST_ASSERT_EQUAL_INT(4, mb.len);
+    TEST_ASSERT_EQUAL_STRING("Tw Tw Tr ", busLog.c_str());
+
+    // Out of retries
+    nakLeft[THR_ADDR] = 2;
+    postThrottle(&mb);
+    runFor(1000);
+    TEST_ASSERT_EQUAL(I2CMB_DONE, mb.state);
+    TEST_ASSERT_EQUAL_INT(-1, mb.len);
+
+    // Short read
+    shortRead = true;
+    TEST_ASSERT_EQUAL_INT(-1, i2cbus_xfer(BP_ADDR, NULL, 0, buf, 2, I2CBUS_NOGAP));
+    shortRead = false;
+    TEST_ASSERT_EQUAL_INT(2, i2cbus_xfer(BP_ADDR, NULL, 0, buf, 2, I2CBUS_NOGAP));
+    TEST_ASSERT_EQUAL_HEX8(BP_ADDR + 1, buf[1]);
+
+    // Not there
+    TEST_ASSERT_FALSE(i2cbus_probe(0x50));
+    TEST_ASSERT_TRUE(i2cbus_probe(BP_ADDR));
+
+    i2cbus_getStats(st, true);
+    TEST_ASSERT_EQUAL_UINT32(4, st.trans);        // Probes not counted
+    TEST_ASSERT_EQUAL_UINT32(1 + 2 + 2, st.naks);
+    TEST_ASSERT_EQUAL_UINT32(1 + 1 + 1, st.retries);
+    TEST_ASSERT_TRUE(st.busUs > 0);
+
+    i2cbus_getStats(st);
+    TEST_ASSERT_EQUAL_UINT32(0, st.trans);
+    TEST_ASSERT_EQUAL_UINT(stubMillis, st.startMs);
+}
+
+static void test_throttle_period(void)
+{
+    i2cMailbox mbT, mbB;
+    i2cBusStats st;
+    unsigned long lastThr = 0, lastBP = 0, lastBatt = 0;
+    unsigned long maxLat = 0, postTime = 0;
+    static const uint8_t reg = 0x0f;
+    uint8_t buf[3];
+    uint8_t cnt = 0;
+    char msg[128];
+
+    // Worst case: 100kHz, display redrawn twice per main
+    // loop pass, ButtonPack read every 20ms, battery
+    // synchronously every second; a pass per ms.
+    stubWireByteUs = 90;
+    mbT.state = mbB.state = I2CMB_IDLE;
+
+    for(int pass = 0; pass < 10000; pass++) {
+        unsigned long now = stubMillis;
+
+        // As REMRotEnc::pollEncPos()
+        if(mbT.state == I2CMB_DONE) {
+            TEST_ASSERT_EQUAL_INT(4, mbT.len);
+            maxLat = max(maxLat, thrReads.back() - postTime);
+            mbT.state = I2CMB_IDLE;
+        }
+        if(mbT.state == I2CMB_IDLE && now - lastThr > 100) {
+            lastThr = now;
+            postTime = stubMicros;
+            postThrottle(&mbT);
+        }
+
+        postFrame(++cnt);
+        postFrame(++cnt);
+
+        if(mbB.state == I2CMB_DONE) {
+            mbB.state = I2CMB_IDLE;
+        }
+        if(mbB.state == I2CMB_IDLE && now - lastBP >= 20) {
+            lastBP = now;
+            i2cbus_post(BP_ADDR, NULL, 0, 1, I2CBUS_NOGAP, &mbB);
+        }
+
+        if(now - lastBatt >= 1000) {
+            lastBatt = now;
+            TEST_ASSERT_EQUAL_INT(3, i2cbus_xfer(BATT_ADDR, &reg, 1, buf, 3, I2CBUS_RSTART));
+        }
+
+        i2cbus_loop();
+
+        // Rest of the pass
+        stubMicros = max(stubMicros, (stubMillis + 1) * 1000);
+        stubMillis = stubMicros / 1000;
+    }
+
+    // Reads come at the poll interval; the only delay is
+    // the gap plus at most one display frame
+    TEST_ASSERT_TRUE(thrReads.size() >= 98);
+    unsigned long minP = ~0UL, maxP = 0;
+    for(size_t i = 1; i < thrReads.size(); i++) {
+        minP = min(minP, thrReads[i] - thrReads[i-1]);
+        maxP = max(maxP, thrReads[i] - thrReads[i-1]);
+    }
+    unsigned long frameUs = (1 + I2CBUS_MAX_WR) * 90;
+    TEST_ASSERT_TRUE(maxLat <= 3 * 90 + THR_GAP + frameUs + 5 * 90);
+    TEST_ASSERT_TRUE(minP >= 101000 - maxLat);
+    TEST_ASSERT_TRUE(maxP <= 101000 + maxLat);
+
+    // Display kept to its budget, all others served
+    TEST_ASSERT_TRUE(frames.size() <= 10000000 / DISP_BUDGET + 1);
+    i2cbus_getStats(st);
+    TEST_ASSERT_EQUAL_UINT32(0, st.naks);
+
+    snprintf(msg, sizeof(msg), "Throttle period %lu-%luus, max latency %luus; %u frames, %u coalesced, bus %u%%",
+            minP, maxP, maxLat, (unsigned)frames.size(), (unsigned)st.coalesced,
+            (unsigned)(st.busUs / 100000));
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_priority_order);
+    RUN_TEST(test_frame_budget);
+    RUN_TEST(test_frame_coalesce);
+    RUN_TEST(test_queue_full);
+    RUN_TEST(test_nak_retry);
+    RUN_TEST(test_throttle_period);
+    return UNITY_END();
+}
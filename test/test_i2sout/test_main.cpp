@@ -0,0 +1,282 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: Staged I2S output against the former per-sample
+ * path, on a stand-in driver
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+// The ESP32 code path is the one under test
+#define ESP32
+
+#include <unity.h>
+#include <chrono>
+#include <vector>
+
+#include "src/ESP8266Audio/AudioLogger.cpp"
+#include "src/ESP8266Audio/AudioOutputI2S.cpp"
+
+#define DMA_BYTES (8 * 64 * 4)      // dma_buf_count * dma_buf_len * frame
+
+// Former TWESP32 ConsumeSample(): One i2s_write() per frame,
+// gain applied through AmplifyL/R. AUTO_MONO, as configured.
+class perSampleI2S : public AudioOutput {
+    public:
+        perSampleI2S()
+        {
+            bps = 16;
+            channels = 2;
+            hertz = 44100;
+            SetGain(1.0);
+        }
+        size_t ConsumeSample(int16_t msL, int16_t msR) override
+        {
+            uint32_t s32;
+            size_t i2s_bytes_written;
+
+            if(channels == 1) msR = msL;
+
+            AmplifyL(msL);
+            s32 = ((uint32_t)AmplifyR(msR)) | (uint16_t)msL;
+
+            i2s_write(0, (const char*)&s32, sizeof(uint32_t), &i2s_bytes_written, 0);
+            return i2s_bytes_written;
+        }
+};
+
+class stagedI2S : public AudioOutputI2S {
+    public:
+        using AudioOutputI2S::stageLen;
+        int staged() { return stageIn - stageOut; }
+};
+
+// What the DMA plays between two calls; it never
+// holds more than DMA_BYTES
+static void drain(size_t bytes)
+{
+    stubI2SRoom = min((size_t)DMA_BYTES, stubI2SRoom + bytes);
+}
+
+static void randomPCM(std::vector<int16_t> &pcm, size_t frames, unsigned int seed)
+{
+    srand(seed);
+    pcm.resize(frames * 2);
+    for(size_t i = 0; i < frames * 2; i++) {
+        switch(rand() % 50) {
+        case 0:  pcm[i] = -32768; break;
+        case 1:  pcm[i] = 32767;  break;
+        default: pcm[i] = (rand() % 65536) - 32768;
+        }
+    }
+}
+
+// Push all of pcm in random blocks while the DMA drains at a
+// random pace, as the generators do: Whatever the output does
+// not take is offered again in the next round
+static std::vector<uint8_t> play(AudioOutput &out, const std::vector<int16_t> &pcm, unsigned int seed)
+{
+    size_t frames = pcm.size() / 2, pos = 0;
+
+    srand(seed);
+    stubI2SData.clear();
+    stubI2SRoom = DMA_BYTES;
+
+    while(pos < frames) {
+        size_t blk = min(frames - pos, (size_t)(1 + rand() % 1152));
+        pos += out.ConsumeSamples(&pcm[pos * 2], blk);
+        out.loop();
+        drain((rand() % 160) * 4);
+    }
+
+    // Out of data: loop() hands over the rest
+    for(int i = 0; i < 1000; i++) {
+        out.loop();
+        drain(64 * 4);
+    }
+
+    return stubI2SData;
+}
+
+static void compare(float gain, int mute, int chans, unsigned int seed)
+{
+    std::vector<int16_t> pcm;
+    perSampleI2S ref;
+    stagedI2S out;
+    char msg[80];
+
+    randomPCM(pcm, 20000, seed);
+
+    ref.SetGain(gain, mute);
+    ref.SetChannels(chans);
+    std::vector<uint8_t> a = play(ref, pcm, seed);
+
+    TEST_ASSERT_TRUE(out.begin());
+    out.SetGain(gain, mute);
+    out.SetChannels(chans);
+    std::vector<uint8_t> b = play(out, pcm, seed);
+    TEST_ASSERT_EQUAL_INT(0, out.staged());
+
+    TEST_ASSERT_EQUAL(pcm.size() * 2, a.size());
+    TEST_ASSERT_EQUAL(a.size(), b.size());
+    for(size_t i = 0; i < a.size(); i++) {
+        if(a[i] != b[i]) {
+            snprintf(msg, sizeof(msg), "Gain %.2f/%d, %d ch: Byte %zu of frame %zu differs",
+                        gain, mute, chans, i % 4, i / 4);
+            TEST_FAIL_MESSAGE(msg);
+        }
+    }
+}
+
+void setUp(void)
+{
+    stubI2SData.clear();
+    stubI2SRoom = (size_t)-1;
+    stubI2SWrites = 0;
+    stubI2SKeep = true;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_unity_gain(void)
+{
+    // Behind the mixer: Samples are only packed
+    compare(1.0, 0, 2, 1);
+    compare(1.0, 0, 1, 2);
+}
+
+static void test_gain(void)
+{
+    compare(0.5, 0, 2, 3);
+    compare(0.73, 0, 2, 4);
+    compare(0.05, 0, 2, 5);
+    compare(0.6, 0, 1, 6);
+}
+
+static void test_muted_channel(void)
+{
+    compare(0.3, 1, 2, 7);
+    compare(0.3, -1, 2, 8);
+}
+
+// Data left in the staging buffer when the generator runs out
+// goes out with loop(), in order
+static void test_partial_flush(void)
+{
+    std::vector<int16_t> pcm;
+    perSampleI2S ref;
+    stagedI2S out;
+
+    randomPCM(pcm, 300, 9);
+    ref.SetGain(0.5);
+    std::vector<uint8_t> a = play(ref, pcm, 9);
+
+    TEST_ASSERT_TRUE(out.begin());
+    out.SetGain(0.5);
+    stubI2SData.clear();
+
+    // DMA full: 100 frames are taken into the staging buffer
+    stubI2SRoom = 0;
+    TEST_ASSERT_EQUAL(100, out.ConsumeSamples(&pcm[0], 100));
+    TEST_ASSERT_EQUAL_INT(100, out.staged());
+    TEST_ASSERT_EQUAL(0, stubI2SData.size());
+
+    // 40 frames of room: Part of them go out
+    drain(40 * 4);
+    out.loop();
+    TEST_ASSERT_EQUAL_INT(60, out.staged());
+    TEST_ASSERT_EQUAL(40 * 4, stubI2SData.size());
+
+    // Buffer fills up behind the unsent rest, then refuses
+    TEST_ASSERT_EQUAL(stagedI2S::stageLen - 60, out.ConsumeSamples(&pcm[100 * 2], 200));
+    TEST_ASSERT_EQUAL_INT(stagedI2S::stageLen, out.staged());
+    TEST_ASSERT_EQUAL(0, out.ConsumeSample(pcm[(100 + stagedI2S::stageLen - 60) * 2], 0));
+
+    // Room for 10: Sent, and the rest is moved to the front
+    // so that 10 more are taken
+    drain(10 * 4);
+    size_t pos = 100 + stagedI2S::stageLen - 60;
+    TEST_ASSERT_EQUAL(10, out.ConsumeSamples(&pcm[pos * 2], 300 - pos));
+    pos += 10;
+    TEST_ASSERT_EQUAL_INT(stagedI2S::stageLen, out.staged());
+
+    // The rest, ending on a partial buffer
+    while(pos < 300) {
+        drain(37 * 4);
+        pos += out.ConsumeSamples(&pcm[pos * 2], 300 - pos);
+    }
+    TEST_ASSERT_TRUE(out.staged() > 0);
+    while(out.staged()) {
+        drain(23 * 4);
+        out.loop();
+    }
+
+    TEST_ASSERT_EQUAL(a.size(), stubI2SData.size());
+    TEST_ASSERT_TRUE(a == stubI2SData);
+}
+
+static void test_benchmark(void)
+{
+    std::vector<int16_t> pcm;
+    const size_t frames = 10 * 44100;
+    char msg[160];
+
+    randomPCM(pcm, frames, 10);
+    stubI2SKeep = false;
+    stubI2SRoom = (size_t)-1;
+
+    for(int g = 0; g < 2; g++) {
+        float gain = g ? 0.5 : 1.0;
+        perSampleI2S ref;
+        stagedI2S out;
+        unsigned long w0, w1;
+        double t0, t1;
+
+        ref.SetGain(gain);
+        TEST_ASSERT_TRUE(out.begin());
+        out.SetGain(gain);
+
+        // Former path: generators pushed sample by sample
+        stubI2SWrites = 0;
+        std::chrono::steady_clock::time_point st = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < frames; i++) ref.ConsumeSample(pcm[i * 2], pcm[i * 2 + 1]);
+        t0 = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+        w0 = stubI2SWrites;
+
+        // Staged: One MP3 frame per call
+        stubI2SWrites = 0;
+        st = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < frames; i += 1152) {
+            out.ConsumeSamples(&pcm[i * 2], min((size_t)1152, frames - i));
+        }
+        t1 = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+        w1 = stubI2SWrites;
+
+        TEST_ASSERT_EQUAL_UINT(frames, w0);
+        TEST_ASSERT_TRUE(w1 <= frames / stagedI2S::stageLen + frames / 1152 + 1);
+
+        snprintf(msg, sizeof(msg), "Gain %.1f: per sample %lu driver calls/s, %.1fns/frame; "
+                                   "staged %lu calls/s, %.1fns/frame",
+                    gain, w0 / 10, t0 * 1e9 / frames, w1 / 10, t1 * 1e9 / frames);
+        TEST_MESSAGE(msg);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_unity_gain);
+    RUN_TEST(test_gain);
+    RUN_TEST(test_muted_channel);
+    RUN_TEST(test_partial_flush);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,264 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: Low-power state machine, replaying scripted traces
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <string>
+
+#include "lpstate.h"
+
+#define MAIN_IDLE_MAX 10    // as in remote_main.cpp
+
+// A trace line: From time "at" on, the power switch is in
+// position "fakeOff", and the loop is busy (display, audio)
+// if "busy". "wake" is a wakeup (button, power switch) at
+// exactly that time, which cuts the idle short.
+typedef struct {
+    unsigned long at;
+    bool          fakeOff;
+    bool          busy;
+    bool          wake;
+} lpEvent;
+
+// The main loop as seen by the state machine: update, then
+// idle for the (stretched) poll interval, unless woken.
+// Transitions are recorded as "E@time" and "L@time".
+class lpSim {
+
+    public:
+
+        lpSim(const lpEvent *trace, int n) : ev(trace), num(n) { sm.begin(0); }
+
+        void run(unsigned long until)
+        {
+            lpStats st;
+
+            while(now < until) {
+                while(i < num && ev[i].at <= now) {
+                    fakeOff = ev[i].fakeOff;
+                    busy = ev[i].busy;
+                    wake |= ev[i].wake;
+                    i++;
+                }
+
+                switch(sm.update(fakeOff, busy || wake, now)) {
+                case LPT_ENTER:
+                    TEST_ASSERT_FALSE(entered);
+                    entered = true;
+                    trans += "E@" + std::to_string(now) + " ";
+                    break;
+                case LPT_LEAVE:
+                    TEST_ASSERT_TRUE(entered);
+                    entered = false;
+                    trans += "L@" + std::to_string(now) + " ";
+                    break;
+                }
+                wake = false;
+
+                sm.getStats(st, true);
+                TEST_ASSERT_TRUE(st.sleepMs <= st.lowPowerMs);
+                TEST_ASSERT_TRUE(st.lowPowerMs <= st.fakeOffMs);
+
+                // Hardware set up exactly while in low-power mode
+                TEST_ASSERT_EQUAL(entered, sm.state() == LP_ON);
+                TEST_ASSERT_EQUAL(!fakeOff, sm.state() == LP_OFF);
+
+                // Other events are seen at the next loop
+                unsigned long w = sm.idleMax(MAIN_IDLE_MAX);
+                for(int j = i; j < num && ev[j].at < now + w; j++) {
+                    if(ev[j].wake) {
+                        // Woken by GPIO interrupt
+                        w = ev[j].at - now;
+                        if(!w) w = 1;
+                        break;
+                    }
+                }
+                sm.idled(w);
+                now += w;
+            }
+        }
+
+        const lpEvent  *ev;
+        int            num;
+        int            i = 0;
+        bool           fakeOff = false, busy = false, wake = false;
+
+        lpStateMachine sm;
+        unsigned long  now = 0;
+        bool           entered = false;
+        std::string    trans;
+};
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_power_switch(void)
+{
+    static const lpEvent tr[] = {
+        { 1000,  true,  false, true },      // Switch off
+        { 20000, false, false, true },      // Switch on
+        { 30000, true,  false, true },      // Off again
+    };
+    lpSim s(tr, 3);
+
+    s.run(5990);
+    TEST_ASSERT_EQUAL(LP_PENDING, s.sm.state());
+    TEST_ASSERT_EQUAL_UINT(MAIN_IDLE_MAX, s.sm.idleMax(MAIN_IDLE_MAX));
+
+    // After LP_ENTER_DELAY of quiet
+    s.run(6010);
+    TEST_ASSERT_EQUAL(LP_ON, s.sm.state());
+    TEST_ASSERT_EQUAL_UINT(LP_IDLE_MAX, s.sm.idleMax(MAIN_IDLE_MAX));
+
+    // Switching on leaves at once, thanks to the wakeup
+    s.run(40000);
+    TEST_ASSERT_EQUAL_STRING("E@6000 L@20000 E@35000 ", s.trans.c_str());
+}
+
+static void test_button_wake(void)
+{
+    static const lpEvent tr[] = {
+        { 0,     true,  false, false },
+        { 7003,  true,  false, true },      // Button press
+        { 9000,  true,  false, true },      // Button press while pending
+        { 20001, true,  false, true },      // Button press
+        { 20002, true,  false, true },      // and another
+    };
+    lpSim s(tr, 5);
+
+    s.run(30000);
+    TEST_ASSERT_EQUAL_STRING("E@5000 L@7003 E@14000 L@20001 E@25002 ", s.trans.c_str());
+}
+
+static void test_busy_postpones(void)
+{
+    static const lpEvent tr[] = {
+        { 0,     true,  true,  false },     // Audio playing
+        { 3000,  true,  false, false },     // done
+        { 6000,  true,  true,  false },     // Display on (offDisplayTmr)
+        { 6500,  true,  false, false },
+        { 11490, true,  true,  false },     // Busy again
+        { 11495, true,  false, false },     // (seen at next loop, 11500)
+        { 20000, true,  true,  false },     // Busy in low-power mode, seen at
+                                            // the next (stretched) poll
+        { 20500, true,  false, false },
+    };
+    lpSim s(tr, 8);
+
+    s.run(20000);
+    TEST_ASSERT_EQUAL_STRING("E@16490 ", s.trans.c_str());
+
+    s.run(30000);
+    TEST_ASSERT_EQUAL_STRING("E@16490 L@20090 E@25490 ", s.trans.c_str());
+}
+
+static void test_switch_bounce(void)
+{
+    // A bouncing power switch never gets as far as low-power mode
+    static const lpEvent tr[] = {
+        { 1000,  true,  false, true },
+        { 1003,  false, false, true },
+        { 1004,  true,  false, true },
+        { 1010,  false, false, true },
+        { 1011,  true,  false, true },
+        { 1012,  false, false, true },
+    };
+    lpSim s(tr, 6);
+
+    s.run(20000);
+    TEST_ASSERT_EQUAL_STRING("", s.trans.c_str());
+    TEST_ASSERT_EQUAL(LP_OFF, s.sm.state());
+}
+
+static void test_stats(void)
+{
+    static const lpEvent tr[] = {
+        { 1000,  true,  false, true },      // Off: 5000 pending
+        { 26000, false, false, true },      // On: 20000 low-power
+    };
+    lpSim s(tr, 2);
+    lpStats st;
+
+    s.sm.getStats(st, true);
+    TEST_ASSERT_EQUAL_UINT(0, st.estCurrent);
+
+    s.run(30000);
+
+    s.sm.getStats(st, false);
+    TEST_ASSERT_EQUAL(LP_OFF, st.state);
+    TEST_ASSERT_EQUAL_UINT(25000, st.fakeOffMs);
+    TEST_ASSERT_EQUAL_UINT(20000, st.lowPowerMs);
+    // All of low-power mode is idle, save for the loops
+    TEST_ASSERT_EQUAL_UINT(20000, st.sleepMs);
+    TEST_ASSERT_EQUAL_UINT((110 * 5000 + 35 * 20000) / 25000, st.estCurrent);
+    TEST_ASSERT_FALSE(st.autoLightSleep);
+
+    s.sm.getStats(st, true);
+    TEST_ASSERT_TRUE(st.autoLightSleep);
+    TEST_ASSERT_EQUAL_UINT((110 * 5000 + 12 * 20000) / 25000, st.estCurrent);
+}
+
+static void test_random_traces(void)
+{
+    srand(17);
+
+    for(int r = 0; r < 200; r++) {
+        lpEvent tr[40];
+        unsigned long t = 0;
+        lpSim s(tr, 40);
+        lpStats st;
+
+        for(int i = 0; i < 40; i++) {
+            t += rand() % 8000;
+            tr[i].at = t;
+            tr[i].fakeOff = (rand() % 4) != 0;
+            tr[i].busy = (rand() % 3) == 0;
+            tr[i].wake = (rand() % 2) == 0;
+        }
+        s.run(t + 10000);
+
+        s.sm.getStats(st, true);
+        TEST_ASSERT_TRUE(st.estCurrent >= LP_EST_LSLP_MA || !st.fakeOffMs);
+        TEST_ASSERT_TRUE(st.estCurrent <= LP_EST_AWAKE_MA);
+
+        // Every entry follows LP_ENTER_DELAY of quiet, fake-off
+        size_t p = 0;
+        while((p = s.trans.find("E@", p)) != std::string::npos) {
+            unsigned long e = strtoul(s.trans.c_str() + p + 2, NULL, 10);
+            for(int i = 0; i < 40; i++) {
+                if(tr[i].at > e - LP_ENTER_DELAY && tr[i].at <= e) {
+                    TEST_ASSERT_TRUE(tr[i].fakeOff && !tr[i].busy && !tr[i].wake);
+                }
+            }
+            p += 2;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_power_switch);
+    RUN_TEST(test_button_wake);
+    RUN_TEST(test_busy_postpones);
+    RUN_TEST(test_switch_bounce);
+    RUN_TEST(test_stats);
+    RUN_TEST(test_random_traces);
+    return UNITY_END();
+}
@@ -0,0 +1,535 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: AudioOutputMixer against a plain 64 bit model
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define cycles() __rdtsc()
+#else
+#define cycles() 0ULL
+#endif
+
+#include "AudioOutputMixer.cpp"
+
+// Collects what the mixer hands on. If "partial" is set, only
+// a random share of each block is taken, like a DMA buffer being
+// drained.
+class pcmSink : public AudioOutput {
+    public:
+        bool begin() { running = true; return true; }
+        bool stop() { running = false; stops++; return true; }
+        size_t ConsumeSamples(const int16_t *samples, size_t count)
+        {
+            if(partial) count = min(count, (size_t)(rand() % 100));
+            if(keep) pcm.insert(pcm.end(), samples, samples + count * 2);
+            return count;
+        }
+        int rate() { return hertz; }
+
+        std::vector<int16_t> pcm;
+        bool                 keep = true;
+        bool                 partial = false;
+        bool                 running = false;
+        int                  stops = 0;
+};
+
+class mixProbe : public AudioOutputMixer {
+    public:
+        mixProbe(AudioOutput *s) : AudioOutputMixer(s) {}
+        using AudioOutputMixer::maxVoices;
+        using AudioOutputMixer::blkLen;
+        const int16_t *voicePcm(int i) { return voice[i].pcm; }
+        int active() { return numVoices; }
+        int pending() { return blkIn - blkOut; }
+};
+
+// What the output should be: Everything summed up exactly,
+// then saturated
+typedef struct {
+    const int16_t *pcm;
+    uint32_t len;
+    uint32_t start;         // frame of main stream
+    int32_t  gain;
+} refVoice;
+
+static std::vector<int16_t> refMix(const std::vector<int16_t> *in, size_t frames, int32_t g,
+                                   bool mono, const std::vector<refVoice> &v)
+{
+    std::vector<int16_t> o;
+
+    for(size_t k = 0; k < frames; k++) {
+        int64_t vs = 0;
+        for(size_t j = 0; j < v.size(); j++) {
+            if(k >= v[j].start && k - v[j].start < v[j].len) {
+                vs += (int64_t)v[j].pcm[k - v[j].start] * v[j].gain;
+            }
+        }
+        for(int c = 0; c < 2; c++) {
+            int64_t s = vs;
+            if(in) s += (int64_t)(*in)[k * 2 + (mono ? 0 : c)] * g;
+            s >>= 15;
+            o.push_back(s > 32767 ? 32767 : (s < -32768 ? -32768 : s));
+        }
+    }
+
+    return o;
+}
+
+static void randomPCM(std::vector<int16_t> &pcm, size_t n, int amp)
+{
+    pcm.resize(n);
+    for(size_t i = 0; i < n; i++) {
+        switch(rand() % 50) {
+        case 0:  pcm[i] = -32768; break;
+        case 1:  pcm[i] = 32767;  break;
+        default: pcm[i] = (rand() % (2 * amp + 1)) - amp;
+        }
+    }
+}
+
+static void assertNear(const std::vector<int16_t> &a, const std::vector<int16_t> &b, int tol, const char *what)
+{
+    char msg[100];
+
+    if(a.size() != b.size()) {
+        snprintf(msg, sizeof(msg), "%s: %zu samples, expected %zu", what, b.size(), a.size());
+        TEST_FAIL_MESSAGE(msg);
+    }
+    for(size_t i = 0; i < a.size(); i++) {
+        if(abs(a[i] - b[i]) > tol) {
+            snprintf(msg, sizeof(msg), "%s: Frame %zu (%s): %d, expected %d",
+                        what, i / 2, (i & 1) ? "R" : "L", b[i], a[i]);
+            TEST_FAIL_MESSAGE(msg);
+        }
+    }
+}
+
+// Feed main stream in random blocks; voices are started at
+// the frames given (which must be in ascending order)
+static void feed(mixProbe &mix, const std::vector<int16_t> &in, std::vector<refVoice> &v)
+{
+    size_t frames = in.size() / 2, pos = 0, nv = 0;
+
+    while(pos < frames) {
+        while(nv < v.size() && v[nv].start <= pos) {
+            TEST_ASSERT_TRUE(mix.playVoice(v[nv].pcm, v[nv].len, v[nv].gain / 32768.0f, 1));
+            v[nv++].start = pos;
+        }
+        size_t n = 1 + rand() % 1152;
+        if(nv < v.size()) n = min(n, v[nv].start - pos);
+        n = min(n, frames - pos);
+        pos += mix.ConsumeSamples(&in[pos * 2], n);
+        mix.loop();
+    }
+
+    // What the sink didn't take yet goes out with the next
+    // block; stop() would drop it
+    while(mix.pending()) {
+        mix.ConsumeSamples(&in[0], 0);
+    }
+    mix.stop();
+}
+
+void setUp(void)
+{
+    srand(4711);
+}
+
+void tearDown(void)
+{
+}
+
+// No voices: Main stream scaled only
+static void test_main_only(void)
+{
+    static const float gains[] = { 1.0f, 0.7f, 0.13f, 0.02f };
+    std::vector<int16_t> in;
+
+    randomPCM(in, 2 * 5000, 32767);
+
+    for(int mono = 0; mono < 2; mono++) {
+        for(int i = 0; i < 4; i++) {
+            pcmSink sink;
+            mixProbe mix(&sink);
+            std::vector<refVoice> v;
+
+            sink.partial = true;
+            mix.SetGain(gains[i]);
+            mix.SetChannels(mono ? 1 : 2);
+            TEST_ASSERT_TRUE(mix.begin());
+            feed(mix, in, v);
+
+            assertNear(refMix(&in, 5000, toQ15(gains[i]), mono, v), sink.pcm, 0, "Main");
+        }
+    }
+}
+
+// Voices started anywhere in the stream, overlapping
+static void test_voices(void)
+{
+    std::vector<int16_t> in, p[4];
+    std::vector<refVoice> v;
+    pcmSink sink;
+    mixProbe mix(&sink);
+
+    randomPCM(in, 2 * 20000, 12000);
+    for(int i = 0; i < 4; i++) {
+        randomPCM(p[i], 300 + rand() % 3000, 12000);
+    }
+
+    // At most three at a time
+    static const uint32_t st[]   = { 10, 700, 1000, 5000, 5001, 5002, 9000, 12000, 12500 };
+    static const float    gain[] = { 0.5f, 1.0f, 0.3f, 0.8f, 0.8f, 0.8f, 0.02f, 0.6f, 0.9f };
+    for(int i = 0; i < 9; i++) {
+        refVoice r = { p[i & 3].data(), (uint32_t)p[i & 3].size(), st[i], toQ15(gain[i]) };
+        v.push_back(r);
+    }
+
+    sink.partial = true;
+    mix.SetGain(0.6f);
+    TEST_ASSERT_TRUE(mix.begin());
+    feed(mix, in, v);
+
+    assertNear(refMix(&in, 20000, toQ15(0.6f), false, v), sink.pcm, 1, "Voices");
+}
+
+// Full scale everywhere: Clipped, not wrapped
+static void test_saturation(void)
+{
+    std::vector<int16_t> in, p[3];
+    std::vector<refVoice> v;
+    pcmSink sink;
+    mixProbe mix(&sink);
+
+    for(int i = 0; i < 3; i++) {
+        p[i].assign(2000, (i & 1) ? -32768 : 32767);
+        for(size_t k = 0; k < 2000; k += 7) p[i][k] = -p[i][k] - 1;
+        refVoice r = { p[i].data(), 2000, (uint32_t)i * 100, toQ15(1.0f) };
+        v.push_back(r);
+    }
+    randomPCM(in, 2 * 3000, 0);
+    for(size_t k = 0; k < in.size(); k++) in[k] = (k & 2) ? 32767 : -32768;
+
+    TEST_ASSERT_TRUE(mix.begin());
+    feed(mix, in, v);
+    std::vector<int16_t> ref = refMix(&in, 3000, toQ15(1.0f), false, v);
+    assertNear(ref, sink.pcm, 1, "Saturation");
+}
+
+// All slots taken: The oldest voice of the lowest priority
+// goes, never one of higher priority
+static void test_priority(void)
+{
+    static const int16_t a[100] = { 0 }, b[100] = { 0 }, c[100] = { 0 }, d[100] = { 0 }, e[100] = { 0 };
+    pcmSink sink;
+    mixProbe mix(&sink);
+
+    TEST_ASSERT_EQUAL_INT(3, mixProbe::maxVoices);
+    TEST_ASSERT_TRUE(mix.begin());
+
+    TEST_ASSERT_TRUE(mix.playVoice(a, 100, 1.0f, 1));
+    TEST_ASSERT_TRUE(mix.playVoice(b, 100, 1.0f, 2));
+    TEST_ASSERT_TRUE(mix.playVoice(c, 100, 1.0f, 1));
+    TEST_ASSERT_EQUAL_INT(3, mix.active());
+
+    // Replaces a, the older one of prio 1
+    TEST_ASSERT_TRUE(mix.playVoice(d, 100, 1.0f, 1));
+    TEST_ASSERT_TRUE(mix.voicePcm(0) == d);
+
+    // Nothing lower than 2 to replace
+    TEST_ASSERT_FALSE(mix.playVoice(e, 100, 1.0f, 0));
+
+    // Prio 2: Replaces c (prio 1, now older than d)
+    TEST_ASSERT_TRUE(mix.playVoice(e, 100, 1.0f, 2));
+    TEST_ASSERT_TRUE(mix.voicePcm(2) == e);
+    TEST_ASSERT_TRUE(mix.voicePcm(1) == b);
+    TEST_ASSERT_EQUAL_INT(3, mix.active());
+
+    mix.stopVoices();
+    TEST_ASSERT_EQUAL_INT(0, mix.active());
+}
+
+// No main stream: Voices are played over silence by loop(),
+// which stops the sink when they are done
+static void test_voices_only(void)
+{
+    std::vector<int16_t> p[2];
+    std::vector<refVoice> v;
+    pcmSink sink;
+    mixProbe mix(&sink);
+
+    sink.partial = true;
+    randomPCM(p[0], 1000, 30000);
+    randomPCM(p[1], 333, 30000);
+    refVoice r0 = { p[0].data(), 1000, 0, toQ15(0.9f) };
+    refVoice r1 = { p[1].data(), 333, 0, toQ15(0.8f) };
+    v.push_back(r0);
+    v.push_back(r1);
+
+    TEST_ASSERT_TRUE(mix.playVoice(r0.pcm, r0.len, 0.9f, 1));
+    TEST_ASSERT_TRUE(mix.playVoice(r1.pcm, r1.len, 0.8f, 1));
+    TEST_ASSERT_TRUE(sink.running);
+    TEST_ASSERT_TRUE(mix.voicesActive());
+
+    for(int i = 0; i < 1000 && mix.voicesActive(); i++) mix.loop();
+
+    TEST_ASSERT_FALSE(mix.voicesActive());
+    TEST_ASSERT_FALSE(sink.running);
+    TEST_ASSERT_EQUAL_INT(1, sink.stops);
+
+    // Whole blocks: Silence after the voices
+    size_t frames = (1000 + mixProbe::blkLen - 1) / mixProbe::blkLen * mixProbe::blkLen;
+    assertNear(refMix(NULL, frames, 0, false, v), sink.pcm, 1, "Voices only");
+}
+
+// Voices are 44.1kHz and can't be mixed into other rates
+static void test_rate(void)
+{
+    static const int16_t a[100] = { 0 };
+    pcmSink sink;
+    mixProbe mix(&sink);
+
+    TEST_ASSERT_TRUE(mix.playVoice(a, 100, 1.0f, 1));
+    TEST_ASSERT_TRUE(mix.begin());
+    mix.SetRate(22050);
+    TEST_ASSERT_EQUAL_INT(22050, sink.rate());
+    TEST_ASSERT_EQUAL_INT(0, mix.active());
+    TEST_ASSERT_FALSE(mix.playVoice(a, 100, 1.0f, 1));
+
+    mix.SetRate(44100);
+    TEST_ASSERT_TRUE(mix.playVoice(a, 100, 1.0f, 1));
+
+    // Main stream stops: Voices over silence at their rate
+    mix.stop();
+    mix.SetRate(22050);
+    TEST_ASSERT_TRUE(mix.playVoice(a, 100, 1.0f, 1));
+    TEST_ASSERT_EQUAL_INT(44100, sink.rate());
+}
+
+/*
+ * Gain ramp
+ *
+ * Input at -32768 comes out as the negated gain, exactly, on 
+ * both paths: Main stream only and with voices.
+ */
+
+static int16_t rampIn[2 * 1152];
+static const int16_t silence[4000] = { 0 };
+
+// Feed n frames, return the gain of each
+static void rampFeed(mixProbe &mix, pcmSink &sink, int n, std::vector<int32_t> &g)
+{
+    sink.pcm.clear();
+    TEST_ASSERT_EQUAL(n, mix.ConsumeSamples(rampIn, n));
+    for(size_t i = 0; i < sink.pcm.size(); i += 2) {
+        TEST_ASSERT_EQUAL_INT(sink.pcm[i], sink.pcm[i + 1]);
+        g.push_back(-sink.pcm[i]);
+    }
+}
+
+// After SetGain(), the gain moves linearly to the new value over
+// the next block (at most blkLen frames), then stays there
+static void test_ramp(void)
+{
+    for(int withVoice = 0; withVoice < 2; withVoice++) {
+        pcmSink sink;
+        mixProbe mix(&sink);
+        std::vector<int32_t> g;
+        int32_t cur;
+        char msg[100];
+
+        for(int i = 0; i < 2 * 1152; i++) rampIn[i] = -32768;
+
+        // Not playing: No ramp
+        mix.SetGain(0.5f);
+        TEST_ASSERT_TRUE(mix.begin());
+        rampFeed(mix, sink, 100, g);
+        for(size_t i = 0; i < g.size(); i++) TEST_ASSERT_EQUAL_INT32(toQ15(0.5f), g[i]);
+        cur = toQ15(0.5f);
+
+        for(int r = 0; r < 300; r++) {
+            float f = (rand() % 1001) / 1000.0f;
+            int32_t target = toQ15(f);
+            int n = 1 + rand() % 1152;
+            int blk = (n < mixProbe::blkLen) ? n : mixProbe::blkLen;
+            int32_t maxStep = (abs(target - cur) + blk - 1) / blk + 1;
+
+            if(withVoice && !mix.active()) {
+                mix.playVoice(silence, 1 + rand() % 4000, 1.0f, 1);
+            }
+
+            mix.SetGain(f);
+            g.clear();
+            rampFeed(mix, sink, n, g);
+
+            for(int i = 0; i < n; i++) {
+                int32_t prev = i ? g[i - 1] : cur;
+                int32_t step = g[i] - prev;
+                if(abs(step) > maxStep || (step && ((step > 0) != (target > cur)))) {
+                    snprintf(msg, sizeof(msg), "%d -> %d over %d: Frame %d steps %d",
+                                cur, target, blk, i, step);
+                    TEST_FAIL_MESSAGE(msg);
+                }
+                if(i >= blk - 1 && g[i] != target) {
+                    snprintf(msg, sizeof(msg), "%d -> %d over %d: Frame %d at %d",
+                                cur, target, blk, i, g[i]);
+                    TEST_FAIL_MESSAGE(msg);
+                }
+            }
+            cur = target;
+        }
+    }
+}
+
+// The former way: Gain recalculated as float every other loop,
+// then applied per sample by the output (AmplifyL/AmplifyR)
+static const float volTable[20] = {
+    0.00f, 0.02f, 0.04f, 0.06f,
+    0.08f, 0.10f, 0.13f, 0.16f,
+    0.19f, 0.22f, 0.26f, 0.30f,
+    0.35f, 0.40f, 0.50f, 0.60f,
+    0.70f, 0.80f, 0.90f, 1.00f
+};
+
+static volatile int   curSoftVol = 12;
+static volatile float curVolFact = 0.8f;
+
+static float calcVolume(float fact)
+{
+    float vol_val = volTable[curSoftVol];
+
+    if(vol_val == 0.0f) return vol_val;
+    vol_val *= fact;
+    if(vol_val < 0.02f) vol_val = 0.02f;
+
+    return vol_val;
+}
+
+// I2S driver's buffer
+uint32_t ampBuf[1152];
+
+class amplifyOut : public AudioOutput {
+    public:
+        size_t ConsumeSamples(const int16_t *samples, size_t count)
+        {
+            for(size_t i = 0; i < count; i++, samples += 2) {
+                int16_t l = samples[0];
+                AmplifyL(l);
+                ampBuf[i] = ((uint32_t)AmplifyR(samples[1])) | (uint16_t)l;
+            }
+            return count;
+        }
+};
+
+static void test_ramp_benchmark(void)
+{
+    const int blocks = 20000;
+    pcmSink sink;
+    mixProbe mix(&sink);
+    amplifyOut amp;
+    double t[3], c[3];
+    char msg[240];
+
+    for(int i = 0; i < 2 * 1152; i++) rampIn[i] = (rand() % 40001) - 20000;
+    sink.keep = false;
+    TEST_ASSERT_TRUE(mix.begin());
+
+    for(int m = 0; m < 3; m++) {
+        std::chrono::steady_clock::time_point st = std::chrono::steady_clock::now();
+        unsigned long long c0 = cycles();
+        for(int i = 0; i < blocks; i++) {
+            switch(m) {
+            case 0:
+                // SetGain() on every other loop()
+                if(i & 1) amp.SetGain(calcVolume(curVolFact));
+                amp.ConsumeSamples(rampIn, 1152);
+                break;
+            case 1:
+                // Gain unchanged
+                mix.ConsumeSamples(rampIn, 1152);
+                break;
+            case 2:
+                // New gain for every frame, ramped
+                mix.SetGain((i & 1) ? 0.3f : 0.4f);
+                mix.ConsumeSamples(rampIn, 1152);
+                break;
+            }
+        }
+        c[m] = (double)(cycles() - c0) / blocks;
+        t[m] = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count() * 1e6 / blocks;
+    }
+
+    snprintf(msg, sizeof(msg), "Per 1152 frames: SetGain polling + Amplify %.2fus (%.0f cycles); "
+                               "Q15 %.2fus (%.0f cycles), with ramp %.2fus (%.0f cycles)",
+                t[0], c[0], t[1], c[1], t[2], c[2]);
+    TEST_MESSAGE(msg);
+}
+
+// Mixing one MP3 frame (1152 frames) with 0-3 voices
+static void test_benchmark(void)
+{
+    std::vector<int16_t> in, p;
+    const int blocks = 20000;
+    double t[4], c[4];
+    char msg[240];
+
+    randomPCM(in, 2 * 1152, 20000);
+    randomPCM(p, 1152 * (blocks + 1), 20000);
+
+    for(int nv = 0; nv < 4; nv++) {
+        pcmSink sink;
+        mixProbe mix(&sink);
+
+        sink.keep = false;
+        mix.SetGain(0.7f);
+        TEST_ASSERT_TRUE(mix.begin());
+        for(int k = 0; k < nv; k++) {
+            mix.playVoice(p.data() + k, p.size() - k, 0.5f, 1);
+        }
+
+        std::chrono::steady_clock::time_point st = std::chrono::steady_clock::now();
+        unsigned long long c0 = cycles();
+        for(int i = 0; i < blocks; i++) {
+            TEST_ASSERT_EQUAL(1152, mix.ConsumeSamples(in.data(), 1152));
+        }
+        c[nv] = (double)(cycles() - c0) / blocks / 1152;
+        t[nv] = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+        TEST_ASSERT_EQUAL_INT(nv, mix.active());
+    }
+
+    // Host TSC cycles; 0 where there is no such counter
+    snprintf(msg, sizeof(msg), "Per 1152 frames: main only %.2fus, 1 voice %.2fus, "
+                               "2 voices %.2fus, 3 voices %.2fus; cycles/frame %.1f + %.1f per voice",
+                t[0] * 1e6 / blocks, t[1] * 1e6 / blocks, t[2] * 1e6 / blocks, t[3] * 1e6 / blocks,
+                c[0], (c[3] - c[0]) / 3);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_main_only);
+    RUN_TEST(test_voices);
+    RUN_TEST(test_saturation);
+    RUN_TEST(test_priority);
+    RUN_TEST(test_voices_only);
+    RUN_TEST(test_rate);
+    RUN_TEST(test_ramp);
+    RUN_TEST(test_ramp_benchmark);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
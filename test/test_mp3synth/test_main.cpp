@@ -0,0 +1,261 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: MP3 whole-frame synthesis against the former
+ * per-slot path
+ *
+ * libmad is C and built as its own unit, see libmad.c
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <vector>
+
+#include "src/ESP8266Audio/AudioLogger.cpp"
+#include "src/ESP8266Audio/AudioGeneratorMP3.cpp"
+
+// Collects what is handed to the output. If "partial" is set,
+// only a random share of each block is taken, like a DMA buffer
+// being drained.
+class pcmSink : public AudioOutput {
+    public:
+        size_t ConsumeSample(int16_t sL, int16_t sR)
+        {
+            calls++;
+            if(keep) {
+                pcm.push_back(sL);
+                pcm.push_back(sR);
+            }
+            return 1;
+        }
+        size_t ConsumeSamples(const int16_t *samples, size_t count)
+        {
+            calls++;
+            if(partial) count = min(count, (size_t)(rand() % 400));
+            if(keep) pcm.insert(pcm.end(), samples, samples + count * 2);
+            return count;
+        }
+        int rate() { return hertz; }
+        int chans() { return channels; }
+
+        std::vector<int16_t> pcm;
+        bool                 keep = true;
+        bool                 partial = false;
+        unsigned long        calls = 0;
+};
+
+// The generator without file and decoder: Synthesizes the
+// frame given and drains it as loop() does
+class synthProbe : public AudioGeneratorMP3 {
+    public:
+        synthProbe(struct mad_synth *s, struct mad_frame *f, AudioOutput *o)
+        {
+            synth = s;
+            frame = f;
+            output = o;
+            samplePtr = pcmLen = 0;
+            lastRate = 0;
+            lastChannels = 0;
+        }
+        ~synthProbe()
+        {
+            // Not ours to free
+            synth = NULL;
+            frame = NULL;
+        }
+        void frameOut()
+        {
+            TEST_ASSERT_TRUE(SynthFrame());
+            while(samplePtr < pcmLen) {
+                samplePtr += output->ConsumeSamples(&pcmBuf[samplePtr * 2], pcmLen - samplePtr);
+            }
+        }
+};
+
+// Former path: mad_synth_frame_onens() per subband slot, each
+// sample handed to the output by itself
+static unsigned int lastRate, lastChannels;
+
+static void baselineFrame(struct mad_synth *s, struct mad_frame *f, AudioOutput *o)
+{
+    unsigned int ns = MAD_NSBSAMPLES(&f->header);
+
+    for(unsigned int i = 0; i < ns; i++) {
+        mad_synth_frame_onens(s, f, i);
+        if(s->pcm.samplerate != lastRate) {
+            o->SetRate(s->pcm.samplerate);
+            lastRate = s->pcm.samplerate;
+        }
+        if(s->pcm.channels != lastChannels) {
+            o->SetChannels(s->pcm.channels);
+            lastChannels = s->pcm.channels;
+        }
+        for(unsigned int j = 0; j < s->pcm.length; j++) {
+            o->ConsumeSample(s->pcm.samples[0][j], s->pcm.samples[1][j]);
+        }
+    }
+}
+
+enum { ST_44K, MONO_44K, LSF_22K };
+
+// Decoded subband samples as the layer III decoder leaves them:
+// Mostly within +/-1/32, a few far out to hit the clipping
+static void fillFrame(struct mad_frame *f, int kind, unsigned int seed)
+{
+    srand(seed);
+
+    f->header.layer = MAD_LAYER_III;
+    f->header.mode = (kind == MONO_44K) ? MAD_MODE_SINGLE_CHANNEL : MAD_MODE_JOINT_STEREO;
+    f->header.flags = (kind == LSF_22K) ? MAD_FLAG_LSF_EXT : 0;
+    f->header.samplerate = (kind == LSF_22K) ? 22050 : 44100;
+    f->options = 0;
+
+    for(int ch = 0; ch < 2; ch++) {
+        for(int s = 0; s < 36; s++) {
+            for(int sb = 0; sb < 32; sb++) {
+                mad_fixed_t v = (rand() % (MAD_F_ONE / 16)) - MAD_F_ONE / 32;
+                if(!(rand() % 5000)) v *= 64;
+                f->sbsample[ch][s][sb] = v;
+            }
+        }
+    }
+}
+
+static struct mad_synth *newSynth()
+{
+    struct mad_synth *s = (struct mad_synth *)calloc(1, sizeof(struct mad_synth));
+    mad_synth_init(s);
+    return s;
+}
+
+// Same frames through both paths, compared sample by sample
+static void compare(const int *kinds, int numKinds, int frames, bool partial)
+{
+    struct mad_frame *f = (struct mad_frame *)calloc(1, sizeof(struct mad_frame));
+    struct mad_synth *s0 = newSynth(), *s1 = newSynth();
+    pcmSink ref, out;
+    synthProbe gen(s1, f, &out);
+    size_t expect = 0;
+
+    lastRate = lastChannels = 0;
+    out.partial = partial;
+
+    for(int i = 0; i < frames; i++) {
+        int kind = kinds[i % numKinds];
+        fillFrame(f, kind, i + 1);
+        baselineFrame(s0, f, &ref);
+        gen.frameOut();
+        expect += 32 * MAD_NSBSAMPLES(&f->header);
+        TEST_ASSERT_EQUAL_INT(ref.rate(), out.rate());
+        TEST_ASSERT_EQUAL_INT(ref.chans(), out.chans());
+    }
+
+    TEST_ASSERT_EQUAL(expect * 2, ref.pcm.size());
+    TEST_ASSERT_EQUAL(ref.pcm.size(), out.pcm.size());
+    for(size_t i = 0; i < ref.pcm.size(); i++) {
+        if(ref.pcm[i] != out.pcm[i]) {
+            char msg[80];
+            snprintf(msg, sizeof(msg), "Sample %zu (%s): %d != %d", 
+                        i / 2, (i & 1) ? "R" : "L", ref.pcm[i], out.pcm[i]);
+            TEST_FAIL_MESSAGE(msg);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT(s0->phase, s1->phase);
+
+    free(s0);
+    free(s1);
+    free(f);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_stereo(void)
+{
+    static const int k[] = { ST_44K };
+    compare(k, 1, 200, false);
+}
+
+static void test_mono(void)
+{
+    static const int k[] = { MONO_44K };
+    compare(k, 1, 200, false);
+}
+
+// MPEG-2: 18 slots per frame, the filter phase (mod 16)
+// runs across frame boundaries
+static void test_lsf(void)
+{
+    static const int k[] = { LSF_22K };
+    compare(k, 1, 200, false);
+}
+
+// Format changes between frames, and an output that
+// takes a frame in several bites
+static void test_mixed_partial(void)
+{
+    static const int k[] = { ST_44K, LSF_22K, LSF_22K, MONO_44K, ST_44K, LSF_22K };
+    compare(k, 6, 300, true);
+}
+
+static void test_benchmark(void)
+{
+    struct mad_frame *f = (struct mad_frame *)calloc(1, sizeof(struct mad_frame));
+    struct mad_synth *s0 = newSynth(), *s1 = newSynth();
+    pcmSink ref, out;
+    synthProbe gen(s1, f, &out);
+    const int frames = 2000;
+    double t0, t1;
+    char msg[160];
+
+    ref.keep = out.keep = false;
+    fillFrame(f, ST_44K, 1);
+    lastRate = lastChannels = 0;
+
+    std::chrono::steady_clock::time_point st = std::chrono::steady_clock::now();
+    for(int i = 0; i < frames; i++) baselineFrame(s0, f, &ref);
+    t0 = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+
+    st = std::chrono::steady_clock::now();
+    for(int i = 0; i < frames; i++) gen.frameOut();
+    t1 = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+
+    TEST_ASSERT_EQUAL_UINT(frames * 1152, ref.calls);
+    TEST_ASSERT_EQUAL_UINT(frames, out.calls);
+
+    // 1152 samples per frame at 44.1kHz
+    snprintf(msg, sizeof(msg), "Per-slot: %.1fus/frame, %lu output calls/frame; "
+                               "whole frame: %.1fus/frame, %lu call/frame (%.0fx realtime)",
+                t0 * 1e6 / frames, ref.calls / frames,
+                t1 * 1e6 / frames, out.calls / frames,
+                frames * 1152.0 / 44100.0 / t1);
+    TEST_MESSAGE(msg);
+
+    free(s0);
+    free(s1);
+    free(f);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_stereo);
+    RUN_TEST(test_mono);
+    RUN_TEST(test_lsf);
+    RUN_TEST(test_mixed_partial);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,271 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: Music folder index, on a temporary directory
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <string>
+
+#include "mpidx.cpp"
+
+#define FOLDER 2
+
+static std::string path(const char *fn)
+{
+    char buf[32];
+    sprintf(buf, "/music%d/%s", FOLDER, fn);
+    return buf;
+}
+
+static std::string numPath(int num)
+{
+    char buf[16];
+    sprintf(buf, "%03d.mp3", num);
+    return path(buf);
+}
+
+// An mp3 file: ID3v2 tag of tagLen bytes (0 = none), then
+// dataLen bytes starting with an MPEG1 Layer III frame header,
+// 128kbps, 44.1kHz, stereo.
+static void putMP3(int num, int tagLen, int dataLen)
+{
+    std::string c;
+
+    if(tagLen) {
+        int t = tagLen - 10;
+        c = std::string("ID3\x03\x00\x00", 6);
+        c += (char)((t >> 21) & 0x7f);
+        c += (char)((t >> 14) & 0x7f);
+        c += (char)((t >> 7) & 0x7f);
+        c += (char)(t & 0x7f);
+        c += std::string(t, 'T');
+    }
+    c += std::string("\xff\xfb\x90\x00", 4);
+    c += std::string(dataLen - 4, '\0');
+
+    File f = SD.open(numPath(num).c_str(), FILE_WRITE);
+    TEST_ASSERT_TRUE(f);
+    f.write((const uint8_t *)c.data(), c.size());
+    f.close();
+}
+
+static void checkEntry(int num, int tagLen, int dataLen)
+{
+    TEST_ASSERT_TRUE(num < mpIdxCount);
+    TEST_ASSERT_EQUAL_UINT32(tagLen + dataLen, mpIndex[num].size);
+    TEST_ASSERT_EQUAL_UINT32(tagLen, mpIndex[num].dataOffs);
+    // 128 kbit/s = 16 bytes per ms
+    TEST_ASSERT_EQUAL_UINT32(dataLen / 16, mpIndex[num].durMs);
+}
+
+void setUp(void)
+{
+    char tmpl[] = "/tmp/mpidxXXXXXX";
+
+    TEST_ASSERT_NOT_NULL(mkdtemp(tmpl));
+    stubFSRoot = tmpl;
+    TEST_ASSERT_EQUAL_INT(0, mkdir((stubFSRoot + path("")).c_str(), 0755));
+
+    putMP3(0, 0, 16000);
+    putMP3(1, 1034, 32000);
+    putMP3(3, 20, 1600);
+}
+
+void tearDown(void)
+{
+    mpidx_free();
+    TEST_ASSERT_EQUAL_INT(0, stubFSOpen);
+    std::string cmd = "rm -rf " + stubFSRoot;
+    if(system(cmd.c_str())) { }
+}
+
+static void test_build(void)
+{
+    File f = SD.open(path("notes.txt").c_str(), FILE_WRITE);
+    f.close();
+    TEST_ASSERT_EQUAL_INT(0, mkdir((stubFSRoot + path("010.mp3")).c_str(), 0755));
+
+    TEST_ASSERT_TRUE(mpidx_build(FOLDER));
+
+    // Up to the highest file; no entry for gaps,
+    // other files and directories
+    TEST_ASSERT_EQUAL_UINT16(4, mpIdxCount);
+    checkEntry(0, 0, 16000);
+    checkEntry(1, 1034, 32000);
+    TEST_ASSERT_EQUAL_UINT32(0, mpIndex[2].size);
+    checkEntry(3, 20, 1600);
+
+    TEST_ASSERT_TRUE(SD.exists(path("REM_MPIX.BIN").c_str()));
+}
+
+static void test_build_empty(void)
+{
+    SD.remove(numPath(0).c_str());
+    SD.remove(numPath(1).c_str());
+    SD.remove(numPath(3).c_str());
+
+    TEST_ASSERT_FALSE(mpidx_build(FOLDER));
+    TEST_ASSERT_NULL(mpIndex);
+    TEST_ASSERT_FALSE(mpidx_build(FOLDER + 1));
+}
+
+static void test_load(void)
+{
+    TEST_ASSERT_FALSE(mpidx_load(FOLDER));
+
+    TEST_ASSERT_TRUE(mpidx_build(FOLDER));
+    mpidx_free();
+    TEST_ASSERT_NULL(mpIndex);
+    TEST_ASSERT_EQUAL_UINT16(0, mpIdxCount);
+
+    TEST_ASSERT_TRUE(mpidx_load(FOLDER));
+    TEST_ASSERT_EQUAL_UINT16(4, mpIdxCount);
+    checkEntry(0, 0, 16000);
+    checkEntry(1, 1034, 32000);
+    TEST_ASSERT_EQUAL_UINT32(0, mpIndex[2].size);
+    checkEntry(3, 20, 1600);
+
+    // Index of one folder is not taken for another
+    TEST_ASSERT_FALSE(mpidx_load(FOLDER + 1));
+}
+
+static void test_load_corrupt(void)
+{
+    uint8_t buf[200];
+    size_t len;
+
+    TEST_ASSERT_TRUE(mpidx_build(FOLDER));
+    mpidx_free();
+
+    File f = SD.open(path("REM_MPIX.BIN").c_str());
+    len = f.read(buf, sizeof(buf));
+    f.close();
+    TEST_ASSERT_EQUAL(sizeof(mpIdxHeader) + 4 * sizeof(mpIdxEntry), len);
+
+    // Damaged entry
+    buf[sizeof(mpIdxHeader) + 5] ^= 1;
+    f = SD.open(path("REM_MPIX.BIN").c_str(), FILE_WRITE);
+    f.write(buf, len);
+    f.close();
+    TEST_ASSERT_FALSE(mpidx_load(FOLDER));
+    TEST_ASSERT_NULL(mpIndex);
+
+    // Truncated
+    buf[sizeof(mpIdxHeader) + 5] ^= 1;
+    f = SD.open(path("REM_MPIX.BIN").c_str(), FILE_WRITE);
+    f.write(buf, len - 1);
+    f.close();
+    TEST_ASSERT_FALSE(mpidx_load(FOLDER));
+
+    f = SD.open(path("REM_MPIX.BIN").c_str(), FILE_WRITE);
+    f.write(buf, len);
+    f.close();
+    TEST_ASSERT_TRUE(mpidx_load(FOLDER));
+}
+
+static void test_stale_signature(void)
+{
+    TEST_ASSERT_TRUE(mpidx_build(FOLDER));
+
+    // File added: Index is stale, rebuilt
+    putMP3(5, 0, 3200);
+    TEST_ASSERT_FALSE(mpidx_load(FOLDER));
+    TEST_ASSERT_TRUE(mpidx_build(FOLDER));
+    TEST_ASSERT_EQUAL_UINT16(6, mpIdxCount);
+    checkEntry(5, 0, 3200);
+    TEST_ASSERT_TRUE(mpidx_load(FOLDER));
+
+    // File added in a gap
+    putMP3(2, 0, 800);
+    TEST_ASSERT_FALSE(mpidx_load(FOLDER));
+    TEST_ASSERT_TRUE(mpidx_build(FOLDER));
+    checkEntry(2, 0, 800);
+
+    // File removed
+    SD.remove(numPath(1).c_str());
+    TEST_ASSERT_FALSE(mpidx_load(FOLDER));
+    TEST_ASSERT_TRUE(mpidx_build(FOLDER));
+    TEST_ASSERT_EQUAL_UINT32(0, mpIndex[1].size);
+    TEST_ASSERT_TRUE(mpidx_load(FOLDER));
+
+    // Highest file removed: Index shrinks
+    SD.remove(numPath(5).c_str());
+    TEST_ASSERT_FALSE(mpidx_load(FOLDER));
+    TEST_ASSERT_TRUE(mpidx_build(FOLDER));
+    TEST_ASSERT_EQUAL_UINT16(4, mpIdxCount);
+}
+
+static void test_changed_size(void)
+{
+    TEST_ASSERT_TRUE(mpidx_build(FOLDER));
+
+    // Same set of files: Still valid, the replaced file
+    // is only caught when played
+    putMP3(1, 2058, 8000);
+    TEST_ASSERT_TRUE(mpidx_load(FOLDER));
+    checkEntry(1, 1034, 32000);
+
+    // Audio task reported it: Rescanned
+    TEST_ASSERT_TRUE(mpidx_validate(1));
+    checkEntry(1, 2058, 8000);
+    TEST_ASSERT_TRUE(mpIdxDirty);
+
+    // Unchanged: Nothing to do
+    TEST_ASSERT_TRUE(mpidx_validate(0));
+    checkEntry(0, 0, 16000);
+
+    // Written back by flush, not rebuilt
+    mpidx_flush();
+    TEST_ASSERT_FALSE(mpIdxDirty);
+    mpidx_free();
+    TEST_ASSERT_TRUE(mpidx_load(FOLDER));
+    checkEntry(1, 2058, 8000);
+    checkEntry(3, 20, 1600);
+}
+
+static void test_vanished(void)
+{
+    TEST_ASSERT_TRUE(mpidx_build(FOLDER));
+
+    // Gone behind our back; since the set of files changed,
+    // the next load rebuilds, but until then the entry is
+    // marked as missing.
+    SD.remove(numPath(3).c_str());
+    TEST_ASSERT_FALSE(mpidx_validate(3));
+    TEST_ASSERT_EQUAL_UINT32(0, mpIndex[3].size);
+
+    // Out of range, gaps
+    TEST_ASSERT_FALSE(mpidx_validate(-1));
+    TEST_ASSERT_FALSE(mpidx_validate(4));
+    TEST_ASSERT_FALSE(mpidx_validate(999));
+    TEST_ASSERT_FALSE(mpidx_validate(2));
+
+    // Freeing writes back; stale nonetheless
+    mpidx_free();
+    TEST_ASSERT_FALSE(mpIdxDirty);
+    TEST_ASSERT_FALSE(mpidx_load(FOLDER));
+    TEST_ASSERT_TRUE(mpidx_build(FOLDER));
+    TEST_ASSERT_EQUAL_UINT16(2, mpIdxCount);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_build);
+    RUN_TEST(test_build_empty);
+    RUN_TEST(test_load);
+    RUN_TEST(test_load_corrupt);
+    RUN_TEST(test_stale_signature);
+    RUN_TEST(test_changed_size);
+    RUN_TEST(test_vanished);
+    return UNITY_END();
+}
@@ -0,0 +1,426 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: Music folder renamer, run on a temporary directory
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <Arduino.h>
+#include <SD.h>
+
+// Track the renamer's heap use
+static size_t heapCur, heapPeak;
+
+static void *testMalloc(size_t n)
+{
+    size_t *p = (size_t *)malloc(n + sizeof(size_t));
+    if(!p) return NULL;
+    *p = n;
+    heapCur += n;
+    if(heapCur > heapPeak) heapPeak = heapCur;
+    return p + 1;
+}
+
+static void testFree(void *p)
+{
+    if(!p) return;
+    size_t *s = (size_t *)p - 1;
+    heapCur -= *s;
+    free(s);
+}
+
+#define malloc(n) testMalloc(n)
+#define free(p)   testFree(p)
+#include "mpren.cpp"
+#undef malloc
+#undef free
+
+#define FOLDER      3
+#define HEAP_LIMIT  (MPREN_SORT_BUDGET + MPREN_MERGE_WAYS * sizeof(mprenReader))
+
+// Work per mpren_step(), independent of the number of files:
+// Opening the runs of a merge group and the output, or saving
+// progress and removing the group's runs; spilling a full sort
+// buffer, or filling the read buffers of a group.
+#define STEP_OPS_MAX    (2 * MPREN_MERGE_WAYS + 4)
+#define STEP_BYTES_MAX  (MPREN_SORT_BUDGET + MPREN_MERGE_WAYS * MPREN_RDBUF + 128)
+
+static int doneCalls;
+static int cutPhases;       // Phases a power loss was simulated in
+static long maxStepOps, maxStepBytes;
+
+static std::string path(const std::string& fn)
+{
+    char buf[16];
+    sprintf(buf, "/music%d/", FOLDER);
+    return buf + fn;
+}
+
+static std::string numName(int num)
+{
+    char buf[16];
+    sprintf(buf, "%03d.mp3", num);
+    return buf;
+}
+
+static void putFile(const std::string& fn, const std::string& content)
+{
+    File f = SD.open(path(fn).c_str(), FILE_WRITE);
+    TEST_ASSERT_TRUE(f);
+    f.write((const uint8_t *)content.c_str(), content.size());
+    f.close();
+}
+
+static bool getFile(const std::string& fn, std::string& content)
+{
+    char buf[300];
+    File f = SD.open(path(fn).c_str());
+    if(!f) return false;
+    size_t n = f.read((uint8_t *)buf, sizeof(buf));
+    f.close();
+    content.assign(buf, n);
+    return true;
+}
+
+// Not counted as renamer's work (the real one bisects)
+static int maxNum()
+{
+    long ops = stubFSOps;
+    int i = 0;
+    while(i <= 999 && SD.exists(path(numName(i)).c_str())) i++;
+    stubFSOps = ops;
+    return i - 1;
+}
+
+static void onDone()
+{
+    doneCalls++;
+}
+
+// Random names that never clash case-insensitively,
+// nor is one a prefix of another
+static std::vector<std::string> makeNames(int num, int minLen, int maxLen, uint32_t seed)
+{
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 -_";
+    std::vector<std::string> v;
+    char idx[16];
+
+    for(int i = 0; i < num; i++) {
+        std::string s;
+        seed = seed * 1103515245 + 12345;
+        int len = minLen + (seed >> 8) % (maxLen - minLen + 1);
+        while((int)s.size() < len) {
+            seed = seed * 1103515245 + 12345;
+            s += chars[(seed >> 16) % (sizeof(chars) - 1)];
+        }
+        sprintf(idx, " %05d", i);
+        v.push_back(s + idx + ((i & 1) ? ".mp3" : ".MP3"));
+    }
+
+    return v;
+}
+
+// Order as established by the renamer
+static bool refLT(const std::string& a, const std::string& b)
+{
+    size_t n = std::min(a.size(), b.size());
+    for(size_t i = 0; i < n; i++) {
+        unsigned char x = a[i], y = b[i];
+        if(x >= 'a' && x <= 'z') x &= ~0x20;
+        if(y >= 'a' && y <= 'z') y &= ~0x20;
+        if(x != y) return x < y;
+    }
+    return false;
+}
+
+// Run to the end; if after, simulate a power loss that many
+// steps into each phase (or after resuming), at most maxCuts 
+// times per phase, as a scan, or a merge in progress, starts
+// over. Returns number of steps.
+static long runRenamer(int after = 0, int maxCuts = 0)
+{
+    long steps = 0, inPhase = 0;
+    int cuts[MPREN_DONE] = { 0 }, phase = -1;
+
+    TEST_ASSERT_TRUE(mpren_begin(FOLDER, maxNum, onDone));
+    for(;;) {
+        long ops = stubFSOps, bytes = stubFSBytes;
+        bool more = mpren_step();
+        ops = stubFSOps - ops;
+        bytes = stubFSBytes - bytes;
+        if(ops > maxStepOps) maxStepOps = ops;
+        if(bytes > maxStepBytes) maxStepBytes = bytes;
+        TEST_ASSERT_TRUE(ops <= STEP_OPS_MAX);
+        TEST_ASSERT_TRUE(bytes <= STEP_BYTES_MAX);
+        if(!more) break;
+        steps++;
+        TEST_ASSERT_TRUE(heapCur <= HEAP_LIMIT);
+        if(mprenPhase != phase) {
+            phase = mprenPhase;
+            inPhase = 0;
+        }
+        if(after && ++inPhase == after && cuts[phase]++ < maxCuts) {
+            cutPhases |= 1 << phase;
+            mpren_cleanup();
+            TEST_ASSERT_EQUAL_INT(0, stubFSOpen);
+            TEST_ASSERT_TRUE(mpren_begin(FOLDER, maxNum, onDone));
+            phase = -1;
+        }
+    }
+
+    TEST_ASSERT_FALSE(mpren_busy());
+    TEST_ASSERT_FALSE(mpren_failed());
+    TEST_ASSERT_EQUAL_INT(-1, mpren_remaining());
+    TEST_ASSERT_EQUAL_INT(0, heapCur);
+    TEST_ASSERT_EQUAL_INT(0, stubFSOpen);
+
+    return steps;
+}
+
+// Files are numbered in sorted order from start, skipping
+// numbers in use; those beyond 999 stay as they are.
+static void checkResult(std::vector<std::string> names, int start, const std::vector<int>& used)
+{
+    std::string c;
+    int num = start;
+
+    std::sort(names.begin(), names.end(), refLT);
+
+    for(size_t i = 0; i < names.size(); i++) {
+        while(std::find(used.begin(), used.end(), num) != used.end()) num++;
+        if(num <= 999) {
+            TEST_ASSERT_FALSE(SD.exists(path(names[i]).c_str()));
+            TEST_ASSERT_TRUE(getFile(numName(num), c));
+            TEST_ASSERT_EQUAL_STRING(names[i].c_str(), c.c_str());
+            num++;
+        } else {
+            TEST_ASSERT_TRUE(getFile(names[i], c));
+            TEST_ASSERT_EQUAL_STRING(names[i].c_str(), c.c_str());
+        }
+    }
+
+    // Work files removed
+    File dir = SD.open(path("").c_str());
+    File f;
+    while((f = dir.openNextFile())) {
+        TEST_ASSERT_NULL(strstr(f.name(), ".TMP"));
+        f.close();
+    }
+    dir.close();
+
+    TEST_ASSERT_EQUAL_INT(1, doneCalls);
+}
+
+void setUp(void)
+{
+    char tmpl[] = "/tmp/mprenXXXXXX";
+
+    TEST_ASSERT_NOT_NULL(mkdtemp(tmpl));
+    stubFSRoot = tmpl;
+    TEST_ASSERT_EQUAL_INT(0, mkdir((stubFSRoot + path("")).c_str(), 0755));
+    doneCalls = 0;
+    stubFSReadOnly = false;
+    heapCur = heapPeak = 0;
+    maxStepOps = maxStepBytes = 0;
+}
+
+void tearDown(void)
+{
+    mpren_cleanup();
+    std::string cmd = "rm -rf " + stubFSRoot;
+    if(system(cmd.c_str())) { }
+}
+
+static void test_checkFN(void)
+{
+    TEST_ASSERT_FALSE(mpren_checkFN("a.mp3"));
+    TEST_ASSERT_FALSE(mpren_checkFN("Song.MP3"));
+    TEST_ASSERT_FALSE(mpren_checkFN("1234.mp3"));
+    TEST_ASSERT_FALSE(mpren_checkFN("12a.mp3"));
+    TEST_ASSERT_TRUE(mpren_checkFN(".mp3"));
+    TEST_ASSERT_TRUE(mpren_checkFN("123.mp3"));
+    TEST_ASSERT_TRUE(mpren_checkFN("._a.mp3"));
+    TEST_ASSERT_TRUE(mpren_checkFN("a.mp4"));
+    TEST_ASSERT_TRUE(mpren_checkFN("a.wav"));
+    TEST_ASSERT_TRUE(mpren_checkFN("mp3"));
+}
+
+static void test_small(void)
+{
+    std::vector<std::string> names = {
+        "b.mp3", "A.mp3", "c song.MP3", "a song.mp3", "Zed.mp3", "1.mp3"
+    };
+    std::string c;
+
+    for(auto& n : names) putFile(n, n);
+    putFile("042.mp3", "keep");         // Kept, numbers are
+    putFile("001.mp3", "keep");         // used from 000
+    putFile("._x.mp3", "keep");         // Ignored
+    putFile("notes.txt", "keep");
+
+    runRenamer();
+    checkResult(names, 0, { 1, 42 });
+
+    TEST_ASSERT_TRUE(getFile("042.mp3", c) && c == "keep");
+    TEST_ASSERT_TRUE(getFile("001.mp3", c) && c == "keep");
+    TEST_ASSERT_TRUE(getFile("._x.mp3", c) && c == "keep");
+    TEST_ASSERT_TRUE(getFile("notes.txt", c) && c == "keep");
+}
+
+static void test_continue_numbering(void)
+{
+    std::vector<std::string> names = makeNames(50, 1, 20, 7);
+
+    for(int i = 0; i <= 4; i++) putFile(numName(i), "old");
+    for(auto& n : names) putFile(n, n);
+
+    runRenamer();
+    checkResult(names, 5, { });
+}
+
+static void test_empty(void)
+{
+    putFile("notes.txt", "keep");
+
+    runRenamer();
+    TEST_ASSERT_EQUAL_INT(1, doneCalls);
+    TEST_ASSERT_FALSE(SD.exists(path("000.mp3").c_str()));
+}
+
+static void test_long_names(void)
+{
+    // Many runs, several merge passes, names up to 255 chars
+    std::vector<std::string> names = makeNames(1500, 100, 240, 11);
+    names.push_back(std::string(251, 'x') + ".mp3");
+
+    for(auto& n : names) putFile(n, n);
+
+    runRenamer();
+    checkResult(names, 0, { });
+    TEST_ASSERT_TRUE(heapPeak <= HEAP_LIMIT);
+}
+
+static void test_power_loss(void)
+{
+    static const int after[] = { 1, 7, 8, 61, 250 };
+
+    for(int i = 0; i < 5; i++) {
+        // Two merge passes
+        std::vector<std::string> names = makeNames(500, 60, 200, 100 + i);
+
+        for(auto& n : names) putFile(n, n);
+
+        cutPhases = 0;
+        runRenamer(after[i], 3);
+        checkResult(names, 0, { });
+        TEST_ASSERT_EQUAL_INT((1 << MPREN_CLEAN) | (1 << MPREN_SCAN) | (1 << MPREN_MERGE) | (1 << MPREN_RENAME), cutPhases);
+
+        tearDown();
+        setUp();
+    }
+}
+
+static void test_leftovers(void)
+{
+    std::vector<std::string> names = makeNames(20, 1, 20, 5);
+
+    for(auto& n : names) putFile(n, n);
+
+    // Runs of an interrupted scan, not necessarily numbered
+    // without gaps, and an unusable progress file
+    putFile("MPREN000.TMP", "x\n");
+    putFile("MPREN002.TMP", "y\n");
+    putFile("MPREN017.TMP", "z\n");
+    putFile("mpren003.tmp", "w\n");
+    putFile("MPREN_P.TMP", "garbage");
+    putFile("MPRENX.TXT", "keep");
+
+    runRenamer();
+    checkResult(names, 0, { });
+    TEST_ASSERT_TRUE(SD.exists(path("MPRENX.TXT").c_str()));
+}
+
+// Card turns read-only while scanning or merging: The renamer
+// gives up without calling back, and says so; done on retry.
+static void test_error(void)
+{
+    for(int ph = MPREN_SCAN; ph <= MPREN_MERGE; ph++) {
+        std::vector<std::string> names = makeNames(500, 60, 200, 20 + ph);
+
+        for(auto& n : names) putFile(n, n);
+
+        TEST_ASSERT_TRUE(mpren_begin(FOLDER, maxNum, onDone));
+        TEST_ASSERT_FALSE(mpren_failed());
+        while(mprenPhase != ph) {
+            TEST_ASSERT_TRUE(mpren_step());
+        }
+        stubFSReadOnly = true;
+        for(int i = 0; i < 100000 && mpren_step(); i++) { }
+
+        TEST_ASSERT_TRUE(mpren_failed());
+        TEST_ASSERT_FALSE(mpren_busy());
+        TEST_ASSERT_EQUAL_INT(0, doneCalls);
+        TEST_ASSERT_EQUAL_INT(0, heapCur);
+        TEST_ASSERT_EQUAL_INT(0, stubFSOpen);
+
+        stubFSReadOnly = false;
+        runRenamer();
+        checkResult(names, 0, { });
+
+        tearDown();
+        setUp();
+    }
+
+    // Can't even start
+    TEST_ASSERT_FALSE(mpren_begin(FOLDER + 1, maxNum, onDone));
+    TEST_ASSERT_TRUE(mpren_failed());
+    mpren_cleanup();
+    TEST_ASSERT_FALSE(mpren_failed());
+}
+
+static void test_bench_10k(void)
+{
+    std::vector<std::string> names = makeNames(10000, 5, 60, 3);
+    char msg[200];
+
+    for(auto& n : names) putFile(n, n);
+
+    auto t0 = std::chrono::steady_clock::now();
+    long steps = runRenamer();
+    double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    checkResult(names, 0, { });
+    TEST_ASSERT_TRUE(heapPeak <= HEAP_LIMIT);
+
+    snprintf(msg, sizeof(msg), "10000 files: %.2f s, %ld steps, peak heap %u bytes (limit %u), per step max %ld ops, %ld bytes",
+              t, steps, (unsigned)heapPeak, (unsigned)HEAP_LIMIT, maxStepOps, maxStepBytes);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_checkFN);
+    RUN_TEST(test_small);
+    RUN_TEST(test_continue_numbering);
+    RUN_TEST(test_empty);
+    RUN_TEST(test_long_names);
+    RUN_TEST(test_power_loss);
+    RUN_TEST(test_leftovers);
+    RUN_TEST(test_error);
+    RUN_TEST(test_bench_10k);
+    return UNITY_END();
+}
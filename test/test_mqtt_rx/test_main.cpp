@@ -0,0 +1,216 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: MQTT client receive path against a mock broker
+ * that dribbles its bytes
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "mqtt.cpp"
+
+#define BUFSIZE     512
+#define NUM_MSGS    200
+
+// Wall time a single loop() may take on the host. A call takes
+// microseconds; the bound leaves room for scheduler noise but
+// catches any wait for data. The byte budget per call (at most
+// one buffer) is checked alongside.
+#define MAX_LOOP_US 20000
+
+static WiFiClient *cl;
+static PubSubClient *mqtt;
+static std::vector<std::string> got;
+static unsigned long tFeed;
+static long maxBytes, maxUs;
+
+static void callback(char *topic, uint8_t *pl, unsigned int len)
+{
+    got.push_back(std::string(topic) + "=" + std::string((char *)pl, len));
+}
+
+static std::vector<uint8_t> pubPacket(const char *topic, const std::string &pl)
+{
+    std::vector<uint8_t> v;
+    int tl = strlen(topic);
+    uint32_t rl = 2 + tl + pl.size();
+
+    v.push_back(MQTTPUBLISH);
+    do {
+        uint8_t d = rl & 0x7f;
+        rl >>= 7;
+        if(rl) d |= 0x80;
+        v.push_back(d);
+    } while(rl);
+    v.push_back(tl >> 8);
+    v.push_back(tl & 0xff);
+    v.insert(v.end(), topic, topic + tl);
+    v.insert(v.end(), pl.begin(), pl.end());
+    return v;
+}
+
+// Queue bytes from the broker, each up to maxGap ms after the previous
+static void feed(const std::vector<uint8_t> &pkt, int maxGap)
+{
+    for(size_t i = 0; i < pkt.size(); i++) {
+        if(maxGap) tFeed += rand() % (maxGap + 1);
+        cl->feed(&pkt[i], 1, tFeed);
+    }
+}
+
+// One loop(), recording the work done in it
+static void loopOnce()
+{
+    long b0 = cl->bytesRead;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+    mqtt->loop();
+
+    long us = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - t0).count();
+    if(us > maxUs) maxUs = us;
+    if(cl->bytesRead - b0 > maxBytes) maxBytes = cl->bytesRead - b0;
+}
+
+static void runUntil(unsigned long end)
+{
+    while(stubMillis < end) {
+        loopOnce();
+        stubMillis++;
+    }
+}
+
+void setUp()
+{
+    srand(7);
+    stubMillis = 1000;
+    got.clear();
+    maxBytes = maxUs = 0;
+
+    cl = new WiFiClient;
+    mqtt = new PubSubClient(*cl);
+    mqtt->setBufferSize(BUFSIZE);
+    mqtt->setVersion(3);
+    mqtt->setClientID("remote");
+    mqtt->setServer(IPAddress(192, 168, 1, 2), 1883);
+    mqtt->setCallback(callback);
+
+    // CONNACK, dribbled
+    mqtt->connect();
+    tFeed = stubMillis;
+    feed(std::vector<uint8_t>{ MQTTCONNACK, 2, 0, 0 }, 300);
+    runUntil(tFeed + 1);
+    TEST_ASSERT_EQUAL(MQTT_CONNECTED, mqtt->state());
+}
+
+void tearDown()
+{
+    delete mqtt;
+    delete cl;
+}
+
+static void checkReceived(int num)
+{
+    TEST_ASSERT_EQUAL(num, got.size());
+    for(int i = 0; i < num; i++) {
+        char buf[64];
+        sprintf(buf, "bttf/remote/cmd=CMD_%d", i);
+        TEST_ASSERT_EQUAL_STRING(buf, got[i].c_str());
+    }
+}
+
+// Bytes trickle in with random gaps; an oversized packet in between
+// is skipped. No loop() call may wait for or consume more than 
+// one buffer's worth.
+void test_dribble()
+{
+    char msg[80];
+
+    for(int i = 0; i < NUM_MSGS; i++) {
+        char pl[16];
+        sprintf(pl, "CMD_%d", i);
+        feed(pubPacket("bttf/remote/cmd", pl), (i % 10) ? 3 : 50);
+        if(i == NUM_MSGS / 2) {
+            feed(pubPacket("bttf/remote/cmd", std::string(1000, 'x')), 1);
+        }
+    }
+    runUntil(tFeed + 10);
+
+    checkReceived(NUM_MSGS);
+    TEST_ASSERT_EQUAL(MQTT_CONNECTED, mqtt->state());
+    TEST_ASSERT_LESS_OR_EQUAL(BUFSIZE, maxBytes);
+    TEST_ASSERT_LESS_OR_EQUAL(MAX_LOOP_US, maxUs);
+
+    snprintf(msg, sizeof(msg), "max %ld bytes, %ld us per loop()", maxBytes, maxUs);
+    TEST_MESSAGE(msg);
+}
+
+// Everything arrives at once: Still bounded per call
+void test_burst()
+{
+    for(int i = 0; i < NUM_MSGS; i++) {
+        char pl[16];
+        sprintf(pl, "CMD_%d", i);
+        feed(pubPacket("bttf/remote/cmd", pl), 0);
+        if(i == NUM_MSGS / 2) {
+            feed(pubPacket("bttf/remote/cmd", std::string(3000, 'y')), 0);
+        }
+    }
+    for(int i = 0; i < 2 * NUM_MSGS && cl->in.size(); i++) {
+        loopOnce();
+    }
+
+    checkReceived(NUM_MSGS);
+    TEST_ASSERT_EQUAL(0, cl->in.size());
+    TEST_ASSERT_LESS_OR_EQUAL(BUFSIZE, maxBytes);
+    TEST_ASSERT_LESS_OR_EQUAL(MAX_LOOP_US, maxUs);
+}
+
+// Peer stops in the middle of a packet: Connection dropped 
+// after the socket timeout, not before
+void test_half_open()
+{
+    unsigned long start;
+
+    feed(std::vector<uint8_t>{ MQTTPUBLISH, 10, 0, 3, 'a' }, 0);
+    start = stubMillis;
+    while(mqtt->state() == MQTT_CONNECTED && stubMillis - start < 30000) {
+        loopOnce();
+        stubMillis += 10;
+    }
+
+    TEST_ASSERT_EQUAL(MQTT_CONNECTION_TIMEOUT, mqtt->state());
+    TEST_ASSERT_GREATER_OR_EQUAL(MQTT_SOCKET_TIMEOUT * 1000, stubMillis - start);
+    TEST_ASSERT_LESS_THAN(MQTT_SOCKET_TIMEOUT * 1000 + 100, stubMillis - start);
+    TEST_ASSERT_FALSE(cl->connected());
+}
+
+// Broken remaining length: Connection killed at once
+void test_bad_length()
+{
+    feed(std::vector<uint8_t>{ MQTTPUBLISH, 0xff, 0xff, 0xff, 0xff, 0xff }, 0);
+    for(int i = 0; i < 10; i++) loopOnce();
+    TEST_ASSERT_FALSE(cl->connected());
+    TEST_ASSERT_EQUAL(0, got.size());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_dribble);
+    RUN_TEST(test_burst);
+    RUN_TEST(test_half_open);
+    RUN_TEST(test_bad_length);
+    return UNITY_END();
+}
@@ -0,0 +1,280 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: MQTT client outbound queue
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <string>
+#include <vector>
+
+#include "mqtt.cpp"
+
+static WiFiClient *cl;
+static PubSubClient *mqtt;
+
+struct sentPkt {
+    uint8_t     hdr;
+    std::string topic;
+    std::string pl;
+    int         msgId;      // -1: QoS0
+};
+
+// Take apart what the client has written so far
+static std::vector<sentPkt> takeSent()
+{
+    std::vector<sentPkt> r;
+    std::vector<uint8_t> &o = cl->out;
+    size_t i = 0;
+
+    while(i < o.size()) {
+        sentPkt p;
+        uint32_t len = 0, mult = 1;
+        uint8_t d;
+        p.hdr = o[i++];
+        do {
+            d = o[i++];
+            len += (d & 0x7f) * mult;
+            mult <<= 7;
+        } while(d & 0x80);
+        size_t end = i + len;
+        p.msgId = -1;
+        if((p.hdr & 0xf0) == MQTTPUBLISH) {
+            int tl = (o[i] << 8) | o[i + 1];
+            size_t j = i + 2 + tl;
+            p.topic.assign((const char *)&o[i + 2], tl);
+            if(p.hdr & MQTTQOS1) {
+                p.msgId = (o[j] << 8) | o[j + 1];
+                j += 2;
+            }
+            p.pl.assign((const char *)&o[j], end - j);
+        }
+        r.push_back(p);
+        i = end;
+    }
+    o.clear();
+
+    return r;
+}
+
+static void connack()
+{
+    const uint8_t p[] = { MQTTCONNACK, 2, 0, 0 };
+    cl->feed(p, sizeof(p), stubMillis);
+}
+
+static void puback(int msgId)
+{
+    const uint8_t p[] = { MQTTPUBACK, 2, (uint8_t)(msgId >> 8), (uint8_t)msgId };
+    cl->feed(p, sizeof(p), stubMillis);
+}
+
+static bool pub(const char *topic, const std::string &pl, uint8_t qos = 0)
+{
+    return mqtt->publish(topic, (const uint8_t *)pl.data(), pl.size(), false, qos);
+}
+
+// Several passes, as the client handles one inbound packet per loop()
+static void loops(int n = 4)
+{
+    while(n--) {
+        mqtt->loop();
+        stubMillis += 10;
+    }
+}
+
+static void doConnect()
+{
+    mqtt->connect();
+    connack();
+    loops();
+    TEST_ASSERT_EQUAL(MQTT_CONNECTED, mqtt->state());
+}
+
+void setUp()
+{
+    stubMillis = 1000;
+    cl = new WiFiClient;
+    mqtt = new PubSubClient(*cl);
+    mqtt->setBufferSize(512);
+    mqtt->setVersion(3);
+    mqtt->setClientID("remote");
+    mqtt->setServer(IPAddress(192, 168, 1, 2), 1883);
+    doConnect();
+    takeSent();
+    cl->writes = 0;
+}
+
+void tearDown()
+{
+    delete mqtt;
+    delete cl;
+}
+
+// Queued in order, sent from loop() in a single write
+void test_order_and_coalescing()
+{
+    for(int i = 0; i < 10; i++) {
+        TEST_ASSERT_TRUE(pub("t/a", "m" + std::to_string(i)));
+    }
+    TEST_ASSERT_EQUAL(0, cl->out.size());
+
+    mqtt->loop();
+    TEST_ASSERT_EQUAL(1, cl->writes);
+
+    std::vector<sentPkt> p = takeSent();
+    TEST_ASSERT_EQUAL(10, p.size());
+    for(int i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL_STRING(("m" + std::to_string(i)).c_str(), p[i].pl.c_str());
+    }
+}
+
+// Full queue (by bytes, by entries): New packets are dropped
+void test_drop_policy()
+{
+    std::string big(200, 'x');
+    int ok = 0;
+
+    for(int i = 0; i < 10; i++) ok += pub("t/big", big);
+    TEST_ASSERT_EQUAL(MQTT_TXQ_SIZE / 208, ok);
+    TEST_ASSERT_EQUAL(10 - ok, mqtt->dropped());
+    mqtt->loop();
+    TEST_ASSERT_EQUAL(ok, takeSent().size());
+
+    ok = 0;
+    for(int i = 0; i < 20; i++) ok += pub("t", "x");
+    TEST_ASSERT_EQUAL(MQTT_TXQ_ENTRIES, ok);
+    mqtt->loop();
+    TEST_ASSERT_EQUAL(MQTT_TXQ_ENTRIES, takeSent().size());
+
+    // Space is free again
+    TEST_ASSERT_TRUE(pub("t/big", big));
+}
+
+// No resend with DUP while the connection is up
+void test_qos1_no_live_resend()
+{
+    TEST_ASSERT_TRUE(pub("b/1", "ON", 1));
+    TEST_ASSERT_TRUE(pub("s", "q0"));
+    mqtt->loop();
+
+    std::vector<sentPkt> p = takeSent();
+    TEST_ASSERT_EQUAL(2, p.size());
+    TEST_ASSERT_EQUAL_STRING("b/1", p[0].topic.c_str());
+    TEST_ASSERT_EQUAL(MQTTQOS1, p[0].hdr & 0x06);
+    TEST_ASSERT_FALSE(p[0].hdr & 0x08);
+    TEST_ASSERT_EQUAL_STRING("q0", p[1].pl.c_str());
+
+    stubMillis += 60000;
+    connack();          // Keep the connection alive
+    loops(20);
+    for(auto &q : takeSent()) {
+        TEST_ASSERT_TRUE((q.hdr & 0xf0) != MQTTPUBLISH);
+    }
+
+    puback(p[0].msgId);
+    loops();
+    TEST_ASSERT_EQUAL(0, takeSent().size());
+}
+
+// A QoS1 packet waiting for its PUBACK must not hold back
+// the queue space of QoS0 packets sent after it
+void test_inflight_does_not_pin_queue()
+{
+    std::string d(430, 'd');
+    int ok = 0;
+
+    TEST_ASSERT_TRUE(pub("b/1", "ON", 1));
+    mqtt->loop();
+    std::vector<sentPkt> p = takeSent();
+    TEST_ASSERT_EQUAL(1, p.size());
+
+    for(int i = 0; i < 8; i++) {
+        ok += pub("ha/cfg", d);
+        mqtt->loop();
+    }
+    TEST_ASSERT_EQUAL(8, ok);
+    TEST_ASSERT_EQUAL(8, takeSent().size());
+    TEST_ASSERT_EQUAL(0, mqtt->dropped());
+
+    puback(p[0].msgId);
+    loops();
+}
+
+// At most MQTT_MAX_INFLIGHT unacknowledged; order is kept
+void test_inflight_limit()
+{
+    std::vector<sentPkt> p;
+
+    for(int i = 0; i < MQTT_MAX_INFLIGHT + 2; i++) {
+        TEST_ASSERT_TRUE(pub("b", std::to_string(i), 1));
+    }
+    TEST_ASSERT_TRUE(pub("s", "after"));
+    mqtt->loop();
+    p = takeSent();
+    TEST_ASSERT_EQUAL(MQTT_MAX_INFLIGHT, p.size());
+
+    for(auto &q : p) puback(q.msgId);
+    loops(MQTT_MAX_INFLIGHT + 2);
+    p = takeSent();
+    TEST_ASSERT_EQUAL(3, p.size());
+    TEST_ASSERT_EQUAL_STRING(std::to_string(MQTT_MAX_INFLIGHT).c_str(), p[0].pl.c_str());
+    TEST_ASSERT_EQUAL_STRING("after", p[2].pl.c_str());
+}
+
+// Disconnected: QoS0 refused, QoS1 kept; unacknowledged
+// ones are sent again (with DUP) after reconnecting
+void test_reconnect_resend()
+{
+    std::vector<sentPkt> p;
+
+    TEST_ASSERT_TRUE(pub("b/1", "A", 1));
+    mqtt->loop();
+    p = takeSent();
+    TEST_ASSERT_EQUAL(1, p.size());
+    int id = p[0].msgId;
+
+    cl->stop();
+    TEST_ASSERT_FALSE(mqtt->connected());
+    TEST_ASSERT_FALSE(pub("s", "x"));
+    TEST_ASSERT_TRUE(pub("b/2", "B", 1));
+
+    doConnect();
+    p = takeSent();
+    // CONNECT first, then both, in order
+    TEST_ASSERT_EQUAL(3, p.size());
+    TEST_ASSERT_EQUAL(MQTTCONNECT, p[0].hdr & 0xf0);
+    TEST_ASSERT_EQUAL_STRING("b/1", p[1].topic.c_str());
+    TEST_ASSERT_EQUAL(id, p[1].msgId);
+    TEST_ASSERT_TRUE(p[1].hdr & 0x08);
+    TEST_ASSERT_EQUAL_STRING("b/2", p[2].topic.c_str());
+    TEST_ASSERT_FALSE(p[2].hdr & 0x08);
+
+    puback(p[1].msgId);
+    puback(p[2].msgId);
+    loops();
+    cl->stop();
+    doConnect();
+    p = takeSent();
+    TEST_ASSERT_EQUAL(1, p.size());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_order_and_coalescing);
+    RUN_TEST(test_drop_policy);
+    RUN_TEST(test_qos1_no_live_resend);
+    RUN_TEST(test_inflight_does_not_pin_queue);
+    RUN_TEST(test_inflight_limit);
+    RUN_TEST(test_reconnect_resend);
+    return UNITY_END();
+}
@@ -0,0 +1,243 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: MQTT command lookup, against the former linear
+ * search on an upper-cased copy of the payload
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <time.h>
+
+#include "mqttcmd.cpp"
+
+// The former lists; the position is the command number
+static const char *refList[] = {
+    "PLAYKEY_", "STOPKEY", "AUTOTHROTTLE_ON", "AUTOTHROTTLE_OFF",
+    "COASTING_ON", "COASTING_OFF", "MOVIEACCEL_ON", "MOVIEACCEL_OFF",
+    "DISPTCDSPD_ON", "DISPTCDSPD_OFF", "MP_SHUFFLE_ON", "MP_SHUFFLE_OFF",
+    "MP_PLAY", "MP_STOP", "MP_NEXT", "MP_PREV", "MP_FOLDER_", "INJECT_",
+    "POWERSTATS", "NETSTATS", NULL
+};
+
+static const char *refList2[] = {
+    "PREPARE", "TIMETRAVEL", "REENTRY", "ABORT_TT", "ALARM", "WAKEUP", NULL
+};
+
+// The former lookup
+static int refFind(const char **list, const uint8_t *payload, unsigned int length, unsigned int *cmdLen)
+{
+    int i = 0, j, ml = (length <= 255) ? length : 255;
+    char tempBuf[256];
+
+    if(!length) return -1;
+
+    memcpy(tempBuf, (const char *)payload, ml);
+    tempBuf[ml] = 0;
+    for(j = 0; j < ml; j++) {
+        if(tempBuf[j] >= 'a' && tempBuf[j] <= 'z') tempBuf[j] &= ~0x20;
+    }
+
+    while(list[i]) {
+        j = strlen(list[i]);
+        if(((int)length >= j) && !strncmp((const char *)tempBuf, list[i], j)) {
+            *cmdLen = j;
+            return i;
+        }
+        i++;
+    }
+
+    return -1;
+}
+
+// As done by mqttCallback()
+static int newFind(bool user, const uint8_t *payload, unsigned int length, unsigned int *cmdLen)
+{
+    const char *pl = (const char *)payload;
+    const char *t;
+
+    if((t = (const char *)memchr(pl, 0, length))) {
+        length = t - pl;
+    }
+
+    if(!length) return -1;
+
+    return user ? mqttcmd_findUser(pl, length, cmdLen) : mqttcmd_findTCD(pl, length, cmdLen);
+}
+
+static const char *randomCmd(bool user)
+{
+    const char **l = user ? refList : refList2;
+    int n = 0;
+
+    while(l[n]) n++;
+
+    return l[rand() % n];
+}
+
+// A payload close to a command: Exact, case-mangled, truncated, 
+// with one byte changed, with arguments, or garbage
+static unsigned int mkPayload(bool user, uint8_t *buf)
+{
+    const char *c = randomCmd(user);
+    unsigned int len = strlen(c);
+
+    memcpy(buf, c, len);
+
+    switch(rand() % 6) {
+    case 0:
+        break;
+    case 1:
+        for(unsigned int i = 0; i < len; i++) {
+            if(rand() & 1) buf[i] = tolower(buf[i]);
+        }
+        break;
+    case 2:
+        len = rand() % (len + 1);
+        break;
+    case 3:
+        buf[rand() % len] = rand();
+        break;
+    case 4:
+        {
+            unsigned int n = rand() % 12;
+            for(unsigned int i = 0; i < n; i++) {
+                static const char args[] = "0123456789Ll -+\0xyz";
+                buf[len++] = args[rand() % (sizeof(args) - 1)];
+            }
+        }
+        break;
+    case 5:
+        len = rand() % 40;
+        for(unsigned int i = 0; i < len; i++) buf[i] = rand();
+        break;
+    }
+
+    return len;
+}
+
+void setUp() { srand(22); }
+void tearDown() {}
+
+void test_all_commands()
+{
+    unsigned int j;
+    uint8_t buf[64];
+
+    for(int user = 0; user < 2; user++) {
+        const char **l = user ? refList : refList2;
+        for(int i = 0; l[i]; i++) {
+            unsigned int len = strlen(l[i]);
+            j = 0;
+            TEST_ASSERT_EQUAL(i, newFind(user, (const uint8_t *)l[i], len, &j));
+            TEST_ASSERT_EQUAL(len, j);
+
+            // Lower case, with argument
+            for(unsigned int k = 0; k < len; k++) buf[k] = tolower(l[i][k]);
+            memcpy(buf + len, "7l", 2);
+            TEST_ASSERT_EQUAL(i, newFind(user, buf, len + 2, &j));
+            TEST_ASSERT_EQUAL(len, j);
+
+            // One short: Unknown
+            TEST_ASSERT_EQUAL(-1, newFind(user, buf, len - 1, &j));
+        }
+    }
+
+    TEST_ASSERT_EQUAL(-1, newFind(true, (const uint8_t *)"", 0, &j));
+    TEST_ASSERT_EQUAL(-1, newFind(true, (const uint8_t *)"\0STOPKEY", 8, &j));
+    TEST_ASSERT_EQUAL(1, newFind(true, (const uint8_t *)"STOPKEY\0xx", 10, &j));
+    TEST_ASSERT_EQUAL(-1, newFind(true, (const uint8_t *)"STOP\0KEY", 8, &j));
+}
+
+void test_fuzz_equivalence()
+{
+    uint8_t buf[64];
+
+    for(int n = 0; n < 1000000; n++) {
+        bool user = n & 1;
+        unsigned int len = mkPayload(user, buf);
+        unsigned int j1 = 0, j2 = 0;
+        int r1 = refFind(user ? refList : refList2, buf, len, &j1);
+        int r2 = newFind(user, buf, len, &j2);
+        TEST_ASSERT_EQUAL(r1, r2);
+        if(r1 >= 0) {
+            TEST_ASSERT_EQUAL(j1, j2);
+        }
+    }
+}
+
+void test_atoi()
+{
+    static const char chars[] = "0123456789 \t\n-+x";
+    char buf[16];
+
+    TEST_ASSERT_EQUAL(0, mqttcmd_atoi("", 0));
+    TEST_ASSERT_EQUAL(12, mqttcmd_atoi("123", 2));
+    TEST_ASSERT_EQUAL(-45, mqttcmd_atoi("  -45x", 6));
+    TEST_ASSERT_EQUAL(0, mqttcmd_atoi("--1", 3));
+
+    for(int n = 0; n < 1000000; n++) {
+        unsigned int len = rand() % 10;
+        for(unsigned int i = 0; i < len; i++) {
+            buf[i] = chars[rand() % (sizeof(chars) - 1)];
+        }
+        // Not 0-terminated: A digit after the end must not count
+        buf[len] = '9';
+        buf[len + 1] = 0;
+        char ref[16];
+        memcpy(ref, buf, len);
+        ref[len] = 0;
+        TEST_ASSERT_EQUAL(atoi(ref), mqttcmd_atoi(buf, len));
+    }
+}
+
+void test_lookup_speed()
+{
+    static uint8_t pl[1024][32];
+    static unsigned int len[1024];
+    const int rounds = 2000;
+    unsigned int j;
+    long sum = 0;
+    clock_t t0;
+    double tr, tn;
+    char msg[80];
+
+    for(int i = 0; i < 1024; i++) {
+        len[i] = mkPayload(true, pl[i]);
+    }
+
+    t0 = clock();
+    for(int r = 0; r < rounds; r++) {
+        for(int i = 0; i < 1024; i++) sum += refFind(refList, pl[i], len[i], &j);
+    }
+    tr = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    t0 = clock();
+    for(int r = 0; r < rounds; r++) {
+        for(int i = 0; i < 1024; i++) sum -= newFind(true, pl[i], len[i], &j);
+    }
+    tn = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    TEST_ASSERT_EQUAL(0, sum);
+
+    snprintf(msg, sizeof(msg), "former %.1f M msgs/s, mqttcmd_findUser %.1f M msgs/s", 
+              tr > 0 ? rounds * 1024 / tr / 1e6 : 0.0, tn > 0 ? rounds * 1024 / tn / 1e6 : 0.0);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_all_commands);
+    RUN_TEST(test_fuzz_equivalence);
+    RUN_TEST(test_atoi);
+    RUN_TEST(test_lookup_speed);
+    return UNITY_END();
+}
@@ -0,0 +1,309 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: Home Assistant discovery serializer and state
+ * rate limiting
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <string>
+#include <vector>
+
+#include "mqttha.cpp"
+
+#define INTERVAL 5000
+
+struct haMsg {
+    std::string topic;
+    std::string pl;
+};
+
+static std::vector<haMsg> msgs;
+static bool queueFull;
+static haTelemetry tel;
+
+static bool pub(const char *topic, const char *pl, unsigned int len)
+{
+    haMsg m;
+
+    if(queueFull) return false;
+
+    m.topic = topic;
+    m.pl.assign(pl, len);
+    msgs.push_back(m);
+
+    return true;
+}
+
+// Minimal JSON syntax check (objects, arrays, strings, literals)
+static bool jsonValue(const char *&p);
+
+static void jsonWs(const char *&p)
+{
+    while(*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+}
+
+static bool jsonString(const char *&p)
+{
+    if(*p++ != '"') return false;
+    while(*p && *p != '"') {
+        if((unsigned char)*p < 0x20) return false;
+        if(*p == '\\') {
+            p++;
+            if(!*p || !strchr("\"\\/bfnrtu", *p)) return false;
+        }
+        p++;
+    }
+    return *p++ == '"';
+}
+
+static bool jsonValue(const char *&p)
+{
+    jsonWs(p);
+    if(*p == '{' || *p == '[') {
+        char close = (*p == '{') ? '}' : ']';
+        bool obj = (*p++ == '{');
+        jsonWs(p);
+        if(*p == close) {
+            p++;
+            return true;
+        }
+        for(;;) {
+            if(obj) {
+                jsonWs(p);
+                if(!jsonString(p)) return false;
+                jsonWs(p);
+                if(*p++ != ':') return false;
+            }
+            if(!jsonValue(p)) return false;
+            jsonWs(p);
+            if(*p == ',') {
+                p++;
+                continue;
+            }
+            return *p++ == close;
+        }
+    }
+    if(*p == '"') return jsonString(p);
+    if(!strncmp(p, "true", 4) || !strncmp(p, "null", 4)) { p += 4; return true; }
+    if(!strncmp(p, "false", 5)) { p += 5; return true; }
+    if(*p == '-' || (*p >= '0' && *p <= '9')) {
+        p++;
+        while((*p >= '0' && *p <= '9') || *p == '.') p++;
+        return true;
+    }
+    return false;
+}
+
+static bool jsonValid(const std::string &s)
+{
+    const char *p = s.c_str();
+    if(!jsonValue(p)) return false;
+    jsonWs(p);
+    return !*p;
+}
+
+static bool has(const std::string &s, const char *sub)
+{
+    return s.find(sub) != std::string::npos;
+}
+
+// Call the loop n times, as the main loop would: Only if due
+static void loops(int n, bool connected = true)
+{
+    while(n--) {
+        if(mqttha_due(connected, stubMillis)) {
+            mqttha_loop(tel, connected, stubMillis);
+        } else {
+            // Not due must mean: Nothing to publish
+            size_t cnt = msgs.size();
+            mqttha_loop(tel, connected, stubMillis);
+            TEST_ASSERT_EQUAL(cnt, msgs.size());
+        }
+        stubMillis += 10;
+    }
+}
+
+void setUp()
+{
+    msgs.clear();
+    queueFull = false;
+    stubMillis = 100000;
+
+    memset(&tel, 0, sizeof(tel));
+    tel.speed = 88;
+    tel.power = true;
+    tel.throttle = -3;
+    tel.soc = 75;
+    tel.voltage = 3.91f;
+    tel.tte = 120;
+    tel.link = true;
+    tel.rtt = 12;
+    tel.audio = HA_AUDIO_MUSIC;
+    tel.heap = 150000;
+}
+
+void tearDown() {}
+
+void test_discovery()
+{
+    mqttha_setup("futaba", "V1.23 (APR282026)", INTERVAL, true, pub);
+    loops(HAE_NUM);
+
+    TEST_ASSERT_EQUAL(HAE_NUM, msgs.size());
+    for(int i = 0; i < HAE_NUM; i++) {
+        const haEntity *e = &haEntities[i];
+        std::string topic = std::string("homeassistant/") + 
+                            ((e->flags & HAE_BIN) ? "binary_sensor/" : "sensor/") + 
+                            "futaba/" + e->key + "/config";
+        const std::string &pl = msgs[i].pl;
+
+        TEST_ASSERT_EQUAL_STRING(topic.c_str(), msgs[i].topic.c_str());
+        TEST_ASSERT_TRUE_MESSAGE(jsonValid(pl), pl.c_str());
+        TEST_ASSERT_TRUE(has(pl, "\"~\":\"bttf/remote/futaba\""));
+        TEST_ASSERT_TRUE(has(pl, (std::string("\"uniq_id\":\"futaba_") + e->key + "\"").c_str()));
+        TEST_ASSERT_TRUE(has(pl, (std::string("\"stat_t\":\"~/") + e->key + "\"").c_str()));
+        TEST_ASSERT_TRUE(has(pl, "\"sw\":\"V1.23 (APR282026)\""));
+        TEST_ASSERT_EQUAL(!!e->unit, has(pl, "\"unit_of_meas\""));
+        TEST_ASSERT_EQUAL(!!(e->flags & HAE_DIAG), has(pl, "\"ent_cat\":\"diagnostic\""));
+    }
+}
+
+void test_no_pm()
+{
+    mqttha_setup("futaba", "V1", INTERVAL, false, pub);
+    loops(2 * HAE_NUM + 2);
+
+    // Neither configs nor states for the battery
+    TEST_ASSERT_EQUAL(2 * (HAE_NUM - 3), msgs.size());
+    for(auto &m : msgs) {
+        TEST_ASSERT_FALSE(has(m.topic, "/soc") || has(m.topic, "/volt") || has(m.topic, "/tte"));
+    }
+}
+
+// A config that does not fit is skipped, never sent truncated
+void test_overflow_skipped()
+{
+    std::string vers(500, 'v');
+
+    mqttha_setup("futaba", vers.c_str(), INTERVAL, true, pub);
+    loops(HAE_NUM + 1);
+
+    TEST_ASSERT_TRUE(msgs.size() > 0);
+    for(auto &m : msgs) {
+        TEST_ASSERT_FALSE(has(m.topic, "/config"));
+    }
+}
+
+void test_states_rate_limited()
+{
+    mqttha_setup("futaba", "V1", INTERVAL, true, pub);
+    loops(HAE_NUM);
+    msgs.clear();
+
+    // First round: Everything, one per call
+    loops(HAE_NUM);
+    TEST_ASSERT_EQUAL(HAE_NUM, msgs.size());
+    TEST_ASSERT_EQUAL_STRING("bttf/remote/futaba/spd", msgs[HAE_SPD].topic.c_str());
+    TEST_ASSERT_EQUAL_STRING("88", msgs[HAE_SPD].pl.c_str());
+    TEST_ASSERT_EQUAL_STRING("3.91", msgs[HAE_VOLT].pl.c_str());
+    TEST_ASSERT_EQUAL_STRING("music", msgs[HAE_AUD].pl.c_str());
+    TEST_ASSERT_EQUAL_STRING("146", msgs[HAE_HEAP].pl.c_str());
+    msgs.clear();
+
+    // Changes within the interval wait for the next round
+    tel.speed = 42;
+    loops(INTERVAL / 10 / 2);
+    TEST_ASSERT_EQUAL(0, msgs.size());
+
+    // Next round: Only what changed
+    tel.heap += 100;        // Same KiB
+    loops(INTERVAL / 10);
+    TEST_ASSERT_EQUAL(1, msgs.size());
+    TEST_ASSERT_EQUAL_STRING("42", msgs[0].pl.c_str());
+    msgs.clear();
+
+    // Nothing changed: Nothing sent
+    loops(3 * INTERVAL / 10);
+    TEST_ASSERT_EQUAL(0, msgs.size());
+}
+
+void test_queue_full()
+{
+    mqttha_setup("futaba", "V1", INTERVAL, true, pub);
+
+    // Config retried until it goes through
+    queueFull = true;
+    loops(5);
+    queueFull = false;
+    loops(HAE_NUM);
+    TEST_ASSERT_EQUAL(HAE_NUM, msgs.size());
+    TEST_ASSERT_TRUE(has(msgs[0].topic, "/spd/config"));
+    msgs.clear();
+
+    // State round given up; the rest follows in the next one
+    loops(3);
+    queueFull = true;
+    loops(2);
+    queueFull = false;
+    TEST_ASSERT_EQUAL(3, msgs.size());
+    loops(INTERVAL / 10 + HAE_NUM);
+    TEST_ASSERT_EQUAL(HAE_NUM, msgs.size());
+}
+
+void test_reconnect()
+{
+    mqttha_setup("futaba", "V1", INTERVAL, true, pub);
+    loops(2 * HAE_NUM);
+    TEST_ASSERT_EQUAL(2 * HAE_NUM, msgs.size());
+    msgs.clear();
+
+    loops(10, false);
+    TEST_ASSERT_EQUAL(0, msgs.size());
+    TEST_ASSERT_FALSE(mqttha_due(false, stubMillis));
+
+    // Announced again, and all states resent
+    loops(2 * HAE_NUM);
+    TEST_ASSERT_EQUAL(2 * HAE_NUM, msgs.size());
+}
+
+// Random changes, connection drops and full queues; loops()
+// checks that nothing is ever published when not due
+void test_due()
+{
+    mqttha_setup("futaba", "V1", INTERVAL, true, pub);
+    srand(24);
+
+    for(int i = 0; i < 20000; i++) {
+        int r = rand() % 100;
+        if(r < 10) tel.speed = rand() % 89;
+        else if(r < 12) tel.link = !tel.link;
+        else if(r < 14) queueFull = !queueFull;
+        loops(1, (rand() % 500) != 0);
+        stubMillis += rand() % 50;
+    }
+
+    mqttha_setup("futaba", "V1", 0, true, pub);
+    TEST_ASSERT_FALSE(mqttha_due(true, stubMillis));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_discovery);
+    RUN_TEST(test_no_pm);
+    RUN_TEST(test_overflow_skipped);
+    RUN_TEST(test_states_rate_limited);
+    RUN_TEST(test_queue_full);
+    RUN_TEST(test_reconnect);
+    RUN_TEST(test_due);
+    return UNITY_END();
+}
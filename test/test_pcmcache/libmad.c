@@ -0,0 +1,24 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: libmad, built as C
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include "src/ESP8266Audio/libmad/bit.c"
+#include "src/ESP8266Audio/libmad/decoder.c"
+#include "src/ESP8266Audio/libmad/fixed.c"
+#include "src/ESP8266Audio/libmad/frame.c"
+#include "src/ESP8266Audio/libmad/huffman.c"
+#include "src/ESP8266Audio/libmad/layer3.c"
+#include "src/ESP8266Audio/libmad/stream.c"
+#include "src/ESP8266Audio/libmad/synth.c"
+#include "src/ESP8266Audio/libmad/timer.c"
+#include "src/ESP8266Audio/libmad/version.c"
@@ -0,0 +1,450 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: PCM cache, filled and played back through the
+ * MP3 decoder's capture and preroll
+ *
+ * libmad is C and built as its own unit, see libmad.c
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <vector>
+
+#include "src/ESP8266Audio/AudioLogger.cpp"
+#include "src/ESP8266Audio/AudioFileSourcePROGMEM.cpp"
+#include "src/ESP8266Audio/AudioGeneratorMP3.cpp"
+#include "pcmcache.cpp"
+
+typedef std::chrono::steady_clock clk;
+
+// Collects what is handed to the output. If "partial" is set,
+// only a random share of each block is taken, like a DMA buffer
+// being drained.
+class pcmSink : public AudioOutput {
+    public:
+        bool begin() { return true; }
+        size_t ConsumeSamples(const int16_t *samples, size_t count)
+        {
+            if(partial) count = min(count, (size_t)(rand() % 400));
+            if(count && !gotFirst) {
+                first = clk::now();
+                gotFirst = true;
+            }
+            pcm.insert(pcm.end(), samples, samples + count * 2);
+            return count;
+        }
+        std::vector<int16_t> pcm;
+        bool                 partial = false;
+        bool                 gotFirst = false;
+        clk::time_point      first;
+};
+
+/*
+ * MP3 files made up on the fly: MPEG1 Layer III, 128kbps, no
+ * bit reservoir. Each granule holds only a count1 region (values
+ * -1..1, table B), which is enough for a decoder output that is
+ * not silence and differs from frame to frame.
+ */
+class bitWriter {
+    public:
+        void put(uint32_t val, int bits)
+        {
+            while(bits--) {
+                if(!(pos & 7)) buf.push_back(0);
+                if(val & (1 << bits)) buf.back() |= 0x80 >> (pos & 7);
+                pos++;
+            }
+        }
+        std::vector<uint8_t> buf;
+        size_t               pos = 0;
+};
+
+#define QUADS 30
+
+static std::vector<uint8_t> mkMP3(int frames, bool mono, bool is48k, unsigned int seed)
+{
+    int nch = mono ? 1 : 2;
+    int frameLen = is48k ? 384 : 417;
+    std::vector<uint8_t> f;
+
+    srand(seed);
+
+    for(int i = 0; i < frames; i++) {
+        bitWriter md, hd;
+        uint32_t p23[2][2];
+
+        // Main data first, side info needs the lengths
+        for(int gr = 0; gr < 2; gr++) {
+            for(int ch = 0; ch < nch; ch++) {
+                size_t start = md.pos;
+                for(int q = 0; q < QUADS; q++) {
+                    int v = rand() & 15;
+                    if(q > QUADS / 2) v &= rand() & 15;
+                    md.put(~v & 15, 4);
+                    for(int b = 3; b >= 0; b--) {
+                        if(v & (1 << b)) md.put(rand() & 1, 1);
+                    }
+                }
+                p23[gr][ch] = md.pos - start;
+            }
+        }
+
+        hd.put(0xfffb, 16);
+        hd.put(9, 4);                   // 128kbps
+        hd.put(is48k ? 1 : 0, 2);
+        hd.put(0, 2);                   // padding, private
+        hd.put(mono ? 3 : 0, 2);
+        hd.put(0, 6);
+
+        hd.put(0, 9);                   // main_data_begin
+        hd.put(0, mono ? 5 : 3);
+        hd.put(0, 4 * nch);             // scfsi
+        for(int gr = 0; gr < 2; gr++) {
+            for(int ch = 0; ch < nch; ch++) {
+                hd.put(p23[gr][ch], 12);
+                hd.put(0, 9);           // big_values
+                hd.put(150 + (i % 20), 8);
+                hd.put(0, 4 + 1 + 15 + 4 + 3 + 1 + 1);
+                hd.put(1, 1);           // count1 table B
+            }
+        }
+
+        f.insert(f.end(), hd.buf.begin(), hd.buf.end());
+        f.insert(f.end(), md.buf.begin(), md.buf.end());
+        f.resize((i + 1) * frameLen, 0);
+    }
+
+    return f;
+}
+
+static AudioGeneratorMP3 *mp3;
+static AudioFileSourcePROGMEM *myPM;
+
+// As do_play_file() does for PA_CACHE; the decoder runs until
+// the end, or for maxLoops loop()s if given.
+static bool play(const char *fn, const std::vector<uint8_t> &data, pcmSink &out, int maxLoops = 0)
+{
+    pcmCacheEntry *ce, *capEntry = NULL;
+    bool hit = false;
+
+    mp3->SetCapture(NULL, 0);
+    mp3->SetPreroll(NULL, 0, false);
+
+    ce = pcmc_lookup(fn);
+    if(ce && ce->state != PCMC_EMPTY) {
+        hit = true;
+        mp3->SetPreroll(ce->pcm, ce->len, (ce->state == PCMC_COMPLETE));
+        mp3->StartPreroll(&out);
+    } else if(ce) {
+        mp3->SetCapture(ce->pcm, pcmc_maxLen());
+        capEntry = ce;
+    }
+
+    if(!hit || ce->state != PCMC_COMPLETE) {
+        myPM->open(data.data(), data.size());
+    }
+    TEST_ASSERT_TRUE(mp3->begin(myPM, &out));
+
+    for(int i = 0; mp3->isRunning(); i++) {
+        if(maxLoops && i == maxLoops) {
+            mp3->stop();
+            break;
+        }
+        mp3->loop();
+    }
+    if(mp3->isRunning()) mp3->stop();
+
+    if(capEntry) {
+        pcmc_finalize(capEntry, mp3->GetCaptureLen(), mp3->CaptureComplete());
+    }
+
+    return hit;
+}
+
+// The decoder by itself, no cache involved
+static std::vector<int16_t> decode(const std::vector<uint8_t> &data)
+{
+    pcmSink out;
+
+    mp3->SetCapture(NULL, 0);
+    mp3->SetPreroll(NULL, 0, false);
+    myPM->open(data.data(), data.size());
+    TEST_ASSERT_TRUE(mp3->begin(myPM, &out));
+    while(mp3->loop()) {}
+    mp3->stop();
+
+    return out.pcm;
+}
+
+static std::vector<int16_t> leftOf(const std::vector<int16_t> &pcm)
+{
+    std::vector<int16_t> l;
+    for(size_t i = 0; i < pcm.size(); i += 2) l.push_back(pcm[i]);
+    return l;
+}
+
+static void assertSame(const std::vector<int16_t> &a, const std::vector<int16_t> &b, const char *what)
+{
+    char msg[100];
+
+    if(a.size() != b.size()) {
+        snprintf(msg, sizeof(msg), "%s: %zu samples, expected %zu", what, b.size(), a.size());
+        TEST_FAIL_MESSAGE(msg);
+    }
+    for(size_t i = 0; i < a.size(); i++) {
+        if(a[i] != b[i]) {
+            snprintf(msg, sizeof(msg), "%s: Sample %zu: %d != %d", what, i, b[i], a[i]);
+            TEST_FAIL_MESSAGE(msg);
+        }
+    }
+}
+
+static void pcmc_reset(bool usePSRAM)
+{
+    for(int i = 0; i < PCMC_ENTRIES; i++) {
+        free(pcmCache[i].pcm);
+    }
+    memset(pcmCache, 0, sizeof(pcmCache));
+    memset(&pcmcStats, 0, sizeof(pcmcStats));
+    pcmc_setup(usePSRAM);
+}
+
+void setUp(void)
+{
+    mp3 = new AudioGeneratorMP3();
+    myPM = new AudioFileSourcePROGMEM();
+    pcmc_reset(false);
+    srand(1);
+}
+
+void tearDown(void)
+{
+    delete mp3;
+    delete myPM;
+}
+
+// Entries are allocated on first lookup up to the arena size
+static void test_lookup(void)
+{
+    audioCacheStats st;
+    pcmCacheEntry *ce[4];
+    char fn[16];
+
+    for(int p = 0; p < 2; p++) {
+        uint32_t maxLen = p ? 66150 : 5292;
+        uint32_t arena = p ? 512*1024 : 48*1024;
+        int fit = arena / (maxLen * 2);
+
+        pcmc_reset(p);
+        TEST_ASSERT_EQUAL_UINT32(maxLen, pcmc_maxLen());
+
+        for(int i = 0; i < fit; i++) {
+            sprintf(fn, "/snd%d.mp3", i);
+            ce[i] = pcmc_lookup(fn);
+            TEST_ASSERT_NOT_NULL(ce[i]);
+            TEST_ASSERT_NOT_NULL(ce[i]->pcm);
+            TEST_ASSERT_EQUAL_INT(PCMC_EMPTY, ce[i]->state);
+            TEST_ASSERT_EQUAL_STRING(fn, ce[i]->fn);
+        }
+        TEST_ASSERT_NULL(pcmc_lookup("/full.mp3"));
+
+        // Same file, same entry
+        for(int i = 0; i < fit; i++) {
+            sprintf(fn, "/snd%d.mp3", i);
+            TEST_ASSERT_TRUE(pcmc_lookup(fn) == ce[i]);
+        }
+
+        pcmc_getStats(&st);
+        TEST_ASSERT_EQUAL_UINT32(0, st.hits);
+        TEST_ASSERT_EQUAL_UINT32(2 * fit + 1, st.misses);
+        TEST_ASSERT_EQUAL_UINT32(0, st.fills);
+        TEST_ASSERT_EQUAL_UINT32(fit * maxLen * 2, st.bytesUsed);
+        TEST_ASSERT_EQUAL_UINT32(arena, st.bytesTotal);
+    }
+}
+
+// Shorter than the cache entry: Cached completely on first
+// play, played from the cache alone afterwards
+static void test_complete(void)
+{
+    std::vector<uint8_t> data = mkMP3(3, true, false, 1);
+    std::vector<int16_t> ref = leftOf(decode(data));
+    audioCacheStats st;
+    pcmSink out1, out2;
+
+    TEST_ASSERT_TRUE(ref.size() >= 2 * 1152);
+    TEST_ASSERT_TRUE(ref.size() < pcmc_maxLen());
+
+    TEST_ASSERT_FALSE(play("/volchg.mp3", data, out1));
+    assertSame(ref, leftOf(out1.pcm), "Miss");
+
+    pcmCacheEntry *ce = pcmc_lookup("/volchg.mp3");
+    TEST_ASSERT_EQUAL_INT(PCMC_COMPLETE, ce->state);
+    assertSame(ref, std::vector<int16_t>(ce->pcm, ce->pcm + ce->len), "Entry");
+
+    // No file needed
+    out2.partial = true;
+    TEST_ASSERT_TRUE(play("/volchg.mp3", std::vector<uint8_t>(), out2));
+    assertSame(ref, leftOf(out2.pcm), "Hit");
+
+    pcmc_getStats(&st);
+    TEST_ASSERT_EQUAL_UINT32(2, st.hits);
+    TEST_ASSERT_EQUAL_UINT32(1, st.misses);
+    TEST_ASSERT_EQUAL_UINT32(1, st.fills);
+}
+
+// Longer than the cache entry: The start is cached, on a hit the
+// decoder picks up exactly where the cached part ends
+static void test_partial(void)
+{
+    for(int p = 0; p < 2; p++) {
+        std::vector<uint8_t> data = mkMP3(p ? 80 : 40, true, false, 2 + p);
+        std::vector<int16_t> ref;
+        pcmSink out1, out2;
+
+        pcmc_reset(p);
+        ref = leftOf(decode(data));
+        TEST_ASSERT_TRUE(ref.size() > pcmc_maxLen());
+
+        out1.partial = true;
+        TEST_ASSERT_FALSE(play("/travelstart.mp3", data, out1));
+        assertSame(ref, leftOf(out1.pcm), "Miss");
+
+        pcmCacheEntry *ce = pcmc_lookup("/travelstart.mp3");
+        TEST_ASSERT_EQUAL_INT(PCMC_PARTIAL, ce->state);
+        TEST_ASSERT_EQUAL_UINT32(pcmc_maxLen(), ce->len);
+
+        out2.partial = true;
+        TEST_ASSERT_TRUE(play("/travelstart.mp3", data, out2));
+        assertSame(ref, leftOf(out2.pcm), "Hit");
+    }
+}
+
+// Stopped before the end: Nothing is kept, the next play
+// captures again
+static void test_interrupted(void)
+{
+    std::vector<uint8_t> data = mkMP3(40, true, false, 4);
+    std::vector<int16_t> ref = leftOf(decode(data));
+    audioCacheStats st;
+    pcmSink out1, out2, out3;
+
+    out1.partial = true;
+    play("/brakeon.mp3", data, out1, 2);
+    TEST_ASSERT_TRUE(mp3->GetCaptureLen() > 0);
+    TEST_ASSERT_TRUE(mp3->GetCaptureLen() < pcmc_maxLen());
+    TEST_ASSERT_EQUAL_INT(PCMC_EMPTY, pcmc_lookup("/brakeon.mp3")->state);
+
+    TEST_ASSERT_FALSE(play("/brakeon.mp3", data, out2));
+    TEST_ASSERT_TRUE(play("/brakeon.mp3", data, out3));
+    assertSame(ref, leftOf(out3.pcm), "Hit");
+
+    pcmc_getStats(&st);
+    TEST_ASSERT_EQUAL_UINT32(1, st.fills);
+    TEST_ASSERT_EQUAL_UINT32(1, st.hits);
+    TEST_ASSERT_EQUAL_UINT32(3, st.misses);
+}
+
+// Only 44.1kHz is cached
+static void test_samplerate(void)
+{
+    std::vector<uint8_t> data = mkMP3(3, true, true, 5);
+    std::vector<int16_t> ref = leftOf(decode(data));
+    pcmSink out1, out2;
+
+    TEST_ASSERT_TRUE(ref.size() > 0);
+    TEST_ASSERT_FALSE(play("/key1.mp3", data, out1));
+    TEST_ASSERT_EQUAL_INT(PCMC_EMPTY, pcmc_lookup("/key1.mp3")->state);
+    TEST_ASSERT_FALSE(play("/key1.mp3", data, out2));
+    assertSame(ref, leftOf(out2.pcm), "48kHz");
+}
+
+// Stereo is cached as mono
+static void test_stereo(void)
+{
+    std::vector<uint8_t> data = mkMP3(3, false, false, 6);
+    std::vector<int16_t> ref = decode(data), mono;
+    pcmSink out;
+
+    for(size_t i = 0; i < ref.size(); i += 2) {
+        mono.push_back((ref[i] + ref[i + 1]) >> 1);
+    }
+
+    play("/key2.mp3", data, out);
+    pcmCacheEntry *ce = pcmc_lookup("/key2.mp3");
+    TEST_ASSERT_EQUAL_INT(PCMC_COMPLETE, ce->state);
+    assertSame(mono, std::vector<int16_t>(ce->pcm, ce->pcm + ce->len), "Entry");
+}
+
+// From play request to first sample handed to the output:
+// Through the cache, or straight to the decoder
+static double firstSampleUs(const std::vector<uint8_t> &data, const char *fn, int runs)
+{
+    double t = 0;
+
+    for(int i = 0; i <= runs; i++) {
+        pcmSink out;
+        clk::time_point st = clk::now();
+        if(fn) {
+            play(fn, data, out, 1);
+        } else {
+            mp3->SetCapture(NULL, 0);
+            mp3->SetPreroll(NULL, 0, false);
+            myPM->open(data.data(), data.size());
+            mp3->begin(myPM, &out);
+            mp3->loop();
+            mp3->stop();
+        }
+        TEST_ASSERT_TRUE(out.gotFirst);
+        // First run warms up
+        if(i) t += std::chrono::duration<double>(out.first - st).count();
+    }
+
+    return t * 1e6 / runs;
+}
+
+static void test_benchmark(void)
+{
+    std::vector<uint8_t> data = mkMP3(40, true, false, 7);
+    const int runs = 500;
+    double tMiss, tHit;
+    pcmSink out;
+    char msg[160];
+
+    // Not cached: Decoder set up, first frame decoded
+    tMiss = firstSampleUs(data, NULL, runs);
+
+    play("/cached.mp3", data, out);
+    TEST_ASSERT_EQUAL_INT(PCMC_PARTIAL, pcmc_lookup("/cached.mp3")->state);
+    tHit = firstSampleUs(data, "/cached.mp3", runs);
+
+    TEST_ASSERT_TRUE(tHit < tMiss);
+
+    // Opening the file and skipping the ID3 tag on SD come
+    // on top of the uncached figure on the device
+    snprintf(msg, sizeof(msg), "Time to first sample: uncached %.2fus, cached %.2fus (%.0fx)",
+                tMiss, tHit, tMiss / tHit);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_lookup);
+    RUN_TEST(test_complete);
+    RUN_TEST(test_partial);
+    RUN_TEST(test_interrupted);
+    RUN_TEST(test_samplerate);
+    RUN_TEST(test_stereo);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
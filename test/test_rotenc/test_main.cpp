@@ -0,0 +1,470 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: Rotary encoders/ADC on a simulated bus
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <string>
+#include <math.h>
+
+#include "i2cbus.cpp"
+
+// The ADC filter is private; everything input.cpp pulls
+// in is already included above
+#define private public
+#include "input.cpp"
+#undef private
+
+// As in remote_main.cpp
+static const uint8_t rotEncAddr[4*2] = {
+    0x36, REM_RE_TYPE_ADA4991,
+    0x01, REM_RE_TYPE_DUPPAV2,
+    0x54, REM_RE_TYPE_DFRGR360,
+    0x48, REM_RE_TYPE_ADS1X15
+};
+
+#define PASS_BUDGET_US 250      // Max bus time per main loop pass
+
+/*
+ * Simulated encoders
+ *
+ * A read less than "gap" us after the register select returns
+ * garbage and is counted as early.
+ */
+
+typedef struct {
+    uint8_t       addr;
+    int           type;
+    bool          present;
+    unsigned long gap;
+    uint16_t      reg;
+    unsigned long selAt;
+    int32_t       count;        // Encoder count; DFRobot: raw register
+    int           reads, early;
+} simEnc;
+
+static simEnc encs[4] = {
+    { 0x36, REM_RE_TYPE_ADA4991,  false, 250 },
+    { 0x01, REM_RE_TYPE_DUPPAV2,  false, 1000 },
+    { 0x54, REM_RE_TYPE_DFRGR360, false, 1000 },
+    { 0x48, REM_RE_TYPE_ADS1X15,  false, 0 }
+};
+
+// ADS: Next conversion result
+static int32_t (*adsSample)(void);
+static int32_t adsValue;
+
+static int32_t adsConst(void)
+{
+    return adsValue;
+}
+
+// ADS: Recorded-style trace; throttle held at adsValue, pot and
+// ADC noise of +/- ADS_NOISE counts, and every ADS_SPIKE_EVERY
+// samples a single-sample spike (wiper contact)
+#define ADS_NOISE       6
+#define ADS_SPIKE       80
+#define ADS_SPIKE_EVERY 50
+
+static int adsSamples;
+
+static int32_t adsNoisy(void)
+{
+    int32_t n = (rand() % (2*ADS_NOISE+1) - ADS_NOISE + rand() % (2*ADS_NOISE+1) - ADS_NOISE) / 2;
+
+    if(!(++adsSamples % ADS_SPIKE_EVERY)) {
+        n = (adsSamples & 0x40) ? ADS_SPIKE : -ADS_SPIKE;
+    }
+    return adsValue + n;
+}
+
+static void putBE(uint8_t *buf, int len, uint32_t val)
+{
+    for(int i = len - 1; i >= 0; i--, val >>= 8) buf[i] = val & 0xff;
+}
+
+static int simDev(uint8_t addr, bool read, uint8_t *buf, int len)
+{
+    simEnc *e = NULL;
+
+    for(int i = 0; i < 4; i++) {
+        if(encs[i].present && encs[i].addr == addr) e = &encs[i];
+    }
+    if(!e) return -1;
+
+    if(!read) {
+        int rl = (e->type == REM_RE_TYPE_ADA4991) ? 2 : 1;
+        if(len < rl) return len;
+        e->reg = (rl == 2) ? ((buf[0] << 8) | buf[1]) : buf[0];
+        e->selAt = stubMicros;
+        // Register writes we care about
+        if(len == rl + 4 && e->type == REM_RE_TYPE_DUPPAV2 && e->reg == DUV2_CVALB4) {
+            e->count = (buf[1] << 24) | (buf[2] << 16) | (buf[3] << 8) | buf[4];
+        } else if(len == rl + 2 && e->type == REM_RE_TYPE_DFRGR360 && e->reg == DFR_COUNT_MSB) {
+            e->count = (buf[1] << 8) | buf[2];
+        }
+        return len;
+    }
+
+    e->reads++;
+    memset(buf, 0xff, len);
+    if(stubMicros - e->selAt < e->gap) {
+        e->early++;
+        return len;
+    }
+
+    switch(e->type) {
+    case REM_RE_TYPE_ADA4991:
+        switch(e->reg) {
+        case (SEESAW_STATUS_BASE << 8) | SEESAW_STATUS_HW_ID:
+            buf[0] = SEESAW_HW_ID_CODE_TINY817;
+            break;
+        case (SEESAW_STATUS_BASE << 8) | SEESAW_STATUS_VERSION:
+            putBE(buf, 4, 4991 << 16);
+            break;
+        case (SEESAW_ENCODER_BASE << 8) | SEESAW_ENCODER_POSITION:
+            putBE(buf, 4, -e->count);
+            break;
+        }
+        break;
+    case REM_RE_TYPE_DUPPAV2:
+        switch(e->reg) {
+        case DUV2_IDCODE:
+            buf[0] = 0x53;
+            break;
+        case DUV2_CVALB4:
+            putBE(buf, 4, e->count);
+            break;
+        }
+        break;
+    case REM_RE_TYPE_DFRGR360:
+        switch(e->reg) {
+        case DFR_PID_MSB:
+            buf[0] = DFR_PID_U;
+            buf[1] = DFR_PID_L;
+            break;
+        case DFR_COUNT_MSB:
+            putBE(buf, 2, e->count);
+            break;
+        }
+        break;
+    case REM_RE_TYPE_ADS1X15:
+        if(e->reg == ADS_CONVERT) {
+            putBE(buf, 2, adsSample() << 4);
+        }
+        break;
+    }
+
+    return len;
+}
+
+// Main loop passes, one per ms; returns max bus time
+// spent in a pass
+static unsigned long runLoop(REMRotEnc &re, unsigned long ms)
+{
+    unsigned long maxBlock = 0;
+
+    for(unsigned long i = 0; i < ms; i++) {
+        unsigned long t0 = stubMicros;
+        re.updateThrottlePos();
+        i2cbus_loop();
+        maxBlock = max(maxBlock, stubMicros - t0);
+        stubMicros = max(stubMicros, (stubMillis + 1) * 1000);
+        stubMillis = stubMicros / 1000;
+    }
+
+    return maxBlock;
+}
+
+static void only(int idx)
+{
+    for(int i = 0; i < 4; i++) {
+        encs[i].present = (i == idx);
+        encs[i].count = 0;
+        encs[i].reads = encs[i].early = 0;
+        encs[i].selAt = 0;
+    }
+}
+
+void setUp(void)
+{
+    memset(queue, 0, sizeof(queue));
+    numDevices = 0;
+    memset(&stats, 0, sizeof(stats));
+
+    stubMicros = 1000000;
+    stubMillis = 1000;
+    stubMicrosTick = 1;
+    stubWireByteUs = 25;
+    stubWireDev = simDev;
+
+    adsValue = 0;
+    adsSample = adsConst;
+    adsSamples = 0;
+    srand(4711);
+}
+
+void tearDown(void)
+{
+}
+
+static void test_detect(void)
+{
+    for(int i = 0; i < 4; i++) {
+        REMRotEnc re(4, rotEncAddr);
+        only(i);
+        TEST_ASSERT_TRUE(re.begin(true));
+        TEST_ASSERT_NOT_NULL(findDevice(encs[i].addr));
+        TEST_ASSERT_EQUAL_UINT8(I2CBUS_PRIO_THROTTLE, findDevice(encs[i].addr)->prio);
+        TEST_ASSERT_EQUAL_INT(0, encs[i].early);
+    }
+
+    // Nothing there
+    REMRotEnc re(4, rotEncAddr);
+    only(-1);
+    TEST_ASSERT_FALSE(re.begin(true));
+}
+
+static void test_read_gap(void)
+{
+    char msg[128];
+
+    for(int i = 0; i < 4; i++) {
+        REMRotEnc re(4, rotEncAddr);
+        simEnc *e = &encs[i];
+        unsigned long maxBlock;
+        int reads;
+
+        only(i);
+        TEST_ASSERT_TRUE(re.begin(true));
+        if(e->type == REM_RE_TYPE_ADS1X15) {
+            re.setZeroPos(1000);
+            re.setMaxStepsUp(500);
+            re.setMaxStepsDown(-500);
+            adsValue = 1000;
+        }
+        reads = e->reads;
+
+        maxBlock = runLoop(re, 1000);
+        TEST_ASSERT_EQUAL_INT(0, re.updateThrottlePos());
+
+        // Throttle moved: 3 of 5 steps up; ADC to the end
+        switch(e->type) {
+        case REM_RE_TYPE_DFRGR360:
+            e->count += 3 * DFR_GAIN;
+            break;
+        case REM_RE_TYPE_ADS1X15:
+            adsValue = 1500;
+            break;
+        default:
+            e->count += 3;
+        }
+        maxBlock = max(maxBlock, runLoop(re, 1000));
+        TEST_ASSERT_EQUAL_INT(e->type == REM_RE_TYPE_ADS1X15 ? 100 : 60, re.updateThrottlePos());
+
+        // Read at the device's pace, never early, and
+        // never holding up the loop
+        TEST_ASSERT_EQUAL_INT(0, e->early);
+        reads = e->reads - reads;
+        if(e->type == REM_RE_TYPE_ADS1X15) {
+            TEST_ASSERT_TRUE(reads >= 2000 / (ADS_SAMPLE_INT + 1) - 1);
+        } else {
+            TEST_ASSERT_TRUE(reads >= 2000 / (HWUPD_DELAY + 1) - 1);
+            TEST_ASSERT_TRUE(reads <= 2000 / HWUPD_DELAY + 1);
+        }
+        TEST_ASSERT_TRUE(maxBlock <= PASS_BUDGET_US);
+
+        snprintf(msg, sizeof(msg), "Type %d: %d reads in 2s, max %luus bus time per pass",
+                    e->type, reads, maxBlock);
+        TEST_MESSAGE(msg);
+    }
+}
+
+static void test_gap_needed(void)
+{
+    // The simulation does notice: A device needing more
+    // time than the driver gives gets early reads. Forced
+    // reads wait out the gap, they are the tight case.
+    REMRotEnc re(4, rotEncAddr);
+
+    only(0);
+    TEST_ASSERT_TRUE(re.begin(true));
+    re.updateThrottlePos(true);
+    TEST_ASSERT_EQUAL_INT(0, encs[0].early);
+
+    encs[0].gap = SEESAW_READ_DELAY + 100;
+    re.updateThrottlePos(true);
+    encs[0].gap = SEESAW_READ_DELAY;
+    TEST_ASSERT_EQUAL_INT(1, encs[0].early);
+}
+
+static void test_volume(void)
+{
+    // Volume knob: Same path, no throttle priority
+    REMRotEnc re(4, rotEncAddr);
+    int vol = 10;
+
+    only(1);
+    TEST_ASSERT_TRUE(re.begin(false));
+    TEST_ASSERT_EQUAL_UINT8(I2CBUS_PRIO_INPUT, findDevice(0x01)->prio);
+
+    encs[1].count = 4;
+    for(int i = 0; i < 400; i++) {
+        vol = re.updateVolume(vol);
+        i2cbus_loop();
+        stubMicros += 1000;
+        stubMillis = stubMicros / 1000;
+    }
+    TEST_ASSERT_EQUAL_INT(14, vol);
+    TEST_ASSERT_EQUAL_INT(0, encs[1].early);
+}
+
+static void test_ads_filter(void)
+{
+    REMRotEnc re(4, rotEncAddr);
+    int32_t prev, out;
+    double ref;
+    int i;
+
+    re._st = REM_RE_TYPE_ADS1X15;
+
+    // Single-sample spikes are taken out by the median
+    static const int32_t spikes[] = { 1000, 1000, 1300, 1000, 1000, 700, 1000, 1000, 
+                                      1500, 1000, 500, 1000, 1000 };
+    for(i = 0; i < (int)(sizeof(spikes)/sizeof(spikes[0])); i++) {
+        TEST_ASSERT_EQUAL_INT32(1000, re.adsFilter(spikes[i]));
+    }
+
+    // Real movement (> ADS_STEP_THR) passes after one sample
+    // (median needs two), without IIR lag
+    TEST_ASSERT_EQUAL_INT32(1000, re.adsFilter(1200));
+    TEST_ASSERT_EQUAL_INT32(1200, re.adsFilter(1200));
+    TEST_ASSERT_EQUAL_INT32(1200, re.adsFilter(1200));
+    TEST_ASSERT_EQUAL_INT32(1200, re.adsFilter(1000));
+    TEST_ASSERT_EQUAL_INT32(1000, re.adsFilter(1000));
+
+    // Small step (<= ADS_STEP_THR): first order response with
+    // alpha 1/4, monotonic, no overshoot, within 1 count of the
+    // exact IIR
+    for(int sign = 1; sign >= -1; sign -= 2) {
+        int32_t base = sign * 1000, step = sign * 16;
+        for(i = 0; i < 4; i++) re.adsFilter(base);
+        TEST_ASSERT_EQUAL_INT32(base, re.adsFilter(base + step));   // median delay
+        prev = base;
+        ref = base;
+        for(i = 0; i < 30; i++) {
+            out = re.adsFilter(base + step);
+            ref += (base + step - ref) / 4;
+            TEST_ASSERT_TRUE(sign * (out - prev) >= 0);
+            TEST_ASSERT_TRUE(sign * (base + step - out) >= 0);
+            TEST_ASSERT_TRUE(abs(out - (int32_t)lround(ref)) <= 1);
+            prev = out;
+        }
+        TEST_ASSERT_EQUAL_INT32(base + step, prev);
+    }
+
+    // Negative values round symmetrically
+    REMRotEnc rp(4, rotEncAddr), rn(4, rotEncAddr);
+    rp._st = rn._st = REM_RE_TYPE_ADS1X15;
+    rp.adsFilter(0);
+    rn.adsFilter(0);
+    for(i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL_INT32(rp.adsFilter(10), -rn.adsFilter(-10));
+    }
+}
+
+// Throttle held at each level of a recorded-style noisy trace:
+// Count throttle position changes after settling (false
+// transitions), and time from a move to the final position
+static void test_ads_noise(void)
+{
+    static const int32_t levels[] = { 
+        1000, 1060, 1120, 1180, 1240, 1310, 1370, 1440, 1500, 1000,
+        960, 900, 830, 760, 700, 640, 570, 500, 1000, 1500, 500, 1000
+    };
+    REMRotEnc re(4, rotEncAddr);
+    int falseTrans = 0, maxLat = 0, moves = 0;
+    char msg[128];
+
+    only(3);
+    TEST_ASSERT_TRUE(re.begin(true));
+    re.setZeroPos(1000);
+    re.setMaxStepsUp(500);
+    re.setMaxStepsDown(-500);
+    adsValue = 1000;
+    adsSample = adsNoisy;
+    runLoop(re, 500);
+    TEST_ASSERT_EQUAL_INT(0, re.updateThrottlePos());
+
+    for(int l = 0; l < (int)(sizeof(levels)/sizeof(levels[0])); l++) {
+        int32_t tgt, pos, lat = -1;
+
+        // Noise-free reference for this level
+        adsValue = levels[l];
+        adsSample = adsConst;
+        {
+            REMRotEnc rr(4, rotEncAddr);
+            rr._st = REM_RE_TYPE_ADS1X15;
+            rr.scaleThrottlePos = true;
+            rr.setZeroPos(1000);
+            rr.setMaxStepsUp(500);
+            rr.setMaxStepsDown(-500);
+            for(int i = 0; i < 40; i++) rr.calcThrottlePos(adsValue);
+            tgt = rr.throttlePos;
+        }
+        adsSample = adsNoisy;
+
+        // Settle: Must get within hysteresis of the reference
+        for(int ms = 0; ms < 300; ms++) {
+            runLoop(re, 1);
+            if(lat < 0 && abs(re.updateThrottlePos() - tgt) <= SCALE_HYST) lat = ms + 1;
+        }
+        TEST_ASSERT_TRUE(lat > 0);
+        pos = re.updateThrottlePos();
+        TEST_ASSERT_TRUE(abs(pos - tgt) <= SCALE_HYST);
+        if(l && levels[l] != levels[l-1]) {
+            maxLat = max(maxLat, (int)lat);
+            moves++;
+        }
+
+        // Hold: Not a single change
+        for(int ms = 0; ms < 3000; ms++) {
+            runLoop(re, 1);
+            if(re.updateThrottlePos() != pos) {
+                falseTrans++;
+                pos = re.updateThrottlePos();
+            }
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, encs[3].early);
+    TEST_ASSERT_EQUAL_INT(0, falseTrans);
+    // Big moves: median delay plus polling: Two sample intervals
+    TEST_ASSERT_TRUE(maxLat <= 2 * (ADS_SAMPLE_INT + 1));
+
+    snprintf(msg, sizeof(msg), "%d moves, max latency %dms; %d false transitions in %ds, %d samples",
+                moves, maxLat, falseTrans, 
+                (int)(sizeof(levels)/sizeof(levels[0])) * 3, adsSamples);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_detect);
+    RUN_TEST(test_read_gap);
+    RUN_TEST(test_gap_needed);
+    RUN_TEST(test_volume);
+    RUN_TEST(test_ads_filter);
+    RUN_TEST(test_ads_noise);
+    return UNITY_END();
+}
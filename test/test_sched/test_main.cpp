@@ -0,0 +1,236 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: Deadline timers on a virtual clock
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <limits.h>
+#include <string>
+
+#include "schedtmr.cpp"
+
+// Timers record their name when run
+static std::string fired;
+
+static void onFire(void *arg)
+{
+    fired += (const char *)arg;
+}
+
+static schedTimer tA(onFire, (void *)"a");
+static schedTimer tB(onFire, (void *)"b");
+static schedTimer tC(onFire, (void *)"c");
+static schedTimer tD(onFire, (void *)"d");
+static schedTimer tMark;
+
+static void runAt(unsigned long now)
+{
+    stubMillis = now;
+    sched_run();
+}
+
+void setUp(void)
+{
+    stubMillis = 0;
+    fired = "";
+}
+
+void tearDown(void)
+{
+    sched_cancel(&tA);
+    sched_cancel(&tB);
+    sched_cancel(&tC);
+    sched_cancel(&tD);
+    sched_cancel(&tMark);
+    TEST_ASSERT_NULL(timers);
+}
+
+static void test_deadline_order(void)
+{
+    unsigned long w;
+
+    TEST_ASSERT_FALSE(sched_nextDeadline(w));
+
+    sched_start(&tC, 30);
+    sched_start(&tA, 10);
+    sched_start(&tB, 20);
+
+    TEST_ASSERT_TRUE(sched_nextDeadline(w));
+    TEST_ASSERT_EQUAL_UINT(10, w);
+
+    runAt(9);
+    TEST_ASSERT_EQUAL_STRING("", fired.c_str());
+
+    // Due exactly at the deadline (the former polls
+    // compared with '>', ie fired 1ms later)
+    runAt(10);
+    TEST_ASSERT_EQUAL_STRING("a", fired.c_str());
+    TEST_ASSERT_FALSE(sched_armed(&tA));
+
+    // Several due at once run in deadline order
+    runAt(100);
+    TEST_ASSERT_EQUAL_STRING("abc", fired.c_str());
+    TEST_ASSERT_FALSE(sched_nextDeadline(w));
+}
+
+static void test_fifo_equal(void)
+{
+    sched_start(&tB, 50);
+    sched_start(&tA, 50);
+    sched_start(&tC, 50);
+    sched_start(&tD, 40);
+
+    // Re-arming moves a timer behind the others
+    sched_start(&tB, 50);
+
+    runAt(50);
+    TEST_ASSERT_EQUAL_STRING("dacb", fired.c_str());
+}
+
+static void test_periodic_phase(void)
+{
+    // First at 100, then every 100
+    sched_start(&tA, 100, 100);
+
+    runAt(99);
+    TEST_ASSERT_EQUAL_STRING("", fired.c_str());
+
+    // Late runs neither shift the phase nor catch up
+    // on missed periods
+    unsigned long runs[] = { 105, 199, 230, 299, 300, 720, 799, 800 };
+    unsigned long next[] = { 200, 200, 300, 300, 400, 800, 800, 900 };
+    for(int i = 0; i < 8; i++) {
+        runAt(runs[i]);
+        TEST_ASSERT_EQUAL_UINT(next[i], tA.when);
+        TEST_ASSERT_TRUE(sched_armed(&tA));
+    }
+    TEST_ASSERT_EQUAL_STRING("aaaaa", fired.c_str());
+
+    // No drift over many periods
+    for(unsigned long t = 900; t < 100900; t += 100) {
+        runAt(t + 7);
+    }
+    TEST_ASSERT_EQUAL_UINT(100900, tA.when);
+    TEST_ASSERT_EQUAL_UINT(5 + 1000, fired.size());
+}
+
+static void cancelOther(void *arg)
+{
+    fired += "x";
+    sched_cancel((schedTimer *)arg);
+}
+
+static void rearmSelf(void *arg)
+{
+    fired += "r";
+    if(fired.size() < 3) sched_start((schedTimer *)arg, 0);
+}
+
+static void test_cancel_during_run(void)
+{
+    schedTimer tX(cancelOther, &tB);
+
+    // Both due; x runs first and cancels b
+    sched_start(&tX, 10);
+    sched_start(&tB, 10);
+    sched_start(&tC, 20);
+    runAt(20);
+    TEST_ASSERT_EQUAL_STRING("xc", fired.c_str());
+    TEST_ASSERT_FALSE(sched_armed(&tB));
+
+    // A periodic timer cancelled by an earlier one
+    fired = "";
+    tX.arg = &tD;
+    sched_start(&tX, 10);
+    sched_start(&tD, 10, 10);
+    runAt(30);
+    TEST_ASSERT_EQUAL_STRING("x", fired.c_str());
+    TEST_ASSERT_FALSE(sched_armed(&tD));
+
+    // A periodic timer cancelling itself
+    fired = "";
+    tX.arg = &tX;
+    sched_start(&tX, 10, 10);
+    runAt(40);
+    TEST_ASSERT_EQUAL_STRING("x", fired.c_str());
+    TEST_ASSERT_FALSE(sched_armed(&tX));
+
+    // Re-armed to 0 from its function: Due, but run in
+    // the next sched_run() only
+    fired = "";
+    schedTimer tR(rearmSelf);
+    tR.arg = &tR;
+    sched_start(&tR, 0);
+    runAt(40);
+    TEST_ASSERT_EQUAL_STRING("r", fired.c_str());
+    runAt(40);
+    runAt(40);
+    runAt(40);
+    TEST_ASSERT_EQUAL_STRING("rrr", fired.c_str());
+    TEST_ASSERT_FALSE(sched_armed(&tR));
+
+    TEST_ASSERT_FALSE(sched_armed(&tX));
+}
+
+static void test_wraparound(void)
+{
+    unsigned long w;
+
+    stubMillis = ULONG_MAX - 5;
+
+    sched_start(&tB, 10);           // Due at 4, after wrap
+    sched_start(&tA, 3);            // Due at ULONG_MAX - 2
+    sched_start(&tC, 8, 20);        // Due at 2, then every 20
+
+    TEST_ASSERT_TRUE(sched_nextDeadline(w));
+    TEST_ASSERT_EQUAL_UINT(ULONG_MAX - 2, w);
+
+    runAt(ULONG_MAX);
+    TEST_ASSERT_EQUAL_STRING("a", fired.c_str());
+
+    runAt(1);
+    TEST_ASSERT_EQUAL_STRING("a", fired.c_str());
+
+    runAt(4);
+    TEST_ASSERT_EQUAL_STRING("acb", fired.c_str());
+    TEST_ASSERT_EQUAL_UINT(22, tC.when);
+
+    runAt(22);
+    TEST_ASSERT_EQUAL_STRING("acbc", fired.c_str());
+}
+
+static void test_mark_only(void)
+{
+    sched_start(&tMark, 1000);
+    TEST_ASSERT_TRUE(sched_armed(&tMark));
+
+    runAt(999);
+    TEST_ASSERT_TRUE(sched_armed(&tMark));
+    runAt(1000);
+    TEST_ASSERT_FALSE(sched_armed(&tMark));
+
+    // Cancel is harmless when not armed
+    sched_cancel(&tMark);
+    TEST_ASSERT_FALSE(sched_armed(&tMark));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_deadline_order);
+    RUN_TEST(test_fifo_equal);
+    RUN_TEST(test_periodic_phase);
+    RUN_TEST(test_cancel_during_run);
+    RUN_TEST(test_wraparound);
+    RUN_TEST(test_mark_only);
+    return UNITY_END();
+}
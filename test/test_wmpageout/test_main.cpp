@@ -0,0 +1,270 @@
+/*
+ * -------------------------------------------------------------------
+ * Remote Control
+ * (C) 2024-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Remote
+ * https://remote.out-a-ti.me
+ *
+ * Native test: WiFiManager chunked page output
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI; see src/remote_main.cpp
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <string>
+
+#include <Arduino.h>
+#include <WebServer.h>
+
+// Let the buffer allocation fail on demand
+static bool failAlloc = false;
+static void *testMalloc(size_t n) { return failAlloc ? NULL : malloc(n); }
+
+#define malloc(n) testMalloc(n)
+#include "src/WiFiManager/wm_pageout.cpp"
+#undef malloc
+
+#define PS WM_PAGEOUT_SIZE
+
+static std::string pattern(size_t len, unsigned seed)
+{
+    std::string s;
+    for(size_t i = 0; i < len; i++) s += (char)('a' + (i * 7 + seed) % 26);
+    return s;
+}
+
+// Headers once and first, every chunk full but the last,
+// body is what went in, terminated once
+static void checkResponse(WebServer& srv, const std::string& want)
+{
+    TEST_ASSERT_EQUAL_INT(1, srv.sends);
+    TEST_ASSERT_EQUAL_INT(200, srv.status);
+    TEST_ASSERT_EQUAL_STRING("text/html", srv.ctype.c_str());
+    TEST_ASSERT_TRUE(srv.contentLength == CONTENT_LENGTH_UNKNOWN);
+    TEST_ASSERT_EQUAL_INT(1, srv.ended);
+    for(size_t i = 0; i < srv.chunks.size(); i++) {
+        TEST_ASSERT_TRUE(srv.chunks[i].size() <= PS);
+        if(i + 1 < srv.chunks.size()) {
+            TEST_ASSERT_EQUAL_UINT(PS, srv.chunks[i].size());
+        }
+    }
+    TEST_ASSERT_TRUE(srv.body == want);
+}
+
+void setUp(void)
+{
+    failAlloc = false;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_empty(void)
+{
+    WebServer srv;
+    {
+        WMPageOut p(&srv);
+        p.end();
+        TEST_ASSERT_EQUAL_UINT(0, p.length());
+    }
+    TEST_ASSERT_EQUAL_UINT(0, srv.chunks.size());
+    checkResponse(srv, "");
+}
+
+static void test_headers_deferred(void)
+{
+    WebServer srv;
+    WMPageOut p(&srv);
+
+    // Nothing goes out before the buffer is full
+    p += "<html>";
+    p.add(pattern(PS - 7, 0).c_str(), PS - 7);
+    TEST_ASSERT_EQUAL_INT(0, srv.sends);
+    TEST_ASSERT_EQUAL_UINT(0, srv.chunks.size());
+
+    // One more byte fills it exactly
+    p += "x";
+    TEST_ASSERT_EQUAL_INT(1, srv.sends);
+    TEST_ASSERT_EQUAL_UINT(1, srv.chunks.size());
+    TEST_ASSERT_EQUAL_UINT(PS, srv.chunks[0].size());
+
+    // Buffer was full, not flushed again
+    p.end();
+    TEST_ASSERT_EQUAL_UINT(1, srv.chunks.size());
+    checkResponse(srv, "<html>" + pattern(PS - 7, 0) + "x");
+}
+
+static void test_exact_fills(void)
+{
+    static const size_t lens[] = { PS, 2 * PS, 3 * PS };
+
+    for(unsigned i = 0; i < 3; i++) {
+        WebServer srv;
+        std::string s = pattern(lens[i], i);
+        {
+            WMPageOut p(&srv);
+            p.add(s.c_str(), s.size());
+            p.end();
+            TEST_ASSERT_EQUAL_UINT(s.size(), p.length());
+        }
+        TEST_ASSERT_EQUAL_UINT(i + 1, srv.chunks.size());
+        checkResponse(srv, s);
+    }
+}
+
+static void test_spanning_pieces(void)
+{
+    // Pieces of every awkward size, including ones larger
+    // than the buffer and ones crossing its boundary
+    static const size_t lens[] = {
+        0, 1, PS - 1, 2, PS, PS + 1, 3 * PS + 5, 17, PS - 17, 0, 1
+    };
+
+    for(unsigned start = 0; start < 11; start++) {
+        WebServer srv;
+        std::string want;
+        {
+            WMPageOut p(&srv);
+            for(unsigned k = 0; k < 11; k++) {
+                size_t l = lens[(start + k) % 11];
+                std::string s = pattern(l, k);
+                p.add(s.c_str(), l);
+                want += s;
+            }
+            p.end();
+            TEST_ASSERT_EQUAL_UINT(want.size(), p.length());
+        }
+        TEST_ASSERT_EQUAL_UINT((want.size() + PS - 1) / PS, srv.chunks.size());
+        checkResponse(srv, want);
+    }
+}
+
+static void test_operators(void)
+{
+    WebServer srv;
+    {
+        WMPageOut p(&srv);
+        p += "a";
+        p += F("b");
+        p += String("cd");
+        p.add("efgh", 2);
+        p.end();
+        TEST_ASSERT_EQUAL_UINT(6, p.length());
+    }
+    checkResponse(srv, "abcdef");
+}
+
+static void test_tmpl(void)
+{
+    static const char * const vals[] = { "ONE", "", "<three>" };
+    WebServer srv;
+    {
+        WMPageOut p(&srv);
+        // Known tokens, unknown token, lone braces, brace at end
+        p.addTmpl("x{a}y{b}z{c}{c}-{q}-{}-{{a}}-{a", "abc", vals);
+        p.end();
+    }
+    checkResponse(srv, "xONEyz<three><three>-{q}-{}-{ONE}-{a");
+
+    WebServer srv2;
+    {
+        WMPageOut p(&srv2);
+        p.addTmpl("{", "a", vals);
+        p.addTmpl("{a", "a", vals);
+        p.addTmpl("", "a", vals);
+        p.addTmpl("{a}", "", vals);
+        p.end();
+    }
+    checkResponse(srv2, "{{a{a}");
+}
+
+static void test_tmpl_spanning(void)
+{
+    // Replacements crossing the buffer boundary
+    std::string big = pattern(PS + 3, 5);
+    const char * const vals[] = { big.c_str() };
+    std::string tmpl, want;
+
+    for(int i = 0; i < 5; i++) {
+        std::string pre = pattern(PS / 3 + i, i);
+        tmpl += pre + "{v}";
+        want += pre + big;
+    }
+
+    WebServer srv;
+    {
+        WMPageOut p(&srv);
+        p.addTmpl(tmpl.c_str(), "v", vals);
+        p.end();
+        TEST_ASSERT_EQUAL_UINT(want.size(), p.length());
+    }
+    checkResponse(srv, want);
+}
+
+static void test_no_buffer(void)
+{
+    static const char * const vals[] = { "A" };
+
+    failAlloc = true;
+
+    WebServer srv;
+    {
+        WMPageOut p(&srv);
+
+        // Headers go out with the first piece, each
+        // piece is a chunk of its own, whatever size
+        p += "<html>";
+        TEST_ASSERT_EQUAL_INT(1, srv.sends);
+        TEST_ASSERT_EQUAL_UINT(1, srv.chunks.size());
+
+        p.add("", 0);
+        std::string big = pattern(2 * PS + 1, 3);
+        p.add(big.c_str(), big.size());
+        p.addTmpl("-{a}-", "a", vals);
+        p.end();
+
+        TEST_ASSERT_EQUAL_UINT(6 + big.size() + 3, p.length());
+
+        // No empty chunks, which would end the response early
+        TEST_ASSERT_EQUAL_UINT(5, srv.chunks.size());
+        TEST_ASSERT_TRUE(srv.chunks[0] == "<html>");
+        TEST_ASSERT_TRUE(srv.chunks[1] == big);
+        TEST_ASSERT_TRUE(srv.chunks[2] == "-");
+        TEST_ASSERT_TRUE(srv.chunks[3] == "A");
+        TEST_ASSERT_TRUE(srv.chunks[4] == "-");
+        TEST_ASSERT_TRUE(srv.body == "<html>" + big + "-A-");
+    }
+    TEST_ASSERT_EQUAL_INT(1, srv.sends);
+    TEST_ASSERT_EQUAL_INT(1, srv.ended);
+}
+
+static void test_no_buffer_empty(void)
+{
+    failAlloc = true;
+
+    WebServer srv;
+    {
+        WMPageOut p(&srv);
+        p.end();
+    }
+    TEST_ASSERT_EQUAL_UINT(0, srv.chunks.size());
+    checkResponse(srv, "");
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty);
+    RUN_TEST(test_headers_deferred);
+    RUN_TEST(test_exact_fills);
+    RUN_TEST(test_spanning_pieces);
+    RUN_TEST(test_operators);
+    RUN_TEST(test_tmpl);
+    RUN_TEST(test_tmpl_spanning);
+    RUN_TEST(test_no_buffer);
+    RUN_TEST(test_no_buffer_empty);
+    return UNITY_END();
+}